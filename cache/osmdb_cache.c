@@ -0,0 +1,424 @@
+/*
+ * Copyright (c) 2021 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#define LOG_TAG "osmdb"
+#include "libcc/cc_log.h"
+#include "libcc/cc_memory.h"
+#include "osmdb_cache.h"
+
+/***********************************************************
+* private                                                  *
+***********************************************************/
+
+static uint64_t
+osmdb_cache_hash(size_t size, const void* data)
+{
+	ASSERT(data);
+
+	// FNV-1a
+	const unsigned char* ptr = (const unsigned char*) data;
+	uint64_t h = 0xCBF29CE484222325ULL;
+
+	size_t i;
+	for(i = 0; i < size; ++i)
+	{
+		h ^= (uint64_t) ptr[i];
+		h *= 0x100000001B3ULL;
+	}
+	return h;
+}
+
+static void
+osmdb_cache_key(uint64_t hash, int size, char* key)
+{
+	ASSERT(key);
+
+	snprintf(key, 256, "content/%016" PRIx64 "-%i",
+	         hash, size);
+}
+
+static int
+osmdb_cache_reserve(osmdb_cache_t* self, size_t size)
+{
+	ASSERT(self);
+
+	if(self->size_zdata >= size)
+	{
+		return 1;
+	}
+
+	void* tmp = REALLOC(self->zdata, size);
+	if(tmp == NULL)
+	{
+		LOGE("REALLOC failed");
+		return 0;
+	}
+
+	self->zdata      = (unsigned char*) tmp;
+	self->size_zdata = size;
+
+	return 1;
+}
+
+static osmdb_tile_t*
+osmdb_cache_inflate(osmdb_cacheRef_t* ref,
+                    size_t size, void* data,
+                    int zoom, int x, int y)
+{
+	ASSERT(ref);
+	ASSERT(data);
+
+	osmdb_cacheZ_t* z = (osmdb_cacheZ_t*) data;
+	if((size < sizeof(osmdb_cacheZ_t)) ||
+	   (z->magic != OSMDB_CACHE_MAGIC_Z) ||
+	   (z->size  != ref->size)           ||
+	   (z->size  < (int) sizeof(osmdb_tile_t)))
+	{
+		LOGE("invalid %i/%i/%i", zoom, x, y);
+		return NULL;
+	}
+
+	osmdb_tile_t* tile;
+	tile = (osmdb_tile_t*) MALLOC((size_t) z->size);
+	if(tile == NULL)
+	{
+		LOGE("MALLOC failed");
+		return NULL;
+	}
+
+	uLongf dsize = (uLongf) z->size;
+	if((uncompress((Bytef*) tile, &dsize,
+	               (const Bytef*) &z[1],
+	               (uLong) (size - sizeof(osmdb_cacheZ_t))) != Z_OK) ||
+	   (dsize != (uLongf) z->size))
+	{
+		LOGE("uncompress failed");
+		FREE(tile);
+		return NULL;
+	}
+
+	// restore the address
+	tile->zoom = zoom;
+	tile->x    = x;
+	tile->y    = y;
+
+	return tile;
+}
+
+static int
+osmdb_cache_compare(osmdb_cache_t* self,
+                    osmdb_cacheRef_t* ref, const char* key,
+                    osmdb_tile_t* tile, int* _equal)
+{
+	ASSERT(self);
+	ASSERT(ref);
+	ASSERT(key);
+	ASSERT(tile);
+	ASSERT(_equal);
+
+	size_t zsize = 0;
+	void*  zdata = NULL;
+	if(bfs_file_blobGet(self->file, 0, key, &zsize, &zdata) == 0)
+	{
+		return 0;
+	}
+
+	// the tile address is cleared for the content
+	osmdb_tile_t* content;
+	content = osmdb_cache_inflate(ref, zsize, zdata, 0, 0, 0);
+	if(content == NULL)
+	{
+		FREE(zdata);
+		return 0;
+	}
+
+	*_equal = (memcmp((const void*) content,
+	                  (const void*) tile,
+	                  (size_t) ref->size) == 0);
+
+	FREE(content);
+	FREE(zdata);
+
+	return 1;
+}
+
+/***********************************************************
+* public                                                   *
+***********************************************************/
+
+osmdb_cache_t* osmdb_cache_new(bfs_file_t* file)
+{
+	ASSERT(file);
+
+	osmdb_cache_t* self;
+	self = (osmdb_cache_t*) CALLOC(1, sizeof(osmdb_cache_t));
+	if(self == NULL)
+	{
+		LOGE("CALLOC failed");
+		return NULL;
+	}
+
+	self->file = file;
+
+	self->contents = cc_map_new();
+	if(self->contents == NULL)
+	{
+		goto fail_contents;
+	}
+
+	// success
+	return self;
+
+	// failure
+	fail_contents:
+		FREE(self);
+	return NULL;
+}
+
+void osmdb_cache_delete(osmdb_cache_t** _self)
+{
+	ASSERT(_self);
+
+	osmdb_cache_t* self = *_self;
+	if(self)
+	{
+		cc_map_discard(self->contents);
+		cc_map_delete(&self->contents);
+		FREE(self->zdata);
+		FREE(self);
+		*_self = NULL;
+	}
+}
+
+int osmdb_cache_put(osmdb_cache_t* self,
+                    size_t size, osmdb_tile_t* tile)
+{
+	ASSERT(self);
+	ASSERT(tile);
+
+	if((size < sizeof(osmdb_tile_t)) || (size > INT32_MAX))
+	{
+		LOGE("invalid size=%" PRIu64, (uint64_t) size);
+		return 0;
+	}
+
+	int zoom = tile->zoom;
+	int x    = tile->x;
+	int y    = tile->y;
+
+	// clear the address so that the content only depends
+	// on the tile features
+	tile->zoom = 0;
+	tile->x    = 0;
+	tile->y    = 0;
+
+	osmdb_cacheRef_t ref =
+	{
+		.magic = OSMDB_CACHE_MAGIC_REF,
+		.size  = (int) size,
+		.hash  = osmdb_cache_hash(size, (const void*) tile),
+	};
+
+	char key[256];
+	osmdb_cache_key(ref.hash, ref.size, key);
+
+	osmdb_cacheKey_t ckey =
+	{
+		.hash = ref.hash,
+		.size = (int64_t) size,
+	};
+
+	// the content is only shared when the bytes match since
+	// a hash collision would otherwise replace the tile
+	int           equal   = 0;
+	int           collide = 0;
+	cc_mapIter_t* miter;
+	miter = cc_map_findp(self->contents,
+	                     sizeof(osmdb_cacheKey_t), &ckey);
+	if(miter)
+	{
+		if(osmdb_cache_compare(self, &ref, key,
+		                       tile, &equal) == 0)
+		{
+			goto fail_content;
+		}
+		collide = (equal == 0);
+	}
+
+	if(equal)
+	{
+		++self->count_dedup;
+	}
+	else if(collide)
+	{
+		++self->count_collide;
+		self->bytes_z += size;
+	}
+	else
+	{
+		// compress the content
+		size_t zsize = sizeof(osmdb_cacheZ_t) +
+		               compressBound((uLong) size);
+		if(osmdb_cache_reserve(self, zsize) == 0)
+		{
+			goto fail_content;
+		}
+
+		osmdb_cacheZ_t* z = (osmdb_cacheZ_t*) self->zdata;
+		z->magic = OSMDB_CACHE_MAGIC_Z;
+		z->size  = (int) size;
+
+		uLongf dsize = (uLongf) (zsize - sizeof(osmdb_cacheZ_t));
+		if(compress2((Bytef*) &z[1], &dsize,
+		             (const Bytef*) tile, (uLong) size,
+		             Z_DEFAULT_COMPRESSION) != Z_OK)
+		{
+			LOGE("compress2 failed");
+			goto fail_content;
+		}
+		zsize = sizeof(osmdb_cacheZ_t) + (size_t) dsize;
+
+		if(bfs_file_blobSet(self->file, key, zsize,
+		                    (const void*) self->zdata) == 0)
+		{
+			goto fail_content;
+		}
+
+		if(cc_map_addp(self->contents,
+		               (const void*) (intptr_t) zsize,
+		               sizeof(osmdb_cacheKey_t),
+		               &ckey) == NULL)
+		{
+			goto fail_content;
+		}
+
+		self->bytes_z += zsize;
+	}
+
+	tile->zoom = zoom;
+	tile->x    = x;
+	tile->y    = y;
+
+	// colliding tiles are stored uncompressed in place of
+	// the ref (see osmdb_cache_get)
+	char name[256];
+	snprintf(name, 256, "%i/%i/%i", zoom, x, y);
+	if(collide)
+	{
+		if(bfs_file_blobSet(self->file, name, size,
+		                    (const void*) tile) == 0)
+		{
+			return 0;
+		}
+	}
+	else if(bfs_file_blobSet(self->file, name,
+	                         sizeof(osmdb_cacheRef_t),
+	                         (const void*) &ref) == 0)
+	{
+		return 0;
+	}
+
+	++self->count_put;
+	self->bytes_put += size;
+
+	// success
+	return 1;
+
+	// failure
+	fail_content:
+		tile->zoom = zoom;
+		tile->x    = x;
+		tile->y    = y;
+	return 0;
+}
+
+osmdb_tile_t* osmdb_cache_get(osmdb_cache_t* self,
+                              int zoom, int x, int y,
+                              size_t* _size)
+{
+	ASSERT(self);
+	ASSERT(_size);
+
+	char name[256];
+	snprintf(name, 256, "%i/%i/%i", zoom, x, y);
+
+	size_t size = 0;
+	void*  data = NULL;
+	if(bfs_file_blobGet(self->file, 0, name, &size, &data) == 0)
+	{
+		return NULL;
+	}
+	else if(size == 0)
+	{
+		// not found
+		FREE(data);
+		return NULL;
+	}
+
+	// tiles stored by an older prefetch or which collide
+	// with the content of another tile are uncompressed
+	osmdb_cacheRef_t* ref = (osmdb_cacheRef_t*) data;
+	if((size != sizeof(osmdb_cacheRef_t)) ||
+	   (ref->magic != OSMDB_CACHE_MAGIC_REF))
+	{
+		*_size = size;
+		return (osmdb_tile_t*) data;
+	}
+
+	char key[256];
+	osmdb_cache_key(ref->hash, ref->size, key);
+
+	size_t zsize = 0;
+	void*  zdata = NULL;
+	if(bfs_file_blobGet(self->file, 0, key, &zsize, &zdata) == 0)
+	{
+		goto fail_get;
+	}
+
+	osmdb_tile_t* tile;
+	tile = osmdb_cache_inflate(ref, zsize, zdata, zoom, x, y);
+	if(tile == NULL)
+	{
+		goto fail_inflate;
+	}
+	*_size = (size_t) ref->size;
+
+	FREE(zdata);
+	FREE(data);
+
+	// success
+	return tile;
+
+	// failure
+	fail_inflate:
+		FREE(zdata);
+	fail_get:
+		FREE(data);
+	return NULL;
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2021 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef osmdb_cache_H
+#define osmdb_cache_H
+
+#include <stdint.h>
+
+#include "libbfs/bfs_file.h"
+#include "libcc/cc_map.h"
+#include "../tiler/osmdb_tile.h"
+
+#define OSMDB_CACHE_MAGIC_REF 0xB00D90DC
+#define OSMDB_CACHE_MAGIC_Z   0xB00D90DD
+
+// the z/x/y blob is a ref to the compressed tile which is
+// stored once under the content key (see osmdb_cache_key)
+// tiles are compressed with the zoom/x/y cleared so that
+// identical tiles (e.g. ocean) share the content
+// the z/x/y blob may also be an uncompressed tile which
+// was stored by an older prefetch or whose content key
+// collides with a different tile
+typedef struct
+{
+	int      magic;
+	int      size;
+	uint64_t hash;
+} osmdb_cacheRef_t;
+
+typedef struct
+{
+	int magic;
+	int size;
+	// unsigned char zdata[];
+} osmdb_cacheZ_t;
+
+typedef struct
+{
+	uint64_t hash;
+	int64_t  size;
+} osmdb_cacheKey_t;
+
+typedef struct
+{
+	bfs_file_t* file;
+
+	// content which has been stored where the map val is
+	// the compressed size
+	cc_map_t* contents;
+
+	// compression buffer
+	size_t         size_zdata;
+	unsigned char* zdata;
+
+	// stats
+	uint64_t count_put;
+	uint64_t count_dedup;
+	uint64_t count_collide;
+	uint64_t bytes_put;
+	uint64_t bytes_z;
+} osmdb_cache_t;
+
+osmdb_cache_t* osmdb_cache_new(bfs_file_t* file);
+void           osmdb_cache_delete(osmdb_cache_t** _self);
+int            osmdb_cache_put(osmdb_cache_t* self,
+                               size_t size,
+                               osmdb_tile_t* tile);
+osmdb_tile_t*  osmdb_cache_get(osmdb_cache_t* self,
+                               int zoom, int x, int y,
+                               size_t* _size);
+
+#endif
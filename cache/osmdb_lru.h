@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2021 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef osmdb_lru_H
+#define osmdb_lru_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "libcc/cc_list.h"
+#include "libcc/cc_map.h"
+
+typedef struct
+{
+	int zoom;
+	int x;
+	int y;
+} osmdb_lruKey_t;
+
+// the tile data follows the entry
+typedef struct
+{
+	osmdb_lruKey_t key;
+	size_t         size;
+	// unsigned char data[];
+} osmdb_lruEntry_t;
+
+// byte bounded LRU cache of encoded tiles which may be
+// shared by multiple threads
+// the map val is the list iter and the list head is the
+// least recently used entry
+typedef struct
+{
+	size_t max_size;
+	size_t size;
+
+	pthread_mutex_t mutex;
+	cc_map_t*       map;
+	cc_list_t*      list;
+
+	// stats
+	uint64_t count_hit;
+	uint64_t count_miss;
+	uint64_t count_evict;
+} osmdb_lru_t;
+
+osmdb_lru_t* osmdb_lru_new(size_t max_size);
+void         osmdb_lru_delete(osmdb_lru_t** _self);
+void*        osmdb_lru_get(osmdb_lru_t* self,
+                           int zoom, int x, int y,
+                           size_t* _size);
+int          osmdb_lru_put(osmdb_lru_t* self,
+                           int zoom, int x, int y,
+                           size_t size, const void* data);
+
+#endif
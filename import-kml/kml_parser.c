@@ -32,6 +32,8 @@
 #include "libbfs/bfs_util.h"
 #include "libcc/cc_log.h"
 #include "libcc/cc_memory.h"
+#include "osmdb/osmdb_cover.h"
+#include "osmdb/osmdb_proj.h"
 #include "osmdb/osmdb_util.h"
 #include "terrain/terrain_util.h"
 
@@ -62,8 +64,8 @@ int osmdb_index_add(osmdb_index_t* self,
                     int type, int64_t id,
                     size_t size, void* data);
 int osmdb_index_addTile(osmdb_index_t* self,
-                        int type, int64_t major_id,
-                        int64_t ref);
+                        int type, int64_t id,
+                        int class, int64_t ref);
 void osmdb_nodeInfo_addName(osmdb_nodeInfo_t* self,
                             const char* name);
 void osmdb_wayInfo_addName(osmdb_wayInfo_t* self,
@@ -157,11 +159,13 @@ static int clamp(int val, int a, int b)
 
 static int
 kml_parser_addTileRange(kml_parser_t* self,
-                        int type, int64_t ref,
+                        int type, int64_t ref, int class,
                         double latT, double lonL,
                         double latB, double lonR,
-                        int min_zoom)
+                        int min_zoom,
+                        osmdb_cover_t* cover)
 {
+	// cover may be NULL
 	ASSERT(self);
 
 	if(min_zoom >= 15)
@@ -267,13 +271,41 @@ kml_parser_addTileRange(kml_parser_t* self,
 
 		int r;
 		int c;
+		if(cover && cover->count_edges)
+		{
+			// add the tiles which the geometry touches
+			if(osmdb_cover_rasterize(cover, zoom[i],
+			                         border) == 0)
+			{
+				return 0;
+			}
+
+			int j;
+			for(j = 0; j < cover->count_spans; ++j)
+			{
+				osmdb_coverSpan_t* span = &cover->spans[j];
+				for(c = span->col0; c <= span->col1; ++c)
+				{
+					id = (int64_t) pow2n[i]*span->row + c;
+					if(osmdb_index_addTile(self->index, type_array[i],
+					                       id, class, ref) == 0)
+					{
+						return 0;
+					}
+				}
+			}
+
+			++i;
+			continue;
+		}
+
 		for(r = iy0; r <= iy1; ++r)
 		{
 			for(c = ix0; c <= ix1; ++c)
 			{
 				id = (int64_t) pow2n[i]*r + c;
 				if(osmdb_index_addTile(self->index, type_array[i],
-				                       id, ref) == 0)
+				                       id, class, ref) == 0)
 				{
 					return 0;
 				}
@@ -347,13 +379,21 @@ kml_parser_wayAddSeg(kml_parser_t* self)
 			return 0;
 		}
 
+		osmdb_cover_reset(self->cover, 0);
+		if(osmdb_cover_addLine(self->cover,
+		                       self->seg_nds->count,
+		                       self->seg_pts) == 0)
+		{
+			return 0;
+		}
+
 		int min_zoom = sc->line->min_zoom;
 		if(kml_parser_addTileRange(self,
 		                           OSMDB_TYPE_WAYRANGE,
-		                           way_range.wid,
+		                           way_range.wid, self->class,
 		                           way_range.latT, way_range.lonL,
 		                           way_range.latB, way_range.lonR,
-		                           min_zoom) == 0)
+		                           min_zoom, self->cover) == 0)
 		{
 			return 0;
 		}
@@ -432,6 +472,8 @@ kml_parser_wayAddNd(kml_parser_t* self, osmdb_nodeCoord_t* node_coord)
 	// append to seg_nds
 	int64_t* nds = osmdb_wayNds_nds(self->seg_nds);
 	nds[self->seg_nds->count] = node_coord->nid;
+	self->seg_pts[self->seg_nds->count].x = node_coord->x;
+	self->seg_pts[self->seg_nds->count].y = node_coord->y;
 	++self->way_nds;
 	++self->seg_nds->count;
 }
@@ -543,6 +585,8 @@ kml_parser_parseNode(kml_parser_t* self, int min_zoom,
 		node_coord->nid = self->nid;
 		node_coord->lat = lat;
 		node_coord->lon = lon;
+		osmdb_proj_coord2world(1, &lat, &lon,
+		                       &node_coord->x, &node_coord->y);
 
 		if(cc_map_addp(map_node_coords,
 		               (const void*) node_coord,
@@ -735,7 +779,7 @@ kml_parser_beginPlacemark(kml_parser_t* self, int line,
 
 static int
 kml_parser_addTileCoord(kml_parser_t* self,
-                        int64_t ref,
+                        int64_t ref, int class,
                         double lat, double lon,
                         int min_zoom)
 {
@@ -805,7 +849,7 @@ kml_parser_addTileCoord(kml_parser_t* self,
 		iy = (int) y;
 		id = (int64_t) pow2n[i]*iy + ix;
 		if(osmdb_index_addTile(self->index, type_array[i],
-		                       id, ref) == 0)
+		                       id, class, ref) == 0)
 		{
 			return 0;
 		}
@@ -841,6 +885,9 @@ kml_parser_endPlacemark(kml_parser_t* self, int line,
 			.lon = self->way_lonL +
 			       (self->way_lonR - self->way_lonL)/2.0
 		};
+		osmdb_proj_coord2world(1, &node_coord.lat,
+		                       &node_coord.lon,
+		                       &node_coord.x, &node_coord.y);
 
 		size_t size = osmdb_nodeCoord_sizeof(&node_coord);
 		if(osmdb_index_add(self->index,
@@ -866,6 +913,7 @@ kml_parser_endPlacemark(kml_parser_t* self, int line,
 
 		int min_zoom = sc->point->min_zoom;
 		if(kml_parser_addTileCoord(self, node_coord.nid,
+		                           self->class,
 		                           node_coord.lat, node_coord.lon,
 		                           min_zoom) == 0)
 		{
@@ -1494,6 +1542,20 @@ kml_parser_new(float smem, const char* style,
 		goto fail_seg_nds;
 	}
 
+	self->seg_pts = (osmdb_worldPoint_t*)
+	                CALLOC(KML_PARSER_WAY_NDS,
+	                       sizeof(osmdb_worldPoint_t));
+	if(self->seg_pts == NULL)
+	{
+		goto fail_seg_pts;
+	}
+
+	self->cover = osmdb_cover_new();
+	if(self->cover == NULL)
+	{
+		goto fail_cover;
+	}
+
 	if(bfs_util_initialize() == 0)
 	{
 		goto fail_init;
@@ -1522,6 +1584,10 @@ kml_parser_new(float smem, const char* style,
 	fail_index:
 		bfs_util_shutdown();
 	fail_init:
+		osmdb_cover_delete(&self->cover);
+	fail_cover:
+		FREE(self->seg_pts);
+	fail_seg_pts:
 		FREE(self->seg_nds);
 	fail_seg_nds:
 		FREE(self->node_info);
@@ -1635,6 +1701,8 @@ void kml_parser_delete(kml_parser_t** _self)
 		osmdb_style_delete(&self->style);
 		osmdb_index_delete(&self->index);
 		bfs_util_shutdown();
+		osmdb_cover_delete(&self->cover);
+		FREE(self->seg_pts);
 		FREE(self->seg_nds);
 		FREE(self->node_info);
 		cc_map_delete(&self->map_node_coords15);
@@ -1707,7 +1775,8 @@ int kml_parser_finish(kml_parser_t* self)
 				return 0;
 			}
 
-			if(kml_parser_addTileCoord(self, node_coord->nid,
+			// way nds do not have a class
+			if(kml_parser_addTileCoord(self, node_coord->nid, 0,
 			                           node_coord->lat,
 			                           node_coord->lon,
 			                           min_zoom[i]) == 0)
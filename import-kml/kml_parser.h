@@ -29,6 +29,7 @@
 #include "libcc/cc_list.h"
 #include "libcc/cc_map.h"
 #include "osmdb/index/osmdb_index.h"
+#include "osmdb/osmdb_cover.h"
 #include "osmdb/osmdb_style.h"
 
 typedef struct
@@ -64,8 +65,12 @@ typedef struct
 	cc_map_t* map_node_coords15;
 
 	// parsing data
-	osmdb_nodeInfo_t* node_info;
-	osmdb_wayNds_t*   seg_nds;
+	osmdb_nodeInfo_t*   node_info;
+	osmdb_wayNds_t*     seg_nds;
+	osmdb_worldPoint_t* seg_pts;
+
+	// tile coverage
+	osmdb_cover_t* cover;
 
 	osmdb_index_t* index;
 
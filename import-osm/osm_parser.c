@@ -34,6 +34,8 @@
 #include "libcc/cc_memory.h"
 #include "libcc/cc_timestamp.h"
 #include "libxmlstream/xml_istream.h"
+#include "osmdb/osmdb_cover.h"
+#include "osmdb/osmdb_proj.h"
 #include "osmdb/osmdb_util.h"
 #include "terrain/terrain_util.h"
 #include "osm_parser.h"
@@ -45,8 +47,8 @@ int osmdb_index_add(osmdb_index_t* self,
                     int type, int64_t id,
                     size_t size, void* data);
 int osmdb_index_addTile(osmdb_index_t* self,
-                        int type, int64_t major_id,
-                        int64_t ref);
+                        int type, int64_t id,
+                        int class, int64_t ref);
 void osmdb_nodeInfo_addName(osmdb_nodeInfo_t* self,
                             const char* name);
 void osmdb_wayInfo_addName(osmdb_wayInfo_t* self,
@@ -67,6 +69,20 @@ void osmdb_relInfo_addName(osmdb_relInfo_t* self,
 #define OSM_STATE_OSM_REL_MEMBER 10
 #define OSM_STATE_DONE           -1
 
+// chains are referenced by the tiles at zoom 13 and below
+// and are limited in size since they are loaded by every
+// tile which they cross
+#define OSM_CHAIN_MAX_ZOOM  13
+#define OSM_CHAIN_MAX_COUNT 1024
+
+#define OSM_CHAINWAY_STATE_FREE    0
+#define OSM_CHAINWAY_STATE_USED    1
+#define OSM_CHAINWAY_STATE_CLAIMED 2
+
+// generalized geometry is stored for the tiles at zoom 9
+// and below (see OSMDB_TYPE_WAYGEN9)
+#define OSM_GEN_MAX_ZOOM 9
+
 #define ICONV_OPEN_ERR ((iconv_t) (-1))
 #define ICONV_CONV_ERR ((size_t) (-1))
 
@@ -1051,6 +1067,45 @@ osm_parser_beginOsm(osm_parser_t* self, int line,
 	return 1;
 }
 
+static int
+osm_parser_flushNodeCoords(osm_parser_t* self)
+{
+	ASSERT(self);
+
+	int count = self->node_batch_count;
+	if(count == 0)
+	{
+		return 1;
+	}
+	self->node_batch_count = 0;
+
+	// project the pending node coords in a single batch
+	osmdb_proj_coord2world(count, self->node_batch_lat,
+	                       self->node_batch_lon,
+	                       self->node_batch_x,
+	                       self->node_batch_y);
+
+	int i;
+	for(i = 0; i < count; ++i)
+	{
+		osmdb_nodeCoord_t* node_coord = &self->node_batch[i];
+		node_coord->x = self->node_batch_x[i];
+		node_coord->y = self->node_batch_y[i];
+
+		size_t size;
+		size = osmdb_nodeCoord_sizeof(node_coord);
+		if(osmdb_index_add(self->index,
+		                   OSMDB_TYPE_NODECOORD,
+		                   node_coord->nid,
+		                   size, (void*) node_coord) == 0)
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
 static int
 osm_parser_endOsm(osm_parser_t* self, int line,
                   const char* content)
@@ -1060,6 +1115,11 @@ osm_parser_endOsm(osm_parser_t* self, int line,
 
 	self->state = OSM_STATE_DONE;
 
+	if(osm_parser_flushNodeCoords(self) == 0)
+	{
+		return 0;
+	}
+
 	return osmdb_index_updateChangeset(self->index,
 	                                   self->tag_changeset);
 }
@@ -1135,7 +1195,7 @@ osm_parser_beginOsmNode(osm_parser_t* self, int line,
 
 static int
 osm_parser_addTileCoord(osm_parser_t* self,
-                        int64_t ref,
+                        int64_t ref, int class,
                         double lat, double lon,
                         int min_zoom)
 {
@@ -1171,7 +1231,7 @@ osm_parser_addTileCoord(osm_parser_t* self,
 		iy = (int) y;
 		id = (int64_t) pow2n[i]*iy + ix;
 		if(osmdb_index_addTile(self->index, type_array[i],
-		                       id, ref) == 0)
+		                       id, class, ref) == 0)
 		{
 			return 0;
 		}
@@ -1199,6 +1259,7 @@ osm_parser_insertNodeInfo(osm_parser_t* self, int min_zoom)
 
 	if(osm_parser_addTileCoord(self,
 	                           self->node_coord->nid,
+	                           self->node_info->class,
 	                           self->node_coord->lat,
 	                           self->node_coord->lon,
 	                           min_zoom) == 0)
@@ -1214,12 +1275,20 @@ osm_parser_insertNodeCoords(osm_parser_t* self)
 {
 	ASSERT(self);
 
-	size_t size;
-	size = osmdb_nodeCoord_sizeof(self->node_coord);
-	return osmdb_index_add(self->index,
-	                       OSMDB_TYPE_NODECOORD,
-	                       self->node_coord->nid,
-	                       size, (void*) self->node_coord);
+	// node coords are not read until the ways and rels
+	// so they may be deferred until the batch is full
+	int i = self->node_batch_count;
+	self->node_batch[i]     = *(self->node_coord);
+	self->node_batch_lat[i] = self->node_coord->lat;
+	self->node_batch_lon[i] = self->node_coord->lon;
+	++self->node_batch_count;
+
+	if(self->node_batch_count == OSM_PARSER_NODE_BATCH)
+	{
+		return osm_parser_flushNodeCoords(self);
+	}
+
+	return 1;
 }
 
 static int
@@ -1497,6 +1566,11 @@ osm_parser_beginOsmWay(osm_parser_t* self, int line,
 	ASSERT(self);
 	ASSERT(atts);
 
+	if(osm_parser_flushNodeCoords(self) == 0)
+	{
+		return 0;
+	}
+
 	self->state = OSM_STATE_OSM_WAY;
 	osm_parser_initWay(self);
 
@@ -1619,13 +1693,16 @@ static int clamp(int val, int a, int b)
 }
 
 static int
-osm_parser_addTileRange(osm_parser_t* self,
-                        int type, int64_t ref,
+osm_parser_addTileZooms(osm_parser_t* self,
+                        int type, int64_t ref, int class,
                         double latT, double lonL,
                         double latB, double lonR,
                         int center, int polygon,
-                        int min_zoom)
+                        int min_zoom,
+                        int zoom0, int zoom1,
+                        osmdb_cover_t* cover)
 {
+	// cover may be NULL
 	ASSERT(self);
 
 	// elements are defined with zero width but in
@@ -1698,6 +1775,13 @@ osm_parser_addTileRange(osm_parser_t* self,
 
 	while(min_zoom < max_zoom[i])
 	{
+		// refs are only added for zooms in [zoom0, zoom1]
+		if((zoom[i] < zoom0) || (zoom[i] > zoom1))
+		{
+			++i;
+			continue;
+		}
+
 		terrain_coord2tile(latT, lonL,
 		                   zoom[i], &x0, &y0);
 		terrain_coord2tile(latB, lonR,
@@ -1707,18 +1791,51 @@ osm_parser_addTileRange(osm_parser_t* self,
 		ix1 = clamp((int) (x1 + border), 0, pow2n[i] - 1);
 		iy1 = clamp((int) (y1 + border), 0, pow2n[i] - 1);
 
+		self->count_tiles_bbox += (uint64_t)
+		                          (ix1 - ix0 + 1)*(iy1 - iy0 + 1);
+
 		int r;
 		int c;
+		if(cover && (center == 0) && cover->count_edges)
+		{
+			// add the tiles which the geometry touches
+			if(osmdb_cover_rasterize(cover, zoom[i],
+			                         border) == 0)
+			{
+				return 0;
+			}
+
+			int j;
+			for(j = 0; j < cover->count_spans; ++j)
+			{
+				osmdb_coverSpan_t* span = &cover->spans[j];
+				for(c = span->col0; c <= span->col1; ++c)
+				{
+					id = (int64_t) pow2n[i]*span->row + c;
+					if(osmdb_index_addTile(self->index, type_array[i],
+					                       id, class, ref) == 0)
+					{
+						return 0;
+					}
+					++self->count_tiles;
+				}
+			}
+
+			++i;
+			continue;
+		}
+
 		for(r = iy0; r <= iy1; ++r)
 		{
 			for(c = ix0; c <= ix1; ++c)
 			{
 				id = (int64_t) pow2n[i]*r + c;
 				if(osmdb_index_addTile(self->index, type_array[i],
-				                       id, ref) == 0)
+				                       id, class, ref) == 0)
 				{
 					return 0;
 				}
+				++self->count_tiles;
 			}
 		}
 
@@ -1729,173 +1846,711 @@ osm_parser_addTileRange(osm_parser_t* self,
 }
 
 static int
-osm_parser_insertWay(osm_parser_t* self,
-                     int center, int polygon,
-                     int selected, int min_zoom)
+osm_parser_addTileRange(osm_parser_t* self,
+                        int type, int64_t ref, int class,
+                        double latT, double lonL,
+                        double latB, double lonR,
+                        int center, int polygon,
+                        int min_zoom,
+                        osmdb_cover_t* cover)
 {
+	// cover may be NULL
 	ASSERT(self);
 
-	size_t size;
-	size = osmdb_wayInfo_sizeof(self->way_info);
-	if(osmdb_index_add(self->index,
-	                   OSMDB_TYPE_WAYINFO,
-	                   self->way_info->wid,
-	                   size, (void*) self->way_info) == 0)
-	{
-		return 0;
-	}
+	return osm_parser_addTileZooms(self, type, ref, class,
+	                               latT, lonL, latB, lonR,
+	                               center, polygon, min_zoom,
+	                               0, 15, cover);
+}
 
-	// only compute the range if way was selected
-	// or recursively selected by osm_parser_computeRelRange
-	if(selected)
+static int
+osm_parser_resolveWay(osm_parser_t* self, int64_t wid,
+                      osmdb_wayRange_t* range,
+                      int count, int64_t* nds)
+{
+	ASSERT(self);
+	ASSERT(range);
+	ASSERT(nds);
+
+	osmdb_wayChain_t tmp_way_chain = { .count=count };
+	size_t size = osmdb_wayChain_sizeof(&tmp_way_chain);
+	if(size > self->way_chain_maxSize)
 	{
-		if(osm_parser_computeWayRange(self, self->way_nds,
-		                              self->way_range) == 0)
+		osmdb_wayChain_t* tmp;
+		tmp = (osmdb_wayChain_t*)
+		      REALLOC((void*) self->way_chain, size);
+		if(tmp == NULL)
 		{
+			LOGE("REALLOC failed");
 			return 0;
 		}
 
-		size = osmdb_wayRange_sizeof(self->way_range);
-		if(osmdb_index_add(self->index,
-		                   OSMDB_TYPE_WAYRANGE,
-		                   self->way_range->wid,
-		                   size, (void*) self->way_range) == 0)
+		self->way_chain         = tmp;
+		self->way_chain_maxSize = size;
+	}
+
+	osmdb_wayChain_t* way_chain = self->way_chain;
+	memset((void*) way_chain, 0, sizeof(osmdb_wayChain_t));
+	way_chain->cid   = wid;
+	way_chain->count = count;
+	memcpy((void*) &way_chain->range, (void*) range,
+	       sizeof(osmdb_wayRange_t));
+	way_chain->range.wid = wid;
+
+	// pts are written to a temporary location following
+	// the nds and moved once missing nds are discarded
+	int64_t*            way_nds = osmdb_wayChain_nds(way_chain);
+	osmdb_worldPoint_t* tmp_pts = osmdb_wayChain_pts(way_chain);
+
+	int i;
+	int j = 0;
+	for(i = 0; i < count; ++i)
+	{
+		osmdb_handle_t* hnc;
+		if(osmdb_index_get(self->index, 0,
+		                   OSMDB_TYPE_NODECOORD,
+		                   nds[i], &hnc) == 0)
 		{
 			return 0;
 		}
 
-		if(osm_parser_addTileRange(self,
-		                           OSMDB_TYPE_WAYRANGE,
-		                           self->way_range->wid,
-		                           self->way_range->latT,
-		                           self->way_range->lonL,
-		                           self->way_range->latB,
-		                           self->way_range->lonR,
-		                           center, polygon,
-		                           min_zoom) == 0)
+		// some nodes may not exist due to osmosis
+		if(hnc == NULL)
 		{
-			return 0;
+			continue;
 		}
-	}
 
-	size = osmdb_wayNds_sizeof(self->way_nds);
-	if(osmdb_index_add(self->index,
-	                   OSMDB_TYPE_WAYNDS,
-	                   self->way_nds->wid,
-	                   size, (void*) self->way_nds) == 0)
-	{
-		return 0;
+		way_nds[j]   = nds[i];
+		tmp_pts[j].x = hnc->node_coord->x;
+		tmp_pts[j].y = hnc->node_coord->y;
+		++j;
+
+		osmdb_index_put(self->index, &hnc);
 	}
 
+	way_chain->count = j;
+	memmove((void*) osmdb_wayChain_pts(way_chain),
+	        (void*) tmp_pts, j*sizeof(osmdb_worldPoint_t));
+
 	return 1;
 }
 
-static int min(int a, int b)
+static double
+osm_parser_dist2(osmdb_worldPoint_t* p,
+                 osmdb_worldPoint_t* a,
+                 osmdb_worldPoint_t* b)
 {
-	return (b < a) ? b : a;
+	ASSERT(p);
+	ASSERT(a);
+	ASSERT(b);
+
+	// squared distance from p to the line segment ab
+	double abx = (double) b->x - (double) a->x;
+	double aby = (double) b->y - (double) a->y;
+	double apx = (double) p->x - (double) a->x;
+	double apy = (double) p->y - (double) a->y;
+	double ab2 = abx*abx + aby*aby;
+	if(ab2 > 0.0)
+	{
+		double t = (apx*abx + apy*aby)/ab2;
+		if(t > 1.0)
+		{
+			apx = (double) p->x - (double) b->x;
+			apy = (double) p->y - (double) b->y;
+		}
+		else if(t > 0.0)
+		{
+			apx -= t*abx;
+			apy -= t*aby;
+		}
+	}
+
+	return apx*apx + apy*apy;
 }
 
 static int
-osm_parser_endOsmWay(osm_parser_t* self, int line,
-                     float progress, const char* content)
+osm_parser_generalize(osm_parser_t* self, int zoom,
+                      int count, osmdb_worldPoint_t* pts,
+                      int* _count)
 {
-	// content may be NULL
 	ASSERT(self);
+	ASSERT(pts);
+	ASSERT(_count);
 
-	self->state = OSM_STATE_OSM;
-
-	int center   = 0;
-	int selected = 0;
-	int polygon  = 0;
-
-	// override custom classes
-	if(self->ownership_national &&
-	   ((self->way_info->class == self->class_boundary_np) ||
-	    (self->way_info->class == self->class_boundary_pa)))
+	// resize the keep flags and stack
+	if(count > self->gen_maxCount)
 	{
-		if(self->protect_class == 2)
+		char* keep;
+		keep = (char*)
+		       REALLOC((void*) self->gen_keep,
+		               count*sizeof(char));
+		if(keep == NULL)
 		{
-			self->way_info->class = self->class_boundary_np2;
+			LOGE("REALLOC failed");
+			return 0;
 		}
-		else if(self->protect_class == 3)
+		self->gen_keep = keep;
+
+		int* stack;
+		stack = (int*)
+		        REALLOC((void*) self->gen_stack,
+		                2*count*sizeof(int));
+		if(stack == NULL)
 		{
-			self->way_info->class = self->class_boundary_nm3;
+			LOGE("REALLOC failed");
+			return 0;
 		}
+		self->gen_stack    = stack;
+		self->gen_maxCount = count;
 	}
-	else if(self->piste_downhill)
+
+	// the tolerance is half of the tiler tolerance (see
+	// osmdb_tilerState_init) in world coordinates since
+	// the tiler simplifies the geometry again
+	double tol  = (double) (1 << (21 - zoom));
+	double tol2 = tol*tol;
+
+	int   i;
+	char* keep  = self->gen_keep;
+	int*  stack = self->gen_stack;
+	for(i = 0; i < count; ++i)
 	{
-		if(self->piste_difficulty == 0)
+		keep[i] = 0;
+		if((i == 0) || (i == count - 1))
 		{
-			self->way_info->class = self->class_piste_downhill0;
+			keep[i] = 1;
 		}
-		else if(self->piste_difficulty == 1)
+	}
+
+	// Douglas-Peucker simplification
+	int top = 0;
+	if(count > 2)
+	{
+		stack[top++] = 0;
+		stack[top++] = count - 1;
+	}
+
+	while(top)
+	{
+		int i1 = stack[--top];
+		int i0 = stack[--top];
+
+		// find the farthest point from the segment
+		int    k    = -1;
+		double max2 = 0.0;
+		for(i = i0 + 1; i < i1; ++i)
 		{
-			self->way_info->class = self->class_piste_downhill1;
+			double d2 = osm_parser_dist2(&pts[i], &pts[i0],
+			                             &pts[i1]);
+			if(d2 > max2)
+			{
+				k    = i;
+				max2 = d2;
+			}
 		}
-		else if(self->piste_difficulty == 2)
+
+		if((k >= 0) && (max2 > tol2))
 		{
-			self->way_info->class = self->class_piste_downhill2;
+			keep[k] = 1;
+			stack[top++] = i0;
+			stack[top++] = k;
+			stack[top++] = k;
+			stack[top++] = i1;
 		}
-		else if(self->piste_difficulty == 3)
+	}
+
+	int j = 0;
+	for(i = 0; i < count; ++i)
+	{
+		if(keep[i])
 		{
-			self->way_info->class = self->class_piste_downhill3;
+			++j;
 		}
-		else if(self->piste_difficulty == 4)
+	}
+	*_count = j;
+
+	return 1;
+}
+
+static void
+osm_parser_copyGen(osm_parser_t* self, int count,
+                   int64_t* src_nds,
+                   osmdb_worldPoint_t* src_pts,
+                   int64_t* dst_nds,
+                   osmdb_worldPoint_t* dst_pts)
+{
+	ASSERT(self);
+	ASSERT(src_nds);
+	ASSERT(src_pts);
+	ASSERT(dst_nds);
+	ASSERT(dst_pts);
+
+	int i;
+	int j = 0;
+	for(i = 0; i < count; ++i)
+	{
+		if(self->gen_keep[i])
 		{
-			self->way_info->class = self->class_piste_downhill4;
+			dst_nds[j] = src_nds[i];
+			dst_pts[j] = src_pts[i];
+			++j;
 		}
 	}
-	else if(self->piste_nordic &&
-	        (self->way_info->class == self->class_none))
+}
+
+static int
+osm_parser_addWayGens(osm_parser_t* self, int64_t ref,
+                      osmdb_wayChain_t* src, int min_zoom)
+{
+	ASSERT(self);
+	ASSERT(src);
+
+	if(src->count < 2)
 	{
-		self->way_info->class = self->class_piste_nordic;
+		return 1;
 	}
 
-	const char* class_name;
-	class_name = osmdb_classCodeToName(self->way_info->class);
+	// generalized ways are smaller than the source
+	size_t size = osmdb_wayChain_sizeof(src);
+	if(size > self->way_gen_maxSize)
+	{
+		osmdb_wayChain_t* tmp;
+		tmp = (osmdb_wayChain_t*)
+		      REALLOC((void*) self->way_gen, size);
+		if(tmp == NULL)
+		{
+			LOGE("REALLOC failed");
+			return 0;
+		}
 
-	// select ways
-	osmdb_styleClass_t* sc1;
-	osmdb_styleClass_t* sc2 = NULL;
-	sc1 = osmdb_style_class(self->style, class_name);
+		self->way_gen         = tmp;
+		self->way_gen_maxSize = size;
+	}
 
-	int is_bldg = self->way_info->flags &
-	              OSMDB_WAYINFO_FLAG_BUILDING;
-	if(is_bldg)
+	// generalize for each low zoom tile which references
+	// the way (see osm_parser_addTileZooms)
+	int type[]     =
 	{
-		sc2 = osmdb_style_class(self->style, "building:yes");
-	}
+		OSMDB_TYPE_WAYGEN9,
+		OSMDB_TYPE_WAYGEN7,
+		OSMDB_TYPE_WAYGEN5,
+		OSMDB_TYPE_WAYGEN3,
+	};
+	int zoom[]     = { 9,  7, 5, 3 };
+	int max_zoom[] = { 11, 9, 7, 5 };
 
-	int min_zoom = 999;
-	if(sc1 || sc2)
+	int i;
+	int count;
+	osmdb_wayChain_t* way_gen = self->way_gen;
+	for(i = 0; (i < 4) && (min_zoom < max_zoom[i]); ++i)
 	{
-		int has_name = 0;
-		if((self->tag_name[0] != '\0') ||
-		   (self->tag_ref[0]  != '\0'))
+		if(osm_parser_generalize(self, zoom[i], src->count,
+		                         osmdb_wayChain_pts(src),
+		                         &count) == 0)
 		{
-			has_name = 1;
+			return 0;
 		}
 
-		// select the way as a line
-		// when named or when the named mode is not set
-		if(sc1 &&
-		   (sc1->line &&
-		    (has_name ||
-		     ((sc1->line->mode & OSMDB_STYLE_MODE_NAMED) == 0))))
+		memset((void*) way_gen, 0, sizeof(osmdb_wayChain_t));
+		way_gen->cid   = ref;
+		way_gen->count = count;
+		memcpy((void*) &way_gen->range, (void*) &src->range,
+		       sizeof(osmdb_wayRange_t));
+		osm_parser_copyGen(self, src->count,
+		                   osmdb_wayChain_nds(src),
+		                   osmdb_wayChain_pts(src),
+		                   osmdb_wayChain_nds(way_gen),
+		                   osmdb_wayChain_pts(way_gen));
+
+		size = osmdb_wayChain_sizeof(way_gen);
+		if(osmdb_index_add(self->index, type[i], ref,
+		                   size, (void*) way_gen) == 0)
 		{
-			selected = 1;
-			min_zoom = min(min_zoom, osmdb_styleClass_minZoom(sc1));
+			return 0;
 		}
-		else if(sc2 &&
-		        (sc2->line &&
-		         (has_name ||
-		          ((sc2->line->mode & OSMDB_STYLE_MODE_NAMED) == 0))))
+	}
+
+	return 1;
+}
+
+static int
+osm_parser_coverWay(osm_parser_t* self, int polygon)
+{
+	ASSERT(self);
+
+	// cover the resolved way (see osm_parser_resolveWay)
+	osmdb_wayChain_t* way_chain = self->way_chain;
+	osmdb_cover_reset(self->cover, polygon);
+	return osmdb_cover_addLine(self->cover, way_chain->count,
+	                           osmdb_wayChain_pts(way_chain));
+}
+
+static int
+osm_parser_coverRings(osm_parser_t* self, int polygon)
+{
+	ASSERT(self);
+
+	// cover the assembled rings (see
+	// osm_parser_insertRelRings)
+	osmdb_relRings_t* rel_rings = self->rel_rings;
+	osmdb_cover_reset(self->cover, polygon);
+
+	int i;
+	osmdb_relRing_t* ring = NULL;
+	for(i = 0; i < rel_rings->count; ++i)
+	{
+		ring = osmdb_relRings_ring(rel_rings, ring);
+		if(osmdb_cover_addLine(self->cover, ring->count,
+		                       osmdb_relRing_pts(ring)) == 0)
 		{
-			selected = 1;
-			min_zoom = min(min_zoom, osmdb_styleClass_minZoom(sc2));
+			return 0;
 		}
+	}
 
-		// select the way as a polygon
+	return 1;
+}
+
+static int
+osm_parser_addRelGens(osm_parser_t* self, int min_zoom)
+{
+	ASSERT(self);
+
+	osmdb_relRings_t* src = self->rel_rings;
+
+	// generalized rings are smaller than the source
+	size_t size = osmdb_relRings_sizeof(src);
+	if(size > self->rel_gen_maxSize)
+	{
+		osmdb_relRings_t* tmp;
+		tmp = (osmdb_relRings_t*)
+		      REALLOC((void*) self->rel_gen, size);
+		if(tmp == NULL)
+		{
+			LOGE("REALLOC failed");
+			return 0;
+		}
+
+		self->rel_gen         = tmp;
+		self->rel_gen_maxSize = size;
+	}
+
+	// generalize for each low zoom tile which references
+	// the rel (see osm_parser_addTileZooms)
+	int type[]     =
+	{
+		OSMDB_TYPE_RELGEN9,
+		OSMDB_TYPE_RELGEN7,
+		OSMDB_TYPE_RELGEN5,
+		OSMDB_TYPE_RELGEN3,
+	};
+	int zoom[]     = { 9,  7, 5, 3 };
+	int max_zoom[] = { 11, 9, 7, 5 };
+
+	int i;
+	int j;
+	int count;
+	osmdb_relRings_t* rel_gen = self->rel_gen;
+	for(i = 0; (i < 4) && (min_zoom < max_zoom[i]); ++i)
+	{
+		// copy the header and wids
+		size = sizeof(osmdb_relRings_t) +
+		       src->count_wids*sizeof(int64_t);
+		memcpy((void*) rel_gen, (void*) src, size);
+
+		osmdb_relRing_t* src_ring = NULL;
+		osmdb_relRing_t* gen_ring = NULL;
+		for(j = 0; j < src->count; ++j)
+		{
+			src_ring = osmdb_relRings_ring(src, src_ring);
+			gen_ring = osmdb_relRings_ring(rel_gen, gen_ring);
+
+			if(osm_parser_generalize(self, zoom[i],
+			                         src_ring->count,
+			                         osmdb_relRing_pts(src_ring),
+			                         &count) == 0)
+			{
+				return 0;
+			}
+
+			memcpy((void*) gen_ring, (void*) src_ring,
+			       sizeof(osmdb_relRing_t));
+			gen_ring->count = count;
+			osm_parser_copyGen(self, src_ring->count,
+			                   osmdb_relRing_nds(src_ring),
+			                   osmdb_relRing_pts(src_ring),
+			                   osmdb_relRing_nds(gen_ring),
+			                   osmdb_relRing_pts(gen_ring));
+
+			size += osmdb_relRing_sizeof(gen_ring);
+		}
+
+		if(osmdb_index_add(self->index, type[i],
+		                   rel_gen->rid,
+		                   size, (void*) rel_gen) == 0)
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+static int
+osm_parser_addChainWay(osm_parser_t* self, int min_zoom)
+{
+	ASSERT(self);
+
+	// update chain ways size
+	if(self->chain_ways_maxCount <= self->chain_ways_count)
+	{
+		int max_count = 2*self->chain_ways_maxCount;
+		if(max_count < 256)
+		{
+			max_count = 256;
+		}
+
+		osm_chainWay_t* tmp;
+		tmp = (osm_chainWay_t*)
+		      REALLOC((void*) self->chain_ways,
+		              max_count*sizeof(osm_chainWay_t));
+		if(tmp == NULL)
+		{
+			LOGE("REALLOC failed");
+			return 0;
+		}
+
+		self->chain_ways          = tmp;
+		self->chain_ways_maxCount = max_count;
+	}
+
+	int64_t* nds = osmdb_wayNds_nds(self->way_nds);
+
+	osm_chainWay_t* cw;
+	cw = &self->chain_ways[self->chain_ways_count];
+	memset((void*) cw, 0, sizeof(osm_chainWay_t));
+	cw->wid      = self->way_info->wid;
+	cw->ref1     = nds[0];
+	cw->ref2     = nds[self->way_nds->count - 1];
+	cw->class    = self->way_info->class;
+	cw->flags    = self->way_info->flags;
+	cw->layer    = self->way_info->layer;
+	cw->min_zoom = min_zoom;
+	cw->state    = OSM_CHAINWAY_STATE_FREE;
+
+	self->chain_ways_count += 1;
+	self->chain_ways_sorted = 0;
+
+	return 1;
+}
+
+static int
+osm_parser_insertWay(osm_parser_t* self,
+                     int center, int polygon,
+                     int selected, int min_zoom)
+{
+	ASSERT(self);
+
+	size_t size;
+	size = osmdb_wayInfo_sizeof(self->way_info);
+	if(osmdb_index_add(self->index,
+	                   OSMDB_TYPE_WAYINFO,
+	                   self->way_info->wid,
+	                   size, (void*) self->way_info) == 0)
+	{
+		return 0;
+	}
+
+	// only compute the range if way was selected
+	// or recursively selected by osm_parser_computeRelRange
+	if(selected)
+	{
+		if(osm_parser_computeWayRange(self, self->way_nds,
+		                              self->way_range) == 0)
+		{
+			return 0;
+		}
+
+		size = osmdb_wayRange_sizeof(self->way_range);
+		if(osmdb_index_add(self->index,
+		                   OSMDB_TYPE_WAYRANGE,
+		                   self->way_range->wid,
+		                   size, (void*) self->way_range) == 0)
+		{
+			return 0;
+		}
+
+		// defer the tile refs of lines which may be merged
+		// into chains for the low zoom tiles
+		int      count = self->way_nds->count;
+		int64_t* nds   = osmdb_wayNds_nds(self->way_nds);
+		if((center == 0) && (polygon == 0) &&
+		   (min_zoom <= OSM_CHAIN_MAX_ZOOM) &&
+		   (count >= 2) && (nds[0] != nds[count - 1]))
+		{
+			if(osm_parser_addChainWay(self, min_zoom) == 0)
+			{
+				return 0;
+			}
+		}
+		else
+		{
+			// resolve the way once for the tile coverage and
+			// the generalized geometry where only closed
+			// polygons are filled
+			int fill = polygon && (count >= 2) &&
+			           (nds[0] == nds[count - 1]);
+			if((osm_parser_resolveWay(self,
+			                          self->way_range->wid,
+			                          self->way_range,
+			                          count, nds) == 0) ||
+			   (osm_parser_coverWay(self, fill) == 0))
+			{
+				return 0;
+			}
+
+			if(osm_parser_addTileRange(self,
+			                           OSMDB_TYPE_WAYRANGE,
+			                           self->way_range->wid,
+			                           self->way_info->class,
+			                           self->way_range->latT,
+			                           self->way_range->lonL,
+			                           self->way_range->latB,
+			                           self->way_range->lonR,
+			                           center, polygon,
+			                           min_zoom,
+			                           self->cover) == 0)
+			{
+				return 0;
+			}
+
+			if(osm_parser_addWayGens(self,
+			                         self->way_range->wid,
+			                         self->way_chain,
+			                         min_zoom) == 0)
+			{
+				return 0;
+			}
+		}
+	}
+
+	size = osmdb_wayNds_sizeof(self->way_nds);
+	if(osmdb_index_add(self->index,
+	                   OSMDB_TYPE_WAYNDS,
+	                   self->way_nds->wid,
+	                   size, (void*) self->way_nds) == 0)
+	{
+		return 0;
+	}
+
+	return 1;
+}
+
+static int min(int a, int b)
+{
+	return (b < a) ? b : a;
+}
+
+static int
+osm_parser_endOsmWay(osm_parser_t* self, int line,
+                     float progress, const char* content)
+{
+	// content may be NULL
+	ASSERT(self);
+
+	self->state = OSM_STATE_OSM;
+
+	int center   = 0;
+	int selected = 0;
+	int polygon  = 0;
+
+	// override custom classes
+	if(self->ownership_national &&
+	   ((self->way_info->class == self->class_boundary_np) ||
+	    (self->way_info->class == self->class_boundary_pa)))
+	{
+		if(self->protect_class == 2)
+		{
+			self->way_info->class = self->class_boundary_np2;
+		}
+		else if(self->protect_class == 3)
+		{
+			self->way_info->class = self->class_boundary_nm3;
+		}
+	}
+	else if(self->piste_downhill)
+	{
+		if(self->piste_difficulty == 0)
+		{
+			self->way_info->class = self->class_piste_downhill0;
+		}
+		else if(self->piste_difficulty == 1)
+		{
+			self->way_info->class = self->class_piste_downhill1;
+		}
+		else if(self->piste_difficulty == 2)
+		{
+			self->way_info->class = self->class_piste_downhill2;
+		}
+		else if(self->piste_difficulty == 3)
+		{
+			self->way_info->class = self->class_piste_downhill3;
+		}
+		else if(self->piste_difficulty == 4)
+		{
+			self->way_info->class = self->class_piste_downhill4;
+		}
+	}
+	else if(self->piste_nordic &&
+	        (self->way_info->class == self->class_none))
+	{
+		self->way_info->class = self->class_piste_nordic;
+	}
+
+	const char* class_name;
+	class_name = osmdb_classCodeToName(self->way_info->class);
+
+	// select ways
+	osmdb_styleClass_t* sc1;
+	osmdb_styleClass_t* sc2 = NULL;
+	sc1 = osmdb_style_class(self->style, class_name);
+
+	int is_bldg = self->way_info->flags &
+	              OSMDB_WAYINFO_FLAG_BUILDING;
+	if(is_bldg)
+	{
+		sc2 = osmdb_style_class(self->style, "building:yes");
+	}
+
+	int min_zoom = 999;
+	if(sc1 || sc2)
+	{
+		int has_name = 0;
+		if((self->tag_name[0] != '\0') ||
+		   (self->tag_ref[0]  != '\0'))
+		{
+			has_name = 1;
+		}
+
+		// select the way as a line
+		// when named or when the named mode is not set
+		if(sc1 &&
+		   (sc1->line &&
+		    (has_name ||
+		     ((sc1->line->mode & OSMDB_STYLE_MODE_NAMED) == 0))))
+		{
+			selected = 1;
+			min_zoom = min(min_zoom, osmdb_styleClass_minZoom(sc1));
+		}
+		else if(sc2 &&
+		        (sc2->line &&
+		         (has_name ||
+		          ((sc2->line->mode & OSMDB_STYLE_MODE_NAMED) == 0))))
+		{
+			selected = 1;
+			min_zoom = min(min_zoom, osmdb_styleClass_minZoom(sc2));
+		}
+
+		// select the way as a polygon
 		if(sc1 && sc1->poly)
 		{
 			polygon  = 1;
@@ -1969,6 +2624,15 @@ osm_parser_endOsmWay(osm_parser_t* self, int line,
 		                      self->tag_ref);
 	}
 
+	// closed ways which are selected as polygons are areas
+	// which the tiler clips as polygons rather than lines
+	int      count = self->way_nds->count;
+	int64_t* nds   = osmdb_wayNds_nds(self->way_nds);
+	if(polygon && (count >= 2) && (nds[0] == nds[count - 1]))
+	{
+		self->way_info->flags |= OSMDB_WAYINFO_FLAG_AREA;
+	}
+
 	// always add ways since they may be transitively selected
 	if(osm_parser_insertWay(self, center, polygon,
 	                        selected, min_zoom) == 0)
@@ -2189,226 +2853,1432 @@ osm_parser_beginOsmWayNd(osm_parser_t* self, int line,
 	// update nds size
 	if(self->way_nds_maxCount <= self->way_nds->count)
 	{
-		osmdb_wayNds_t tmp_size =
+		osmdb_wayNds_t tmp_size =
+		{
+			.count=2*self->way_nds_maxCount
+		};
+
+		size_t size = osmdb_wayNds_sizeof(&tmp_size);
+
+		osmdb_wayNds_t* tmp;
+		tmp = (osmdb_wayNds_t*)
+		      REALLOC((void*) self->way_nds, size);
+		if(tmp == NULL)
+		{
+			LOGE("REALLOC failed");
+			return 0;
+		}
+
+		self->way_nds           = tmp;
+		self->way_nds_maxCount  = tmp_size.count;
+	}
+
+	int64_t ref = 0;
+
+	// parse the ref
+	int i = 0;
+	int j = 1;
+	while(atts[i] && atts[j])
+	{
+		if(strcmp(atts[i], "ref") == 0)
+		{
+			ref = (int64_t) strtoll(atts[j], NULL, 0);
+			break;
+		}
+
+		i += 2;
+		j += 2;
+	}
+
+	if(ref == 0)
+	{
+		LOGE("invalid ref=0");
+		return 0;
+	}
+
+	int64_t* nds = osmdb_wayNds_nds(self->way_nds);
+	nds[self->way_nds->count] = ref;
+	self->way_nds->count += 1;
+
+	return 1;
+}
+
+static int
+osm_parser_endOsmWayNd(osm_parser_t* self, int line,
+                       const char* content)
+{
+	// content may be NULL
+	ASSERT(self);
+
+	self->state = OSM_STATE_OSM_WAY;
+
+	return 1;
+}
+
+static int
+osm_parser_beginOsmRel(osm_parser_t* self, int line,
+                       const char** atts)
+{
+	ASSERT(self);
+	ASSERT(atts);
+
+	if(osm_parser_flushNodeCoords(self) == 0)
+	{
+		return 0;
+	}
+
+	self->state = OSM_STATE_OSM_REL;
+	osm_parser_initRel(self);
+
+	int i = 0;
+	int j = 1;
+	while(atts[i] && atts[j])
+	{
+		if(strcmp(atts[i], "id")  == 0)
+		{
+			self->rel_info->rid    = (int64_t)
+			                         strtoll(atts[j], NULL, 0);
+			self->rel_members->rid = self->rel_info->rid;
+			self->rel_range->rid   = self->rel_info->rid;
+		}
+		else if(strcmp(atts[i], "changeset") == 0)
+		{
+			int64_t changeset = (int64_t)
+			                    strtoll(atts[j], NULL, 0);
+			if(changeset > self->tag_changeset)
+			{
+				self->tag_changeset = changeset;
+			}
+		}
+
+		i += 2;
+		j += 2;
+	}
+
+	return 1;
+}
+
+static int
+osm_parser_computeRelRange(osm_parser_t* self)
+{
+	ASSERT(self);
+
+	osmdb_handle_t*     hnd_way_range;
+	osmdb_handle_t*     hnd_way_nds;
+	osmdb_relMembers_t* rel_members = self->rel_members;
+	osmdb_relRange_t*   rel_range   = self->rel_range;
+	osmdb_wayRange_t*   way_range;
+	osmdb_wayRange_t    tmp_way_range;
+
+	// ignore
+	if(rel_members->count == 0)
+	{
+		return 1;
+	}
+
+	osmdb_relData_t* data;
+	data = osmdb_relMembers_data(rel_members);
+
+	int i;
+	int first = 1;
+	for(i = 0; i < rel_members->count; ++i)
+	{
+		if(osmdb_index_get(self->index, 0,
+		                   OSMDB_TYPE_WAYRANGE,
+		                   data[i].wid, &hnd_way_range) == 0)
+		{
+			return 0;
+		}
+
+		// some way ranges may not exist due to osmosis or must
+		// be computed since they were not selected by
+		// osm_parser_insertWay
+		if(hnd_way_range)
+		{
+			way_range = hnd_way_range->way_range;
+		}
+		else
+		{
+			way_range = &tmp_way_range;
+			way_range->wid  = data[i].wid;
+			way_range->latT = 0.0;
+			way_range->lonL = 0.0;
+			way_range->latB = 0.0;
+			way_range->lonR = 0.0;
+
+			if(osmdb_index_get(self->index, 0,
+			                   OSMDB_TYPE_WAYNDS,
+			                   data[i].wid, &hnd_way_nds) == 0)
+			{
+				return 0;
+			}
+
+			// some ways may not exist due to osmosis
+			if(hnd_way_nds == NULL)
+			{
+				continue;
+			}
+
+			if(osm_parser_computeWayRange(self,
+			                              hnd_way_nds->way_nds,
+			                              way_range) == 0)
+			{
+				osmdb_index_put(self->index, &hnd_way_nds);
+				return 0;
+			}
+
+			size_t size;
+			size = osmdb_wayRange_sizeof(way_range);
+			if(osmdb_index_add(self->index,
+			                   OSMDB_TYPE_WAYRANGE,
+			                   way_range->wid,
+			                   size, (void*) way_range) == 0)
+			{
+				osmdb_index_put(self->index, &hnd_way_nds);
+				return 0;
+			}
+
+			osmdb_index_put(self->index, &hnd_way_nds);
+		}
+
+		if(first)
+		{
+			rel_range->latT = way_range->latT;
+			rel_range->lonL = way_range->lonL;
+			rel_range->latB = way_range->latB;
+			rel_range->lonR = way_range->lonR;
+
+			first = 0;
+		}
+		else
+		{
+			if(way_range->latT > rel_range->latT)
+			{
+				rel_range->latT = way_range->latT;
+			}
+
+			if(way_range->lonL < rel_range->lonL)
+			{
+				rel_range->lonL = way_range->lonL;
+			}
+
+			if(way_range->latB < rel_range->latB)
+			{
+				rel_range->latB = way_range->latB;
+			}
+
+			if(way_range->lonR > rel_range->lonR)
+			{
+				rel_range->lonR = way_range->lonR;
+			}
+		}
+
+		// hnd_way_range may be NULL
+		osmdb_index_put(self->index, &hnd_way_range);
+	}
+
+	return 1;
+}
+
+static int osm_chainWay_cmp(const void* a, const void* b)
+{
+	ASSERT(a);
+	ASSERT(b);
+
+	const osm_chainWay_t* cwa = (const osm_chainWay_t*) a;
+	const osm_chainWay_t* cwb = (const osm_chainWay_t*) b;
+
+	if(cwa->wid < cwb->wid)
+	{
+		return -1;
+	}
+	else if(cwa->wid > cwb->wid)
+	{
+		return 1;
+	}
+
+	return 0;
+}
+
+static void
+osm_parser_sortChainWays(osm_parser_t* self)
+{
+	ASSERT(self);
+
+	if(self->chain_ways_sorted == 0)
+	{
+		qsort((void*) self->chain_ways,
+		      (size_t) self->chain_ways_count,
+		      sizeof(osm_chainWay_t), osm_chainWay_cmp);
+		self->chain_ways_sorted = 1;
+	}
+}
+
+static osm_chainWay_t*
+osm_parser_findChainWay(osm_parser_t* self, int64_t wid)
+{
+	ASSERT(self);
+
+	osm_parser_sortChainWays(self);
+
+	osm_chainWay_t key = { .wid=wid };
+	return (osm_chainWay_t*)
+	       bsearch((const void*) &key,
+	               (const void*) self->chain_ways,
+	               (size_t) self->chain_ways_count,
+	               sizeof(osm_chainWay_t), osm_chainWay_cmp);
+}
+
+static void
+osm_parser_claimChainWay(osm_parser_t* self, int64_t wid)
+{
+	ASSERT(self);
+
+	// ways which are drawn by a rel are not merged into
+	// chains since the tiler must be able to exclude them
+	osm_chainWay_t* cw = osm_parser_findChainWay(self, wid);
+	if(cw)
+	{
+		cw->state = OSM_CHAINWAY_STATE_CLAIMED;
+	}
+}
+
+typedef struct
+{
+	int64_t nid;
+	int     idx;
+	int     pad; // unused padding for 64-bit alignment
+} osm_chainEnd_t;
+
+static int osm_chainEnd_cmp(const void* a, const void* b)
+{
+	ASSERT(a);
+	ASSERT(b);
+
+	const osm_chainEnd_t* cea = (const osm_chainEnd_t*) a;
+	const osm_chainEnd_t* ceb = (const osm_chainEnd_t*) b;
+
+	if(cea->nid < ceb->nid)
+	{
+		return -1;
+	}
+	else if(cea->nid > ceb->nid)
+	{
+		return 1;
+	}
+
+	return cea->idx - ceb->idx;
+}
+
+static int
+osm_parser_findChainEnd(osm_chainEnd_t* ends, int count,
+                        int64_t nid)
+{
+	ASSERT(ends);
+
+	// find the first end which matches nid
+	int lo = 0;
+	int hi = count;
+	while(lo < hi)
+	{
+		int mid = lo + (hi - lo)/2;
+		if(ends[mid].nid < nid)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+
+	return lo;
+}
+
+static int
+osm_parser_resizeChainNds(osm_parser_t* self, int count)
+{
+	ASSERT(self);
+
+	if(count <= self->chain_nds_maxCount)
+	{
+		return 1;
+	}
+
+	int max_count = 2*self->chain_nds_maxCount;
+	if(max_count < count)
+	{
+		max_count = count;
+	}
+
+	int64_t* tmp;
+	tmp = (int64_t*)
+	      REALLOC((void*) self->chain_nds,
+	              max_count*sizeof(int64_t));
+	if(tmp == NULL)
+	{
+		LOGE("REALLOC failed");
+		return 0;
+	}
+
+	self->chain_nds          = tmp;
+	self->chain_nds_maxCount = max_count;
+
+	return 1;
+}
+
+static void
+osm_parser_reverseChainNds(osm_parser_t* self)
+{
+	ASSERT(self);
+
+	int      i;
+	int      count = self->chain_nds_count;
+	int64_t* nds   = self->chain_nds;
+	for(i = 0; i < count/2; ++i)
+	{
+		int64_t tmp        = nds[i];
+		nds[i]             = nds[count - 1 - i];
+		nds[count - 1 - i] = tmp;
+	}
+}
+
+static int
+osm_parser_addChainWayTiles(osm_parser_t* self,
+                            osm_chainWay_t* cw,
+                            int zoom0, int zoom1,
+                            osmdb_wayRange_t* range)
+{
+	// range may be NULL
+	ASSERT(self);
+	ASSERT(cw);
+
+	osmdb_handle_t* hwr;
+	if(osmdb_index_get(self->index, 0,
+	                   OSMDB_TYPE_WAYRANGE,
+	                   cw->wid, &hwr) == 0)
+	{
+		return 0;
+	}
+	else if(hwr == NULL)
+	{
+		LOGE("invalid wid=%" PRId64, cw->wid);
+		return 0;
+	}
+
+	// resolve the way for the tile coverage and the
+	// generalized geometry
+	osmdb_handle_t* hwn;
+	if(osmdb_index_get(self->index, 0,
+	                   OSMDB_TYPE_WAYNDS,
+	                   cw->wid, &hwn) == 0)
+	{
+		goto fail_nds;
+	}
+	else if(hwn == NULL)
+	{
+		LOGE("invalid wid=%" PRId64, cw->wid);
+		goto fail_nds;
+	}
+
+	osmdb_wayRange_t* way_range = hwr->way_range;
+	if((osm_parser_resolveWay(self, cw->wid, way_range,
+	                          hwn->way_nds->count,
+	                          osmdb_wayNds_nds(hwn->way_nds)) == 0) ||
+	   (osm_parser_coverWay(self, 0) == 0))
+	{
+		goto fail_resolve;
+	}
+
+	if(osm_parser_addTileZooms(self, OSMDB_TYPE_WAYRANGE,
+	                           cw->wid, cw->class,
+	                           way_range->latT,
+	                           way_range->lonL,
+	                           way_range->latB,
+	                           way_range->lonR,
+	                           0, 0, cw->min_zoom,
+	                           zoom0, zoom1,
+	                           self->cover) == 0)
+	{
+		goto fail_tiles;
+	}
+
+	// generalize the way for the low zoom tiles
+	if((zoom0 <= OSM_GEN_MAX_ZOOM) &&
+	   (osm_parser_addWayGens(self, cw->wid,
+	                          self->way_chain,
+	                          cw->min_zoom) == 0))
+	{
+		goto fail_gens;
+	}
+
+	// combine range
+	if(range)
+	{
+		if(range->wid == -1)
+		{
+			memcpy((void*) range, (void*) way_range,
+			       sizeof(osmdb_wayRange_t));
+		}
+		else
+		{
+			if(way_range->latT > range->latT)
+			{
+				range->latT = way_range->latT;
+			}
+
+			if(way_range->lonL < range->lonL)
+			{
+				range->lonL = way_range->lonL;
+			}
+
+			if(way_range->latB < range->latB)
+			{
+				range->latB = way_range->latB;
+			}
+
+			if(way_range->lonR > range->lonR)
+			{
+				range->lonR = way_range->lonR;
+			}
+		}
+	}
+
+	osmdb_index_put(self->index, &hwn);
+	osmdb_index_put(self->index, &hwr);
+
+	// success
+	return 1;
+
+	// failure
+	fail_gens:
+	fail_tiles:
+	fail_resolve:
+		osmdb_index_put(self->index, &hwn);
+	fail_nds:
+		osmdb_index_put(self->index, &hwr);
+	return 0;
+}
+
+static int
+osm_parser_checkJoinAngle(osm_parser_t* self,
+                          int64_t ref0, int64_t ref1,
+                          int64_t ref2, int* _ok)
+{
+	ASSERT(self);
+	ASSERT(_ok);
+
+	*_ok = 0;
+
+	int64_t         ref[3] = { ref0, ref1, ref2 };
+	double          x[3];
+	double          y[3];
+	osmdb_handle_t* hnc;
+
+	int i;
+	for(i = 0; i < 3; ++i)
+	{
+		if(osmdb_index_get(self->index, 0,
+		                   OSMDB_TYPE_NODECOORD,
+		                   ref[i], &hnc) == 0)
+		{
+			return 0;
+		}
+		else if(hnc == NULL)
+		{
+			// nodes may not exist due to osmosis
+			return 1;
+		}
+
+		x[i] = (double) hnc->node_coord->x;
+		y[i] = (double) hnc->node_coord->y;
+		osmdb_index_put(self->index, &hnc);
+	}
+
+	// check join angle to prevent joining ways at a sharp
+	// angle (see osmdb_tiler_joinWay)
+	double x01 = x[1] - x[0];
+	double y01 = y[1] - y[0];
+	double x12 = x[2] - x[1];
+	double y12 = y[2] - y[1];
+	double d01 = sqrt(x01*x01 + y01*y01);
+	double d12 = sqrt(x12*x12 + y12*y12);
+	if((d01 == 0.0) || (d12 == 0.0))
+	{
+		return 1;
+	}
+
+	double dot = (x01*x12 + y01*y12)/(d01*d12);
+	if(dot >= cos(M_PI/6.0))
+	{
+		*_ok = 1;
+	}
+
+	return 1;
+}
+
+static int
+osm_parser_joinChainWay(osm_parser_t* self,
+                        osm_chainWay_t* head,
+                        const char* name,
+                        osm_chainWay_t* cw,
+                        int* _joined)
+{
+	// name may be NULL
+	ASSERT(self);
+	ASSERT(head);
+	ASSERT(cw);
+	ASSERT(_joined);
+
+	*_joined = 0;
+
+	// check if ways may be joined
+	// the min_zoom must also match since the chain is only
+	// referenced by the tiles of the chain min_zoom
+	if((cw->state    != OSM_CHAINWAY_STATE_FREE) ||
+	   (cw->class    != head->class) ||
+	   (cw->flags    != head->flags) ||
+	   (cw->layer    != head->layer) ||
+	   (cw->min_zoom != head->min_zoom))
+	{
+		return 1;
+	}
+
+	// check name
+	osmdb_handle_t* hwi;
+	if(osmdb_index_get(self->index, 0,
+	                   OSMDB_TYPE_WAYINFO,
+	                   cw->wid, &hwi) == 0)
+	{
+		return 0;
+	}
+	else if(hwi == NULL)
+	{
+		return 1;
+	}
+
+	const char* cw_name = osmdb_wayInfo_name(hwi->way_info);
+	if((name && cw_name && strcmp(name, cw_name)) ||
+	   ((name == NULL) && cw_name) ||
+	   (name && (cw_name == NULL)))
+	{
+		osmdb_index_put(self->index, &hwi);
+		return 1;
+	}
+	osmdb_index_put(self->index, &hwi);
+
+	osmdb_handle_t* hwn;
+	if(osmdb_index_get(self->index, 0,
+	                   OSMDB_TYPE_WAYNDS,
+	                   cw->wid, &hwn) == 0)
+	{
+		return 0;
+	}
+	else if(hwn == NULL)
+	{
+		return 1;
+	}
+
+	// check the size and orientation of the join
+	int      count = self->chain_nds_count;
+	int64_t  ref1  = self->chain_nds[count - 1];
+	int      n     = hwn->way_nds->count;
+	int64_t* nds   = osmdb_wayNds_nds(hwn->way_nds);
+	int64_t  ref2;
+	int      reverse;
+	if(count + n - 1 > OSM_CHAIN_MAX_COUNT)
+	{
+		osmdb_index_put(self->index, &hwn);
+		return 1;
+	}
+	else if(nds[0] == ref1)
+	{
+		reverse = 0;
+		ref2    = nds[1];
+	}
+	else if(nds[n - 1] == ref1)
+	{
+		reverse = 1;
+		ref2    = nds[n - 2];
+	}
+	else
+	{
+		osmdb_index_put(self->index, &hwn);
+		return 1;
+	}
+
+	int ok = 0;
+	if(osm_parser_checkJoinAngle(self,
+	                             self->chain_nds[count - 2],
+	                             ref1, ref2, &ok) == 0)
+	{
+		osmdb_index_put(self->index, &hwn);
+		return 0;
+	}
+	else if(ok == 0)
+	{
+		osmdb_index_put(self->index, &hwn);
+		return 1;
+	}
+
+	if(osm_parser_resizeChainNds(self, count + n - 1) == 0)
+	{
+		osmdb_index_put(self->index, &hwn);
+		return 0;
+	}
+
+	// append nds skipping the shared nd
+	int i;
+	for(i = 1; i < n; ++i)
+	{
+		if(reverse)
+		{
+			self->chain_nds[count++] = nds[n - 1 - i];
+		}
+		else
+		{
+			self->chain_nds[count++] = nds[i];
+		}
+	}
+	self->chain_nds_count = count;
+
+	osmdb_index_put(self->index, &hwn);
+
+	cw->state = OSM_CHAINWAY_STATE_USED;
+	*_joined  = 1;
+
+	return 1;
+}
+
+static int
+osm_parser_addWayChain(osm_parser_t* self,
+                       osm_chainWay_t* head,
+                       osmdb_wayRange_t* range,
+                       int min_zoom)
+{
+	ASSERT(self);
+	ASSERT(head);
+	ASSERT(range);
+
+	if(osm_parser_resolveWay(self, head->wid, range,
+	                         self->chain_nds_count,
+	                         self->chain_nds) == 0)
+	{
+		return 0;
+	}
+
+	// discard degenerate chains
+	osmdb_wayChain_t* way_chain = self->way_chain;
+	if(way_chain->count < 2)
+	{
+		return 1;
+	}
+
+	size_t size = osmdb_wayChain_sizeof(way_chain);
+	if(osmdb_index_add(self->index,
+	                   OSMDB_TYPE_WAYCHAIN,
+	                   way_chain->cid,
+	                   size, (void*) way_chain) == 0)
+	{
+		return 0;
+	}
+
+	if(osm_parser_coverWay(self, 0) == 0)
+	{
+		return 0;
+	}
+
+	// chains are referenced as -cid
+	if(osm_parser_addTileZooms(self, OSMDB_TYPE_WAYRANGE,
+	                           -way_chain->cid, head->class,
+	                           range->latT, range->lonL,
+	                           range->latB, range->lonR,
+	                           0, 0, min_zoom,
+	                           0, OSM_CHAIN_MAX_ZOOM,
+	                           self->cover) == 0)
+	{
+		return 0;
+	}
+
+	if(osm_parser_addWayGens(self, -way_chain->cid,
+	                         way_chain, min_zoom) == 0)
+	{
+		return 0;
+	}
+
+	++self->count_chains;
+
+	return 1;
+}
+
+static int
+osm_parser_insertChain(osm_parser_t* self,
+                       osm_chainEnd_t* ends,
+                       int count_ends,
+                       osm_chainWay_t* head)
+{
+	ASSERT(self);
+	ASSERT(ends);
+	ASSERT(head);
+
+	// the ways are referenced by the high zoom tiles
+	// regardless of the chain
+	osmdb_wayRange_t range = { .wid=-1 };
+	head->state = OSM_CHAINWAY_STATE_USED;
+	if(osm_parser_addChainWayTiles(self, head,
+	                               OSM_CHAIN_MAX_ZOOM + 1, 15,
+	                               &range) == 0)
+	{
+		return 0;
+	}
+
+	// copy the head nds
+	osmdb_handle_t* hwn;
+	if(osmdb_index_get(self->index, 0,
+	                   OSMDB_TYPE_WAYNDS,
+	                   head->wid, &hwn) == 0)
+	{
+		return 0;
+	}
+	else if(hwn == NULL)
+	{
+		LOGE("invalid wid=%" PRId64, head->wid);
+		return 0;
+	}
+
+	int count = hwn->way_nds->count;
+	if(osm_parser_resizeChainNds(self, count) == 0)
+	{
+		osmdb_index_put(self->index, &hwn);
+		return 0;
+	}
+	memcpy((void*) self->chain_nds,
+	       (void*) osmdb_wayNds_nds(hwn->way_nds),
+	       count*sizeof(int64_t));
+	self->chain_nds_count = count;
+	osmdb_index_put(self->index, &hwn);
+
+	osmdb_handle_t* hwi;
+	if(osmdb_index_get(self->index, 0,
+	                   OSMDB_TYPE_WAYINFO,
+	                   head->wid, &hwi) == 0)
+	{
+		return 0;
+	}
+	else if(hwi == NULL)
+	{
+		LOGE("invalid wid=%" PRId64, head->wid);
+		return 0;
+	}
+
+	const char* name = osmdb_wayInfo_name(hwi->way_info);
+
+	// extend the tail and then reverse the chain to extend
+	// the head which restores the orientation of the head
+	int i;
+	int k;
+	int count_ways = 1;
+	for(i = 0; i < 2; ++i)
+	{
+		while(self->chain_nds_count < OSM_CHAIN_MAX_COUNT)
+		{
+			int64_t* nds  = self->chain_nds;
+			int64_t  ref1 = nds[self->chain_nds_count - 1];
+			if(nds[0] == ref1)
+			{
+				break;
+			}
+
+			int             joined = 0;
+			osm_chainWay_t* cw     = NULL;
+			k = osm_parser_findChainEnd(ends, count_ends, ref1);
+			while((k < count_ends) && (ends[k].nid == ref1))
+			{
+				cw = &self->chain_ways[ends[k].idx];
+				if(osm_parser_joinChainWay(self, head, name,
+				                           cw, &joined) == 0)
+				{
+					goto fail_join;
+				}
+				else if(joined)
+				{
+					break;
+				}
+				++k;
+			}
+
+			if(joined == 0)
+			{
+				break;
+			}
+
+			if(osm_parser_addChainWayTiles(self, cw,
+			                               OSM_CHAIN_MAX_ZOOM + 1,
+			                               15, &range) == 0)
+			{
+				goto fail_join;
+			}
+
+			++count_ways;
+		}
+
+		osm_parser_reverseChainNds(self);
+	}
+
+	osmdb_index_put(self->index, &hwi);
+
+	// single ways are referenced directly
+	if(count_ways == 1)
+	{
+		return osm_parser_addChainWayTiles(self, head, 0,
+		                                   OSM_CHAIN_MAX_ZOOM,
+		                                   NULL);
+	}
+
+	return osm_parser_addWayChain(self, head, &range,
+	                              head->min_zoom);
+
+	// failure
+	fail_join:
+		osmdb_index_put(self->index, &hwi);
+	return 0;
+}
+
+static int
+osm_parser_insertChains(osm_parser_t* self)
+{
+	ASSERT(self);
+
+	int count = self->chain_ways_count;
+	if(count == 0)
+	{
+		return 1;
+	}
+
+	// chains are assembled in order of wid so that the
+	// cid is stable between imports
+	osm_parser_sortChainWays(self);
+
+	// index the chain way endpoints
+	int             i;
+	int             count_ends = 2*count;
+	osm_chainEnd_t* ends;
+	ends = (osm_chainEnd_t*)
+	       CALLOC(count_ends, sizeof(osm_chainEnd_t));
+	if(ends == NULL)
+	{
+		LOGE("CALLOC failed");
+		return 0;
+	}
+
+	for(i = 0; i < count; ++i)
+	{
+		ends[2*i].nid     = self->chain_ways[i].ref1;
+		ends[2*i].idx     = i;
+		ends[2*i + 1].nid = self->chain_ways[i].ref2;
+		ends[2*i + 1].idx = i;
+	}
+	qsort((void*) ends, (size_t) count_ends,
+	      sizeof(osm_chainEnd_t), osm_chainEnd_cmp);
+
+	osm_chainWay_t* cw;
+	for(i = 0; i < count; ++i)
+	{
+		cw = &self->chain_ways[i];
+		if(cw->state == OSM_CHAINWAY_STATE_CLAIMED)
+		{
+			if(osm_parser_addChainWayTiles(self, cw, 0, 15,
+			                               NULL) == 0)
+			{
+				goto fail_insert;
+			}
+		}
+		else if(cw->state == OSM_CHAINWAY_STATE_FREE)
+		{
+			if(osm_parser_insertChain(self, ends, count_ends,
+			                          cw) == 0)
+			{
+				goto fail_insert;
+			}
+		}
+	}
+
+	LOGI("ways=%i, chains=%" PRIu64,
+	     count, self->count_chains);
+
+	FREE(ends);
+
+	// success
+	return 1;
+
+	// failure
+	fail_insert:
+		FREE(ends);
+	return 0;
+}
+
+typedef struct
+{
+	int64_t wid;
+	int     inner;
+	int     used;
+	int     offset;
+	int     count;
+} osm_ringMember_t;
+
+static int
+osm_parser_resizeRelRings(osm_parser_t* self, size_t size)
+{
+	ASSERT(self);
+
+	if(size <= self->rel_rings_maxSize)
+	{
+		return 1;
+	}
+
+	size_t max_size = 2*self->rel_rings_maxSize;
+	if(max_size < 4096)
+	{
+		max_size = 4096;
+	}
+
+	while(max_size < size)
+	{
+		max_size *= 2;
+	}
+
+	osmdb_relRings_t* tmp;
+	tmp = (osmdb_relRings_t*)
+	      REALLOC((void*) self->rel_rings, max_size);
+	if(tmp == NULL)
+	{
+		LOGE("REALLOC failed");
+		return 0;
+	}
+
+	self->rel_rings         = tmp;
+	self->rel_rings_maxSize = max_size;
+
+	return 1;
+}
+
+static int
+osm_parser_addRelRing(osm_parser_t* self, size_t* _size,
+                      int64_t wid, int inner,
+                      int count, int64_t* nds)
+{
+	ASSERT(self);
+	ASSERT(_size);
+	ASSERT(nds);
+
+	// reserve space for the ring which may be closed again
+	// when the first nd is missing due to osmosis
+	size_t offset = *_size;
+	size_t size   = offset + sizeof(osmdb_relRing_t) +
+	                (count + 1)*sizeof(int64_t) +
+	                (count + 1)*sizeof(osmdb_worldPoint_t);
+	if(osm_parser_resizeRelRings(self, size) == 0)
+	{
+		return 0;
+	}
+
+	// nds are written in place and the pts are
+	// written to a temporary location following the
+	// reserved nds
+	osmdb_relRing_t* ring;
+	ring = (osmdb_relRing_t*)
+	       (((void*) self->rel_rings) + offset);
+	memset((void*) ring, 0, sizeof(osmdb_relRing_t));
+	ring->flags     = inner ? OSMDB_RELRING_FLAG_INNER : 0;
+	ring->range.wid = wid;
+
+	int64_t*            ring_nds = osmdb_relRing_nds(ring);
+	osmdb_worldPoint_t* tmp_pts;
+	tmp_pts = (osmdb_worldPoint_t*) &ring_nds[count + 1];
+
+	int i;
+	int j = 0;
+	for(i = 0; i < count; ++i)
+	{
+		osmdb_handle_t* hnc;
+		if(osmdb_index_get(self->index, 0,
+		                   OSMDB_TYPE_NODECOORD,
+		                   nds[i], &hnc) == 0)
 		{
-			.count=2*self->way_nds_maxCount
-		};
+			return 0;
+		}
 
-		size_t size = osmdb_wayNds_sizeof(&tmp_size);
+		// some nodes may not exist due to osmosis
+		if(hnc == NULL)
+		{
+			continue;
+		}
 
-		osmdb_wayNds_t* tmp;
-		tmp = (osmdb_wayNds_t*)
-		      REALLOC((void*) self->way_nds, size);
-		if(tmp == NULL)
+		osmdb_nodeCoord_t* node_coord = hnc->node_coord;
+		if(j == 0)
 		{
-			LOGE("REALLOC failed");
-			return 0;
+			ring->range.latT = node_coord->lat;
+			ring->range.lonL = node_coord->lon;
+			ring->range.latB = node_coord->lat;
+			ring->range.lonR = node_coord->lon;
 		}
+		else
+		{
+			if(node_coord->lat > ring->range.latT)
+			{
+				ring->range.latT = node_coord->lat;
+			}
 
-		self->way_nds           = tmp;
-		self->way_nds_maxCount  = tmp_size.count;
-	}
+			if(node_coord->lon < ring->range.lonL)
+			{
+				ring->range.lonL = node_coord->lon;
+			}
 
-	int64_t ref = 0;
+			if(node_coord->lat < ring->range.latB)
+			{
+				ring->range.latB = node_coord->lat;
+			}
 
-	// parse the ref
-	int i = 0;
-	int j = 1;
-	while(atts[i] && atts[j])
-	{
-		if(strcmp(atts[i], "ref") == 0)
-		{
-			ref = (int64_t) strtoll(atts[j], NULL, 0);
-			break;
+			if(node_coord->lon > ring->range.lonR)
+			{
+				ring->range.lonR = node_coord->lon;
+			}
 		}
 
-		i += 2;
-		j += 2;
+		ring_nds[j]  = node_coord->nid;
+		tmp_pts[j].x = node_coord->x;
+		tmp_pts[j].y = node_coord->y;
+		++j;
+
+		osmdb_index_put(self->index, &hnc);
 	}
 
-	if(ref == 0)
+	// close the ring if the first nd was discarded
+	if((j > 1) && (nds[0] == nds[count - 1]) &&
+	   (ring_nds[0] != ring_nds[j - 1]))
 	{
-		LOGE("invalid ref=0");
-		return 0;
+		ring_nds[j] = ring_nds[0];
+		tmp_pts[j]  = tmp_pts[0];
+		++j;
 	}
 
-	int64_t* nds = osmdb_wayNds_nds(self->way_nds);
-	nds[self->way_nds->count] = ref;
-	self->way_nds->count += 1;
-
-	return 1;
-}
+	// discard degenerate rings
+	if(j < 2)
+	{
+		return 1;
+	}
 
-static int
-osm_parser_endOsmWayNd(osm_parser_t* self, int line,
-                       const char* content)
-{
-	// content may be NULL
-	ASSERT(self);
+	// move the pts to follow the nds
+	ring->count = j;
+	memmove((void*) osmdb_relRing_pts(ring), (void*) tmp_pts,
+	        j*sizeof(osmdb_worldPoint_t));
 
-	self->state = OSM_STATE_OSM_WAY;
+	self->rel_rings->count += 1;
+	*_size = offset + osmdb_relRing_sizeof(ring);
 
 	return 1;
 }
 
 static int
-osm_parser_beginOsmRel(osm_parser_t* self, int line,
-                       const char** atts)
+osm_parser_assembleRelRings(osm_parser_t* self,
+                            int count_members,
+                            osm_ringMember_t* members,
+                            int64_t* member_nds,
+                            int64_t* nds, size_t* _size)
 {
 	ASSERT(self);
-	ASSERT(atts);
+	ASSERT(members);
+	ASSERT(member_nds);
+	ASSERT(nds);
+	ASSERT(_size);
+
+	// rings are assembled by greedily joining members with
+	// the same role at their endpoints until the ring is
+	// closed or no member may be joined at either end
+	// the nds buffer is sized to hold all member nds
+	int i;
+	int j;
+	int k;
+	for(i = 0; i < count_members; ++i)
+	{
+		osm_ringMember_t* m = &members[i];
+		if(m->used || (m->count < 2))
+		{
+			continue;
+		}
+		m->used = 1;
 
-	self->state = OSM_STATE_OSM_REL;
-	osm_parser_initRel(self);
+		int count = m->count;
+		memcpy((void*) nds, (void*) &member_nds[m->offset],
+		       count*sizeof(int64_t));
 
-	int i = 0;
-	int j = 1;
-	while(atts[i] && atts[j])
-	{
-		if(strcmp(atts[i], "id")  == 0)
+		int reversed = 0;
+		while(nds[0] != nds[count - 1])
 		{
-			self->rel_info->rid    = (int64_t)
-			                         strtoll(atts[j], NULL, 0);
-			self->rel_members->rid = self->rel_info->rid;
-			self->rel_range->rid   = self->rel_info->rid;
+			// find a member which joins the tail
+			osm_ringMember_t* n = NULL;
+			int64_t*          n_nds;
+			for(j = i + 1; j < count_members; ++j)
+			{
+				n     = &members[j];
+				n_nds = &member_nds[n->offset];
+				if((n->used == 0) && (n->count >= 2) &&
+				   (n->inner == m->inner) &&
+				   ((n_nds[0] == nds[count - 1]) ||
+				    (n_nds[n->count - 1] == nds[count - 1])))
+				{
+					break;
+				}
+				n = NULL;
+			}
+
+			if(n)
+			{
+				// append the member skipping the shared nd
+				n->used = 1;
+				if(n_nds[0] == nds[count - 1])
+				{
+					for(k = 1; k < n->count; ++k)
+					{
+						nds[count++] = n_nds[k];
+					}
+				}
+				else
+				{
+					for(k = n->count - 2; k >= 0; --k)
+					{
+						nds[count++] = n_nds[k];
+					}
+				}
+				continue;
+			}
+
+			// otherwise try to extend the head
+			if(reversed)
+			{
+				break;
+			}
+
+			for(k = 0; k < count/2; ++k)
+			{
+				int64_t tmp        = nds[k];
+				nds[k]             = nds[count - 1 - k];
+				nds[count - 1 - k] = tmp;
+			}
+			reversed = 1;
 		}
-		else if(strcmp(atts[i], "changeset") == 0)
+
+		// restore the orientation of the first member
+		if(reversed)
 		{
-			int64_t changeset = (int64_t)
-			                    strtoll(atts[j], NULL, 0);
-			if(changeset > self->tag_changeset)
+			for(k = 0; k < count/2; ++k)
 			{
-				self->tag_changeset = changeset;
+				int64_t tmp        = nds[k];
+				nds[k]             = nds[count - 1 - k];
+				nds[count - 1 - k] = tmp;
 			}
 		}
 
-		i += 2;
-		j += 2;
+		if(osm_parser_addRelRing(self, _size, m->wid,
+		                         m->inner, count, nds) == 0)
+		{
+			return 0;
+		}
 	}
 
 	return 1;
 }
 
 static int
-osm_parser_computeRelRange(osm_parser_t* self)
+osm_parser_insertRelRings(osm_parser_t* self)
 {
 	ASSERT(self);
 
-	osmdb_handle_t*     hnd_way_range;
-	osmdb_handle_t*     hnd_way_nds;
 	osmdb_relMembers_t* rel_members = self->rel_members;
-	osmdb_relRange_t*   rel_range   = self->rel_range;
-	osmdb_wayRange_t*   way_range;
-	osmdb_wayRange_t    tmp_way_range;
+	osmdb_relData_t*    data;
+	data = osmdb_relMembers_data(rel_members);
 
-	// ignore
-	if(rel_members->count == 0)
+	int count_members = rel_members->count;
+
+	// initialize the rings header and reserve the wids
+	size_t size = sizeof(osmdb_relRings_t) +
+	              count_members*sizeof(int64_t);
+	if(osm_parser_resizeRelRings(self, size) == 0)
 	{
-		return 1;
+		return 0;
 	}
+	self->rel_rings->rid        = self->rel_info->rid;
+	self->rel_rings->count      = 0;
+	self->rel_rings->count_wids = 0;
 
-	osmdb_relData_t* data;
-	data = osmdb_relMembers_data(rel_members);
-
-	int i;
-	int first = 1;
-	for(i = 0; i < rel_members->count; ++i)
+	// members are drawn by the rel when the class or
+	// name matches the rel where the name may be provided
+	// by the admin_centre/label node
+	osmdb_handle_t* hni  = NULL;
+	const char*     name = osmdb_relInfo_name(self->rel_info);
+	if((name == NULL) && (self->rel_info->nid > 0))
 	{
 		if(osmdb_index_get(self->index, 0,
-		                   OSMDB_TYPE_WAYRANGE,
-		                   data[i].wid, &hnd_way_range) == 0)
+		                   OSMDB_TYPE_NODEINFO,
+		                   self->rel_info->nid, &hni) == 0)
 		{
 			return 0;
 		}
 
-		// some way ranges may not exist due to osmosis or must
-		// be computed since they were not selected by
-		// osm_parser_insertWay
-		if(hnd_way_range)
+		if(hni)
 		{
-			way_range = hnd_way_range->way_range;
+			name = osmdb_nodeInfo_name(hni->node_info);
 		}
-		else
+	}
+
+	osm_ringMember_t* members = NULL;
+	if(count_members)
+	{
+		members = (osm_ringMember_t*)
+		          CALLOC(count_members, sizeof(osm_ringMember_t));
+		if(members == NULL)
 		{
-			way_range = &tmp_way_range;
-			way_range->wid  = data[i].wid;
-			way_range->latT = 0.0;
-			way_range->lonL = 0.0;
-			way_range->latB = 0.0;
-			way_range->lonR = 0.0;
+			LOGE("CALLOC failed");
+			goto fail_members;
+		}
+	}
 
-			if(osmdb_index_get(self->index, 0,
-			                   OSMDB_TYPE_WAYNDS,
-			                   data[i].wid, &hnd_way_nds) == 0)
-			{
-				return 0;
-			}
+	// copy the member nds
+	int      i;
+	int      count_nds  = 0;
+	int      max_nds    = 0;
+	int64_t* member_nds = NULL;
+	int64_t* wids       = osmdb_relRings_wids(self->rel_rings);
+	for(i = 0; i < count_members; ++i)
+	{
+		osm_ringMember_t* m = &members[i];
+		m->wid   = data[i].wid;
+		m->inner = data[i].inner;
 
-			// some ways may not exist due to osmosis
-			if(hnd_way_nds == NULL)
-			{
-				continue;
-			}
+		// some ways may not exist due to osmosis
+		osmdb_handle_t* hwi;
+		osmdb_handle_t* hwn;
+		if(osmdb_index_get(self->index, 0,
+		                   OSMDB_TYPE_WAYINFO,
+		                   m->wid, &hwi) == 0)
+		{
+			goto fail_copy;
+		}
+		else if(hwi == NULL)
+		{
+			continue;
+		}
 
-			if(osm_parser_computeWayRange(self,
-			                              hnd_way_nds->way_nds,
-			                              way_range) == 0)
+		if(osmdb_index_get(self->index, 0,
+		                   OSMDB_TYPE_WAYNDS,
+		                   m->wid, &hwn) == 0)
+		{
+			osmdb_index_put(self->index, &hwi);
+			goto fail_copy;
+		}
+		else if((hwn == NULL) || (hwn->way_nds->count == 0))
+		{
+			osmdb_index_put(self->index, &hwn);
+			osmdb_index_put(self->index, &hwi);
+			continue;
+		}
+
+		int count = hwn->way_nds->count;
+		if(count_nds + count > max_nds)
+		{
+			int max_count = 2*max_nds;
+			if(max_count < count_nds + count)
 			{
-				osmdb_index_put(self->index, &hnd_way_nds);
-				return 0;
+				max_count = count_nds + count;
 			}
 
-			size_t size;
-			size = osmdb_wayRange_sizeof(way_range);
-			if(osmdb_index_add(self->index,
-			                   OSMDB_TYPE_WAYRANGE,
-			                   way_range->wid,
-			                   size, (void*) way_range) == 0)
+			int64_t* tmp;
+			tmp = (int64_t*)
+			      REALLOC((void*) member_nds,
+			              max_count*sizeof(int64_t));
+			if(tmp == NULL)
 			{
-				osmdb_index_put(self->index, &hnd_way_nds);
-				return 0;
+				LOGE("REALLOC failed");
+				osmdb_index_put(self->index, &hwn);
+				osmdb_index_put(self->index, &hwi);
+				goto fail_copy;
 			}
 
-			osmdb_index_put(self->index, &hnd_way_nds);
+			member_nds = tmp;
+			max_nds    = max_count;
 		}
 
-		if(first)
+		memcpy((void*) &member_nds[count_nds],
+		       (void*) osmdb_wayNds_nds(hwn->way_nds),
+		       count*sizeof(int64_t));
+		m->offset  = count_nds;
+		m->count   = count;
+		count_nds += count;
+
+		int         way_class = hwi->way_info->class;
+		const char* way_name  = osmdb_wayInfo_name(hwi->way_info);
+		if((way_class == self->rel_info->class) ||
+		   (name && way_name && (strcmp(name, way_name) == 0)))
 		{
-			rel_range->latT = way_range->latT;
-			rel_range->lonL = way_range->lonL;
-			rel_range->latB = way_range->latB;
-			rel_range->lonR = way_range->lonR;
-
-			first = 0;
+			wids[self->rel_rings->count_wids] = m->wid;
+			self->rel_rings->count_wids += 1;
+			osm_parser_claimChainWay(self, m->wid);
 		}
-		else
-		{
-			if(way_range->latT > rel_range->latT)
-			{
-				rel_range->latT = way_range->latT;
-			}
 
-			if(way_range->lonL < rel_range->lonL)
-			{
-				rel_range->lonL = way_range->lonL;
-			}
+		osmdb_index_put(self->index, &hwn);
+		osmdb_index_put(self->index, &hwi);
+	}
 
-			if(way_range->latB < rel_range->latB)
-			{
-				rel_range->latB = way_range->latB;
-			}
+	// rings follow the wids
+	size = sizeof(osmdb_relRings_t) +
+	       self->rel_rings->count_wids*sizeof(int64_t);
 
-			if(way_range->lonR > rel_range->lonR)
-			{
-				rel_range->lonR = way_range->lonR;
-			}
+	if(count_nds)
+	{
+		int64_t* nds;
+		nds = (int64_t*) MALLOC(count_nds*sizeof(int64_t));
+		if(nds == NULL)
+		{
+			LOGE("MALLOC failed");
+			goto fail_nds;
 		}
 
-		// hnd_way_range may be NULL
-		osmdb_index_put(self->index, &hnd_way_range);
+		if(osm_parser_assembleRelRings(self, count_members,
+		                               members, member_nds,
+		                               nds, &size) == 0)
+		{
+			FREE(nds);
+			goto fail_assemble;
+		}
+
+		FREE(nds);
+	}
+
+	if(osmdb_index_add(self->index,
+	                   OSMDB_TYPE_RELRINGS,
+	                   self->rel_rings->rid,
+	                   size, (void*) self->rel_rings) == 0)
+	{
+		goto fail_add;
 	}
 
+	FREE(member_nds);
+	FREE(members);
+	osmdb_index_put(self->index, &hni);
+
+	// success
 	return 1;
+
+	// failure
+	fail_add:
+	fail_assemble:
+	fail_nds:
+	fail_copy:
+		FREE(member_nds);
+		FREE(members);
+	fail_members:
+		osmdb_index_put(self->index, &hni);
+	return 0;
 }
 
 static int
@@ -2451,27 +4321,47 @@ osm_parser_insertRel(osm_parser_t* self,
 	double latB = self->rel_range->latB;
 	double lonR = self->rel_range->lonR;
 	float  area = (float) ((latT-latB)*(lonR-lonL));
+	// assemble the rings of multipolygon and boundary
+	// relations once rather than for every tile
+	// the tile coverage is computed from the rings when
+	// they exist and from the range otherwise
+	osmdb_cover_t* cover = NULL;
 	if((center == 0) &&
 	   ((polygon == 0) ||
 	    (polygon && (area < 64*0.002f))))
 	{
-		size = osmdb_relMembers_sizeof(self->rel_members);
-		if(osmdb_index_add(self->index,
-		                   OSMDB_TYPE_RELMEMBERS,
-		                   self->rel_members->rid,
-		                   size, (void*) self->rel_members) == 0)
+		if((self->rel_info->type == OSMDB_RELINFO_TYPE_MULTIPOLYGON) ||
+		   (self->rel_info->type == OSMDB_RELINFO_TYPE_BOUNDARY))
 		{
-			return 0;
+			if((osm_parser_insertRelRings(self) == 0) ||
+			   (osm_parser_addRelGens(self, min_zoom) == 0) ||
+			   (osm_parser_coverRings(self, polygon) == 0))
+			{
+				return 0;
+			}
+			cover = self->cover;
+		}
+		else
+		{
+			size = osmdb_relMembers_sizeof(self->rel_members);
+			if(osmdb_index_add(self->index,
+			                   OSMDB_TYPE_RELMEMBERS,
+			                   self->rel_members->rid,
+			                   size, (void*) self->rel_members) == 0)
+			{
+				return 0;
+			}
 		}
 	}
 
 	if(osm_parser_addTileRange(self,
 	                           OSMDB_TYPE_RELRANGE,
 	                           self->rel_range->rid,
+	                           self->rel_info->class,
 	                           latT, lonL,
 	                           latB, lonR,
 	                           center, polygon,
-	                           min_zoom) == 0)
+	                           min_zoom, cover) == 0)
 	{
 		return 0;
 	}
@@ -2578,6 +4468,13 @@ osm_parser_endOsmRel(osm_parser_t* self, int line,
 		                      self->tag_abrev);
 	}
 
+	// the rings of polygons are areas which the tiler clips
+	// as polygons rather than lines
+	if(polygon)
+	{
+		self->rel_info->flags |= OSMDB_RELINFO_FLAG_AREA;
+	}
+
 	if(osm_parser_insertRel(self, center,
 	                        polygon, min_zoom) == 0)
 	{
@@ -2954,6 +4851,12 @@ osm_parser_new(float smem, const char* style,
 		goto fail_rel_members;
 	}
 
+	self->cover = osmdb_cover_new();
+	if(self->cover == NULL)
+	{
+		goto fail_cover;
+	}
+
 	self->class_map = cc_map_new();
 	if(self->class_map == NULL)
 	{
@@ -3041,6 +4944,8 @@ osm_parser_new(float smem, const char* style,
 	fail_fill_class:
 		cc_map_delete(&self->class_map);
 	fail_class_map:
+		osmdb_cover_delete(&self->cover);
+	fail_cover:
 		FREE(self->rel_members);
 	fail_rel_members:
 		FREE(self->rel_range);
@@ -3085,6 +4990,15 @@ void osm_parser_delete(osm_parser_t** _self)
 		osm_parser_discardClass(self);
 		cc_map_delete(&self->class_map);
 
+		osmdb_cover_delete(&self->cover);
+		FREE(self->rel_gen);
+		FREE(self->way_gen);
+		FREE(self->gen_stack);
+		FREE(self->gen_keep);
+		FREE(self->way_chain);
+		FREE(self->chain_nds);
+		FREE(self->chain_ways);
+		FREE(self->rel_rings);
 		FREE(self->rel_members);
 		FREE(self->rel_range);
 		FREE(self->rel_info);
@@ -3117,6 +5031,17 @@ int osm_parser_parseFile(osm_parser_t* self,
 		return 0;
 	}
 
+	// merge lines into chains once all ways and rels have
+	// been parsed
+	if(osm_parser_insertChains(self) == 0)
+	{
+		return 0;
+	}
+
+	// compare the tile refs with the bounding box coverage
+	LOGI("tiles=%" PRIu64 ", tiles_bbox=%" PRIu64,
+	     self->count_tiles, self->count_tiles_bbox);
+
 	return 1;
 }
 
@@ -30,8 +30,27 @@
 #include "libcc/cc_map.h"
 #include "libsqlite3/sqlite3.h"
 #include "osmdb/index/osmdb_index.h"
+#include "osmdb/osmdb_cover.h"
 #include "osmdb/osmdb_style.h"
 
+// node coords are buffered and projected in batches
+#define OSM_PARSER_NODE_BATCH 256
+
+// lines whose tile refs are deferred until the end of the
+// import so they may be merged into chains
+typedef struct
+{
+	int64_t wid;
+	int64_t ref1;
+	int64_t ref2;
+	int     class;
+	int     flags;
+	int     layer;
+	int     min_zoom;
+	int     state;
+	int     pad; // unused padding for 64-bit alignment
+} osm_chainWay_t;
+
 typedef struct
 {
 	int state;
@@ -39,6 +58,9 @@ typedef struct
 	uint64_t count_nodes;
 	uint64_t count_ways;
 	uint64_t count_rels;
+	uint64_t count_chains;
+	uint64_t count_tiles;
+	uint64_t count_tiles_bbox;
 
 	double t0;
 	double t1;
@@ -59,6 +81,41 @@ typedef struct
 	osmdb_relRange_t*   rel_range;
 	osmdb_relMembers_t* rel_members;
 
+	// node coords pending projection
+	int               node_batch_count;
+	osmdb_nodeCoord_t node_batch[OSM_PARSER_NODE_BATCH];
+	double            node_batch_lat[OSM_PARSER_NODE_BATCH];
+	double            node_batch_lon[OSM_PARSER_NODE_BATCH];
+	int               node_batch_x[OSM_PARSER_NODE_BATCH];
+	int               node_batch_y[OSM_PARSER_NODE_BATCH];
+
+	// ring assembly data
+	size_t            rel_rings_maxSize;
+	osmdb_relRings_t* rel_rings;
+
+	// chain assembly data
+	int               chain_ways_count;
+	int               chain_ways_maxCount;
+	int               chain_ways_sorted;
+	osm_chainWay_t*   chain_ways;
+	int               chain_nds_count;
+	int               chain_nds_maxCount;
+	int64_t*          chain_nds;
+	size_t            way_chain_maxSize;
+	osmdb_wayChain_t* way_chain;
+
+	// tile coverage
+	osmdb_cover_t* cover;
+
+	// generalization data
+	int               gen_maxCount;
+	char*             gen_keep;
+	int*              gen_stack;
+	size_t            way_gen_maxSize;
+	osmdb_wayChain_t* way_gen;
+	size_t            rel_gen_maxSize;
+	osmdb_relRings_t* rel_gen;
+
 	// english flag
 	int name_en;
 
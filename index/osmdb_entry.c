@@ -34,6 +34,41 @@
 * private                                                  *
 ***********************************************************/
 
+// tile refs are sorted by tile, class and then by the
+// order in which they were added
+typedef struct
+{
+	int64_t ref;
+	int     idx;
+	int     class;
+	int     seq;
+	int     pad; // unused padding for 64-bit alignment
+} osmdb_entrySort_t;
+
+static int osmdb_entry_cmpSort(const void* a, const void* b)
+{
+	ASSERT(a);
+	ASSERT(b);
+
+	const osmdb_entrySort_t* sa = (const osmdb_entrySort_t*) a;
+	const osmdb_entrySort_t* sb = (const osmdb_entrySort_t*) b;
+
+	if(sa->idx != sb->idx)
+	{
+		return (sa->idx < sb->idx) ? -1 : 1;
+	}
+	else if(sa->class != sb->class)
+	{
+		return (sa->class < sb->class) ? -1 : 1;
+	}
+	else if(sa->seq != sb->seq)
+	{
+		return (sa->seq < sb->seq) ? -1 : 1;
+	}
+
+	return 0;
+}
+
 static void
 osmdb_entry_unmap(osmdb_entry_t* self)
 {
@@ -55,6 +90,53 @@ osmdb_entry_unmap(osmdb_entry_t* self)
 	}
 }
 
+static int
+osmdb_entry_mapTiles(osmdb_entry_t* self)
+{
+	ASSERT(self);
+
+	// tile blocks are mapped by the offset directory
+	osmdb_tileBlock_t* block = (osmdb_tileBlock_t*) self->data;
+	if(block == NULL)
+	{
+		return 1;
+	}
+
+	int64_t minor_id;
+	for(minor_id = 0; minor_id < OSMDB_TILEBLOCK_COUNT;
+	    ++minor_id)
+	{
+		osmdb_tileRefs_t* tile_refs;
+		tile_refs = osmdb_tileBlock_tile(block, (int) minor_id);
+		if((tile_refs == NULL) ||
+		   cc_map_findp(self->map, sizeof(int64_t), &minor_id))
+		{
+			continue;
+		}
+
+		osmdb_handle_t* hnd;
+		hnd = CALLOC(1, sizeof(osmdb_handle_t));
+		if(hnd == NULL)
+		{
+			LOGE("CALLOC failed");
+			return 0;
+		}
+		hnd->entry     = self;
+		hnd->tile_refs = tile_refs;
+
+		if(cc_map_addp(self->map, (const void*) hnd,
+		               sizeof(int64_t), &minor_id) == NULL)
+		{
+			LOGE("invalid type=%i, major_id=%" PRId64 ", minor_id=%" PRId64,
+			     self->type, self->major_id, minor_id);
+			FREE(hnd);
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
 static int
 osmdb_entry_map(osmdb_entry_t* self, size_t offset)
 {
@@ -76,19 +158,17 @@ osmdb_entry_map(osmdb_entry_t* self, size_t offset)
 		offset = 0;
 	}
 
+	if(self->type < OSMDB_TYPE_TILEREF_COUNT)
+	{
+		return osmdb_entry_mapTiles(self);
+	}
+
 	// add handles to map
 	int64_t         minor_id = 0;
 	size_t          bsize    = 0;
 	osmdb_handle_t* hnd      = NULL;
 	while(offset < self->size)
 	{
-		// tiles only contain a single mapping at 0
-		if((offset > 0) &&
-		   (self->type < OSMDB_TYPE_TILEREF_COUNT))
-		{
-			break;
-		}
-
 		hnd = CALLOC(1, sizeof(osmdb_handle_t));
 		if(hnd == NULL)
 		{
@@ -153,13 +233,23 @@ osmdb_entry_map(osmdb_entry_t* self, size_t offset)
 			bsize    = osmdb_relRange_sizeof(hnd->rel_range);
 			minor_id = hnd->rel_range->rid%OSMDB_ENTRY_SIZE;
 		}
-		else if((self->type < OSMDB_TYPE_TILEREF_COUNT) &&
-		        (offset == 0))
+		else if((self->type == OSMDB_TYPE_RELRINGS) ||
+		        ((self->type >= OSMDB_TYPE_RELGEN3) &&
+		         (self->type <= OSMDB_TYPE_RELGEN9)))
 		{
-			hnd->tile_refs = (osmdb_tileRefs_t*)
+			hnd->rel_rings = (osmdb_relRings_t*)
 			                  (self->data + offset);
-			bsize    = osmdb_tileRefs_sizeof(hnd->tile_refs);
-			minor_id = 0;
+			bsize    = osmdb_relRings_sizeof(hnd->rel_rings);
+			minor_id = hnd->rel_rings->rid%OSMDB_ENTRY_SIZE;
+		}
+		else if((self->type == OSMDB_TYPE_WAYCHAIN) ||
+		        ((self->type >= OSMDB_TYPE_WAYGEN3) &&
+		         (self->type <= OSMDB_TYPE_WAYGEN9)))
+		{
+			hnd->way_chain = (osmdb_wayChain_t*)
+			                  (self->data + offset);
+			bsize    = osmdb_wayChain_sizeof(hnd->way_chain);
+			minor_id = hnd->way_chain->cid%OSMDB_ENTRY_SIZE;
 		}
 		else
 		{
@@ -226,6 +316,7 @@ void osmdb_entry_delete(osmdb_entry_t** _self)
 		}
 
 		osmdb_entry_unmap(self);
+		FREE(self->pending);
 		FREE(self->data);
 		FREE(self);
 		*_self = NULL;
@@ -239,7 +330,8 @@ osmdb_entry_get(osmdb_entry_t* self, int64_t minor_id,
 	ASSERT(self);
 	ASSERT(_hnd);
 
-	if(osmdb_entry_map(self, 0) == 0)
+	if((osmdb_entry_pack(self) == 0) ||
+	   (osmdb_entry_map(self, 0) == 0))
 	{
 		return 0;
 	}
@@ -341,3 +433,237 @@ int osmdb_entry_add(osmdb_entry_t* self, int loaded,
 
 	return 1;
 }
+
+int osmdb_entry_addTile(osmdb_entry_t* self,
+                        int64_t id, int class,
+                        int64_t ref)
+{
+	ASSERT(self);
+	ASSERT(self->type < OSMDB_TYPE_TILEREF_COUNT);
+	ASSERT(self->data);
+
+	// refs are appended to the pending list rather than
+	// inserted into the middle of the block and the pending
+	// list grows with the block so that the cost of packing
+	// is amortized over many refs
+	if(self->pending_count >= self->pending_max)
+	{
+		if(osmdb_entry_pack(self) == 0)
+		{
+			return 0;
+		}
+
+		int pending_max = self->pending_max;
+		if(pending_max == 0)
+		{
+			pending_max = OSMDB_TILEBLOCK_COUNT;
+		}
+
+		while(pending_max*sizeof(osmdb_entryPending_t) <
+		      self->size)
+		{
+			pending_max *= 2;
+		}
+
+		if(pending_max > self->pending_max)
+		{
+			osmdb_entryPending_t* pending;
+			pending = (osmdb_entryPending_t*)
+			          REALLOC(self->pending, pending_max*
+			                  sizeof(osmdb_entryPending_t));
+			if(pending == NULL)
+			{
+				LOGE("REALLOC failed");
+				return 0;
+			}
+
+			self->pending_max = pending_max;
+			self->pending     = pending;
+		}
+	}
+
+	int64_t bid;
+	osmdb_entryPending_t* p = &self->pending[self->pending_count];
+	osmdb_tileBlock_index(self->type, id, &bid, &p->idx);
+	p->id    = id;
+	p->ref   = ref;
+	p->class = class;
+	++self->pending_count;
+
+	self->dirty = 1;
+
+	return 1;
+}
+
+int osmdb_entry_pack(osmdb_entry_t* self)
+{
+	ASSERT(self);
+
+	if(self->pending_count == 0)
+	{
+		return 1;
+	}
+
+	// unmap because the block will be rebuilt
+	if(self->refcount)
+	{
+		LOGE("invalid refcount=%i", self->refcount);
+		return 0;
+	}
+	osmdb_entry_unmap(self);
+
+	// count the existing refs
+	osmdb_tileBlock_t* block = (osmdb_tileBlock_t*) self->data;
+	osmdb_tileRefs_t*  tile_refs;
+	int64_t            ids[OSMDB_TILEBLOCK_COUNT];
+	int                i;
+	int                count = self->pending_count;
+	for(i = 0; i < OSMDB_TILEBLOCK_COUNT; ++i)
+	{
+		ids[i]    = 0;
+		tile_refs = osmdb_tileBlock_tile(block, i);
+		if(tile_refs)
+		{
+			ids[i] = tile_refs->id;
+			count += tile_refs->count;
+		}
+	}
+
+	osmdb_entrySort_t* sort;
+	sort = (osmdb_entrySort_t*)
+	       MALLOC(count*sizeof(osmdb_entrySort_t));
+	if(sort == NULL)
+	{
+		LOGE("MALLOC failed");
+		return 0;
+	}
+
+	// gather the existing refs and then the pending refs
+	int n = 0;
+	int j;
+	int k;
+	for(i = 0; i < OSMDB_TILEBLOCK_COUNT; ++i)
+	{
+		tile_refs = osmdb_tileBlock_tile(block, i);
+		if(tile_refs == NULL)
+		{
+			continue;
+		}
+
+		for(j = 0; j < tile_refs->count_classes; ++j)
+		{
+			int      class;
+			int      class_count;
+			int64_t* refs;
+			refs = osmdb_tileRefs_classRefs(tile_refs, j, &class,
+			                                &class_count);
+			for(k = 0; k < class_count; ++k)
+			{
+				sort[n].ref   = refs[k];
+				sort[n].idx   = i;
+				sort[n].class = class;
+				sort[n].seq   = n;
+				++n;
+			}
+		}
+	}
+
+	osmdb_entryPending_t* p;
+	for(i = 0; i < self->pending_count; ++i)
+	{
+		p = &self->pending[i];
+		ids[p->idx]   = p->id;
+		sort[n].ref   = p->ref;
+		sort[n].idx   = p->idx;
+		sort[n].class = p->class;
+		sort[n].seq   = n;
+		++n;
+	}
+
+	qsort(sort, n, sizeof(osmdb_entrySort_t),
+	      osmdb_entry_cmpSort);
+
+	// compute the packed size
+	size_t size = sizeof(osmdb_tileBlock_t);
+	for(i = 0; i < n; ++i)
+	{
+		size += sizeof(int64_t);
+		if((i == 0) || (sort[i].idx != sort[i - 1].idx))
+		{
+			size += sizeof(osmdb_tileRefs_t);
+		}
+		if((i == 0) || (sort[i].idx   != sort[i - 1].idx) ||
+		   (sort[i].class != sort[i - 1].class))
+		{
+			size += sizeof(osmdb_tileClass_t);
+		}
+	}
+
+	osmdb_tileBlock_t* block2;
+	block2 = (osmdb_tileBlock_t*) CALLOC(1, size);
+	if(block2 == NULL)
+	{
+		LOGE("CALLOC failed");
+		goto fail_block;
+	}
+	block2->bid = block->bid;
+
+	// pack the tiles in Z-order
+	size_t offset = sizeof(osmdb_tileBlock_t);
+	for(i = 0; i < n; i = j)
+	{
+		int idx = sort[i].idx;
+
+		// count the refs and classes for the tile
+		int count_classes = 1;
+		for(j = i + 1; (j < n) && (sort[j].idx == idx); ++j)
+		{
+			if(sort[j].class != sort[j - 1].class)
+			{
+				++count_classes;
+			}
+		}
+
+		block2->offset[idx] = (int) offset;
+		++block2->count;
+
+		tile_refs = osmdb_tileBlock_tile(block2, idx);
+		tile_refs->id            = ids[idx];
+		tile_refs->count         = j - i;
+		tile_refs->count_classes = count_classes;
+
+		osmdb_tileClass_t* classes;
+		int64_t*           refs;
+		classes = osmdb_tileRefs_classes(tile_refs);
+		refs    = osmdb_tileRefs_refs(tile_refs);
+
+		int c = -1;
+		for(k = i; k < j; ++k)
+		{
+			if((k == i) || (sort[k].class != sort[k - 1].class))
+			{
+				++c;
+				classes[c].class  = sort[k].class;
+				classes[c].offset = k - i;
+			}
+			refs[k - i] = sort[k].ref;
+		}
+
+		offset += osmdb_tileRefs_sizeof(tile_refs);
+	}
+
+	FREE(sort);
+	FREE(self->data);
+	self->max_size      = size;
+	self->size          = size;
+	self->data          = (void*) block2;
+	self->pending_count = 0;
+
+	// success
+	return 1;
+
+	// failure
+	fail_block:
+		FREE(sort);
+	return 0;
+}
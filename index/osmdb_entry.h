@@ -31,6 +31,15 @@
 
 #define OSMDB_ENTRY_SIZE 100
 
+// tile refs which have not been packed into the tile block
+typedef struct
+{
+	int64_t id;
+	int64_t ref;
+	int     idx;
+	int     class;
+} osmdb_entryPending_t;
+
 typedef struct osmdb_entry_s
 {
 	// state
@@ -44,6 +53,11 @@ typedef struct osmdb_entry_s
 	size_t size;
 	void*  data;
 
+	// pending tile refs
+	int                   pending_count;
+	int                   pending_max;
+	osmdb_entryPending_t* pending;
+
 	// handles
 	cc_map_t* map;
 } osmdb_entry_t;
@@ -60,5 +74,9 @@ int            osmdb_entry_add(osmdb_entry_t* self,
                                int loaded,
                                size_t size,
                                const void* data);
+int            osmdb_entry_addTile(osmdb_entry_t* self,
+                                   int64_t id, int class,
+                                   int64_t ref);
+int            osmdb_entry_pack(osmdb_entry_t* self);
 
 #endif
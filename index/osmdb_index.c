@@ -67,6 +67,16 @@ const char* OSMDB_INDEX_TBL[] =
 	"tbl_relInfo",
 	"tbl_relMembers",
 	"tbl_relRange",
+	"tbl_relRings",
+	"tbl_wayChain",
+	"tbl_wayGen3",
+	"tbl_wayGen5",
+	"tbl_wayGen7",
+	"tbl_wayGen9",
+	"tbl_relGen3",
+	"tbl_relGen5",
+	"tbl_relGen7",
+	"tbl_relGen9",
 	NULL
 };
 
@@ -166,6 +176,46 @@ osmdb_index_createTables(osmdb_index_t* self)
 		}
 	}
 
+	char sql_version[256];
+	snprintf(sql_version, 256, "PRAGMA user_version = %i;",
+	         OSMDB_INDEX_VERSION);
+	if(sqlite3_exec(self->db, sql_version, NULL, NULL,
+	                NULL) != SQLITE_OK)
+	{
+		LOGE("sqlite3_exec: %s", sqlite3_errmsg(self->db));
+		return 0;
+	}
+
+	return 1;
+}
+
+static int
+osmdb_index_checkVersion(osmdb_index_t* self)
+{
+	ASSERT(self);
+
+	sqlite3_stmt* stmt = NULL;
+	if(sqlite3_prepare_v2(self->db, "PRAGMA user_version;",
+	                      -1, &stmt, NULL) != SQLITE_OK)
+	{
+		LOGE("sqlite3_prepare_v2: %s", sqlite3_errmsg(self->db));
+		return 0;
+	}
+
+	int version = 0;
+	if(sqlite3_step(stmt) == SQLITE_ROW)
+	{
+		version = sqlite3_column_int(stmt, 0);
+	}
+	sqlite3_finalize(stmt);
+
+	if(version != OSMDB_INDEX_VERSION)
+	{
+		LOGE("invalid version=%i, expected=%i",
+		     version, OSMDB_INDEX_VERSION);
+		return 0;
+	}
+
 	return 1;
 }
 
@@ -651,7 +701,8 @@ osmdb_index_evict(osmdb_index_t* self,
 	{
 		if(entry->dirty)
 		{
-			if(osmdb_index_save(self, entry) == 0)
+			if((osmdb_entry_pack(entry) == 0) ||
+			   (osmdb_index_save(self, entry) == 0))
 			{
 				ret = 0;
 			}
@@ -765,14 +816,11 @@ int osmdb_index_add(osmdb_index_t* self,
                     void* data)
 {
 	ASSERT(self);
+	ASSERT(type >= OSMDB_TYPE_TILEREF_COUNT);
 
 	osmdb_entry_t* entry;
 
 	int64_t major_id = id/OSMDB_ENTRY_SIZE;
-	if(type < OSMDB_TYPE_TILEREF_COUNT)
-	{
-		major_id = id;
-	}
 
 	osmdb_cacheMapKey_t key =
 	{
@@ -848,13 +896,18 @@ int osmdb_index_add(osmdb_index_t* self,
 }
 
 int osmdb_index_addTile(osmdb_index_t* self, int type,
-                        int64_t major_id, int64_t ref)
+                        int64_t id, int class,
+                        int64_t ref)
 {
 	ASSERT(self);
 	ASSERT(type < OSMDB_TYPE_TILEREF_COUNT);
 
 	osmdb_entry_t* entry;
 
+	int64_t major_id;
+	int     idx;
+	osmdb_tileBlock_index(type, id, &major_id, &idx);
+
 	osmdb_cacheMapKey_t key =
 	{
 		.major_id = major_id,
@@ -862,9 +915,8 @@ int osmdb_index_addTile(osmdb_index_t* self, int type,
 	};
 
 	// check if entry is in cache
-	osmdb_tileRefs_t* tile_refs;
-	cc_mapIter_t*     miter;
-	cc_listIter_t*    iter;
+	cc_mapIter_t*  miter;
+	cc_listIter_t* iter;
 	miter = cc_map_findp(self->cache_map,
 	                     sizeof(osmdb_cacheMapKey_t), &key);
 	if(miter)
@@ -872,16 +924,11 @@ int osmdb_index_addTile(osmdb_index_t* self, int type,
 		iter  = (cc_listIter_t*) cc_map_val(miter);
 		entry = (osmdb_entry_t*) cc_list_peekIter(iter);
 
-		if(osmdb_entry_add(entry, 0, sizeof(int64_t),
-		                   (void*) &ref) == 0)
+		if(osmdb_entry_addTile(entry, id, class, ref) == 0)
 		{
 			return 0;
 		}
 
-		// update tile count
-		tile_refs = (osmdb_tileRefs_t*) entry->data;
-		++tile_refs->count;
-
 		// update LRU cache
 		cc_list_moven(self->cache_list, iter, NULL);
 		osmdb_index_trim(self);
@@ -914,16 +961,16 @@ int osmdb_index_addTile(osmdb_index_t* self, int type,
 		goto fail_add;
 	}
 
-	// add tile header if not already loaded
+	// add block header if not already loaded
 	if(entry->data == NULL)
 	{
-		osmdb_tileRefs_t tmp =
+		osmdb_tileBlock_t tmp =
 		{
-			.id    = major_id,
+			.bid   = major_id,
 			.count = 0
 		};
 
-		if(osmdb_entry_add(entry, 0, sizeof(osmdb_tileRefs_t),
+		if(osmdb_entry_add(entry, 0, sizeof(osmdb_tileBlock_t),
 		                   (void*) &tmp) == 0)
 		{
 			// fail w/o removing entry from cache
@@ -931,17 +978,12 @@ int osmdb_index_addTile(osmdb_index_t* self, int type,
 		}
 	}
 
-	if(osmdb_entry_add(entry, 0, sizeof(int64_t),
-	                   (void*) &ref) == 0)
+	if(osmdb_entry_addTile(entry, id, class, ref) == 0)
 	{
 		// fail w/o removing entry from cache
 		return 0;
 	}
 
-	// update tile count
-	tile_refs = (osmdb_tileRefs_t*) entry->data;
-	++tile_refs->count;
-
 	osmdb_index_trim(self);
 
 	// success
@@ -1024,6 +1066,10 @@ osmdb_index_new(const char* fname, int mode, int nth,
 			goto fail_create;
 		}
 	}
+	else if(osmdb_index_checkVersion(self) == 0)
+	{
+		goto fail_version;
+	}
 
 	const char* sql_begin = "BEGIN;";
 	if(sqlite3_prepare_v2(self->db, sql_begin, -1,
@@ -1126,7 +1172,8 @@ osmdb_index_new(const char* fname, int mode, int nth,
 	fail_prepare_end:
 		sqlite3_finalize(self->stmt_begin);
 	fail_prepare_begin:
-		fail_create:
+	fail_version:
+	fail_create:
 	fail_open:
 	{
 		// close db even when open fails
@@ -1275,8 +1322,9 @@ int osmdb_index_get(osmdb_index_t* self,
 	int64_t minor_id = id%OSMDB_ENTRY_SIZE;
 	if(type < OSMDB_TYPE_TILEREF_COUNT)
 	{
-		major_id = id;
-		minor_id = 0;
+		int idx;
+		osmdb_tileBlock_index(type, id, &major_id, &idx);
+		minor_id = idx;
 	}
 
 	osmdb_cacheMapKey_t key =
@@ -1317,7 +1365,9 @@ int osmdb_index_get(osmdb_index_t* self,
 	}
 
 	// upgrade read lock
-	osmdb_index_lockLoad(self, tid, type, id);
+	// note that the major_id is locked since neighboring
+	// ids share the same entry
+	osmdb_index_lockLoad(self, tid, type, major_id);
 
 	// retry find after locking for load since the entry
 	// could have been loaded in parallel by another thread
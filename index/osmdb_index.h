@@ -32,6 +32,13 @@
 #include "libsqlite3/sqlite3.h"
 #include "osmdb_type.h"
 
+// the version is stored as the sqlite user_version and
+// must be changed when the tables or the layout of the
+// records change so that databases of another version are
+// refused rather than misread (e.g. the world coordinates
+// of osmdb_nodeCoord_t and the tbl_relRings table)
+#define OSMDB_INDEX_VERSION 20261016
+
 #define OSMDB_INDEX_MODE_READONLY 0
 #define OSMDB_INDEX_MODE_CREATE   1
 #define OSMDB_INDEX_MODE_APPEND   2
@@ -208,6 +208,35 @@ osmdb_wayNds_sizeof(osmdb_wayNds_t* self)
 	       self->count*sizeof(int64_t);
 }
 
+int64_t*
+osmdb_wayChain_nds(osmdb_wayChain_t* self)
+{
+	ASSERT(self);
+
+	return (int64_t*)
+	       (((void*) self) + sizeof(osmdb_wayChain_t));
+}
+
+osmdb_worldPoint_t*
+osmdb_wayChain_pts(osmdb_wayChain_t* self)
+{
+	ASSERT(self);
+
+	return (osmdb_worldPoint_t*)
+	       (((void*) self) + sizeof(osmdb_wayChain_t) +
+	        self->count*sizeof(int64_t));
+}
+
+size_t
+osmdb_wayChain_sizeof(osmdb_wayChain_t* self)
+{
+	ASSERT(self);
+
+	return sizeof(osmdb_wayChain_t) +
+	       self->count*sizeof(int64_t) +
+	       self->count*sizeof(osmdb_worldPoint_t);
+}
+
 char*
 osmdb_relInfo_name(osmdb_relInfo_t* self)
 {
@@ -256,18 +285,209 @@ osmdb_relRange_sizeof(osmdb_relRange_t* self)
 	return sizeof(osmdb_relRange_t);
 }
 
-int64_t* osmdb_tileRefs_refs(osmdb_tileRefs_t* self)
+int64_t*
+osmdb_relRing_nds(osmdb_relRing_t* self)
 {
 	ASSERT(self);
 
 	return (int64_t*)
+	       (((void*) self) + sizeof(osmdb_relRing_t));
+}
+
+osmdb_worldPoint_t*
+osmdb_relRing_pts(osmdb_relRing_t* self)
+{
+	ASSERT(self);
+
+	return (osmdb_worldPoint_t*)
+	       (((void*) self) + sizeof(osmdb_relRing_t) +
+	        self->count*sizeof(int64_t));
+}
+
+size_t
+osmdb_relRing_sizeof(osmdb_relRing_t* self)
+{
+	ASSERT(self);
+
+	return sizeof(osmdb_relRing_t) +
+	       self->count*sizeof(int64_t) +
+	       self->count*sizeof(osmdb_worldPoint_t);
+}
+
+int64_t*
+osmdb_relRings_wids(osmdb_relRings_t* self)
+{
+	ASSERT(self);
+
+	return (int64_t*)
+	       (((void*) self) + sizeof(osmdb_relRings_t));
+}
+
+osmdb_relRing_t*
+osmdb_relRings_ring(osmdb_relRings_t* self,
+                    osmdb_relRing_t* prev)
+{
+	// prev may be NULL
+	ASSERT(self);
+
+	// rings are variable sized where the first ring follows
+	// the wids and the caller must iterate over count rings
+	if(prev == NULL)
+	{
+		return (osmdb_relRing_t*)
+		       (((void*) self) + sizeof(osmdb_relRings_t) +
+		        self->count_wids*sizeof(int64_t));
+	}
+
+	return (osmdb_relRing_t*)
+	       (((void*) prev) + osmdb_relRing_sizeof(prev));
+}
+
+size_t
+osmdb_relRings_sizeof(osmdb_relRings_t* self)
+{
+	ASSERT(self);
+
+	size_t size = sizeof(osmdb_relRings_t) +
+	              self->count_wids*sizeof(int64_t);
+
+	int              i;
+	osmdb_relRing_t* ring = NULL;
+	for(i = 0; i < self->count; ++i)
+	{
+		ring  = osmdb_relRings_ring(self, ring);
+		size += osmdb_relRing_sizeof(ring);
+	}
+
+	return size;
+}
+
+osmdb_tileClass_t*
+osmdb_tileRefs_classes(osmdb_tileRefs_t* self)
+{
+	ASSERT(self);
+
+	return (osmdb_tileClass_t*)
 	       (((void*) self) + sizeof(osmdb_tileRefs_t));
 }
 
+int64_t* osmdb_tileRefs_refs(osmdb_tileRefs_t* self)
+{
+	ASSERT(self);
+
+	return (int64_t*)
+	       (((void*) self) + sizeof(osmdb_tileRefs_t) +
+	        self->count_classes*sizeof(osmdb_tileClass_t));
+}
+
+int64_t*
+osmdb_tileRefs_classRefs(osmdb_tileRefs_t* self, int idx,
+                         int* _class, int* _count)
+{
+	ASSERT(self);
+	ASSERT((idx >= 0) && (idx < self->count_classes));
+	ASSERT(_class);
+	ASSERT(_count);
+
+	osmdb_tileClass_t* classes = osmdb_tileRefs_classes(self);
+	int64_t*           refs    = osmdb_tileRefs_refs(self);
+
+	int end = self->count;
+	if(idx + 1 < self->count_classes)
+	{
+		end = classes[idx + 1].offset;
+	}
+
+	*_class = classes[idx].class;
+	*_count = end - classes[idx].offset;
+	return &refs[classes[idx].offset];
+}
+
+int64_t*
+osmdb_tileRefs_findClass(osmdb_tileRefs_t* self, int class,
+                         int* _count)
+{
+	ASSERT(self);
+	ASSERT(_count);
+
+	osmdb_tileClass_t* classes = osmdb_tileRefs_classes(self);
+
+	// binary search the class table
+	int a = 0;
+	int b = self->count_classes - 1;
+	while(a <= b)
+	{
+		int c = a + (b - a)/2;
+		if(classes[c].class == class)
+		{
+			int class_c;
+			return osmdb_tileRefs_classRefs(self, c, &class_c,
+			                                _count);
+		}
+		else if(classes[c].class < class)
+		{
+			a = c + 1;
+		}
+		else
+		{
+			b = c - 1;
+		}
+	}
+
+	*_count = 0;
+	return NULL;
+}
+
 size_t osmdb_tileRefs_sizeof(osmdb_tileRefs_t* self)
 {
 	ASSERT(self);
 
 	return sizeof(osmdb_tileRefs_t) +
+	       self->count_classes*sizeof(osmdb_tileClass_t) +
 	       self->count*sizeof(int64_t);
 }
+
+void osmdb_tileBlock_index(int type, int64_t id,
+                           int64_t* _bid, int* _idx)
+{
+	ASSERT(type < OSMDB_TYPE_TILEREF_COUNT);
+	ASSERT(_bid);
+	ASSERT(_idx);
+
+	// tile types are ordered by zoom 3, 5, ..., 15 and the
+	// tile id is pow2n*y + x (see osmdb_tiler_gatherNodes)
+	int     zoom  = 3 + 2*(type%7);
+	int64_t pow2n = ((int64_t) 1) << zoom;
+	int64_t x     = id%pow2n;
+	int64_t y     = id/pow2n;
+
+	*_bid = (pow2n/OSMDB_TILEBLOCK_SIZE)*(y/OSMDB_TILEBLOCK_SIZE) +
+	        x/OSMDB_TILEBLOCK_SIZE;
+
+	// interleave the bits of the tile within the block
+	int bx  = (int) (x%OSMDB_TILEBLOCK_SIZE);
+	int by  = (int) (y%OSMDB_TILEBLOCK_SIZE);
+	int idx = 0;
+	int b;
+	for(b = 0; (1 << b) < OSMDB_TILEBLOCK_SIZE; ++b)
+	{
+		idx |= ((bx >> b) & 1) << (2*b);
+		idx |= ((by >> b) & 1) << (2*b + 1);
+	}
+	*_idx = idx;
+}
+
+osmdb_tileRefs_t*
+osmdb_tileBlock_tile(osmdb_tileBlock_t* self, int idx)
+{
+	ASSERT(self);
+	ASSERT((idx >= 0) && (idx < OSMDB_TILEBLOCK_COUNT));
+
+	if(self->offset[idx] == 0)
+	{
+		return NULL;
+	}
+
+	return (osmdb_tileRefs_t*)
+	       (((void*) self) + self->offset[idx]);
+}
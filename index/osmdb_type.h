@@ -26,6 +26,8 @@
 
 #include <stdint.h>
 
+// changes to the types or records require a new
+// OSMDB_INDEX_VERSION (see osmdb_index.h)
 #define OSMDB_TYPE_TILEREF_NODE3   0
 #define OSMDB_TYPE_TILEREF_NODE5   1
 #define OSMDB_TYPE_TILEREF_NODE7   2
@@ -56,13 +58,28 @@
 #define OSMDB_TYPE_RELINFO        26
 #define OSMDB_TYPE_RELMEMBERS     27
 #define OSMDB_TYPE_RELRANGE       28
-#define OSMDB_TYPE_COUNT          29 // COUNT
+#define OSMDB_TYPE_RELRINGS       29
+#define OSMDB_TYPE_WAYCHAIN       30
+#define OSMDB_TYPE_WAYGEN3        31
+#define OSMDB_TYPE_WAYGEN5        32
+#define OSMDB_TYPE_WAYGEN7        33
+#define OSMDB_TYPE_WAYGEN9        34
+#define OSMDB_TYPE_RELGEN3        35
+#define OSMDB_TYPE_RELGEN5        36
+#define OSMDB_TYPE_RELGEN7        37
+#define OSMDB_TYPE_RELGEN9        38
+#define OSMDB_TYPE_COUNT          39 // COUNT
 
 typedef struct
 {
 	int64_t nid;
 	double  lat;
 	double  lon;
+
+	// web mercator coordinates at zoom 31
+	// see osmdb_proj_coord2world
+	int     x;
+	int     y;
 } osmdb_nodeCoord_t;
 
 #define OSMDB_NODEINFO_FLAG_BUILDING        0x0020
@@ -89,6 +106,7 @@ typedef struct
 #define OSMDB_WAYINFO_FLAG_CUTTING   0x0010
 #define OSMDB_WAYINFO_FLAG_BUILDING  0x0020
 #define OSMDB_WAYINFO_FLAG_NAMEREF   0x0040
+#define OSMDB_WAYINFO_FLAG_AREA      0x0080 // CLOSED POLYGON
 #define OSMDB_WAYINFO_FLAG_RESERVED1 0x1000 // INNER
 
 typedef struct
@@ -111,6 +129,14 @@ typedef struct
 	double  lonR;
 } osmdb_wayRange_t;
 
+// web mercator coordinates at zoom 31
+// see osmdb_proj_coord2world
+typedef struct
+{
+	int x;
+	int y;
+} osmdb_worldPoint_t;
+
 typedef struct
 {
 	int64_t wid;
@@ -118,12 +144,37 @@ typedef struct
 	// int64_t nds[];
 } osmdb_wayNds_t;
 
+// chains are assembled by import-osm by merging lines
+// which share the class, flags, layer and name so that
+// the low zoom tiles reference a single chain rather than
+// many short ways
+// chains are referenced by the way tile refs as -cid where
+// the cid is the wid of the first way in the chain which
+// also provides the way_info (range.wid)
+typedef struct
+{
+	int64_t          cid;
+	int              count;
+	int              pad; // unused padding for 64-bit alignment
+	osmdb_wayRange_t range;
+	// int64_t            nds[];
+	// osmdb_worldPoint_t pts[];
+} osmdb_wayChain_t;
+
+// generalized geometry is simplified by import-osm at the
+// tolerance of the low zoom tiles so that the tiler does
+// not need the full resolution nds for these tiles
+// waygen uses the osmdb_wayChain_t layout where the cid is
+// the way tile ref (e.g. wid or -cid) and relgen uses the
+// osmdb_relRings_t layout
+
 #define OSMDB_RELINFO_TYPE_NONE         0
 #define OSMDB_RELINFO_TYPE_BOUNDARY     1
 #define OSMDB_RELINFO_TYPE_MULTIPOLYGON 2
 
 #define OSMDB_RELINFO_FLAG_BUILDING 0x0020
 #define OSMDB_RELINFO_FLAG_NAMEREF  0x0040
+#define OSMDB_RELINFO_FLAG_AREA     0x0080 // POLYGON
 
 typedef struct
 {
@@ -159,13 +210,73 @@ typedef struct
 	double  lonR;
 } osmdb_relRange_t;
 
+#define OSMDB_RELRING_FLAG_INNER  0x0001
+#define OSMDB_RELRING_FLAG_CLOSED 0x0002
+
+// a ring is an ordered node list assembled from the
+// member ways of a relation
+// range.wid is the member way which provides the way_info
+// for the ring and nds which are missing due to osmosis
+// are discarded when the ring is assembled
+typedef struct
+{
+	int              flags;
+	int              count;
+	osmdb_wayRange_t range;
+	// int64_t            nds[];
+	// osmdb_worldPoint_t pts[];
+} osmdb_relRing_t;
+
+// rings are assembled by import-osm for multipolygon and
+// boundary relations so that they are not reassembled by
+// the tiler for every tile
+// wids are the members which are drawn by the relation and
+// are not exported separately as ways
+typedef struct
+{
+	int64_t rid;
+	int     count;
+	int     count_wids;
+	// int64_t         wids[];
+	// osmdb_relRing_t rings[];
+} osmdb_relRings_t;
+
+// tile refs are sorted by class and the class table
+// contains the offset of the first ref for each class such
+// that the refs for a subset of classes may be visited
+// without looking up the info for every ref
+typedef struct
+{
+	int class;
+	int offset;
+} osmdb_tileClass_t;
+
 typedef struct
 {
 	int64_t id;
 	int     count;
-	// int64_t refs[];
+	int     count_classes;
+	// osmdb_tileClass_t classes[];
+	// int64_t           refs[];
 } osmdb_tileRefs_t;
 
+// tile refs are stored in blocks of NxN neighboring tiles
+// so that a single entry is loaded for nearby tiles
+// the tiles within a block are indexed in Z-order and the
+// offset directory contains the byte offset of each tile
+// relative to the block where 0 indicates an empty tile
+#define OSMDB_TILEBLOCK_SIZE  8
+#define OSMDB_TILEBLOCK_COUNT 64
+
+typedef struct
+{
+	int64_t bid;
+	int     count;
+	int     pad; // unused padding for 64-bit alignment
+	int     offset[OSMDB_TILEBLOCK_COUNT];
+	// osmdb_tileRefs_t tiles[];
+} osmdb_tileBlock_t;
+
 typedef struct osmdb_entry_s osmdb_entry_t;
 
 typedef struct
@@ -179,27 +290,52 @@ typedef struct
 		osmdb_wayInfo_t*    way_info;
 		osmdb_wayRange_t*   way_range;
 		osmdb_wayNds_t*     way_nds;
+		osmdb_wayChain_t*   way_chain;
 		osmdb_relInfo_t*    rel_info;
 		osmdb_relMembers_t* rel_members;
 		osmdb_relRange_t*   rel_range;
+		osmdb_relRings_t*   rel_rings;
 		osmdb_tileRefs_t*   tile_refs;
 	};
 } osmdb_handle_t;
 
-size_t           osmdb_nodeCoord_sizeof(osmdb_nodeCoord_t* self);
-char*            osmdb_nodeInfo_name(osmdb_nodeInfo_t* self);
-size_t           osmdb_nodeInfo_sizeof(osmdb_nodeInfo_t* self);
-char*            osmdb_wayInfo_name(osmdb_wayInfo_t* self);
-size_t           osmdb_wayInfo_sizeof(osmdb_wayInfo_t* self);
-size_t           osmdb_wayRange_sizeof(osmdb_wayRange_t* self);
-int64_t*         osmdb_wayNds_nds(osmdb_wayNds_t* self);
-size_t           osmdb_wayNds_sizeof(osmdb_wayNds_t* self);
-char*            osmdb_relInfo_name(osmdb_relInfo_t* self);
-size_t           osmdb_relInfo_sizeof(osmdb_relInfo_t* self);
-osmdb_relData_t* osmdb_relMembers_data(osmdb_relMembers_t* self);
-size_t           osmdb_relMembers_sizeof(osmdb_relMembers_t* self);
-size_t           osmdb_relRange_sizeof(osmdb_relRange_t* self);
-int64_t*         osmdb_tileRefs_refs(osmdb_tileRefs_t* self);
-size_t           osmdb_tileRefs_sizeof(osmdb_tileRefs_t* self);
+size_t              osmdb_nodeCoord_sizeof(osmdb_nodeCoord_t* self);
+char*               osmdb_nodeInfo_name(osmdb_nodeInfo_t* self);
+size_t              osmdb_nodeInfo_sizeof(osmdb_nodeInfo_t* self);
+char*               osmdb_wayInfo_name(osmdb_wayInfo_t* self);
+size_t              osmdb_wayInfo_sizeof(osmdb_wayInfo_t* self);
+size_t              osmdb_wayRange_sizeof(osmdb_wayRange_t* self);
+int64_t*            osmdb_wayNds_nds(osmdb_wayNds_t* self);
+size_t              osmdb_wayNds_sizeof(osmdb_wayNds_t* self);
+int64_t*            osmdb_wayChain_nds(osmdb_wayChain_t* self);
+osmdb_worldPoint_t* osmdb_wayChain_pts(osmdb_wayChain_t* self);
+size_t              osmdb_wayChain_sizeof(osmdb_wayChain_t* self);
+char*               osmdb_relInfo_name(osmdb_relInfo_t* self);
+size_t              osmdb_relInfo_sizeof(osmdb_relInfo_t* self);
+osmdb_relData_t*    osmdb_relMembers_data(osmdb_relMembers_t* self);
+size_t              osmdb_relMembers_sizeof(osmdb_relMembers_t* self);
+size_t              osmdb_relRange_sizeof(osmdb_relRange_t* self);
+int64_t*            osmdb_relRing_nds(osmdb_relRing_t* self);
+osmdb_worldPoint_t* osmdb_relRing_pts(osmdb_relRing_t* self);
+size_t              osmdb_relRing_sizeof(osmdb_relRing_t* self);
+int64_t*            osmdb_relRings_wids(osmdb_relRings_t* self);
+osmdb_relRing_t*    osmdb_relRings_ring(osmdb_relRings_t* self,
+                                        osmdb_relRing_t* prev);
+size_t              osmdb_relRings_sizeof(osmdb_relRings_t* self);
+osmdb_tileClass_t*  osmdb_tileRefs_classes(osmdb_tileRefs_t* self);
+int64_t*            osmdb_tileRefs_refs(osmdb_tileRefs_t* self);
+int64_t*            osmdb_tileRefs_classRefs(osmdb_tileRefs_t* self,
+                                             int idx,
+                                             int* _class,
+                                             int* _count);
+int64_t*            osmdb_tileRefs_findClass(osmdb_tileRefs_t* self,
+                                             int class,
+                                             int* _count);
+size_t              osmdb_tileRefs_sizeof(osmdb_tileRefs_t* self);
+void                osmdb_tileBlock_index(int type, int64_t id,
+                                          int64_t* _bid,
+                                          int* _idx);
+osmdb_tileRefs_t*   osmdb_tileBlock_tile(osmdb_tileBlock_t* self,
+                                         int idx);
 
 #endif
@@ -0,0 +1,444 @@
+/*
+ * Copyright (c) 2021 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOG_TAG "osmdb"
+#include "libcc/cc_log.h"
+#include "libcc/cc_memory.h"
+#include "osmdb_cover.h"
+
+/***********************************************************
+* private                                                  *
+***********************************************************/
+
+static int osmdb_coverSpan_cmp(const void* a, const void* b)
+{
+	ASSERT(a);
+	ASSERT(b);
+
+	const osmdb_coverSpan_t* sa = (const osmdb_coverSpan_t*) a;
+	const osmdb_coverSpan_t* sb = (const osmdb_coverSpan_t*) b;
+
+	if(sa->row != sb->row)
+	{
+		return sa->row - sb->row;
+	}
+
+	return sa->col0 - sb->col0;
+}
+
+static int osmdb_cover_cmpd(const void* a, const void* b)
+{
+	ASSERT(a);
+	ASSERT(b);
+
+	double da = *((const double*) a);
+	double db = *((const double*) b);
+
+	if(da < db)
+	{
+		return -1;
+	}
+	else if(da > db)
+	{
+		return 1;
+	}
+
+	return 0;
+}
+
+static int clampi(int v, int a, int b)
+{
+	if(v < a)
+	{
+		return a;
+	}
+	else if(v > b)
+	{
+		return b;
+	}
+
+	return v;
+}
+
+static int
+osmdb_cover_addSpan(osmdb_cover_t* self,
+                    int row, int col0, int col1)
+{
+	ASSERT(self);
+
+	if(self->count_spans >= self->max_spans)
+	{
+		int max_spans = 2*self->max_spans;
+		if(max_spans < 256)
+		{
+			max_spans = 256;
+		}
+
+		osmdb_coverSpan_t* tmp;
+		tmp = (osmdb_coverSpan_t*)
+		      REALLOC((void*) self->spans,
+		              max_spans*sizeof(osmdb_coverSpan_t));
+		if(tmp == NULL)
+		{
+			LOGE("REALLOC failed");
+			return 0;
+		}
+
+		self->spans     = tmp;
+		self->max_spans = max_spans;
+	}
+
+	osmdb_coverSpan_t* span = &self->spans[self->count_spans];
+	span->row  = row;
+	span->col0 = col0;
+	span->col1 = col1;
+	++self->count_spans;
+
+	return 1;
+}
+
+static int
+osmdb_cover_crossings(osmdb_cover_t* self, double s,
+                      double yc)
+{
+	ASSERT(self);
+
+	if(self->count_edges > self->max_cross)
+	{
+		double* tmp;
+		tmp = (double*)
+		      REALLOC((void*) self->cross,
+		              self->count_edges*sizeof(double));
+		if(tmp == NULL)
+		{
+			LOGE("REALLOC failed");
+			return 0;
+		}
+
+		self->cross     = tmp;
+		self->max_cross = self->count_edges;
+	}
+
+	// find the x crossings of the scanline where edges
+	// are half open to count vertices once
+	int i;
+	self->count_cross = 0;
+	for(i = 0; i < self->count_edges; ++i)
+	{
+		osmdb_coverEdge_t* e = &self->edges[i];
+
+		double ax = s*((double) e->x0);
+		double ay = s*((double) e->y0);
+		double bx = s*((double) e->x1);
+		double by = s*((double) e->y1);
+		if(((ay <= yc) && (yc < by)) ||
+		   ((by <= yc) && (yc < ay)))
+		{
+			double t = (yc - ay)/(by - ay);
+			self->cross[self->count_cross] = ax + t*(bx - ax);
+			++self->count_cross;
+		}
+	}
+
+	qsort((void*) self->cross, (size_t) self->count_cross,
+	      sizeof(double), osmdb_cover_cmpd);
+
+	return 1;
+}
+
+static int
+osmdb_cover_fill(osmdb_cover_t* self, double s)
+{
+	ASSERT(self);
+
+	// tiles between the spans of a row are not touched by
+	// the rings so they are either all inside or all
+	// outside which is determined by the even-odd rule
+	int i;
+	int j   = 0;
+	int row = -1;
+	for(i = 0; i < self->count_spans; ++i)
+	{
+		osmdb_coverSpan_t* span = &self->spans[i];
+		if((j == 0) || (self->spans[j - 1].row != span->row))
+		{
+			self->spans[j++] = *span;
+			continue;
+		}
+
+		osmdb_coverSpan_t* prev = &self->spans[j - 1];
+		if(row != span->row)
+		{
+			if(osmdb_cover_crossings(self, s,
+			                         (double) span->row + 0.5) == 0)
+			{
+				return 0;
+			}
+			row = span->row;
+		}
+
+		int    k;
+		int    count = 0;
+		double x     = (double) prev->col1 + 1.5;
+		for(k = 0; k < self->count_cross; ++k)
+		{
+			if(self->cross[k] >= x)
+			{
+				break;
+			}
+			++count;
+		}
+
+		if(count%2)
+		{
+			prev->col1 = span->col1;
+		}
+		else
+		{
+			self->spans[j++] = *span;
+		}
+	}
+	self->count_spans = j;
+
+	return 1;
+}
+
+/***********************************************************
+* public                                                   *
+***********************************************************/
+
+osmdb_cover_t* osmdb_cover_new(void)
+{
+	osmdb_cover_t* self;
+	self = (osmdb_cover_t*)
+	       CALLOC(1, sizeof(osmdb_cover_t));
+	if(self == NULL)
+	{
+		LOGE("CALLOC failed");
+		return NULL;
+	}
+
+	// edges/spans/cross allocated on demand
+
+	return self;
+}
+
+void osmdb_cover_delete(osmdb_cover_t** _self)
+{
+	ASSERT(_self);
+
+	osmdb_cover_t* self = *_self;
+	if(self)
+	{
+		FREE(self->cross);
+		FREE(self->spans);
+		FREE(self->edges);
+		FREE(self);
+		*_self = NULL;
+	}
+}
+
+void osmdb_cover_reset(osmdb_cover_t* self, int fill)
+{
+	ASSERT(self);
+
+	self->fill        = fill;
+	self->count_edges = 0;
+	self->count_spans = 0;
+	self->count_cross = 0;
+}
+
+int osmdb_cover_addLine(osmdb_cover_t* self,
+                        int count,
+                        osmdb_worldPoint_t* pts)
+{
+	ASSERT(self);
+	ASSERT(pts);
+
+	if(count <= 0)
+	{
+		return 1;
+	}
+
+	// a single point is added as a degenerate edge
+	int count_edges = (count == 1) ? 1 : count - 1;
+	int max_edges   = self->max_edges;
+	if(max_edges < 256)
+	{
+		max_edges = 256;
+	}
+
+	while(max_edges < self->count_edges + count_edges)
+	{
+		max_edges *= 2;
+	}
+
+	if(max_edges > self->max_edges)
+	{
+		osmdb_coverEdge_t* tmp;
+		tmp = (osmdb_coverEdge_t*)
+		      REALLOC((void*) self->edges,
+		              max_edges*sizeof(osmdb_coverEdge_t));
+		if(tmp == NULL)
+		{
+			LOGE("REALLOC failed");
+			return 0;
+		}
+
+		self->edges     = tmp;
+		self->max_edges = max_edges;
+	}
+
+	int i;
+	osmdb_coverEdge_t* e = &self->edges[self->count_edges];
+	for(i = 0; i < count_edges; ++i)
+	{
+		int i1 = (count == 1) ? 0 : i + 1;
+		e[i].x0 = pts[i].x;
+		e[i].y0 = pts[i].y;
+		e[i].x1 = pts[i1].x;
+		e[i].y1 = pts[i1].y;
+	}
+	self->count_edges += count_edges;
+
+	return 1;
+}
+
+int osmdb_cover_rasterize(osmdb_cover_t* self,
+                          int zoom, float border)
+{
+	ASSERT(self);
+
+	self->count_spans = 0;
+
+	// scale world coordinates to tile coordinates
+	double s = ldexp(1.0, zoom - 31);
+	double b = (double) border;
+	int    n = 1 << zoom;
+
+	// add the spans of tiles which each edge crosses in
+	// each row where the row and edge are expanded by the
+	// border
+	int i;
+	int r;
+	for(i = 0; i < self->count_edges; ++i)
+	{
+		osmdb_coverEdge_t* e = &self->edges[i];
+
+		double ax = s*((double) e->x0);
+		double ay = s*((double) e->y0);
+		double bx = s*((double) e->x1);
+		double by = s*((double) e->y1);
+		double y0 = (ay < by) ? ay : by;
+		double y1 = (ay < by) ? by : ay;
+		int    r0 = clampi((int) floor(y0 - b), 0, n - 1);
+		int    r1 = clampi((int) floor(y1 + b), 0, n - 1);
+		for(r = r0; r <= r1; ++r)
+		{
+			// clip the edge to the row
+			double t0 = 0.0;
+			double t1 = 1.0;
+			double yt = (double) r - b;
+			double yb = (double) r + 1.0 + b;
+			if(ay != by)
+			{
+				double ta = (yt - ay)/(by - ay);
+				double tb = (yb - ay)/(by - ay);
+				if(ta > tb)
+				{
+					double tmp = ta;
+					ta = tb;
+					tb = tmp;
+				}
+
+				t0 = (ta > 0.0) ? ta : 0.0;
+				t1 = (tb < 1.0) ? tb : 1.0;
+				if(t0 > t1)
+				{
+					continue;
+				}
+			}
+			else if((ay < yt) || (ay > yb))
+			{
+				continue;
+			}
+
+			double xa = ax + t0*(bx - ax);
+			double xb = ax + t1*(bx - ax);
+			if(xa > xb)
+			{
+				double tmp = xa;
+				xa = xb;
+				xb = tmp;
+			}
+
+			int c0 = clampi((int) floor(xa - b), 0, n - 1);
+			int c1 = clampi((int) floor(xb + b), 0, n - 1);
+			if(osmdb_cover_addSpan(self, r, c0, c1) == 0)
+			{
+				return 0;
+			}
+		}
+	}
+
+	if(self->count_spans == 0)
+	{
+		return 1;
+	}
+
+	// merge the overlapping spans
+	qsort((void*) self->spans, (size_t) self->count_spans,
+	      sizeof(osmdb_coverSpan_t), osmdb_coverSpan_cmp);
+
+	int j = 1;
+	for(i = 1; i < self->count_spans; ++i)
+	{
+		osmdb_coverSpan_t* prev = &self->spans[j - 1];
+		osmdb_coverSpan_t* span = &self->spans[i];
+		if((prev->row == span->row) &&
+		   (span->col0 <= prev->col1 + 1))
+		{
+			if(span->col1 > prev->col1)
+			{
+				prev->col1 = span->col1;
+			}
+		}
+		else
+		{
+			self->spans[j++] = *span;
+		}
+	}
+	self->count_spans = j;
+
+	if(self->fill)
+	{
+		return osmdb_cover_fill(self, s);
+	}
+
+	return 1;
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2021 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#ifndef osmdb_cover_H
+#define osmdb_cover_H
+
+#include "index/osmdb_type.h"
+
+// tile coverage of lines and polygons which is computed by
+// rasterizing the edges rather than the bounding box such
+// that a diagonal or L-shaped way is not referenced by the
+// tiles which it never touches
+// edges are in world coordinates (see
+// osmdb_proj_coord2world) so the coverage may be computed
+// for any zoom level
+
+typedef struct
+{
+	int x0;
+	int y0;
+	int x1;
+	int y1;
+} osmdb_coverEdge_t;
+
+typedef struct
+{
+	int row;
+	int col0;
+	int col1;
+} osmdb_coverSpan_t;
+
+typedef struct
+{
+	// polygons also cover the tiles inside the rings
+	int fill;
+
+	int                count_edges;
+	int                max_edges;
+	osmdb_coverEdge_t* edges;
+
+	// spans of the rasterized zoom which are sorted by
+	// row/col0 and do not overlap
+	int                count_spans;
+	int                max_spans;
+	osmdb_coverSpan_t* spans;
+
+	// scanline crossings for the fill
+	int     count_cross;
+	int     max_cross;
+	double* cross;
+} osmdb_cover_t;
+
+osmdb_cover_t* osmdb_cover_new(void);
+void           osmdb_cover_delete(osmdb_cover_t** _self);
+void           osmdb_cover_reset(osmdb_cover_t* self,
+                                 int fill);
+int            osmdb_cover_addLine(osmdb_cover_t* self,
+                                   int count,
+                                   osmdb_worldPoint_t* pts);
+int            osmdb_cover_rasterize(osmdb_cover_t* self,
+                                     int zoom, float border);
+
+#endif
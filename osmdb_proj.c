@@ -0,0 +1,518 @@
+/*
+ * Copyright (c) 2021 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define OSMDB_PROJ_AVX2
+#include <immintrin.h>
+#endif
+
+#define LOG_TAG "osmdb"
+#include "libcc/cc_log.h"
+#include "osmdb_proj.h"
+
+#define OSMDB_PROJ_PI       3.14159265358979323846
+#define OSMDB_PROJ_PI2      1.57079632679489661923
+#define OSMDB_PROJ_SQRT2    1.41421356237309504880
+#define OSMDB_PROJ_LN2      0.69314718055994530942
+#define OSMDB_PROJ_DEG2RAD  0.01745329251994329577
+#define OSMDB_PROJ_LATMAX   85.0511287798066
+#define OSMDB_PROJ_WGS84_A  6378137.0
+#define OSMDB_PROJ_WGS84_E2 6.69437999014e-3
+#define OSMDB_PROJ_BATCH    256
+
+// sin(x)/x = 1 + x^2*(S1 + x^2*(S2 + ...)) for |x| <= pi/2
+// truncation error is less than 1e-13
+#define OSMDB_PROJ_S1 -1.66666666666666666667e-1
+#define OSMDB_PROJ_S2  8.33333333333333333333e-3
+#define OSMDB_PROJ_S3 -1.98412698412698412698e-4
+#define OSMDB_PROJ_S4  2.75573192239858906526e-6
+#define OSMDB_PROJ_S5 -2.50521083854417187751e-8
+#define OSMDB_PROJ_S6  1.60590438368216145994e-10
+#define OSMDB_PROJ_S7 -7.64716373181981647590e-13
+#define OSMDB_PROJ_S8  2.81145725434552076320e-15
+
+// log(m) = 2*u*(1 + u^2*(L1 + u^2*(L2 + ...)))
+// where u = (m - 1)/(m + 1) for sqrt(1/2) <= m <= sqrt(2)
+#define OSMDB_PROJ_L1 (1.0/3.0)
+#define OSMDB_PROJ_L2 (1.0/5.0)
+#define OSMDB_PROJ_L3 (1.0/7.0)
+#define OSMDB_PROJ_L4 (1.0/9.0)
+#define OSMDB_PROJ_L5 (1.0/11.0)
+#define OSMDB_PROJ_L6 (1.0/13.0)
+#define OSMDB_PROJ_L7 (1.0/15.0)
+#define OSMDB_PROJ_L8 (1.0/17.0)
+#define OSMDB_PROJ_L9 (1.0/19.0)
+
+/***********************************************************
+* private - scalar                                         *
+***********************************************************/
+
+static double osmdb_proj_sin(double x)
+{
+	// fold x from [-pi, pi] to [-pi/2, pi/2]
+	if(x > OSMDB_PROJ_PI2)
+	{
+		x = OSMDB_PROJ_PI - x;
+	}
+	else if(x < -OSMDB_PROJ_PI2)
+	{
+		x = -OSMDB_PROJ_PI - x;
+	}
+
+	double x2 = x*x;
+	double p  = OSMDB_PROJ_S8;
+	p = p*x2 + OSMDB_PROJ_S7;
+	p = p*x2 + OSMDB_PROJ_S6;
+	p = p*x2 + OSMDB_PROJ_S5;
+	p = p*x2 + OSMDB_PROJ_S4;
+	p = p*x2 + OSMDB_PROJ_S3;
+	p = p*x2 + OSMDB_PROJ_S2;
+	p = p*x2 + OSMDB_PROJ_S1;
+	return x + x*x2*p;
+}
+
+static double osmdb_proj_cos(double x)
+{
+	// cos(x) = sin(pi/2 - |x|) for x in [-pi, pi]
+	if(x < 0.0)
+	{
+		x = -x;
+	}
+	return osmdb_proj_sin(OSMDB_PROJ_PI2 - x);
+}
+
+static double osmdb_proj_log(double z)
+{
+	ASSERT(z > 0.0);
+
+	// split z into m*2^e where sqrt(1/2) <= m <= sqrt(2)
+	uint64_t bits;
+	memcpy(&bits, &z, sizeof(double));
+
+	double e = (double) ((int) ((bits >> 52) & 0x7FF) - 1023);
+	double m;
+	bits = (bits & 0x000FFFFFFFFFFFFFULL) |
+	       0x3FF0000000000000ULL;
+	memcpy(&m, &bits, sizeof(double));
+	if(m > OSMDB_PROJ_SQRT2)
+	{
+		m *= 0.5;
+		e += 1.0;
+	}
+
+	double u  = (m - 1.0)/(m + 1.0);
+	double u2 = u*u;
+	double p  = OSMDB_PROJ_L9;
+	p = p*u2 + OSMDB_PROJ_L8;
+	p = p*u2 + OSMDB_PROJ_L7;
+	p = p*u2 + OSMDB_PROJ_L6;
+	p = p*u2 + OSMDB_PROJ_L5;
+	p = p*u2 + OSMDB_PROJ_L4;
+	p = p*u2 + OSMDB_PROJ_L3;
+	p = p*u2 + OSMDB_PROJ_L2;
+	p = p*u2 + OSMDB_PROJ_L1;
+	return e*OSMDB_PROJ_LN2 + 2.0*(u + u*u2*p);
+}
+
+static void
+osmdb_proj_coord2tile1(double lat, double lon, double n,
+                       double* x, double* y)
+{
+	ASSERT(x);
+	ASSERT(y);
+
+	if(lat > OSMDB_PROJ_LATMAX)
+	{
+		lat = OSMDB_PROJ_LATMAX;
+	}
+	else if(lat < -OSMDB_PROJ_LATMAX)
+	{
+		lat = -OSMDB_PROJ_LATMAX;
+	}
+
+	// y = (1/2 - atanh(sin(lat))/(2*pi))*n
+	double s = osmdb_proj_sin(lat*OSMDB_PROJ_DEG2RAD);
+	double l = osmdb_proj_log((1.0 + s)/(1.0 - s));
+	*x = n*(lon + 180.0)/360.0;
+	*y = n*(0.5 - l/(4.0*OSMDB_PROJ_PI));
+}
+
+static void
+osmdb_proj_geo2xyz1(double lat, double lon, double alt,
+                    double* x, double* y, double* z)
+{
+	ASSERT(x);
+	ASSERT(y);
+	ASSERT(z);
+
+	double sp = osmdb_proj_sin(lat*OSMDB_PROJ_DEG2RAD);
+	double cp = osmdb_proj_cos(lat*OSMDB_PROJ_DEG2RAD);
+	double sl = osmdb_proj_sin(lon*OSMDB_PROJ_DEG2RAD);
+	double cl = osmdb_proj_cos(lon*OSMDB_PROJ_DEG2RAD);
+	double n  = OSMDB_PROJ_WGS84_A/
+	            sqrt(1.0 - OSMDB_PROJ_WGS84_E2*sp*sp);
+	*x = (n + alt)*cp*cl;
+	*y = (n + alt)*cp*sl;
+	*z = (n*(1.0 - OSMDB_PROJ_WGS84_E2) + alt)*sp;
+}
+
+/***********************************************************
+* private - avx2                                           *
+***********************************************************/
+
+#ifdef OSMDB_PROJ_AVX2
+
+#define OSMDB_PROJ_TARGET __attribute__((target("avx2")))
+
+OSMDB_PROJ_TARGET
+static inline __m256d osmdb_proj_sin4(__m256d x)
+{
+	__m256d pi   = _mm256_set1_pd(OSMDB_PROJ_PI);
+	__m256d pi2  = _mm256_set1_pd(OSMDB_PROJ_PI2);
+	__m256d npi  = _mm256_set1_pd(-OSMDB_PROJ_PI);
+	__m256d npi2 = _mm256_set1_pd(-OSMDB_PROJ_PI2);
+
+	// fold x from [-pi, pi] to [-pi/2, pi/2]
+	__m256d mp = _mm256_cmp_pd(x, pi2, _CMP_GT_OQ);
+	__m256d mn = _mm256_cmp_pd(x, npi2, _CMP_LT_OQ);
+	x = _mm256_blendv_pd(x, _mm256_sub_pd(pi, x), mp);
+	x = _mm256_blendv_pd(x, _mm256_sub_pd(npi, x), mn);
+
+	__m256d x2 = _mm256_mul_pd(x, x);
+	__m256d p  = _mm256_set1_pd(OSMDB_PROJ_S8);
+	p = _mm256_add_pd(_mm256_mul_pd(p, x2),
+	                  _mm256_set1_pd(OSMDB_PROJ_S7));
+	p = _mm256_add_pd(_mm256_mul_pd(p, x2),
+	                  _mm256_set1_pd(OSMDB_PROJ_S6));
+	p = _mm256_add_pd(_mm256_mul_pd(p, x2),
+	                  _mm256_set1_pd(OSMDB_PROJ_S5));
+	p = _mm256_add_pd(_mm256_mul_pd(p, x2),
+	                  _mm256_set1_pd(OSMDB_PROJ_S4));
+	p = _mm256_add_pd(_mm256_mul_pd(p, x2),
+	                  _mm256_set1_pd(OSMDB_PROJ_S3));
+	p = _mm256_add_pd(_mm256_mul_pd(p, x2),
+	                  _mm256_set1_pd(OSMDB_PROJ_S2));
+	p = _mm256_add_pd(_mm256_mul_pd(p, x2),
+	                  _mm256_set1_pd(OSMDB_PROJ_S1));
+	return _mm256_add_pd(x, _mm256_mul_pd(_mm256_mul_pd(x, x2),
+	                                      p));
+}
+
+OSMDB_PROJ_TARGET
+static inline __m256d osmdb_proj_cos4(__m256d x)
+{
+	// cos(x) = sin(pi/2 - |x|) for x in [-pi, pi]
+	__m256d sign = _mm256_set1_pd(-0.0);
+	x = _mm256_andnot_pd(sign, x);
+	return osmdb_proj_sin4(_mm256_sub_pd(_mm256_set1_pd(OSMDB_PROJ_PI2),
+	                                     x));
+}
+
+OSMDB_PROJ_TARGET
+static inline __m256d osmdb_proj_log4(__m256d z)
+{
+	// split z into m*2^e where sqrt(1/2) <= m <= sqrt(2)
+	// the biased exponent is converted to a double by
+	// inserting it into the mantissa of 2^52
+	__m256i bits = _mm256_castpd_si256(z);
+	__m256i ebits;
+	__m256i mbits;
+	ebits = _mm256_or_si256(_mm256_srli_epi64(bits, 52),
+	                        _mm256_set1_epi64x(0x4330000000000000LL));
+	mbits = _mm256_or_si256(_mm256_and_si256(bits,
+	                        _mm256_set1_epi64x(0x000FFFFFFFFFFFFFLL)),
+	                        _mm256_set1_epi64x(0x3FF0000000000000LL));
+
+	__m256d e = _mm256_sub_pd(_mm256_castsi256_pd(ebits),
+	                          _mm256_set1_pd(4503599627370496.0 + 1023.0));
+	__m256d m = _mm256_castsi256_pd(mbits);
+	__m256d k = _mm256_cmp_pd(m, _mm256_set1_pd(OSMDB_PROJ_SQRT2),
+	                          _CMP_GT_OQ);
+	m = _mm256_blendv_pd(m, _mm256_mul_pd(m, _mm256_set1_pd(0.5)), k);
+	e = _mm256_add_pd(e, _mm256_and_pd(k, _mm256_set1_pd(1.0)));
+
+	__m256d one = _mm256_set1_pd(1.0);
+	__m256d u   = _mm256_div_pd(_mm256_sub_pd(m, one),
+	                            _mm256_add_pd(m, one));
+	__m256d u2  = _mm256_mul_pd(u, u);
+	__m256d p   = _mm256_set1_pd(OSMDB_PROJ_L9);
+	p = _mm256_add_pd(_mm256_mul_pd(p, u2),
+	                  _mm256_set1_pd(OSMDB_PROJ_L8));
+	p = _mm256_add_pd(_mm256_mul_pd(p, u2),
+	                  _mm256_set1_pd(OSMDB_PROJ_L7));
+	p = _mm256_add_pd(_mm256_mul_pd(p, u2),
+	                  _mm256_set1_pd(OSMDB_PROJ_L6));
+	p = _mm256_add_pd(_mm256_mul_pd(p, u2),
+	                  _mm256_set1_pd(OSMDB_PROJ_L5));
+	p = _mm256_add_pd(_mm256_mul_pd(p, u2),
+	                  _mm256_set1_pd(OSMDB_PROJ_L4));
+	p = _mm256_add_pd(_mm256_mul_pd(p, u2),
+	                  _mm256_set1_pd(OSMDB_PROJ_L3));
+	p = _mm256_add_pd(_mm256_mul_pd(p, u2),
+	                  _mm256_set1_pd(OSMDB_PROJ_L2));
+	p = _mm256_add_pd(_mm256_mul_pd(p, u2),
+	                  _mm256_set1_pd(OSMDB_PROJ_L1));
+	p = _mm256_add_pd(u, _mm256_mul_pd(_mm256_mul_pd(u, u2), p));
+	return _mm256_add_pd(_mm256_mul_pd(e, _mm256_set1_pd(OSMDB_PROJ_LN2)),
+	                     _mm256_mul_pd(_mm256_set1_pd(2.0), p));
+}
+
+OSMDB_PROJ_TARGET
+static int
+osmdb_proj_coord2tile4(int count,
+                       const double* lat,
+                       const double* lon,
+                       double n,
+                       double* x, double* y)
+{
+	ASSERT(lat);
+	ASSERT(lon);
+	ASSERT(x);
+	ASSERT(y);
+
+	__m256d vn     = _mm256_set1_pd(n);
+	__m256d latmax = _mm256_set1_pd(OSMDB_PROJ_LATMAX);
+	__m256d latmin = _mm256_set1_pd(-OSMDB_PROJ_LATMAX);
+	__m256d d2r    = _mm256_set1_pd(OSMDB_PROJ_DEG2RAD);
+	__m256d one    = _mm256_set1_pd(1.0);
+	__m256d half   = _mm256_set1_pd(0.5);
+	__m256d c180   = _mm256_set1_pd(180.0);
+	__m256d c360   = _mm256_set1_pd(1.0/360.0);
+	__m256d c4pi   = _mm256_set1_pd(1.0/(4.0*OSMDB_PROJ_PI));
+
+	int i;
+	for(i = 0; i + 4 <= count; i += 4)
+	{
+		__m256d vlat = _mm256_loadu_pd(&lat[i]);
+		__m256d vlon = _mm256_loadu_pd(&lon[i]);
+		vlat = _mm256_min_pd(_mm256_max_pd(vlat, latmin),
+		                     latmax);
+
+		__m256d s = osmdb_proj_sin4(_mm256_mul_pd(vlat, d2r));
+		__m256d l = osmdb_proj_log4(_mm256_div_pd(_mm256_add_pd(one, s),
+		                                          _mm256_sub_pd(one, s)));
+		__m256d vx;
+		__m256d vy;
+		vx = _mm256_mul_pd(vn, _mm256_mul_pd(_mm256_add_pd(vlon, c180),
+		                                     c360));
+		vy = _mm256_mul_pd(vn, _mm256_sub_pd(half,
+		                                     _mm256_mul_pd(l, c4pi)));
+		_mm256_storeu_pd(&x[i], vx);
+		_mm256_storeu_pd(&y[i], vy);
+	}
+
+	return i;
+}
+
+OSMDB_PROJ_TARGET
+static int
+osmdb_proj_geo2xyz4(int count,
+                    const double* lat,
+                    const double* lon,
+                    double alt,
+                    double* x, double* y, double* z)
+{
+	ASSERT(lat);
+	ASSERT(lon);
+	ASSERT(x);
+	ASSERT(y);
+	ASSERT(z);
+
+	__m256d d2r = _mm256_set1_pd(OSMDB_PROJ_DEG2RAD);
+	__m256d one = _mm256_set1_pd(1.0);
+	__m256d a   = _mm256_set1_pd(OSMDB_PROJ_WGS84_A);
+	__m256d e2  = _mm256_set1_pd(OSMDB_PROJ_WGS84_E2);
+	__m256d ie2 = _mm256_set1_pd(1.0 - OSMDB_PROJ_WGS84_E2);
+	__m256d h   = _mm256_set1_pd(alt);
+
+	int i;
+	for(i = 0; i + 4 <= count; i += 4)
+	{
+		__m256d vlat = _mm256_mul_pd(_mm256_loadu_pd(&lat[i]), d2r);
+		__m256d vlon = _mm256_mul_pd(_mm256_loadu_pd(&lon[i]), d2r);
+		__m256d sp   = osmdb_proj_sin4(vlat);
+		__m256d cp   = osmdb_proj_cos4(vlat);
+		__m256d sl   = osmdb_proj_sin4(vlon);
+		__m256d cl   = osmdb_proj_cos4(vlon);
+
+		__m256d n;
+		__m256d nh;
+		n  = _mm256_div_pd(a,
+		                   _mm256_sqrt_pd(_mm256_sub_pd(one,
+		                   _mm256_mul_pd(e2, _mm256_mul_pd(sp, sp)))));
+		nh = _mm256_add_pd(n, h);
+		_mm256_storeu_pd(&x[i], _mm256_mul_pd(nh,
+		                        _mm256_mul_pd(cp, cl)));
+		_mm256_storeu_pd(&y[i], _mm256_mul_pd(nh,
+		                        _mm256_mul_pd(cp, sl)));
+		_mm256_storeu_pd(&z[i], _mm256_mul_pd(_mm256_add_pd(
+		                        _mm256_mul_pd(n, ie2), h), sp));
+	}
+
+	return i;
+}
+
+#endif
+
+/***********************************************************
+* public                                                   *
+***********************************************************/
+
+void osmdb_proj_coord2tile(int count,
+                           const double* lat,
+                           const double* lon,
+                           int zoom,
+                           double* x, double* y)
+{
+	ASSERT(lat);
+	ASSERT(lon);
+	ASSERT(x);
+	ASSERT(y);
+
+	double n = (double) (((int64_t) 1) << zoom);
+
+	int i = 0;
+#ifdef OSMDB_PROJ_AVX2
+	if(__builtin_cpu_supports("avx2"))
+	{
+		i = osmdb_proj_coord2tile4(count, lat, lon, n, x, y);
+	}
+#endif
+
+	for(; i < count; ++i)
+	{
+		osmdb_proj_coord2tile1(lat[i], lon[i], n, &x[i], &y[i]);
+	}
+}
+
+void osmdb_proj_coord2world(int count,
+                            const double* lat,
+                            const double* lon,
+                            int* x, int* y)
+{
+	ASSERT(lat);
+	ASSERT(lon);
+	ASSERT(x);
+	ASSERT(y);
+
+	// project in batches and clamp to the world
+	double wx[OSMDB_PROJ_BATCH];
+	double wy[OSMDB_PROJ_BATCH];
+	double max = (double) INT_MAX;
+	int    i   = 0;
+	while(i < count)
+	{
+		int n = count - i;
+		if(n > OSMDB_PROJ_BATCH)
+		{
+			n = OSMDB_PROJ_BATCH;
+		}
+
+		osmdb_proj_coord2tile(n, &lat[i], &lon[i],
+		                      OSMDB_PROJ_WORLD_ZOOM, wx, wy);
+
+		int j;
+		for(j = 0; j < n; ++j)
+		{
+			if(wx[j] < 0.0)
+			{
+				wx[j] = 0.0;
+			}
+			else if(wx[j] > max)
+			{
+				wx[j] = max;
+			}
+
+			if(wy[j] < 0.0)
+			{
+				wy[j] = 0.0;
+			}
+			else if(wy[j] > max)
+			{
+				wy[j] = max;
+			}
+
+			x[i + j] = (int) wx[j];
+			y[i + j] = (int) wy[j];
+		}
+		i += n;
+	}
+}
+
+void osmdb_proj_world2coord(int count,
+                            const int* x, const int* y,
+                            double* lat, double* lon)
+{
+	ASSERT(x);
+	ASSERT(y);
+	ASSERT(lat);
+	ASSERT(lon);
+
+	// the inverse is only used for a few points so the
+	// scalar libm functions are sufficient
+	// the center of the world coordinate is used since
+	// coord2world truncates
+	double n = (double) (((int64_t) 1) << OSMDB_PROJ_WORLD_ZOOM);
+
+	int i;
+	for(i = 0; i < count; ++i)
+	{
+		double u = (((double) x[i]) + 0.5)/n;
+		double v = (((double) y[i]) + 0.5)/n;
+		lon[i] = 360.0*u - 180.0;
+		lat[i] = atan(sinh(OSMDB_PROJ_PI*(1.0 - 2.0*v)))/
+		         OSMDB_PROJ_DEG2RAD;
+	}
+}
+
+void osmdb_proj_geo2xyz(int count,
+                        const double* lat,
+                        const double* lon,
+                        double alt,
+                        double* x, double* y, double* z)
+{
+	ASSERT(lat);
+	ASSERT(lon);
+	ASSERT(x);
+	ASSERT(y);
+	ASSERT(z);
+
+	int i = 0;
+#ifdef OSMDB_PROJ_AVX2
+	if(__builtin_cpu_supports("avx2"))
+	{
+		i = osmdb_proj_geo2xyz4(count, lat, lon, alt, x, y, z);
+	}
+#endif
+
+	for(; i < count; ++i)
+	{
+		osmdb_proj_geo2xyz1(lat[i], lon[i], alt,
+		                    &x[i], &y[i], &z[i]);
+	}
+}
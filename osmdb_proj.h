@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2021 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef osmdb_proj_H
+#define osmdb_proj_H
+
+// batch projection of lat/lon arrays
+// uses AVX2 kernels when supported by the cpu and
+// polynomial approximations otherwise so that results
+// are consistent across platforms
+
+// web mercator tile coordinates at zoom
+// where (0,0) is the top-left corner of the map
+void osmdb_proj_coord2tile(int count,
+                           const double* lat,
+                           const double* lon,
+                           int zoom,
+                           double* x, double* y);
+
+// web mercator fixed point coordinates at zoom 31
+// which may be converted to tile coordinates at any
+// zoom level with a shift and subtract
+#define OSMDB_PROJ_WORLD_ZOOM 31
+void osmdb_proj_coord2world(int count,
+                            const double* lat,
+                            const double* lon,
+                            int* x, int* y);
+
+// inverse of osmdb_proj_coord2world
+void osmdb_proj_world2coord(int count,
+                            const int* x, const int* y,
+                            double* lat, double* lon);
+
+// WGS84 earth centered earth fixed coordinates
+void osmdb_proj_geo2xyz(int count,
+                        const double* lat,
+                        const double* lon,
+                        double alt,
+                        double* x, double* y, double* z);
+
+#endif
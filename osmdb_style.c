@@ -21,6 +21,7 @@
  *
  */
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -30,6 +31,7 @@
 #include "../libbfs/bfs_file.h"
 #include "../libxmlstream/xml_istream.h"
 #include "osmdb_style.h"
+#include "osmdb_util.h"
 
 /***********************************************************
 * private                                                  *
@@ -1193,3 +1195,115 @@ osmdb_styleClass_t* osmdb_style_class(osmdb_style_t* self,
 
 	return NULL;
 }
+
+int osmdb_style_classMask(osmdb_style_t* self,
+                          const char* layers, char* mask)
+{
+	ASSERT(self);
+	ASSERT(layers);
+	ASSERT(mask);
+
+	int count = osmdb_classCount();
+	memset(mask, 0, count*sizeof(char));
+
+	// copy layers since they are tokenized in place
+	size_t size = strlen(layers) + 1;
+	char*  tmp  = (char*) MALLOC(size);
+	if(tmp == NULL)
+	{
+		LOGE("MALLOC failed");
+		return 0;
+	}
+	memcpy((void*) tmp, (const void*) layers, size);
+
+	// layers is a comma separated list of layer or class
+	// names (e.g. line:highway,poly:water,amenity:school)
+	// where every name must select at least one class of
+	// the style
+	int   count_names = 0;
+	char* save        = NULL;
+	char* name        = strtok_r(tmp, ",", &save);
+	while(name)
+	{
+		int selected = 0;
+
+		cc_mapIter_t* miter;
+		miter = cc_map_find(self->layers, name);
+		if(miter)
+		{
+			int layer = *((int*) cc_map_val(miter));
+
+			int i;
+			for(i = 0; i < count; ++i)
+			{
+				osmdb_styleClass_t* sc;
+				sc = osmdb_style_class(self,
+				                       osmdb_classCodeToName(i));
+				if(sc &&
+				   ((sc->line  && (sc->line->layer  == layer)) ||
+				    (sc->poly  && (sc->poly->layer  == layer)) ||
+				    (sc->point && (sc->point->layer == layer))))
+				{
+					mask[i]  = 1;
+					selected = 1;
+				}
+			}
+		}
+		else
+		{
+			int code = osmdb_classNameToCode(name);
+			if((code > 0) && osmdb_style_class(self, name))
+			{
+				mask[code] = 1;
+				selected   = 1;
+			}
+		}
+
+		if(selected == 0)
+		{
+			LOGE("invalid layer=%s", name);
+			goto fail_layer;
+		}
+		++count_names;
+
+		name = strtok_r(NULL, ",", &save);
+	}
+
+	if(count_names == 0)
+	{
+		LOGE("invalid layers=%s", layers);
+		goto fail_layer;
+	}
+
+	FREE(tmp);
+
+	// success
+	return 1;
+
+	// failure
+	fail_layer:
+		FREE(tmp);
+	return 0;
+}
+
+void osmdb_style_pointMinZoom(osmdb_style_t* self,
+                              int* min_zoom)
+{
+	ASSERT(self);
+	ASSERT(min_zoom);
+
+	// classes without a point style are least important
+	int i;
+	int count = osmdb_classCount();
+	for(i = 0; i < count; ++i)
+	{
+		min_zoom[i] = 999;
+
+		osmdb_styleClass_t* sc;
+		sc = osmdb_style_class(self, osmdb_classCodeToName(i));
+		if(sc && sc->point)
+		{
+			min_zoom[i] = sc->point->min_zoom;
+		}
+	}
+}
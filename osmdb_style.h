@@ -111,5 +111,10 @@ osmdb_style_t*      osmdb_style_newFile(const char* fname);
 void                osmdb_style_delete(osmdb_style_t** _self);
 osmdb_styleClass_t* osmdb_style_class(osmdb_style_t* self,
                                       const char* name);
+int                 osmdb_style_classMask(osmdb_style_t* self,
+                                          const char* layers,
+                                          char* mask);
+void                osmdb_style_pointMinZoom(osmdb_style_t* self,
+                                             int* min_zoom);
 
 #endif
@@ -26,6 +26,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #define LOG_TAG "osmdb-prefetch"
@@ -36,6 +37,7 @@
 #include "libcc/cc_memory.h"
 #include "libcc/cc_timestamp.h"
 #include "libsqlite3/sqlite3.h"
+#include "osmdb/cache/osmdb_cache.h"
 #include "osmdb/tiler/osmdb_tiler.h"
 #include "osmdb/osmdb_util.h"
 #include "terrain/terrain_util.h"
@@ -44,12 +46,24 @@
 #define MODE_US 1
 #define MODE_CO 2
 
+// size of the geometry cache (MB) which retains the rels
+// and ways shared by neighboring tiles
+#define GEOMETRY_MB 256
+
 #define NZOOM 7
 const int ZOOM_LEVEL[] =
 {
 	3, 5, 7, 9, 11, 13, 15
 };
 
+// zoom 15 tiles are decoded at the level of detail for
+// these zoom levels (see osmdb_tileIter_lod)
+#define NLOD 2
+const int LOD_ZOOM[] =
+{
+	15, 18
+};
+
 // sampling rectangles
 const double WW_LATT = 90;
 const double WW_LONL = -180.0;
@@ -75,65 +89,280 @@ typedef struct
 	uint64_t count;
 	uint64_t total;
 
-	osmdb_tiler_t* tiler;
-	bfs_file_t*    cache;
+	// per-zoom stats
+	uint64_t stats_count[NZOOM];
+	uint64_t stats_bytes[NZOOM];
+	double   stats_dt[NZOOM];
+
+	// geometry cache hits/misses for the rels/ways
+	uint64_t stats_geom_hit[NZOOM];
+	uint64_t stats_geom_miss[NZOOM];
+
+	// decode stats compare the compact encoding with the
+	// OSMDB_TILE_VERSION_V1 layout
+	uint64_t stats_bytes_v1[NZOOM];
+	double   stats_decode_dt[NZOOM];
+	double   stats_decode_v1_dt[NZOOM];
+
+	// lod stats count the pts bytes and decode time of
+	// the rels/ways of zoom 15 tiles
+	uint64_t stats_lod_count;
+	uint64_t stats_lod_bytes[NLOD];
+	double   stats_lod_dt[NLOD];
+
+	osmdb_tiler_t*    tiler;
+	bfs_file_t*       file;
+	osmdb_cache_t*    cache;
+	osmdb_tileIter_t* iter;
 } osmdb_prefetch_t;
 
 /***********************************************************
 * private                                                  *
 ***********************************************************/
 
-static int
-osmdb_prefetch_make(osmdb_prefetch_t* self,
-                    int zoom, int x, int y)
+static int osmdb_prefetch_relFn(void* priv, osmdb_rel_t* rel)
+{
+	ASSERT(priv);
+	ASSERT(rel);
+
+	uint64_t* _bytes = (uint64_t*) priv;
+	*_bytes += sizeof(osmdb_rel_t) + rel->size_name;
+
+	return 1;
+}
+
+static int osmdb_prefetch_wayFn(void* priv, osmdb_way_t* way)
+{
+	ASSERT(priv);
+	ASSERT(way);
+
+	uint64_t* _bytes = (uint64_t*) priv;
+	*_bytes += sizeof(osmdb_way_t) + way->size_name +
+	           way->count*sizeof(osmdb_point_t);
+
+	return 1;
+}
+
+static int osmdb_prefetch_nodeFn(void* priv, osmdb_node_t* node)
+{
+	ASSERT(priv);
+	ASSERT(node);
+
+	uint64_t* _bytes = (uint64_t*) priv;
+	*_bytes += sizeof(osmdb_node_t) + node->size_name;
+
+	return 1;
+}
+
+static void
+osmdb_prefetch_decode(osmdb_prefetch_t* self, int izoom,
+                      size_t size, osmdb_tile_t** _tile)
 {
 	ASSERT(self);
+	ASSERT(_tile);
 
+	uint64_t bytes_v1 = sizeof(osmdb_tile_t);
+
+	osmdb_tileParser_t parser =
+	{
+		.priv      = (void*) &bytes_v1,
+		.rel_fn    = osmdb_prefetch_relFn,
+		.member_fn = osmdb_prefetch_wayFn,
+		.way_fn    = osmdb_prefetch_wayFn,
+		.node_fn   = osmdb_prefetch_nodeFn,
+	};
+
+	// decode the compact tile which takes ownership of the
+	// tile on success
+	double        t0 = cc_timestamp();
+	osmdb_tile_t* tile;
+	tile = osmdb_tile_new(size, (void*) *_tile, &parser);
+	if(tile == NULL)
+	{
+		return;
+	}
+	*_tile = tile;
+
+	// validate the decoded tile in the V1 layout
+	double   t1    = cc_timestamp();
+	uint64_t bytes = bytes_v1;
+	bytes_v1 = sizeof(osmdb_tile_t);
+	if(osmdb_tile_new(bytes, (void*) tile, &parser) == NULL)
+	{
+		return;
+	}
+
+	self->stats_bytes_v1[izoom]     += bytes;
+	self->stats_decode_dt[izoom]    += t1 - t0;
+	self->stats_decode_v1_dt[izoom] += cc_timestamp() - t1;
+}
+
+static void
+osmdb_prefetch_decodeLod(osmdb_prefetch_t* self,
+                         size_t size, osmdb_tile_t* tile)
+{
+	ASSERT(self);
+	ASSERT(tile);
+
+	osmdb_tileIter_t* iter = self->iter;
+
+	int i;
+	int j;
+	int k;
+	osmdb_rel_t    rel;
+	osmdb_way_t    way;
+	osmdb_point_t* pts;
+	for(i = 0; i < NLOD; ++i)
+	{
+		double t0 = cc_timestamp();
+		if(osmdb_tileIter_init(iter, size, (const void*) tile,
+		                       OSMDB_TILEITER_FLAG_TRUST) == 0)
+		{
+			return;
+		}
+		osmdb_tileIter_lod(iter, LOD_ZOOM[i]);
+
+		for(j = 0; j < tile->count_rels; ++j)
+		{
+			if(osmdb_tileIter_rel(iter, j, &rel, NULL) == 0)
+			{
+				return;
+			}
+
+			for(k = 0; k < rel.count; ++k)
+			{
+				if(osmdb_tileIter_member(iter, &way,
+				                         NULL, &pts) == 0)
+				{
+					return;
+				}
+			}
+		}
+
+		for(j = 0; j < tile->count_ways; ++j)
+		{
+			if(osmdb_tileIter_way(iter, j, &way,
+			                      NULL, &pts) == 0)
+			{
+				return;
+			}
+		}
+
+		self->stats_lod_bytes[i] += iter->size_pts;
+		self->stats_lod_dt[i]    += cc_timestamp() - t0;
+	}
+
+	self->stats_lod_count += 1;
+}
+
+static int osmdb_prefetch_izoom(int zoom)
+{
 	int izoom;
 	for(izoom = 0; izoom < NZOOM; ++izoom)
 	{
 		if(zoom == ZOOM_LEVEL[izoom])
 		{
-			break;
+			return izoom;
 		}
 	}
 
-	if(izoom == NZOOM)
+	LOGE("invalid zoom=%i", zoom);
+	return -1;
+}
+
+static void
+osmdb_prefetch_geom(osmdb_prefetch_t* self,
+                    uint64_t* _hit, uint64_t* _miss)
+{
+	ASSERT(self);
+	ASSERT(_hit);
+	ASSERT(_miss);
+
+	// total hits/misses of the rels/ways
+	int                i;
+	osmdb_geomCache_t* cache = self->tiler->geom_cache;
+	*_hit  = 0;
+	*_miss = 0;
+	for(i = 0; i < OSMDB_GEOMCACHE_TYPE_COUNT; ++i)
 	{
-		LOGE("invalid izoom=%i", izoom);
-		return 0;
+		*_hit  += cache->count_hit[i];
+		*_miss += cache->count_miss[i];
 	}
+}
 
-	int           ret  = 0;
-	size_t        size = 0;
-	osmdb_tile_t* tile;
-	tile = osmdb_tiler_make(self->tiler, 0,
-	                        zoom, x, y, &size);
-	if(tile && (size <= INT_MAX))
+static int
+osmdb_prefetch_put(osmdb_prefetch_t* self, int izoom,
+                   double dt, size_t size,
+                   osmdb_tile_t** _tile)
+{
+	ASSERT(self);
+	ASSERT(_tile);
+
+	osmdb_tile_t* tile = *_tile;
+
+	self->stats_count[izoom] += 1;
+	self->stats_bytes[izoom] += size;
+	self->stats_dt[izoom]    += dt;
+
+	int ret = 0;
+	if(size <= INT_MAX)
+	{
+		ret = osmdb_cache_put(self->cache, size, tile);
+	}
+
+	if(ZOOM_LEVEL[izoom] == 15)
 	{
-		char name[256];
-		snprintf(name, 256, "%i/%i/%i", zoom, x, y);
-		ret = bfs_file_blobSet(self->cache, name, size,
-		                       (const void*) tile);
+		osmdb_prefetch_decodeLod(self, size, tile);
 	}
 
-	osmdb_tile_delete(&tile);
+	osmdb_prefetch_decode(self, izoom, size, _tile);
+	osmdb_tile_delete(_tile);
 
 	return ret;
 }
 
 static int
-osmdb_prefetch_tile(osmdb_prefetch_t* self,
+osmdb_prefetch_make(osmdb_prefetch_t* self,
                     int zoom, int x, int y)
 {
 	ASSERT(self);
 
-	if(osmdb_prefetch_make(self, zoom, x, y) == 0)
+	int izoom = osmdb_prefetch_izoom(zoom);
+	if(izoom < 0)
 	{
-		// ignore failures
-		printf("[PF] %i/%i/%i failed\n", zoom, x, y);
+		return 0;
+	}
+
+	uint64_t hit0;
+	uint64_t miss0;
+	osmdb_prefetch_geom(self, &hit0, &miss0);
+
+	size_t        size = 0;
+	double        t0   = cc_timestamp();
+	osmdb_tile_t* tile;
+	tile = osmdb_tiler_make(self->tiler, 0,
+	                        zoom, x, y, &size);
+
+	uint64_t hit1;
+	uint64_t miss1;
+	osmdb_prefetch_geom(self, &hit1, &miss1);
+	self->stats_geom_hit[izoom]  += hit1 - hit0;
+	self->stats_geom_miss[izoom] += miss1 - miss0;
+
+	if(tile == NULL)
+	{
+		return 0;
 	}
 
+	return osmdb_prefetch_put(self, izoom,
+	                          cc_timestamp() - t0,
+	                          size, &tile);
+}
+
+static void osmdb_prefetch_progress(osmdb_prefetch_t* self)
+{
+	ASSERT(self);
+
 	// update prefetch state
 	if((self->count % 10000) == 0)
 	{
@@ -146,38 +375,214 @@ osmdb_prefetch_tile(osmdb_prefetch_t* self,
 		       dt, self->count, self->total, progress);
 	}
 	++self->count;
+}
+
+static int
+osmdb_prefetch_tile(osmdb_prefetch_t* self,
+                    int zoom, int x, int y)
+{
+	ASSERT(self);
+
+	if(osmdb_prefetch_make(self, zoom, x, y) == 0)
+	{
+		// ignore failures
+		printf("[PF] %i/%i/%i failed\n", zoom, x, y);
+	}
+
+	osmdb_prefetch_progress(self);
 
 	return 1;
 }
 
 static int
-osmdb_prefetch_tiles(osmdb_prefetch_t* self,
-                     int zoom, int x, int y)
+osmdb_prefetch_clip(osmdb_prefetch_t* self,
+                    int zoom, int x, int y)
 {
 	ASSERT(self);
 
-	// clip tile
-	if(self->mode != MODE_WW)
+	if(self->mode == MODE_WW)
+	{
+		return 0;
+	}
+
+	// compute tile bounds
+	double latT = WW_LATT;
+	double lonL = WW_LONL;
+	double latB = WW_LATB;
+	double lonR = WW_LONR;
+	terrain_bounds(x, y, zoom, &latT, &lonL, &latB, &lonR);
+
+	if((latT < self->latB) || (lonL > self->lonR) ||
+	   (latB > self->latT) || (lonR < self->lonL))
 	{
-		// compute tile bounds
-		double latT = WW_LATT;
-		double lonL = WW_LONL;
-		double latB = WW_LATB;
-		double lonR = WW_LONR;
-		terrain_bounds(x, y, zoom, &latT, &lonL, &latB, &lonR);
+		return 1;
+	}
+
+	return 0;
+}
 
-		if((latT < self->latB) || (lonL > self->lonR) ||
-		   (latB > self->latT) || (lonR < self->lonL))
+static int
+osmdb_prefetch_meta(osmdb_prefetch_t* self,
+                    int zoom, int x0, int y0)
+{
+	ASSERT(self);
+
+	int izoom = osmdb_prefetch_izoom(zoom);
+	if(izoom < 0)
+	{
+		return 0;
+	}
+
+	// the 2x2 metatile shares the gathered rels/ways between
+	// the tiles so the build time is split evenly
+	uint64_t hit0;
+	uint64_t miss0;
+	osmdb_prefetch_geom(self, &hit0, &miss0);
+
+	int           k;
+	size_t        sizes[4];
+	osmdb_tile_t* tiles[4];
+	double        t0  = cc_timestamp();
+	int           ret = osmdb_tiler_makeMeta(self->tiler, 0,
+	                                         zoom, x0, y0, 2,
+	                                         tiles, sizes);
+	double        dt  = (cc_timestamp() - t0)/4.0;
+
+	uint64_t hit1;
+	uint64_t miss1;
+	osmdb_prefetch_geom(self, &hit1, &miss1);
+	self->stats_geom_hit[izoom]  += hit1 - hit0;
+	self->stats_geom_miss[izoom] += miss1 - miss0;
+
+	if(ret == 0)
+	{
+		// ignore failures
+		for(k = 0; k < 4; ++k)
+		{
+			if(osmdb_prefetch_clip(self, zoom,
+			                       x0 + k%2, y0 + k/2) == 0)
+			{
+				printf("[PF] %i/%i/%i failed\n", zoom,
+				       x0 + k%2, y0 + k/2);
+				osmdb_prefetch_progress(self);
+			}
+		}
+		return 1;
+	}
+
+	for(k = 0; k < 4; ++k)
+	{
+		int x = x0 + k%2;
+		int y = y0 + k/2;
+		if(osmdb_prefetch_clip(self, zoom, x, y))
+		{
+			osmdb_tile_delete(&tiles[k]);
+			continue;
+		}
+
+		if(osmdb_prefetch_put(self, izoom, dt, sizes[k],
+		                      &tiles[k]) == 0)
 		{
-			return 1;
+			// ignore failures
+			printf("[PF] %i/%i/%i failed\n", zoom, x, y);
 		}
+
+		osmdb_prefetch_progress(self);
+	}
+
+	return 1;
+}
+
+static void
+osmdb_prefetch_stats(osmdb_prefetch_t* self)
+{
+	ASSERT(self);
+
+	int izoom;
+	for(izoom = 0; izoom < NZOOM; ++izoom)
+	{
+		uint64_t count = self->stats_count[izoom];
+		if(count == 0)
+		{
+			continue;
+		}
+
+		printf("[PF] zoom=%i, count=%" PRIu64
+		       ", bytes=%" PRIu64 ", avg_bytes=%0.1lf"
+		       ", avg_ms=%0.3lf, tiles_per_sec=%0.1lf\n",
+		       ZOOM_LEVEL[izoom], count,
+		       self->stats_bytes[izoom],
+		       ((double) self->stats_bytes[izoom])/
+		       ((double) count),
+		       1000.0*self->stats_dt[izoom]/
+		       ((double) count),
+		       ((double) count)/self->stats_dt[izoom]);
+		printf("[PF] zoom=%i, bytes_v1=%" PRIu64
+		       ", ratio=%0.3lf, avg_decode_ms=%0.3lf"
+		       ", avg_decode_v1_ms=%0.3lf\n",
+		       ZOOM_LEVEL[izoom],
+		       self->stats_bytes_v1[izoom],
+		       ((double) self->stats_bytes[izoom])/
+		       ((double) self->stats_bytes_v1[izoom]),
+		       1000.0*self->stats_decode_dt[izoom]/
+		       ((double) count),
+		       1000.0*self->stats_decode_v1_dt[izoom]/
+		       ((double) count));
+
+		uint64_t hit  = self->stats_geom_hit[izoom];
+		uint64_t miss = self->stats_geom_miss[izoom];
+		if(hit + miss)
+		{
+			printf("[PF] zoom=%i, geom_hit=%" PRIu64
+			       ", geom_miss=%" PRIu64
+			       ", hit_rate=%0.3lf\n",
+			       ZOOM_LEVEL[izoom], hit, miss,
+			       ((double) hit)/((double) (hit + miss)));
+		}
+	}
+
+	uint64_t count = self->stats_lod_count;
+	for(izoom = 0; count && (izoom < NLOD); ++izoom)
+	{
+		printf("[PF] lod=%i, avg_pts_bytes=%0.1lf"
+		       ", avg_decode_ms=%0.3lf\n",
+		       LOD_ZOOM[izoom],
+		       ((double) self->stats_lod_bytes[izoom])/
+		       ((double) count),
+		       1000.0*self->stats_lod_dt[izoom]/
+		       ((double) count));
+	}
+
+	osmdb_cache_t* cache = self->cache;
+	printf("[PF] put=%" PRIu64 ", dedup=%" PRIu64
+	       ", collide=%" PRIu64
+	       ", bytes=%" PRIu64 ", bytes_z=%" PRIu64
+	       ", ratio=%0.3lf\n",
+	       cache->count_put, cache->count_dedup,
+	       cache->count_collide,
+	       cache->bytes_put, cache->bytes_z,
+	       ((double) cache->bytes_z)/
+	       ((double) cache->bytes_put));
+}
+
+static int
+osmdb_prefetch_tiles(osmdb_prefetch_t* self,
+                     int zoom, int x, int y)
+{
+	ASSERT(self);
+
+	// clip tile
+	if(osmdb_prefetch_clip(self, zoom, x, y))
+	{
+		return 1;
 	}
 
 	// prefetch tile
+	// zoom 13 and 15 tiles are built as metatiles by the
+	// parent tile
 	if((zoom == 3)  || (zoom == 5)  ||
 	   (zoom == 7)  || (zoom == 9)  ||
-	   (zoom == 11) || (zoom == 13) ||
-	   (zoom == 15))
+	   (zoom == 11))
 	{
 		if(osmdb_prefetch_tile(self, zoom, x, y) == 0)
 		{
@@ -191,6 +596,13 @@ osmdb_prefetch_tiles(osmdb_prefetch_t* self,
 		int zoom2 = zoom + 1;
 		int x2    = 2*x;
 		int y2    = 2*y;
+
+		if(((zoom2 == 13) || (zoom2 == 15)) &&
+		   (osmdb_prefetch_meta(self, zoom2, x2, y2) == 0))
+		{
+			return 0;
+		}
+
 		return osmdb_prefetch_tiles(self, zoom2, x2,     y2)     &&
 		       osmdb_prefetch_tiles(self, zoom2, x2 + 1, y2)     &&
 		       osmdb_prefetch_tiles(self, zoom2, x2,     y2 + 1) &&
@@ -318,13 +730,39 @@ int main(int argc, char** argv)
 		goto fail_tiler;
 	}
 
-	self->cache = bfs_file_open(fname_cache, 1,
-	                            BFS_MODE_STREAM);
+	// the grid index accelerates hit testing of dense tiles
+	if(osmdb_tiler_indexGrid(self->tiler, 16) == 0)
+	{
+		goto fail_grid;
+	}
+
+	// rels/ways such as state borders, rivers and
+	// interstates are shared by many neighboring tiles
+	if(osmdb_tiler_cacheGeometry(self->tiler,
+	                             1024*1024*GEOMETRY_MB) == 0)
+	{
+		goto fail_grid;
+	}
+
+	self->file = bfs_file_open(fname_cache, 1,
+	                           BFS_MODE_STREAM);
+	if(self->file == NULL)
+	{
+		goto fail_file;
+	}
+
+	self->cache = osmdb_cache_new(self->file);
 	if(self->cache == NULL)
 	{
 		goto fail_cache;
 	}
 
+	self->iter = osmdb_tileIter_new();
+	if(self->iter == NULL)
+	{
+		goto fail_iter;
+	}
+
 	char pa[256];
 	char bounds[256];
 	char cs[256];
@@ -332,13 +770,13 @@ int main(int argc, char** argv)
 	snprintf(bounds, 256, "%lf %lf %lf %lf",
 	         latT, lonL, latB, lonR);
 	snprintf(cs, 256, "%" PRId64, self->tiler->changeset);
-	if((bfs_file_attrSet(self->cache, "name", "osmdbv11") == 0) ||
-	   (bfs_file_attrSet(self->cache, "pattern", pa)      == 0) ||
-	   (bfs_file_attrSet(self->cache, "ext", "osmdb")     == 0) ||
-	   (bfs_file_attrSet(self->cache, "bounds", bounds)   == 0) ||
-	   (bfs_file_attrSet(self->cache, "zmin", "3")        == 0) ||
-	   (bfs_file_attrSet(self->cache, "zmax", "15")       == 0) ||
-	   (bfs_file_attrSet(self->cache, "changeset", cs)    == 0))
+	if((bfs_file_attrSet(self->file, "name", "osmdbv11") == 0) ||
+	   (bfs_file_attrSet(self->file, "pattern", pa)      == 0) ||
+	   (bfs_file_attrSet(self->file, "ext", "osmdb")     == 0) ||
+	   (bfs_file_attrSet(self->file, "bounds", bounds)   == 0) ||
+	   (bfs_file_attrSet(self->file, "zmin", "3")        == 0) ||
+	   (bfs_file_attrSet(self->file, "zmax", "15")       == 0) ||
+	   (bfs_file_attrSet(self->file, "changeset", cs)    == 0))
 	{
 		goto fail_attr;
 	}
@@ -348,7 +786,19 @@ int main(int argc, char** argv)
 		goto fail_run;
 	}
 
-	bfs_file_close(&self->cache);
+	osmdb_prefetch_stats(self);
+
+	osmdb_tileIter_delete(&self->iter);
+	osmdb_cache_delete(&self->cache);
+	bfs_file_close(&self->file);
+
+	struct stat st;
+	if(stat(fname_cache, &st) == 0)
+	{
+		printf("[PF] %s: %" PRId64 " bytes\n",
+		       fname_cache, (int64_t) st.st_size);
+	}
+
 	osmdb_tiler_delete(&self->tiler);
 	bfs_util_shutdown();
 
@@ -359,8 +809,13 @@ int main(int argc, char** argv)
 	// failure
 	fail_run:
 	fail_attr:
-		bfs_file_close(&self->cache);
+		osmdb_tileIter_delete(&self->iter);
+	fail_iter:
+		osmdb_cache_delete(&self->cache);
 	fail_cache:
+		bfs_file_close(&self->file);
+	fail_file:
+	fail_grid:
 		osmdb_tiler_delete(&self->tiler);
 	fail_tiler:
 		bfs_util_shutdown();
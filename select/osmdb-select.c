@@ -30,9 +30,11 @@
 #include "libbfs/bfs_util.h"
 #include "libcc/cc_log.h"
 #include "libcc/cc_memory.h"
+#include "libcc/cc_timestamp.h"
 #include "libsqlite3/sqlite3.h"
 #include "osmdb/index/osmdb_index.h"
 #include "osmdb/tiler/osmdb_tiler.h"
+#include "osmdb/osmdb_style.h"
 #include "osmdb/osmdb_util.h"
 #include "terrain/terrain_util.h"
 #include "texgz/texgz_tex.h"
@@ -117,18 +119,37 @@ static int osmdb_parseZoom(char* s,
 
 static int
 osmdb_parseRequest(const char* s,
-                   int* zoom, int* x, int* y)
+                   int* zoom, int* x, int* y,
+                   char* layers)
 {
 	ASSERT(s);
 	ASSERT(zoom);
 	ASSERT(x);
 	ASSERT(y);
+	ASSERT(layers);
 
 	// copy request
 	char tmp[256];
 	strncpy(tmp, s, 256);
 	tmp[255] = '\0';
 
+	// parse the optional layers query
+	char* q = strchr(tmp, '?');
+	layers[0] = '\0';
+	if(q)
+	{
+		*q = '\0';
+		q  = &(q[1]);
+		if(strncmp(q, "layers=", 7) == 0)
+		{
+			snprintf(layers, 256, "%s", &(q[7]));
+		}
+		else
+		{
+			goto failure;
+		}
+	}
+
 	// determine the type pattern
 	char* p;
 	if((p = strstr(tmp, "/osmdbv11/")) && (p == tmp))
@@ -276,16 +297,100 @@ static int osmdb_nodeFn(void* priv, osmdb_node_t* node)
 	return 1;
 }
 
+#define OSMDB_BENCH_QUERIES 10000
+
+static void
+osmdb_benchQuery(size_t size, const void* data)
+{
+	ASSERT(data);
+
+	osmdb_range_t* ranges;
+	ranges = (osmdb_range_t*)
+	         CALLOC(OSMDB_BENCH_QUERIES, sizeof(osmdb_range_t));
+	if(ranges == NULL)
+	{
+		LOGE("CALLOC failed");
+		return;
+	}
+
+	osmdb_tileIter_t* iter = osmdb_tileIter_new();
+	if(iter == NULL)
+	{
+		FREE(ranges);
+		return;
+	}
+
+	// alternate between point queries and subrect queries
+	// which cover 1/16th of the tile width
+	srand(42);
+	int i;
+	for(i = 0; i < OSMDB_BENCH_QUERIES; ++i)
+	{
+		int w = (i%2) ? 2048 : 0;
+		int l = (rand()%(32768 - w)) - 16384;
+		int b = (rand()%(32768 - w)) - 16384;
+		ranges[i].t = b + w;
+		ranges[i].l = l;
+		ranges[i].b = b;
+		ranges[i].r = l + w;
+	}
+
+	const char* label[2] =
+	{
+		"grid",
+		"nogrid",
+	};
+
+	int flags[2] =
+	{
+		OSMDB_TILEITER_FLAG_TRUST,
+		OSMDB_TILEITER_FLAG_TRUST | OSMDB_TILEITER_FLAG_NOGRID,
+	};
+
+	int j;
+	for(j = 0; j < 2; ++j)
+	{
+		if(osmdb_tileIter_init(iter, size, data, flags[j]) == 0)
+		{
+			break;
+		}
+
+		int64_t hits = 0;
+		double  t0   = cc_timestamp();
+		for(i = 0; i < OSMDB_BENCH_QUERIES; ++i)
+		{
+			int              count;
+			osmdb_tileHit_t* h;
+			if(osmdb_tileIter_query(iter, &ranges[i],
+			                        &count, &h) == 0)
+			{
+				break;
+			}
+			hits += count;
+		}
+		double dt = cc_timestamp() - t0;
+
+		printf("query=%s, cells=%i, hits=%" PRId64
+		       ", lookups/sec=%0.0lf\n",
+		       label[j], iter->cells, hits,
+		       ((double) i)/dt);
+	}
+
+	osmdb_tileIter_delete(&iter);
+	FREE(ranges);
+}
+
 /***********************************************************
 * public                                                   *
 ***********************************************************/
 
 int main(int argc, const char** argv)
 {
-	if(argc != 3)
+	if((argc != 3) && (argc != 4))
 	{
-		LOGE("usage: %s planet.sqlite3 [TILE]", argv[0]);
-		LOGE("TILE: /osmdbv11/zoom/x/y");
+		LOGE("usage: %s planet.sqlite3 [TILE] [style.xml]", argv[0]);
+		LOGE("TILE: /osmdbv11/zoom/x/y[?layers=name,...]");
+		LOGE("layers are style layer or class names");
 		return EXIT_FAILURE;
 	}
 
@@ -295,16 +400,70 @@ int main(int argc, const char** argv)
 	int  zoom;
 	int  x;
 	int  y;
-	if(osmdb_parseRequest(request, &zoom, &x, &y) == 0)
+	char layers[256];
+	if(osmdb_parseRequest(request, &zoom, &x, &y,
+	                      layers) == 0)
+	{
+		return EXIT_FAILURE;
+	}
+
+	if((layers[0] != '\0') && (argc != 4))
 	{
+		LOGE("layers requires style.xml");
 		return EXIT_FAILURE;
 	}
 
+	// create the optional class mask and the point
+	// importance used for node thinning
+	char* mask     = NULL;
+	int*  min_zoom = NULL;
+	if(argc == 4)
+	{
+		osmdb_style_t* style = osmdb_style_newFile(argv[3]);
+		if(style == NULL)
+		{
+			return EXIT_FAILURE;
+		}
+
+		min_zoom = (int*)
+		           CALLOC(osmdb_classCount(), sizeof(int));
+		if(min_zoom == NULL)
+		{
+			LOGE("CALLOC failed");
+			osmdb_style_delete(&style);
+			return EXIT_FAILURE;
+		}
+		osmdb_style_pointMinZoom(style, min_zoom);
+
+		if(layers[0] != '\0')
+		{
+			mask = (char*)
+			       CALLOC(osmdb_classCount(), sizeof(char));
+			if(mask == NULL)
+			{
+				LOGE("CALLOC failed");
+				FREE(min_zoom);
+				osmdb_style_delete(&style);
+				return EXIT_FAILURE;
+			}
+
+			if(osmdb_style_classMask(style, layers, mask) == 0)
+			{
+				FREE(mask);
+				FREE(min_zoom);
+				osmdb_style_delete(&style);
+				return EXIT_FAILURE;
+			}
+		}
+
+		osmdb_style_delete(&style);
+	}
+
 	// create a base image
 	texgz_tex_t* img = osmdb_mkimg(zoom, x, y);
 	if(img == NULL)
 	{
-		return EXIT_FAILURE;
+		goto fail_img_base;
 	}
 
 	if(bfs_util_initialize() == 0)
@@ -319,10 +478,19 @@ int main(int argc, const char** argv)
 		goto fail_tiler;
 	}
 
+	if((min_zoom &&
+	    (osmdb_tiler_thinNodes(tiler, OSMDB_TILER_THIN_CELLS,
+	                           min_zoom) == 0)) ||
+	   (osmdb_tiler_indexGrid(tiler, 16) == 0))
+	{
+		goto fail_thin;
+	}
+
 	void*  data;
 	size_t size = 0;
 	data = (void*)
-	       osmdb_tiler_make(tiler, 0, zoom, x, y, &size);
+	       osmdb_tiler_makeMask(tiler, 0, zoom, x, y,
+	                            mask, &size);
 	if(data == NULL)
 	{
 		goto fail_data;
@@ -366,12 +534,17 @@ int main(int argc, const char** argv)
 	printf("count_ways=%i\n", tile->count_ways);
 	printf("count_nodes=%i\n", tile->count_nodes);
 
+	// compare hit testing with/without the grid
+	osmdb_benchQuery(size, data);
+
 	// print contents
+	// osmdb_tile_new takes ownership of data
 	tile = osmdb_tile_new(size, data, &parser);
 	if(tile == NULL)
 	{
 		goto fail_tile;
 	}
+	data = NULL;
 
 	char iname[256];
 	snprintf(iname, 256, "img-%i-%i-%i.png",
@@ -385,6 +558,8 @@ int main(int argc, const char** argv)
 	osmdb_tiler_delete(&tiler);
 	bfs_util_shutdown();
 	texgz_tex_delete(&img);
+	FREE(min_zoom);
+	FREE(mask);
 
 	size_t memsize = MEMSIZE();
 	if(memsize)
@@ -399,15 +574,20 @@ int main(int argc, const char** argv)
 
 	// failure
 	fail_img:
+		osmdb_tile_delete(&tile);
 	fail_tile:
 	fail_write:
 	fail_open:
 		FREE(data);
 	fail_data:
+	fail_thin:
 		osmdb_tiler_delete(&tiler);
 	fail_tiler:
 		bfs_util_shutdown();
 	fail_init:
 		texgz_tex_delete(&img);
+	fail_img_base:
+		FREE(min_zoom);
+		FREE(mask);
 	return EXIT_FAILURE;
 }
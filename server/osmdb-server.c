@@ -0,0 +1,995 @@
+/*
+ * Copyright (c) 2021 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define LOG_TAG "osmdb-server"
+#include "libbfs/bfs_file.h"
+#include "libbfs/bfs_util.h"
+#include "libcc/cc_log.h"
+#include "libcc/cc_memory.h"
+#include "libcc/cc_timestamp.h"
+#include "osmdb/cache/osmdb_cache.h"
+#include "osmdb/cache/osmdb_lru.h"
+#include "osmdb/tiler/osmdb_scheduler.h"
+#include "osmdb/tiler/osmdb_tiler.h"
+#include "osmdb/osmdb_style.h"
+#include "osmdb/osmdb_util.h"
+
+// pending connections which have been accepted but not
+// yet served by a worker
+#define OSMDB_SERVER_QUEUE 256
+
+// latency samples for the percentiles
+#define OSMDB_SERVER_SAMPLES 65536
+
+#define OSMDB_SERVER_REQUEST 4096
+
+// connection workers per tiler thread since workers may
+// be blocked waiting on the scheduler
+#define OSMDB_SERVER_WORKERS 4
+
+// interactive builds which exceed the timeout (seconds)
+// return a partial tile rather than holding a tiler
+// thread and the index lock
+#define OSMDB_SERVER_TIMEOUT 2.0
+
+// size of the geometry cache (MB) which is shared by the
+// tiler threads (see osmdb_tiler_cacheGeometry)
+#define OSMDB_SERVER_GEOMETRY 256
+
+// tile source
+#define OSMDB_SERVER_SRC_LRU   0
+#define OSMDB_SERVER_SRC_CACHE 1
+#define OSMDB_SERVER_SRC_MAKE  2
+#define OSMDB_SERVER_SRC_FAIL  3
+#define OSMDB_SERVER_SRC_COUNT 4
+
+const char* OSMDB_SERVER_SRC_NAME[] =
+{
+	"lru",
+	"cache",
+	"make",
+	"fail",
+};
+
+typedef struct
+{
+	int    fd;
+	double t0;
+} osmdb_serverConn_t;
+
+struct osmdb_server_s;
+
+typedef struct
+{
+	pthread_t              thread;
+	struct osmdb_server_s* server;
+} osmdb_serverWorker_t;
+
+typedef struct osmdb_server_s
+{
+	int sockfd;
+
+	osmdb_tiler_t*     tiler;
+	osmdb_scheduler_t* scheduler;
+	osmdb_lru_t*       lru;
+
+	// optional prefetch cache
+	pthread_mutex_t cache_mutex;
+	bfs_file_t*     file;
+	osmdb_cache_t*  cache;
+
+	// optional style for the layers query
+	osmdb_style_t* style;
+
+	// connection queue
+	pthread_mutex_t    queue_mutex;
+	pthread_cond_t     queue_cond;
+	int                queue_running;
+	int                queue_head;
+	int                queue_count;
+	osmdb_serverConn_t queue[OSMDB_SERVER_QUEUE];
+
+	// connection workers
+	int                   count_workers;
+	osmdb_serverWorker_t* workers;
+
+	// stats
+	pthread_mutex_t stats_mutex;
+	uint64_t        stats_count[OSMDB_SERVER_SRC_COUNT];
+	uint64_t        stats_samples;
+	double          stats_latency[OSMDB_SERVER_SAMPLES];
+} osmdb_server_t;
+
+static volatile sig_atomic_t g_quit = 0;
+
+/***********************************************************
+* private                                                  *
+***********************************************************/
+
+static void osmdb_server_signal(int sig)
+{
+	g_quit = 1;
+}
+
+static int
+osmdb_server_parseRequest(const char* request,
+                          int* _zoom, int* _x, int* _y,
+                          int* _priority, char* layers)
+{
+	ASSERT(request);
+	ASSERT(_zoom);
+	ASSERT(_x);
+	ASSERT(_y);
+	ASSERT(_priority);
+	ASSERT(layers);
+
+	// GET /osmdbv11/zoom/x/y[?param[&param]] HTTP/1.1
+	// param: priority=background|interactive
+	//        layers=name[,name] (see osmdb_style_classMask)
+	int  zoom;
+	int  x;
+	int  y;
+	int  n = 0;
+	char end;
+	if(sscanf(request, "GET /osmdbv11/%d/%d/%d%c%n",
+	          &zoom, &x, &y, &end, &n) != 4)
+	{
+		return 0;
+	}
+
+	// layers must be OSMDB_SERVER_REQUEST bytes which
+	// bounds the query
+	int priority = OSMDB_SCHEDULER_PRIORITY_INTERACTIVE;
+	layers[0] = '\0';
+	if(end == '?')
+	{
+		const char* query = &request[n];
+		while(1)
+		{
+			size_t len = strcspn(query, "& ");
+			if(query[len] == '\0')
+			{
+				return 0;
+			}
+
+			if((len == 19) &&
+			   (strncmp(query, "priority=background", 19) == 0))
+			{
+				priority = OSMDB_SCHEDULER_PRIORITY_BACKGROUND;
+			}
+			else if((len == 20) &&
+			        (strncmp(query, "priority=interactive",
+			                 20) == 0))
+			{
+				priority = OSMDB_SCHEDULER_PRIORITY_INTERACTIVE;
+			}
+			else if((len > 7) &&
+			        (strncmp(query, "layers=", 7) == 0))
+			{
+				memcpy((void*) layers, (const void*) &query[7],
+				       len - 7);
+				layers[len - 7] = '\0';
+			}
+			else
+			{
+				return 0;
+			}
+
+			if(query[len] == ' ')
+			{
+				break;
+			}
+			query = &query[len + 1];
+		}
+	}
+	else if(end != ' ')
+	{
+		return 0;
+	}
+
+	// the tiler only builds the odd zooms 3-15
+	if((zoom < 3) || (zoom > 15) || ((zoom%2) == 0) ||
+	   (x < 0) || (x >= (1 << zoom)) ||
+	   (y < 0) || (y >= (1 << zoom)))
+	{
+		return 0;
+	}
+
+	*_zoom     = zoom;
+	*_x        = x;
+	*_y        = y;
+	*_priority = priority;
+
+	return 1;
+}
+
+static int
+osmdb_server_readRequest(int fd, char* request)
+{
+	ASSERT(request);
+
+	// read until the end of the request header
+	size_t size = 0;
+	while(size < OSMDB_SERVER_REQUEST - 1)
+	{
+		ssize_t bytes = recv(fd, &request[size],
+		                     OSMDB_SERVER_REQUEST - 1 - size, 0);
+		if(bytes <= 0)
+		{
+			if((bytes < 0) && (errno == EINTR))
+			{
+				continue;
+			}
+			return 0;
+		}
+		size += (size_t) bytes;
+		request[size] = '\0';
+
+		if(strstr(request, "\r\n\r\n"))
+		{
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static int
+osmdb_server_write(int fd, size_t size, const void* data)
+{
+	ASSERT(data);
+
+	const char* ptr = (const char*) data;
+	while(size)
+	{
+		ssize_t bytes = send(fd, ptr, size, MSG_NOSIGNAL);
+		if(bytes < 0)
+		{
+			if(errno == EINTR)
+			{
+				continue;
+			}
+			return 0;
+		}
+		ptr  += bytes;
+		size -= (size_t) bytes;
+	}
+
+	return 1;
+}
+
+static void
+osmdb_server_respond(int fd, const char* status,
+                     size_t size, const void* data)
+{
+	// data may be NULL
+	ASSERT(status);
+
+	char header[256];
+	int  len;
+	len = snprintf(header, 256,
+	               "HTTP/1.1 %s\r\n"
+	               "Content-Type: application/octet-stream\r\n"
+	               "Content-Length: %" PRIu64 "\r\n"
+	               "Connection: close\r\n"
+	               "\r\n",
+	               status, (uint64_t) size);
+
+	if(osmdb_server_write(fd, (size_t) len, header) && data)
+	{
+		osmdb_server_write(fd, size, data);
+	}
+}
+
+static char*
+osmdb_server_mask(osmdb_server_t* self, const char* layers)
+{
+	ASSERT(self);
+	ASSERT(layers);
+
+	if(self->style == NULL)
+	{
+		LOGE("layers requires style.xml");
+		return NULL;
+	}
+
+	char* mask = (char*) CALLOC(osmdb_classCount(), sizeof(char));
+	if(mask == NULL)
+	{
+		LOGE("CALLOC failed");
+		return NULL;
+	}
+
+	if(osmdb_style_classMask(self->style, layers, mask) == 0)
+	{
+		FREE(mask);
+		return NULL;
+	}
+
+	return mask;
+}
+
+static void*
+osmdb_server_get(osmdb_server_t* self, int priority,
+                 int zoom, int x, int y, const char* mask,
+                 size_t* _size, int* _src)
+{
+	// mask may be NULL
+	ASSERT(self);
+	ASSERT(_size);
+	ASSERT(_src);
+
+	// subset tiles are made per request since the caches
+	// only contain the full tiles
+	if(mask)
+	{
+		*_src = OSMDB_SERVER_SRC_MAKE;
+
+		void* data;
+		data = (void*)
+		       osmdb_scheduler_makeMask(self->scheduler,
+		                                priority, zoom, x, y,
+		                                mask, _size);
+		if(data == NULL)
+		{
+			*_src = OSMDB_SERVER_SRC_FAIL;
+		}
+		return data;
+	}
+
+	// check the in-memory cache
+	void* data = osmdb_lru_get(self->lru, zoom, x, y, _size);
+	if(data)
+	{
+		*_src = OSMDB_SERVER_SRC_LRU;
+		return data;
+	}
+
+	// check the prefetch cache
+	if(self->cache)
+	{
+		pthread_mutex_lock(&self->cache_mutex);
+		data = (void*) osmdb_cache_get(self->cache,
+		                               zoom, x, y, _size);
+		pthread_mutex_unlock(&self->cache_mutex);
+		*_src = OSMDB_SERVER_SRC_CACHE;
+	}
+
+	// otherwise make the tile where concurrent requests
+	// for the same tile share a single build
+	if(data == NULL)
+	{
+		data = (void*) osmdb_scheduler_make(self->scheduler,
+		                                    priority, zoom,
+		                                    x, y, _size);
+		*_src = OSMDB_SERVER_SRC_MAKE;
+	}
+
+	if(data == NULL)
+	{
+		*_src = OSMDB_SERVER_SRC_FAIL;
+		return NULL;
+	}
+
+	// partial tiles are not cached so that the tile may be
+	// rebuilt by a background request
+	// ignore put failures
+	if((osmdb_tile_flags(*_size, data) &
+	    OSMDB_TILE_FLAG_PARTIAL) == 0)
+	{
+		osmdb_lru_put(self->lru, zoom, x, y, *_size, data);
+	}
+
+	return data;
+}
+
+static void
+osmdb_server_serve(osmdb_server_t* self,
+                   osmdb_serverConn_t* conn)
+{
+	ASSERT(self);
+	ASSERT(conn);
+
+	int fd = conn->fd;
+
+	char request[OSMDB_SERVER_REQUEST];
+	if(osmdb_server_readRequest(fd, request) == 0)
+	{
+		close(fd);
+		return;
+	}
+
+	int  zoom;
+	int  x;
+	int  y;
+	int  priority;
+	char layers[OSMDB_SERVER_REQUEST];
+	if(osmdb_server_parseRequest(request, &zoom, &x, &y,
+	                             &priority, layers) == 0)
+	{
+		osmdb_server_respond(fd, "404 Not Found", 0, NULL);
+		close(fd);
+		return;
+	}
+
+	// the optional layers select a subset of the classes
+	char* mask = NULL;
+	if(layers[0] != '\0')
+	{
+		mask = osmdb_server_mask(self, layers);
+		if(mask == NULL)
+		{
+			osmdb_server_respond(fd, "400 Bad Request",
+			                     0, NULL);
+			close(fd);
+			return;
+		}
+	}
+
+	int    src  = OSMDB_SERVER_SRC_FAIL;
+	size_t size = 0;
+	void*  data;
+	data = osmdb_server_get(self, priority, zoom, x, y, mask,
+	                        &size, &src);
+	FREE(mask);
+	if(data)
+	{
+		osmdb_server_respond(fd, "200 OK", size, data);
+		FREE(data);
+	}
+	else
+	{
+		osmdb_server_respond(fd, "500 Internal Server Error",
+		                     0, NULL);
+	}
+	close(fd);
+
+	// latency includes the time spent in the queue
+	double dt = cc_timestamp() - conn->t0;
+
+	pthread_mutex_lock(&self->stats_mutex);
+	int idx = (int) (self->stats_samples%OSMDB_SERVER_SAMPLES);
+	self->stats_latency[idx] = dt;
+	self->stats_count[src]  += 1;
+	self->stats_samples     += 1;
+	pthread_mutex_unlock(&self->stats_mutex);
+}
+
+static void* osmdb_server_run(void* arg)
+{
+	ASSERT(arg);
+
+	osmdb_serverWorker_t* worker = (osmdb_serverWorker_t*) arg;
+	osmdb_server_t*       self   = worker->server;
+
+	while(1)
+	{
+		pthread_mutex_lock(&self->queue_mutex);
+		while(self->queue_running && (self->queue_count == 0))
+		{
+			pthread_cond_wait(&self->queue_cond,
+			                  &self->queue_mutex);
+		}
+
+		// drain the queue before exiting
+		if(self->queue_count == 0)
+		{
+			pthread_mutex_unlock(&self->queue_mutex);
+			break;
+		}
+
+		osmdb_serverConn_t conn;
+		conn = self->queue[self->queue_head];
+		self->queue_head   = (self->queue_head + 1)%
+		                     OSMDB_SERVER_QUEUE;
+		self->queue_count -= 1;
+		pthread_mutex_unlock(&self->queue_mutex);
+
+		osmdb_server_serve(self, &conn);
+	}
+
+	return NULL;
+}
+
+static void
+osmdb_server_accept(osmdb_server_t* self, int fd)
+{
+	ASSERT(self);
+
+	osmdb_serverConn_t conn =
+	{
+		.fd = fd,
+		.t0 = cc_timestamp(),
+	};
+
+	// prevent slow clients from blocking the workers
+	struct timeval tv =
+	{
+		.tv_sec  = 5,
+		.tv_usec = 0,
+	};
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO,
+	           &tv, sizeof(struct timeval));
+	setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO,
+	           &tv, sizeof(struct timeval));
+
+	pthread_mutex_lock(&self->queue_mutex);
+	if(self->queue_count == OSMDB_SERVER_QUEUE)
+	{
+		pthread_mutex_unlock(&self->queue_mutex);
+		osmdb_server_respond(fd, "503 Service Unavailable",
+		                     0, NULL);
+		close(fd);
+		return;
+	}
+
+	int idx = (self->queue_head + self->queue_count)%
+	          OSMDB_SERVER_QUEUE;
+	self->queue[idx]   = conn;
+	self->queue_count += 1;
+	pthread_cond_signal(&self->queue_cond);
+	pthread_mutex_unlock(&self->queue_mutex);
+}
+
+static int osmdb_server_cmpLatency(const void* a,
+                                   const void* b)
+{
+	ASSERT(a);
+	ASSERT(b);
+
+	double aa = *((const double*) a);
+	double bb = *((const double*) b);
+	if(aa < bb)
+	{
+		return -1;
+	}
+	else if(aa > bb)
+	{
+		return 1;
+	}
+	return 0;
+}
+
+static void osmdb_server_stats(osmdb_server_t* self)
+{
+	ASSERT(self);
+
+	int i;
+	for(i = 0; i < OSMDB_SERVER_SRC_COUNT; ++i)
+	{
+		printf("[SV] %s=%" PRIu64 "\n",
+		       OSMDB_SERVER_SRC_NAME[i], self->stats_count[i]);
+	}
+
+	osmdb_lru_t* lru = self->lru;
+	printf("[SV] lru: size=%" PRIu64 ", hit=%" PRIu64
+	       ", miss=%" PRIu64 ", evict=%" PRIu64 "\n",
+	       (uint64_t) lru->size, lru->count_hit,
+	       lru->count_miss, lru->count_evict);
+
+	osmdb_geomCache_t* geom_cache = self->tiler->geom_cache;
+	printf("[SV] geometry: size=%" PRIu64
+	       ", way_hit=%" PRIu64 ", way_miss=%" PRIu64
+	       ", rel_hit=%" PRIu64 ", rel_miss=%" PRIu64
+	       ", evict=%" PRIu64 "\n",
+	       (uint64_t) geom_cache->size,
+	       geom_cache->count_hit[OSMDB_GEOMCACHE_TYPE_WAY],
+	       geom_cache->count_miss[OSMDB_GEOMCACHE_TYPE_WAY],
+	       geom_cache->count_hit[OSMDB_GEOMCACHE_TYPE_REL],
+	       geom_cache->count_miss[OSMDB_GEOMCACHE_TYPE_REL],
+	       geom_cache->count_evict);
+
+	// queue wait time is reported separately from the
+	// build time
+	const char* priority_name[] =
+	{
+		"interactive",
+		"background",
+	};
+	for(i = 0; i < OSMDB_SCHEDULER_PRIORITY_COUNT; ++i)
+	{
+		osmdb_schedulerStats_t* stats;
+		stats = &self->scheduler->stats[i];
+
+		double wait_avg  = 0.0;
+		double build_avg = 0.0;
+		if(stats->count_built)
+		{
+			wait_avg  = stats->wait_dt/stats->count_built;
+			build_avg = stats->build_dt/stats->count_built;
+		}
+
+		printf("[SV] %s: count=%" PRIu64
+		       ", coalesced=%" PRIu64 ", built=%" PRIu64
+		       ", partial=%" PRIu64
+		       ", wait=%0.3lf/%0.3lf ms"
+		       ", build=%0.3lf/%0.3lf ms\n",
+		       priority_name[i], stats->count,
+		       stats->count_coalesced, stats->count_built,
+		       stats->count_partial,
+		       1000.0*wait_avg, 1000.0*stats->wait_max,
+		       1000.0*build_avg, 1000.0*stats->build_max);
+	}
+
+	// percentiles of the most recent samples which are
+	// sorted in a copy since the ring buffer order must be
+	// preserved for the workers
+	pthread_mutex_lock(&self->stats_mutex);
+	int count = OSMDB_SERVER_SAMPLES;
+	if(self->stats_samples < OSMDB_SERVER_SAMPLES)
+	{
+		count = (int) self->stats_samples;
+	}
+
+	double* latency = NULL;
+	if(count)
+	{
+		latency = (double*) MALLOC(count*sizeof(double));
+		if(latency)
+		{
+			memcpy((void*) latency,
+			       (const void*) self->stats_latency,
+			       count*sizeof(double));
+		}
+	}
+	pthread_mutex_unlock(&self->stats_mutex);
+
+	if(count == 0)
+	{
+		return;
+	}
+	else if(latency == NULL)
+	{
+		LOGE("MALLOC failed");
+		return;
+	}
+
+	qsort((void*) latency, (size_t) count,
+	      sizeof(double), osmdb_server_cmpLatency);
+
+	printf("[SV] latency: samples=%i, p50=%0.3lf ms"
+	       ", p90=%0.3lf ms, p99=%0.3lf ms, max=%0.3lf ms\n",
+	       count,
+	       1000.0*latency[(50*(count - 1))/100],
+	       1000.0*latency[(90*(count - 1))/100],
+	       1000.0*latency[(99*(count - 1))/100],
+	       1000.0*latency[count - 1]);
+
+	FREE(latency);
+}
+
+static int osmdb_server_listen(int port)
+{
+	int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+	if(sockfd < 0)
+	{
+		LOGE("socket failed");
+		return -1;
+	}
+
+	int on = 1;
+	setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR,
+	           &on, sizeof(int));
+
+	// local connections only
+	struct sockaddr_in addr;
+	memset((void*) &addr, 0, sizeof(struct sockaddr_in));
+	addr.sin_family      = AF_INET;
+	addr.sin_port        = htons((uint16_t) port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if(bind(sockfd, (struct sockaddr*) &addr,
+	        sizeof(struct sockaddr_in)) < 0)
+	{
+		LOGE("bind failed port=%i", port);
+		goto fail_bind;
+	}
+
+	if(listen(sockfd, OSMDB_SERVER_QUEUE) < 0)
+	{
+		LOGE("listen failed");
+		goto fail_listen;
+	}
+
+	// success
+	return sockfd;
+
+	// failure
+	fail_listen:
+	fail_bind:
+		close(sockfd);
+	return -1;
+}
+
+/***********************************************************
+* public                                                   *
+***********************************************************/
+
+int main(int argc, char** argv)
+{
+	if((argc < 6) || (argc > 8))
+	{
+		LOGE("usage: %s PORT NTH SMEM LRU planet.sqlite3 [osmdb.bfs] [style.xml]",
+		     argv[0]);
+		LOGE("PORT: localhost port (e.g. 8080)");
+		LOGE("NTH: number of tiler threads (e.g. 4)");
+		LOGE("SMEM: size of memory in GB (e.g. 1.0)");
+		LOGE("LRU: size of the tile cache in MB (e.g. 256)");
+		LOGE("osmdb.bfs: optional prefetch cache");
+		LOGE("style.xml: optional style for the layers query");
+		LOGE("TILE: http://localhost:PORT/osmdbv11/zoom/x/y[?layers=name,...]");
+		return EXIT_FAILURE;
+	}
+
+	int         port        = (int) strtol(argv[1], NULL, 0);
+	int         nth         = (int) strtol(argv[2], NULL, 0);
+	float       smem        = strtof(argv[3], NULL);
+	size_t      lru_size    = (size_t) strtol(argv[4], NULL, 0);
+	const char* fname_index = argv[5];
+	const char* fname_cache = NULL;
+	const char* fname_style = NULL;
+	if(nth < 1)
+	{
+		LOGE("invalid nth=%i", nth);
+		return EXIT_FAILURE;
+	}
+
+	// the optional files are identified by the extension
+	int i;
+	for(i = 6; i < argc; ++i)
+	{
+		const char* ext = strrchr(argv[i], '.');
+		if(ext && (strcmp(ext, ".xml") == 0) &&
+		   (fname_style == NULL))
+		{
+			fname_style = argv[i];
+		}
+		else if(ext && (strcmp(ext, ".bfs") == 0) &&
+		        (fname_cache == NULL))
+		{
+			fname_cache = argv[i];
+		}
+		else
+		{
+			LOGE("invalid arg=%s", argv[i]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	osmdb_server_t* self;
+	self = (osmdb_server_t*)
+	       CALLOC(1, sizeof(osmdb_server_t));
+	if(self == NULL)
+	{
+		LOGE("CALLOC failed");
+		return EXIT_FAILURE;
+	}
+	self->count_workers = OSMDB_SERVER_WORKERS*nth;
+	self->queue_running = 1;
+
+	if((pthread_mutex_init(&self->cache_mutex, NULL) != 0) ||
+	   (pthread_mutex_init(&self->queue_mutex, NULL) != 0) ||
+	   (pthread_mutex_init(&self->stats_mutex, NULL) != 0) ||
+	   (pthread_cond_init(&self->queue_cond, NULL)   != 0))
+	{
+		LOGE("pthread init failed");
+		goto fail_pthread;
+	}
+
+	if(bfs_util_initialize() == 0)
+	{
+		goto fail_init;
+	}
+
+	self->tiler = osmdb_tiler_new(fname_index, nth, smem);
+	if(self->tiler == NULL)
+	{
+		goto fail_tiler;
+	}
+
+	if((osmdb_tiler_indexGrid(self->tiler, 16) == 0) ||
+	   (osmdb_tiler_cacheGeometry(self->tiler,
+	                              1024*1024*OSMDB_SERVER_GEOMETRY) == 0))
+	{
+		goto fail_grid;
+	}
+
+	self->scheduler = osmdb_scheduler_new(self->tiler);
+	if(self->scheduler == NULL)
+	{
+		goto fail_scheduler;
+	}
+
+	if(osmdb_scheduler_timeout(self->scheduler,
+	                           OSMDB_SCHEDULER_PRIORITY_INTERACTIVE,
+	                           OSMDB_SERVER_TIMEOUT) == 0)
+	{
+		goto fail_timeout;
+	}
+
+	self->lru = osmdb_lru_new(1024*1024*lru_size);
+	if(self->lru == NULL)
+	{
+		goto fail_lru;
+	}
+
+	// the prefetch cache is optional
+	if(fname_cache)
+	{
+		self->file = bfs_file_open(fname_cache, 1,
+		                           BFS_MODE_RDONLY);
+		if(self->file == NULL)
+		{
+			goto fail_file;
+		}
+
+		self->cache = osmdb_cache_new(self->file);
+		if(self->cache == NULL)
+		{
+			goto fail_cache;
+		}
+	}
+
+	// the style is optional
+	if(fname_style)
+	{
+		self->style = osmdb_style_newFile(fname_style);
+		if(self->style == NULL)
+		{
+			goto fail_style;
+		}
+	}
+
+	self->sockfd = osmdb_server_listen(port);
+	if(self->sockfd < 0)
+	{
+		goto fail_listen;
+	}
+
+	signal(SIGINT,  osmdb_server_signal);
+	signal(SIGTERM, osmdb_server_signal);
+
+	self->workers = (osmdb_serverWorker_t*)
+	                CALLOC(self->count_workers,
+	                       sizeof(osmdb_serverWorker_t));
+	if(self->workers == NULL)
+	{
+		LOGE("CALLOC failed");
+		goto fail_workers;
+	}
+
+	int started = 0;
+	for(i = 0; i < self->count_workers; ++i)
+	{
+		osmdb_serverWorker_t* worker = &self->workers[i];
+		worker->server = self;
+		if(pthread_create(&worker->thread, NULL,
+		                  osmdb_server_run,
+		                  (void*) worker) != 0)
+		{
+			LOGE("pthread_create failed");
+			break;
+		}
+		++started;
+	}
+
+	if(started == self->count_workers)
+	{
+		LOGI("listening on localhost:%i", port);
+	}
+
+	// accept connections until interrupted
+	struct pollfd pfd =
+	{
+		.fd     = self->sockfd,
+		.events = POLLIN,
+	};
+	while((started == self->count_workers) && (g_quit == 0))
+	{
+		if(poll(&pfd, 1, 100) <= 0)
+		{
+			continue;
+		}
+
+		int fd = accept(self->sockfd, NULL, NULL);
+		if(fd >= 0)
+		{
+			osmdb_server_accept(self, fd);
+		}
+	}
+
+	// stop the workers
+	pthread_mutex_lock(&self->queue_mutex);
+	self->queue_running = 0;
+	pthread_cond_broadcast(&self->queue_cond);
+	pthread_mutex_unlock(&self->queue_mutex);
+	for(i = 0; i < started; ++i)
+	{
+		pthread_join(self->workers[i].thread, NULL);
+	}
+
+	int status = EXIT_FAILURE;
+	if(started == self->count_workers)
+	{
+		osmdb_server_stats(self);
+		status = EXIT_SUCCESS;
+	}
+
+	FREE(self->workers);
+	close(self->sockfd);
+	osmdb_style_delete(&self->style);
+	osmdb_cache_delete(&self->cache);
+	bfs_file_close(&self->file);
+	osmdb_lru_delete(&self->lru);
+	osmdb_scheduler_delete(&self->scheduler);
+	osmdb_tiler_delete(&self->tiler);
+	bfs_util_shutdown();
+	pthread_cond_destroy(&self->queue_cond);
+	pthread_mutex_destroy(&self->stats_mutex);
+	pthread_mutex_destroy(&self->queue_mutex);
+	pthread_mutex_destroy(&self->cache_mutex);
+	FREE(self);
+
+	// success
+	return status;
+
+	// failure
+	fail_workers:
+		close(self->sockfd);
+	fail_listen:
+		osmdb_style_delete(&self->style);
+	fail_style:
+		osmdb_cache_delete(&self->cache);
+	fail_cache:
+		bfs_file_close(&self->file);
+	fail_file:
+		osmdb_lru_delete(&self->lru);
+	fail_lru:
+	fail_timeout:
+		osmdb_scheduler_delete(&self->scheduler);
+	fail_scheduler:
+	fail_grid:
+		osmdb_tiler_delete(&self->tiler);
+	fail_tiler:
+		bfs_util_shutdown();
+	fail_init:
+	fail_pthread:
+	{
+		FREE(self);
+		LOGE("FAILURE");
+	}
+	return EXIT_FAILURE;
+}
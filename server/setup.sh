@@ -0,0 +1,7 @@
+ln -s ../../libbfs
+ln -s ../../libcc
+ln -s ../../libsqlite3
+ln -s ../../osmdb
+ln -s ../../terrain
+ln -s ../../libexpat
+ln -s ../../libxmlstream
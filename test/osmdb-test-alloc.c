@@ -0,0 +1,227 @@
+/*
+ * Copyright (c) 2021 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define LOG_TAG "osmdb"
+#include "libcc/cc_log.h"
+#include "osmdb/tiler/osmdb_arena.h"
+#include "osmdb/tiler/osmdb_tiler.h"
+#include "osmdb/osmdb_util.h"
+#include "terrain/terrain_util.h"
+#include "osmdb_test.h"
+
+// center of the fixture
+#define LAT 40.0150
+#define LON -105.2705
+
+static int createDb(void)
+{
+	osmdb_index_t* index = osmdb_test_newDb(OSMDB_TEST_DB);
+	if(index == NULL)
+	{
+		return 0;
+	}
+
+	int road = osmdb_classNameToCode("highway:residential");
+	int poi  = osmdb_classNameToCode("amenity:cafe");
+
+	// grid of roads which cross the tile and share nds at
+	// the intersections so that the ways are joined
+	int     i;
+	int     j;
+	int64_t nds[8];
+	double  d = 0.001;
+	for(i = 0; i < 8; ++i)
+	{
+		for(j = 0; j < 8; ++j)
+		{
+			if(osmdb_test_addNode(index, 100 + 8*i + j,
+			                      LAT + d*(i - 4),
+			                      LON + d*(j - 4)) == 0)
+			{
+				goto fail_add;
+			}
+		}
+	}
+
+	for(i = 0; i < 8; ++i)
+	{
+		for(j = 0; j < 8; ++j)
+		{
+			nds[j] = 100 + 8*i + j;
+		}
+
+		if(osmdb_test_addWay(index, 1000 + i, road, 0,
+		                     8, nds) == 0)
+		{
+			goto fail_add;
+		}
+
+		for(j = 0; j < 8; ++j)
+		{
+			nds[j] = 100 + 8*j + i;
+		}
+
+		if(osmdb_test_addWay(index, 2000 + i, road, 0,
+		                     8, nds) == 0)
+		{
+			goto fail_add;
+		}
+	}
+
+	for(i = 0; i < 16; ++i)
+	{
+		if(osmdb_test_addPoi(index, 500 + i, poi,
+		                     LAT + 0.0003*(i%4),
+		                     LON + 0.0003*(i/4),
+		                     "cafe") == 0)
+		{
+			goto fail_add;
+		}
+	}
+
+	osmdb_index_delete(&index);
+
+	// success
+	return 1;
+
+	// failure
+	fail_add:
+		osmdb_index_delete(&index);
+	return 0;
+}
+
+static int countBlocks(osmdb_arena_t* arena)
+{
+	ASSERT(arena);
+
+	int count = 0;
+	osmdb_arenaBlock_t* block = arena->head;
+	while(block)
+	{
+		++count;
+		block = block->next;
+	}
+
+	return count;
+}
+
+static int testArena(void)
+{
+	osmdb_arena_t* arena = osmdb_arena_new(1024, 2048);
+	CHECK(arena);
+
+	// a large build grows the arena past max_size and
+	// includes an oversized block
+	int i;
+	for(i = 0; i < 8; ++i)
+	{
+		CHECK(osmdb_arena_alloc(arena, 1000));
+	}
+	CHECK(osmdb_arena_alloc(arena, 4096));
+	CHECK(countBlocks(arena) == 9);
+
+	// reset frees the blocks past max_size
+	osmdb_arena_reset(arena);
+	CHECK(countBlocks(arena) == 2);
+
+	// allocations within the retained blocks are reused
+	uint64_t allocs = osmdb_test_allocs();
+	for(i = 0; i < 4; ++i)
+	{
+		CHECK(osmdb_arena_alloc(arena, 1000));
+		CHECK(osmdb_arena_alloc(arena, 1000));
+		osmdb_arena_reset(arena);
+	}
+	allocs = osmdb_test_allocs() - allocs;
+	printf("[TEST] arena allocs=%" PRIu64 "\n", allocs);
+	CHECK(allocs == 0);
+	CHECK(countBlocks(arena) == 2);
+
+	osmdb_arena_delete(&arena);
+
+	return EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv)
+{
+	CHECK(createDb());
+	CHECK(testArena() == EXIT_SUCCESS);
+
+	osmdb_tiler_t* tiler;
+	tiler = osmdb_tiler_new(OSMDB_TEST_DB, 1, 1.0f);
+	CHECK(tiler);
+	CHECK(osmdb_tiler_indexGrid(tiler, 16));
+
+	float fx;
+	float fy;
+	int   zoom = 15;
+	terrain_coord2tile(LAT, LON, zoom, &fx, &fy);
+	int x = (int) fx;
+	int y = (int) fy;
+
+	// the first tiles grow the state buffers and load the
+	// index entries
+	int           i;
+	size_t        size0 = 0;
+	size_t        size  = 0;
+	osmdb_tile_t* tile;
+	for(i = 0; i < 2; ++i)
+	{
+		tile = osmdb_tiler_makeShared(tiler, 0, zoom,
+		                              x, y, &size0);
+		CHECK(tile);
+		CHECK(tile->count_ways > 0);
+		CHECK(tile->count_nodes > 0);
+	}
+
+	// steady state tiles reuse the state buffers
+	uint64_t allocs = osmdb_test_allocs();
+	for(i = 0; i < 4; ++i)
+	{
+		tile = osmdb_tiler_makeShared(tiler, 0, zoom,
+		                              x, y, &size);
+		CHECK(tile);
+		CHECK(size == size0);
+	}
+	allocs = osmdb_test_allocs() - allocs;
+	printf("[TEST] shared allocs=%" PRIu64 "\n", allocs);
+	CHECK(allocs == 0);
+
+	// copies of the tile are the only allocation
+	allocs = osmdb_test_allocs();
+	tile   = osmdb_tiler_make(tiler, 0, zoom, x, y, &size);
+	CHECK(tile);
+	allocs = osmdb_test_allocs() - allocs;
+	printf("[TEST] copy allocs=%" PRIu64 "\n", allocs);
+	CHECK(allocs == 1);
+	osmdb_tile_delete(&tile);
+
+	osmdb_tiler_delete(&tiler);
+
+	return EXIT_SUCCESS;
+}
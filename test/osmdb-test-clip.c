@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2021 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define LOG_TAG "osmdb"
+#include "libcc/cc_log.h"
+#include "osmdb/tiler/osmdb_tiler.h"
+#include "osmdb/osmdb_util.h"
+#include "terrain/terrain_util.h"
+#include "osmdb_test.h"
+
+#define COUNT 32
+
+// zoom 15 tile of the fixture
+#define X 6826
+#define Y 12415
+
+// right edge of the tile including the border
+// (see OSMDB_TILERSTATE_BORDER)
+#define EDGE (16383 + 32767/16)
+
+static int
+addLoop(osmdb_index_t* index, int64_t wid, int class,
+        int flags, double lat, double lon, double r)
+{
+	ASSERT(index);
+
+	// loop which starts inside the tile and crosses the
+	// right edge of the tile
+	int     i;
+	int64_t nds[COUNT + 1];
+	for(i = 0; i < COUNT; ++i)
+	{
+		double a = M_PI + 2.0*M_PI*((double) i)/((double) COUNT);
+
+		nds[i] = 100*wid + i;
+		if(osmdb_test_addNode(index, nds[i],
+		                      lat + r*sin(a),
+		                      lon + r*cos(a)) == 0)
+		{
+			return 0;
+		}
+	}
+	nds[COUNT] = nds[0];
+
+	return osmdb_test_addWay(index, wid, class, flags,
+	                         COUNT + 1, nds);
+}
+
+static int createDb(void)
+{
+	osmdb_index_t* index = osmdb_test_newDb(OSMDB_TEST_DB);
+	if(index == NULL)
+	{
+		return 0;
+	}
+
+	double latT;
+	double lonL;
+	double latB;
+	double lonR;
+	terrain_bounds(X, Y, 15, &latT, &lonL, &latB, &lonR);
+
+	// a roundabout and a park which are centered on the
+	// right edge of the tile
+	double h = latT - latB;
+	double r = (lonR - lonL)/4.0;
+	if((addLoop(index, 1, osmdb_classNameToCode("highway:residential"),
+	            0, latB + 0.25*h, lonR, r) == 0) ||
+	   (addLoop(index, 2, osmdb_classNameToCode("leisure:park"),
+	            OSMDB_WAYINFO_FLAG_AREA, latB + 0.75*h, lonR,
+	            r) == 0))
+	{
+		goto fail_add;
+	}
+
+	osmdb_index_delete(&index);
+
+	// success
+	return 1;
+
+	// failure
+	fail_add:
+		osmdb_index_delete(&index);
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	CHECK(createDb());
+
+	osmdb_tiler_t* tiler;
+	tiler = osmdb_tiler_new(OSMDB_TEST_DB, 1, 1.0f);
+	CHECK(tiler);
+
+	size_t        size = 0;
+	osmdb_tile_t* tile;
+	tile = osmdb_tiler_makeShared(tiler, 0, 15, X, Y, &size);
+	CHECK(tile);
+
+	osmdb_tileIter_t* iter = osmdb_tileIter_new();
+	CHECK(iter);
+	CHECK(osmdb_tileIter_init(iter, size, tile, 0));
+
+	int road = osmdb_classNameToCode("highway:residential");
+	int park = osmdb_classNameToCode("leisure:park");
+
+	int            i;
+	int            j;
+	int            count_road = 0;
+	int            count_park = 0;
+	osmdb_way_t    way;
+	osmdb_point_t* pts = NULL;
+	for(i = 0; i < tile->count_ways; ++i)
+	{
+		CHECK(osmdb_tileIter_way(iter, i, &way, NULL, &pts));
+		CHECK(way.count >= 2);
+
+		// every pt lies within the clip rect
+		for(j = 0; j < way.count; ++j)
+		{
+			CHECK(pts[j].x <= EDGE);
+		}
+
+		if(way.class == road)
+		{
+			// the closed line is split where it leaves the
+			// tile rather than closed along the edge
+			++count_road;
+			CHECK((way.flags & OSMDB_WAY_FLAG_AREA) == 0);
+			for(j = 1; j < way.count; ++j)
+			{
+				CHECK((pts[j - 1].x != EDGE) ||
+				      (pts[j].x     != EDGE));
+			}
+		}
+		else if(way.class == park)
+		{
+			// the area is clipped as a closed polygon
+			++count_park;
+			CHECK(way.flags & OSMDB_WAY_FLAG_AREA);
+			CHECK((pts[0].x == pts[way.count - 1].x) &&
+			      (pts[0].y == pts[way.count - 1].y));
+		}
+	}
+
+	printf("[TEST] road parts=%i, park parts=%i\n",
+	       count_road, count_park);
+	CHECK(count_road == 2);
+	CHECK(count_park == 1);
+
+	osmdb_tileIter_delete(&iter);
+	osmdb_tiler_delete(&tiler);
+
+	return EXIT_SUCCESS;
+}
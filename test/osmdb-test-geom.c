@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2021 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOG_TAG "osmdb"
+#include "libcc/cc_log.h"
+#include "osmdb/tiler/osmdb_tiler.h"
+#include "osmdb/osmdb_util.h"
+#include "terrain/terrain_util.h"
+#include "osmdb_test.h"
+
+// west end of the fixture
+#define LAT 40.0150
+#define LON -105.2705
+
+// the ways span a row of zoom 15 tiles
+#define COUNT_NDS 40
+#define STEP_NDS  0.002
+
+#define TILES_MAX 16
+
+static int createDb(void)
+{
+	osmdb_index_t* index = osmdb_test_newDb(OSMDB_TEST_DB);
+	if(index == NULL)
+	{
+		return 0;
+	}
+
+	int road  = osmdb_classNameToCode("highway:residential");
+	int river = osmdb_classNameToCode("waterway:river");
+
+	// three parallel ways which cross every tile of the row
+	// where the last way is a member of a rel
+	int     i;
+	int     j;
+	int64_t nds[COUNT_NDS];
+	double  lat[3] = { LAT, LAT + 0.001, LAT - 0.001 };
+	for(i = 0; i < 3; ++i)
+	{
+		for(j = 0; j < COUNT_NDS; ++j)
+		{
+			nds[j] = 100*(i + 1) + j;
+			if(osmdb_test_addNode(index, nds[j], lat[i],
+			                      LON + STEP_NDS*j) == 0)
+			{
+				goto fail_add;
+			}
+		}
+
+		int class = (i == 1) ? river : road;
+		if(osmdb_test_addWay(index, 1000 + i, class, 0,
+		                     COUNT_NDS, nds) == 0)
+		{
+			goto fail_add;
+		}
+	}
+
+	int64_t wids[1] = { 1002 };
+	if(osmdb_test_addRel(index, 4000, road, 0,
+	                     1, wids) == 0)
+	{
+		goto fail_add;
+	}
+
+	osmdb_index_delete(&index);
+
+	// success
+	return 1;
+
+	// failure
+	fail_add:
+		osmdb_index_delete(&index);
+	return 0;
+}
+
+static int
+makeRow(osmdb_tiler_t* tiler, int zoom, int x0, int y,
+        int count, osmdb_tile_t** tiles, size_t* sizes)
+{
+	ASSERT(tiler);
+	ASSERT(tiles);
+	ASSERT(sizes);
+
+	int i;
+	for(i = 0; i < count; ++i)
+	{
+		tiles[i] = osmdb_tiler_make(tiler, 0, zoom, x0 + i, y,
+		                            &sizes[i]);
+		CHECK(tiles[i]);
+	}
+
+	return EXIT_SUCCESS;
+}
+
+static int
+compareRow(osmdb_tile_t** a, size_t* size_a,
+           osmdb_tile_t** b, size_t* size_b,
+           int count)
+{
+	ASSERT(a);
+	ASSERT(size_a);
+	ASSERT(b);
+	ASSERT(size_b);
+
+	int i;
+	for(i = 0; i < count; ++i)
+	{
+		CHECK(size_a[i] == size_b[i]);
+		CHECK(memcmp(a[i], b[i], size_a[i]) == 0);
+	}
+
+	return EXIT_SUCCESS;
+}
+
+static void deleteRow(osmdb_tile_t** tiles, int count)
+{
+	ASSERT(tiles);
+
+	int i;
+	for(i = 0; i < count; ++i)
+	{
+		osmdb_tile_delete(&tiles[i]);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	CHECK(createDb());
+
+	osmdb_tiler_t* tiler;
+	tiler = osmdb_tiler_new(OSMDB_TEST_DB, 1, 1.0f);
+	CHECK(tiler);
+
+	// the row of zoom 15 tiles which include the ways
+	int   zoom = 15;
+	float x0;
+	float x1;
+	float y0;
+	float y1;
+	terrain_coord2tile(LAT + 0.001, LON, zoom, &x0, &y0);
+	terrain_coord2tile(LAT - 0.001,
+	                   LON + STEP_NDS*(COUNT_NDS - 1),
+	                   zoom, &x1, &y1);
+	CHECK((int) y0 == (int) y1);
+
+	int count = (int) x1 - (int) x0 + 1;
+	CHECK((count > 2) && (count <= TILES_MAX));
+
+	// reference tiles without the geometry cache
+	osmdb_tile_t* ref[TILES_MAX];
+	size_t        size_ref[TILES_MAX];
+	CHECK(makeRow(tiler, zoom, (int) x0, (int) y0, count,
+	              ref, size_ref) == EXIT_SUCCESS);
+
+	// the geometry of the ways and rel is assembled by the
+	// first tile and reused by the remaining tiles
+	// where the member of the rel is only gathered by the
+	// first tile which assembles the rel
+	osmdb_tile_t* tiles[TILES_MAX];
+	size_t        sizes[TILES_MAX];
+	CHECK(osmdb_tiler_cacheGeometry(tiler, 1024*1024));
+	CHECK(makeRow(tiler, zoom, (int) x0, (int) y0, count,
+	              tiles, sizes) == EXIT_SUCCESS);
+	CHECK(compareRow(ref, size_ref, tiles, sizes,
+	                 count) == EXIT_SUCCESS);
+	deleteRow(tiles, count);
+
+	osmdb_geomCache_t* cache = tiler->geom_cache;
+	uint64_t way_hit  = cache->count_hit[OSMDB_GEOMCACHE_TYPE_WAY];
+	uint64_t way_miss = cache->count_miss[OSMDB_GEOMCACHE_TYPE_WAY];
+	uint64_t rel_hit  = cache->count_hit[OSMDB_GEOMCACHE_TYPE_REL];
+	uint64_t rel_miss = cache->count_miss[OSMDB_GEOMCACHE_TYPE_REL];
+	printf("[TEST] tiles=%i, way hit=%" PRIu64 ", miss=%" PRIu64
+	       ", rel hit=%" PRIu64 ", miss=%" PRIu64 "\n",
+	       count, way_hit, way_miss, rel_hit, rel_miss);
+	CHECK(way_miss == 3);
+	CHECK(way_hit  == 2*(count - 1));
+	CHECK(rel_miss == 1);
+	CHECK(rel_hit  == count - 1);
+	CHECK(cache->count_evict == 0);
+
+	// geometry which is larger than the cache is not stored
+	// so every tile misses
+	CHECK(osmdb_tiler_cacheGeometry(tiler, 64));
+	CHECK(makeRow(tiler, zoom, (int) x0, (int) y0, count,
+	              tiles, sizes) == EXIT_SUCCESS);
+	CHECK(compareRow(ref, size_ref, tiles, sizes,
+	                 count) == EXIT_SUCCESS);
+	deleteRow(tiles, count);
+
+	cache = tiler->geom_cache;
+	printf("[TEST] small cache way hit=%" PRIu64
+	       ", miss=%" PRIu64 "\n",
+	       cache->count_hit[OSMDB_GEOMCACHE_TYPE_WAY],
+	       cache->count_miss[OSMDB_GEOMCACHE_TYPE_WAY]);
+	CHECK(cache->count_hit[OSMDB_GEOMCACHE_TYPE_WAY] == 0);
+	CHECK(cache->count_hit[OSMDB_GEOMCACHE_TYPE_REL] == 0);
+
+	deleteRow(ref, count);
+	osmdb_tiler_delete(&tiler);
+
+	return EXIT_SUCCESS;
+}
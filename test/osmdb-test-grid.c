@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2021 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOG_TAG "osmdb"
+#include "libcc/cc_log.h"
+#include "osmdb/tiler/osmdb_ostream.h"
+#include "osmdb/osmdb_proj.h"
+#include "terrain/terrain_util.h"
+#include "osmdb_test.h"
+
+// center of the fixture
+#define LAT  40.0150
+#define LON  -105.2705
+#define ZOOM 12
+
+static int
+buildTile(osmdb_ostream_t* os, int x, int y)
+{
+	ASSERT(os);
+
+	osmdb_wayRange_t way_range =
+	{
+		.latT = LAT + 0.01,
+		.lonL = LON - 0.01,
+		.latB = LAT - 0.01,
+		.lonR = LON + 0.01,
+	};
+
+	if(osmdb_ostream_beginTile(os, ZOOM, x, y, 1234) == 0)
+	{
+		return 0;
+	}
+
+	// 10x10 ways which each span a few cells of the grid
+	int i;
+	int j;
+	for(i = 0; i < 100; ++i)
+	{
+		osmdb_wayInfo_t way_info =
+		{
+			.wid   = 1000 + i,
+			.class = 1,
+		};
+
+		if(osmdb_ostream_beginWay(os, &way_info, &way_range,
+		                          0) == 0)
+		{
+			return 0;
+		}
+
+		for(j = 0; j < 5; ++j)
+		{
+			osmdb_tilePoint_t pt =
+			{
+				.x = -15000 + 3000*(i%10) + 400*j,
+				.y = -15000 + 3000*(i/10) + 300*j*(j%2),
+			};
+			if(osmdb_ostream_addWayPoint(os, &pt) == 0)
+			{
+				return 0;
+			}
+		}
+		osmdb_ostream_endWay(os);
+	}
+
+	// 10x10 nodes around the center
+	for(i = 0; i < 100; ++i)
+	{
+		osmdb_nodeInfo_t node_info =
+		{
+			.nid   = 500 + i,
+			.class = 1,
+		};
+
+		osmdb_nodeCoord_t node_coord =
+		{
+			.nid = node_info.nid,
+			.lat = LAT + 0.003*(i/10 - 5),
+			.lon = LON + 0.003*(i%10 - 5),
+		};
+		osmdb_proj_coord2world(1, &node_coord.lat,
+		                       &node_coord.lon,
+		                       &node_coord.x, &node_coord.y);
+
+		if(osmdb_ostream_addNode(os, &node_info,
+		                         &node_coord) == 0)
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+static short clampPt(int v)
+{
+	if(v < -16384)
+	{
+		return -16384;
+	}
+	else if(v > 16383)
+	{
+		return 16383;
+	}
+	return (short) v;
+}
+
+static int overlaps(osmdb_range_t* a, osmdb_range_t* b)
+{
+	ASSERT(a);
+	ASSERT(b);
+
+	int al = (a->l < a->r) ? a->l : a->r;
+	int ar = (a->l < a->r) ? a->r : a->l;
+	int ab = (a->b < a->t) ? a->b : a->t;
+	int at = (a->b < a->t) ? a->t : a->b;
+	int bl = (b->l < b->r) ? b->l : b->r;
+	int br = (b->l < b->r) ? b->r : b->l;
+	int bb = (b->b < b->t) ? b->b : b->t;
+	int bt = (b->b < b->t) ? b->t : b->b;
+
+	return (ar >= bl) && (al <= br) && (at >= bb) && (ab <= bt);
+}
+
+// count the records which overlap the range by scanning
+// every record
+static int
+bruteForce(osmdb_tileIter_t* iter, osmdb_range_t* range,
+           int* _count)
+{
+	ASSERT(iter);
+	ASSERT(range);
+	ASSERT(_count);
+
+	int count = 0;
+	int i;
+	for(i = 0; i < iter->tile->count_ways; ++i)
+	{
+		osmdb_way_t way;
+		if(osmdb_tileIter_way(iter, i, &way, NULL, NULL) == 0)
+		{
+			return 0;
+		}
+
+		if(overlaps(&way.range, range))
+		{
+			++count;
+		}
+	}
+
+	for(i = 0; i < iter->tile->count_nodes; ++i)
+	{
+		osmdb_node_t node;
+		if(osmdb_tileIter_node(iter, i, &node, NULL) == 0)
+		{
+			return 0;
+		}
+
+		osmdb_range_t pt =
+		{
+			.t = node.pt.y,
+			.l = node.pt.x,
+			.b = node.pt.y,
+			.r = node.pt.x,
+		};
+		if(overlaps(&pt, range))
+		{
+			++count;
+		}
+	}
+
+	*_count = count;
+	return 1;
+}
+
+int main(int argc, char** argv)
+{
+	float fx;
+	float fy;
+	terrain_coord2tile(LAT, LON, ZOOM, &fx, &fy);
+
+	osmdb_ostream_t* os = osmdb_ostream_new();
+	CHECK(os);
+	os->grid_cells = 16;
+	CHECK(buildTile(os, (int) fx, (int) fy));
+
+	size_t        size_v1 = os->offset;
+	size_t        size    = 0;
+	osmdb_tile_t* tile    = osmdb_ostream_endTile(os, &size);
+	CHECK(tile);
+
+	osmdb_tileIter_t* grid  = osmdb_tileIter_new();
+	osmdb_tileIter_t* scan  = osmdb_tileIter_new();
+	osmdb_tileIter_t* brute = osmdb_tileIter_new();
+	CHECK(grid && scan && brute);
+	CHECK(osmdb_tileIter_init(grid, size, tile, 0));
+	CHECK(osmdb_tileIter_init(scan, size, tile,
+	                          OSMDB_TILEITER_FLAG_NOGRID));
+	CHECK(osmdb_tileIter_init(brute, size, tile, 0));
+
+	// the cells are halved until the grid fits in the
+	// bytes saved versus the V1 layout
+	CHECK((grid->cells >= 2) && (grid->cells <= 16));
+	CHECK(size < size_v1);
+
+	// the grid hits match the scan of every record for
+	// windows and points across the tile including the
+	// cell boundaries
+	int total = 0;
+	int i;
+	int j;
+	int k;
+	for(k = 0; k < 3; ++k)
+	{
+		int w = (k == 0) ? 0 : 2048*k*k;
+		for(i = 0; i < 17; ++i)
+		{
+			for(j = 0; j < 17; ++j)
+			{
+				int l = -16384 + 2048*j - w/2;
+				int b = -16384 + 2048*i - w/2;
+				osmdb_range_t range =
+				{
+					.t = clampPt(b + w),
+					.l = clampPt(l),
+					.b = clampPt(b),
+					.r = clampPt(l + w),
+				};
+
+				int              count_grid;
+				int              count_scan;
+				int              count_brute;
+				osmdb_tileHit_t* hits_grid;
+				osmdb_tileHit_t* hits_scan;
+				CHECK(osmdb_tileIter_query(grid, &range,
+				                           &count_grid,
+				                           &hits_grid));
+				CHECK(osmdb_tileIter_query(scan, &range,
+				                           &count_scan,
+				                           &hits_scan));
+				CHECK(bruteForce(brute, &range, &count_brute));
+				CHECK(count_grid == count_scan);
+				CHECK(count_grid == count_brute);
+				CHECK((count_grid == 0) ||
+				      (memcmp(hits_grid, hits_scan, count_grid*
+				              sizeof(osmdb_tileHit_t)) == 0));
+				total += count_grid;
+			}
+		}
+	}
+	printf("[TEST] grid cells=%i, hits=%i\n", grid->cells, total);
+	CHECK(total > 0);
+
+	osmdb_tileIter_delete(&brute);
+	osmdb_tileIter_delete(&scan);
+	osmdb_tileIter_delete(&grid);
+	osmdb_tile_delete(&tile);
+	osmdb_ostream_delete(&os);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,346 @@
+/*
+ * Copyright (c) 2021 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOG_TAG "osmdb"
+#include "libcc/cc_log.h"
+#include "osmdb/tiler/osmdb_tiler.h"
+#include "osmdb/osmdb_util.h"
+#include "terrain/terrain_util.h"
+#include "osmdb_test.h"
+
+// the golden database contains the expected result of the
+// joins as single ways
+#define OSMDB_TEST_GOLDEN_DB "osmdb-test-golden.sqlite3"
+
+// tile of the fixture
+#define LAT 40.0150
+#define LON -105.2705
+
+#define WAYS_MAX 16
+#define PTS_MAX  16
+
+typedef struct
+{
+	osmdb_way_t   way;
+	osmdb_point_t pts[PTS_MAX];
+} wayPts_t;
+
+static int
+addNodes(osmdb_index_t* index, double lat, double lon)
+{
+	ASSERT(index);
+
+	// chain of a zig-zag road which is split into segments
+	// where the turns are below the 30 degree join angle
+	int k;
+	for(k = 0; k < 9; ++k)
+	{
+		double dlat = (k%2) ? 0.00015 : 0.0;
+		if(osmdb_test_addNode(index, 100 + k,
+		                      lat + 0.002 + dlat,
+		                      lon - 0.004 + 0.001*k) == 0)
+		{
+			return 0;
+		}
+	}
+
+	// corner with a 90 degree turn
+	if((osmdb_test_addNode(index, 200, lat - 0.001,
+	                       lon - 0.004) == 0) ||
+	   (osmdb_test_addNode(index, 201, lat - 0.001,
+	                       lon - 0.002) == 0) ||
+	   (osmdb_test_addNode(index, 202, lat - 0.003,
+	                       lon - 0.002) == 0))
+	{
+		return 0;
+	}
+
+	// collinear ways of different classes
+	if((osmdb_test_addNode(index, 300, lat, lon) == 0) ||
+	   (osmdb_test_addNode(index, 301, lat,
+	                       lon + 0.002) == 0) ||
+	   (osmdb_test_addNode(index, 302, lat,
+	                       lon + 0.004) == 0))
+	{
+		return 0;
+	}
+
+	// T junction where the collinear ways are joined
+	if((osmdb_test_addNode(index, 400, lat - 0.003,
+	                       lon + 0.0005) == 0) ||
+	   (osmdb_test_addNode(index, 401, lat - 0.003,
+	                       lon + 0.002) == 0) ||
+	   (osmdb_test_addNode(index, 402, lat - 0.003,
+	                       lon + 0.0035) == 0) ||
+	   (osmdb_test_addNode(index, 403, lat - 0.0015,
+	                       lon + 0.002) == 0))
+	{
+		return 0;
+	}
+
+	// loop which is not joined
+	if((osmdb_test_addNode(index, 500, lat - 0.0005,
+	                       lon - 0.0005) == 0) ||
+	   (osmdb_test_addNode(index, 501, lat - 0.0005,
+	                       lon - 0.0015) == 0) ||
+	   (osmdb_test_addNode(index, 502, lat - 0.0015,
+	                       lon - 0.0015) == 0))
+	{
+		return 0;
+	}
+
+	return 1;
+}
+
+static int
+createDb(const char* fname, double lat, double lon,
+         int golden)
+{
+	ASSERT(fname);
+
+	osmdb_index_t* index = osmdb_test_newDb(fname);
+	if(index == NULL)
+	{
+		return 0;
+	}
+
+	int road  = osmdb_classNameToCode("highway:residential");
+	int road2 = osmdb_classNameToCode("highway:secondary");
+
+	if(addNodes(index, lat, lon) == 0)
+	{
+		goto fail_add;
+	}
+
+	// the chain segments are added out of order and two
+	// segments are reversed
+	int64_t chain[9] = { 100, 101, 102, 103, 104,
+	                     105, 106, 107, 108 };
+	int64_t s1[3]    = { 102, 101, 100 };
+	int64_t s2[3]    = { 102, 103, 104 };
+	int64_t s3[3]    = { 104, 105, 106 };
+	int64_t s4[3]    = { 108, 107, 106 };
+	if(golden)
+	{
+		if(osmdb_test_addWay(index, 1001, road, 0,
+		                     9, chain) == 0)
+		{
+			goto fail_add;
+		}
+	}
+	else if((osmdb_test_addWay(index, 1001, road, 0,
+	                           3, s3) == 0) ||
+	        (osmdb_test_addWay(index, 1002, road, 0,
+	                           3, s1) == 0) ||
+	        (osmdb_test_addWay(index, 1003, road, 0,
+	                           3, s4) == 0) ||
+	        (osmdb_test_addWay(index, 1004, road, 0,
+	                           3, s2) == 0))
+	{
+		goto fail_add;
+	}
+
+	int64_t corner1[2] = { 200, 201 };
+	int64_t corner2[2] = { 201, 202 };
+	int64_t class1[2]  = { 300, 301 };
+	int64_t class2[2]  = { 301, 302 };
+	int64_t t1[2]      = { 400, 401 };
+	int64_t t2[2]      = { 401, 403 };
+	int64_t t3[2]      = { 401, 402 };
+	int64_t t12[3]     = { 400, 401, 402 };
+	int64_t loop[4]    = { 500, 501, 502, 500 };
+	if((osmdb_test_addWay(index, 1101, road, 0,
+	                      2, corner1) == 0) ||
+	   (osmdb_test_addWay(index, 1102, road, 0,
+	                      2, corner2) == 0) ||
+	   (osmdb_test_addWay(index, 1201, road, 0,
+	                      2, class1) == 0) ||
+	   (osmdb_test_addWay(index, 1202, road2, 0,
+	                      2, class2) == 0) ||
+	   (osmdb_test_addWay(index, 1302, road, 0,
+	                      2, t2) == 0) ||
+	   (osmdb_test_addWay(index, 1401, road, 0,
+	                      4, loop) == 0))
+	{
+		goto fail_add;
+	}
+
+	if(golden)
+	{
+		if(osmdb_test_addWay(index, 1301, road, 0,
+		                     3, t12) == 0)
+		{
+			goto fail_add;
+		}
+	}
+	else if((osmdb_test_addWay(index, 1301, road, 0,
+	                           2, t1) == 0) ||
+	        (osmdb_test_addWay(index, 1303, road, 0,
+	                           2, t3) == 0))
+	{
+		goto fail_add;
+	}
+
+	osmdb_index_delete(&index);
+
+	// success
+	return 1;
+
+	// failure
+	fail_add:
+		osmdb_index_delete(&index);
+	return 0;
+}
+
+static int
+decodeWays(const char* fname, int zoom, int x, int y,
+           int* _count, wayPts_t* ways)
+{
+	ASSERT(fname);
+	ASSERT(_count);
+	ASSERT(ways);
+
+	osmdb_tiler_t* tiler;
+	tiler = osmdb_tiler_new(fname, 1, 1.0f);
+	CHECK(tiler);
+
+	size_t        size = 0;
+	osmdb_tile_t* tile;
+	tile = osmdb_tiler_make(tiler, 0, zoom, x, y, &size);
+	CHECK(tile);
+	CHECK(tile->count_ways <= WAYS_MAX);
+
+	osmdb_tileIter_t* iter = osmdb_tileIter_new();
+	CHECK(iter);
+	CHECK(osmdb_tileIter_init(iter, size, tile, 0));
+
+	int i;
+	for(i = 0; i < tile->count_ways; ++i)
+	{
+		osmdb_point_t* pts;
+		CHECK(osmdb_tileIter_way(iter, i, &ways[i].way,
+		                         NULL, &pts));
+		CHECK(ways[i].way.count <= PTS_MAX);
+		memcpy(ways[i].pts, pts,
+		       ways[i].way.count*sizeof(osmdb_point_t));
+	}
+	*_count = tile->count_ways;
+
+	osmdb_tileIter_delete(&iter);
+	osmdb_tile_delete(&tile);
+	osmdb_tiler_delete(&tiler);
+
+	return EXIT_SUCCESS;
+}
+
+// ways are equal when the pts match in either direction
+static int equalWay(wayPts_t* a, wayPts_t* b)
+{
+	ASSERT(a);
+	ASSERT(b);
+
+	if((a->way.class != b->way.class) ||
+	   (a->way.flags != b->way.flags) ||
+	   (a->way.layer != b->way.layer) ||
+	   (a->way.count != b->way.count))
+	{
+		return 0;
+	}
+
+	int n = a->way.count;
+	if(memcmp(a->pts, b->pts, n*sizeof(osmdb_point_t)) == 0)
+	{
+		return 1;
+	}
+
+	int i;
+	for(i = 0; i < n; ++i)
+	{
+		if((a->pts[i].x != b->pts[n - 1 - i].x) ||
+		   (a->pts[i].y != b->pts[n - 1 - i].y))
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+int main(int argc, char** argv)
+{
+	float fx;
+	float fy;
+	int   zoom = 15;
+	terrain_coord2tile(LAT, LON, zoom, &fx, &fy);
+
+	// center the fixture in the tile
+	int    x = (int) fx;
+	int    y = (int) fy;
+	double latT;
+	double lonL;
+	double latB;
+	double lonR;
+	terrain_bounds(x, y, zoom, &latT, &lonL, &latB, &lonR);
+	double lat = 0.5*(latT + latB);
+	double lon = 0.5*(lonL + lonR);
+
+	CHECK(createDb(OSMDB_TEST_DB, lat, lon, 0));
+	CHECK(createDb(OSMDB_TEST_GOLDEN_DB, lat, lon, 1));
+
+	int      count;
+	int      count_golden;
+	wayPts_t ways[WAYS_MAX];
+	wayPts_t golden[WAYS_MAX];
+	CHECK(decodeWays(OSMDB_TEST_DB, zoom, x, y,
+	                 &count, ways) == EXIT_SUCCESS);
+	CHECK(decodeWays(OSMDB_TEST_GOLDEN_DB, zoom, x, y,
+	                 &count_golden, golden) == EXIT_SUCCESS);
+
+	// each joined way matches one golden way
+	int i;
+	int j;
+	int used[WAYS_MAX];
+	memset((void*) used, 0, sizeof(used));
+	CHECK(count == count_golden);
+	for(i = 0; i < count; ++i)
+	{
+		for(j = 0; j < count_golden; ++j)
+		{
+			if((used[j] == 0) && equalWay(&ways[i], &golden[j]))
+			{
+				used[j] = 1;
+				break;
+			}
+		}
+		CHECK(j < count_golden);
+	}
+
+	printf("[TEST] joined ways=%i\n", count);
+	CHECK(count == 8);
+
+	return EXIT_SUCCESS;
+}
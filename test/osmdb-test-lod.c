@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 2021 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOG_TAG "osmdb"
+#include "libcc/cc_log.h"
+#include "osmdb/tiler/osmdb_ostream.h"
+#include "osmdb_test.h"
+
+// tile of the fixture
+#define ZOOM 15
+#define X    6826
+#define Y    12415
+
+#define WAYS 20
+#define PTS  200
+
+static int buildTile(osmdb_ostream_t* os)
+{
+	ASSERT(os);
+
+	osmdb_wayRange_t way_range =
+	{
+		.latT = 40.02,
+		.lonL = -105.28,
+		.latB = 40.01,
+		.lonR = -105.27,
+	};
+
+	if(osmdb_ostream_beginTile(os, ZOOM, X, Y, 1234) == 0)
+	{
+		return 0;
+	}
+
+	// a zoom 20 pixel is 4 units of a zoom 15 tile
+	os->lod_tolerance = 4.0;
+
+	// winding ways with detail at every scale
+	int i;
+	int j;
+	for(i = 0; i < WAYS; ++i)
+	{
+		osmdb_wayInfo_t way_info =
+		{
+			.wid   = 1000 + i,
+			.class = 1,
+		};
+
+		if(osmdb_ostream_beginWay(os, &way_info, &way_range,
+		                          0) == 0)
+		{
+			return 0;
+		}
+
+		double x = -12000.0 + 1000.0*i;
+		double y = -12000.0;
+		double a = 0.1*i;
+		for(j = 0; j < PTS; ++j)
+		{
+			a += 0.3*sin(0.05*j*(i + 1)) + 0.02*(j%7 - 3);
+			x += 60.0*cos(a);
+			y += 60.0*sin(a) + 40.0;
+
+			osmdb_tilePoint_t pt =
+			{
+				.x = (int) x,
+				.y = (int) y,
+			};
+			if(osmdb_ostream_addWayPoint(os, &pt) == 0)
+			{
+				return 0;
+			}
+		}
+		osmdb_ostream_endWay(os);
+	}
+
+	return 1;
+}
+
+// check that pts is an ordered subset of the full pts
+// which includes the endpoints
+static int
+isSubset(int count, osmdb_point_t* pts,
+         int count_full, osmdb_point_t* pts_full)
+{
+	ASSERT(pts);
+	ASSERT(pts_full);
+
+	if((count < 2) ||
+	   (memcmp(&pts[0], &pts_full[0],
+	           sizeof(osmdb_point_t)) != 0) ||
+	   (memcmp(&pts[count - 1], &pts_full[count_full - 1],
+	           sizeof(osmdb_point_t)) != 0))
+	{
+		return 0;
+	}
+
+	int i;
+	int j = 0;
+	for(i = 0; i < count; ++i)
+	{
+		while((j < count_full) &&
+		      (memcmp(&pts[i], &pts_full[j],
+		              sizeof(osmdb_point_t)) != 0))
+		{
+			++j;
+		}
+
+		if(j == count_full)
+		{
+			return 0;
+		}
+		++j;
+	}
+
+	return 1;
+}
+
+int main(int argc, char** argv)
+{
+	osmdb_ostream_t* os = osmdb_ostream_new();
+	CHECK(os);
+	CHECK(buildTile(os));
+
+	size_t        size = 0;
+	osmdb_tile_t* tile = osmdb_ostream_endTile(os, &size);
+	CHECK(tile);
+	CHECK(tile->count_ways == WAYS);
+
+	osmdb_tileIter_t* full = osmdb_tileIter_new();
+	osmdb_tileIter_t* iter = osmdb_tileIter_new();
+	CHECK(full && iter);
+	CHECK(osmdb_tileIter_init(full, size, tile, 0));
+
+	osmdb_point_t pts_full[PTS];
+	int           count_prev[WAYS];
+	size_t        size_prev = 0;
+	size_t        size_min  = 0;
+	memset(count_prev, 0, sizeof(count_prev));
+
+	// each zoom decodes an ordered subset of the pts which
+	// grows with the zoom until zoom 20 has every pt
+	int zoom;
+	int i;
+	for(zoom = 15; zoom <= 20; ++zoom)
+	{
+		CHECK(osmdb_tileIter_init(iter, size, tile, 0));
+		osmdb_tileIter_lod(iter, zoom);
+
+		int total = 0;
+		for(i = 0; i < WAYS; ++i)
+		{
+			osmdb_way_t    way_full;
+			osmdb_way_t    way;
+			osmdb_point_t* pts;
+			CHECK(osmdb_tileIter_way(full, i, &way_full,
+			                         NULL, &pts));
+			CHECK(way_full.count <= PTS);
+			memcpy(pts_full, pts,
+			       way_full.count*sizeof(osmdb_point_t));
+
+			CHECK(osmdb_tileIter_way(iter, i, &way,
+			                         NULL, &pts));
+			CHECK(isSubset(way.count, pts,
+			               way_full.count, pts_full));
+			CHECK(way.count >= count_prev[i]);
+			if(zoom == 20)
+			{
+				CHECK(way.count == way_full.count);
+			}
+			count_prev[i] = way.count;
+			total += way.count;
+		}
+
+		// the lower zooms decode fewer bytes
+		CHECK(iter->size_pts >= size_prev);
+		size_prev = iter->size_pts;
+		if(zoom == 15)
+		{
+			size_min = iter->size_pts;
+		}
+
+		printf("[TEST] zoom=%i, pts=%i, bytes=%i\n",
+		       zoom, total, (int) iter->size_pts);
+	}
+
+	CHECK(size_min < size_prev);
+
+	osmdb_tileIter_delete(&iter);
+	osmdb_tileIter_delete(&full);
+	osmdb_tile_delete(&tile);
+	osmdb_ostream_delete(&os);
+
+	return EXIT_SUCCESS;
+}
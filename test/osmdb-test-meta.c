@@ -0,0 +1,322 @@
+/*
+ * Copyright (c) 2021 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOG_TAG "osmdb"
+#include "libcc/cc_log.h"
+#include "libcc/cc_timestamp.h"
+#include "osmdb/tiler/osmdb_tiler.h"
+#include "osmdb/osmdb_util.h"
+#include "terrain/terrain_util.h"
+#include "osmdb_test.h"
+
+// center of the fixture
+#define LAT 40.0150
+#define LON -105.2705
+
+static int createDb(void)
+{
+	osmdb_index_t* index = osmdb_test_newDb(OSMDB_TEST_DB);
+	if(index == NULL)
+	{
+		return 0;
+	}
+
+	int road = osmdb_classNameToCode("highway:residential");
+	int park = osmdb_classNameToCode("leisure:park");
+	int poi  = osmdb_classNameToCode("amenity:cafe");
+
+	// grid of roads which cross the tile boundaries and
+	// share nds at the intersections so that the ways are
+	// joined
+	int     i;
+	int     j;
+	int64_t nds[10];
+	double  d = 0.002;
+	for(i = 0; i < 10; ++i)
+	{
+		for(j = 0; j < 10; ++j)
+		{
+			if(osmdb_test_addNode(index, 100 + 10*i + j,
+			                      LAT + d*(i - 5),
+			                      LON + d*(j - 5)) == 0)
+			{
+				goto fail_add;
+			}
+		}
+	}
+
+	for(i = 0; i < 10; ++i)
+	{
+		for(j = 0; j < 10; ++j)
+		{
+			nds[j] = 100 + 10*i + j;
+		}
+
+		if(osmdb_test_addWay(index, 1000 + i, road, 0,
+		                     10, nds) == 0)
+		{
+			goto fail_add;
+		}
+
+		for(j = 0; j < 10; ++j)
+		{
+			nds[j] = 100 + 10*j + i;
+		}
+
+		if(osmdb_test_addWay(index, 2000 + i, road, 0,
+		                     10, nds) == 0)
+		{
+			goto fail_add;
+		}
+	}
+
+	// closed park around the center
+	int64_t ring[5] = { 133, 136, 166, 163, 133 };
+	if(osmdb_test_addWay(index, 3000, park,
+	                     OSMDB_WAYINFO_FLAG_AREA,
+	                     5, ring) == 0)
+	{
+		goto fail_add;
+	}
+
+	// rels whose members are drawn by the rel rather than
+	// exported as ways where the rels cross the tile
+	// boundaries
+	int64_t wids1[3] = { 1002, 1003, 2004 };
+	int64_t wids2[2] = { 2007, 1007 };
+	if((osmdb_test_addRel(index, 4000, road, 0,
+	                      3, wids1) == 0) ||
+	   (osmdb_test_addRel(index, 4001, road, 0,
+	                      2, wids2) == 0))
+	{
+		goto fail_add;
+	}
+
+	for(i = 0; i < 64; ++i)
+	{
+		if(osmdb_test_addPoi(index, 500 + i, poi,
+		                     LAT + 0.0015*(i%8 - 4),
+		                     LON + 0.0015*(i/8 - 4),
+		                     "cafe") == 0)
+		{
+			goto fail_add;
+		}
+	}
+
+	osmdb_index_delete(&index);
+
+	// success
+	return 1;
+
+	// failure
+	fail_add:
+		osmdb_index_delete(&index);
+	return 0;
+}
+
+static int
+compareMeta(osmdb_tiler_t* tiler, int zoom, int n)
+{
+	ASSERT(tiler);
+
+	// the center is near the middle of the metatile
+	float fx;
+	float fy;
+	terrain_coord2tile(LAT, LON, zoom, &fx, &fy);
+	int x0 = (int) (fx - 0.5f*((float) (n - 1)));
+	int y0 = (int) (fy - 0.5f*((float) (n - 1)));
+
+	osmdb_tile_t* tiles[16];
+	size_t        sizes[16];
+	CHECK(n*n <= 16);
+	CHECK(osmdb_tiler_makeMeta(tiler, 0, zoom, x0, y0, n,
+	                           tiles, sizes));
+
+	// each tile of the metatile matches the single tile
+	int k;
+	int rels = 0;
+	int ways = 0;
+	for(k = 0; k < n*n; ++k)
+	{
+		size_t        size = 0;
+		osmdb_tile_t* tile;
+		tile = osmdb_tiler_make(tiler, 0, zoom,
+		                        x0 + k%n, y0 + k/n, &size);
+		CHECK(tile);
+		CHECK(size == sizes[k]);
+		CHECK(memcmp(tile, tiles[k], size) == 0);
+		rels += tile->count_rels;
+		ways += tile->count_ways;
+		osmdb_tile_delete(&tile);
+		osmdb_tile_delete(&tiles[k]);
+	}
+
+	printf("[TEST] zoom=%i, n=%i, rels=%i, ways=%i\n",
+	       zoom, n, rels, ways);
+	CHECK(rels > 0);
+	CHECK(ways > 0);
+
+	return EXIT_SUCCESS;
+}
+
+static int
+makeSingle(osmdb_tiler_t* tiler, int zoom,
+           int x0, int y0, int n)
+{
+	ASSERT(tiler);
+
+	int k;
+	for(k = 0; k < n*n; ++k)
+	{
+		osmdb_tile_t* tile;
+		tile = osmdb_tiler_make(tiler, 0, zoom,
+		                        x0 + k%n, y0 + k/n, NULL);
+		CHECK(tile);
+		osmdb_tile_delete(&tile);
+	}
+
+	return EXIT_SUCCESS;
+}
+
+static int
+makeMeta(osmdb_tiler_t* tiler, int zoom,
+         int x0, int y0, int n)
+{
+	ASSERT(tiler);
+
+	osmdb_tile_t* tiles[16];
+	size_t        sizes[16];
+	CHECK(n*n <= 16);
+	CHECK(osmdb_tiler_makeMeta(tiler, 0, zoom, x0, y0, n,
+	                           tiles, sizes));
+
+	int k;
+	for(k = 0; k < n*n; ++k)
+	{
+		osmdb_tile_delete(&tiles[k]);
+	}
+
+	return EXIT_SUCCESS;
+}
+
+static int
+fetchMeta(osmdb_tiler_t* tiler, int zoom, int n)
+{
+	ASSERT(tiler);
+
+	float fx;
+	float fy;
+	terrain_coord2tile(LAT, LON, zoom, &fx, &fy);
+	int x0 = (int) (fx - 0.5f*((float) (n - 1)));
+	int y0 = (int) (fy - 0.5f*((float) (n - 1)));
+
+	// the single tiles fetch the shared ways once per tile
+	// which the geometry cache counts as hits while the
+	// metatile fetches each way once
+	CHECK(osmdb_tiler_cacheGeometry(tiler, 1024*1024));
+	CHECK(makeSingle(tiler, zoom, x0, y0, n) == EXIT_SUCCESS);
+
+	osmdb_geomCache_t* cache = tiler->geom_cache;
+	uint64_t single_hit  = cache->count_hit[OSMDB_GEOMCACHE_TYPE_WAY];
+	uint64_t single_miss = cache->count_miss[OSMDB_GEOMCACHE_TYPE_WAY];
+
+	CHECK(osmdb_tiler_cacheGeometry(tiler, 1024*1024));
+	CHECK(makeMeta(tiler, zoom, x0, y0, n) == EXIT_SUCCESS);
+
+	cache = tiler->geom_cache;
+	uint64_t meta_hit  = cache->count_hit[OSMDB_GEOMCACHE_TYPE_WAY];
+	uint64_t meta_miss = cache->count_miss[OSMDB_GEOMCACHE_TYPE_WAY];
+	CHECK(osmdb_tiler_cacheGeometry(tiler, 0));
+
+	printf("[TEST] zoom=%i, n=%i, single hit=%i, miss=%i"
+	       ", meta hit=%i, miss=%i\n", zoom, n,
+	       (int) single_hit, (int) single_miss,
+	       (int) meta_hit, (int) meta_miss);
+	CHECK(single_hit > 0);
+	CHECK(meta_hit   == 0);
+	CHECK(meta_miss  == single_miss);
+
+	return EXIT_SUCCESS;
+}
+
+static int
+timeMeta(osmdb_tiler_t* tiler, int zoom, int n)
+{
+	ASSERT(tiler);
+
+	float fx;
+	float fy;
+	terrain_coord2tile(LAT, LON, zoom, &fx, &fy);
+	int x0 = (int) (fx - 0.5f*((float) (n - 1)));
+	int y0 = (int) (fy - 0.5f*((float) (n - 1)));
+
+	// tiles per second of the single tiles and metatile
+	// without the geometry cache
+	int    r;
+	int    count = 20;
+	double t0    = cc_timestamp();
+	for(r = 0; r < count; ++r)
+	{
+		CHECK(makeSingle(tiler, zoom, x0, y0, n) == EXIT_SUCCESS);
+	}
+
+	double t1 = cc_timestamp();
+	for(r = 0; r < count; ++r)
+	{
+		CHECK(makeMeta(tiler, zoom, x0, y0, n) == EXIT_SUCCESS);
+	}
+
+	double t2    = cc_timestamp();
+	double tiles = (double) (count*n*n);
+	printf("[TEST] zoom=%i, n=%i, single=%0.1lf tiles/sec"
+	       ", meta=%0.1lf tiles/sec\n", zoom, n,
+	       tiles/(t1 - t0), tiles/(t2 - t1));
+
+	return EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv)
+{
+	CHECK(createDb());
+
+	osmdb_tiler_t* tiler;
+	tiler = osmdb_tiler_new(OSMDB_TEST_DB, 1, 1.0f);
+	CHECK(tiler);
+	CHECK(osmdb_tiler_indexGrid(tiler, 16));
+
+	CHECK(compareMeta(tiler, 15, 1) == EXIT_SUCCESS);
+	CHECK(compareMeta(tiler, 15, 2) == EXIT_SUCCESS);
+	CHECK(compareMeta(tiler, 15, 3) == EXIT_SUCCESS);
+	CHECK(compareMeta(tiler, 13, 2) == EXIT_SUCCESS);
+	CHECK(fetchMeta(tiler, 15, 2)   == EXIT_SUCCESS);
+	CHECK(timeMeta(tiler, 13, 2)    == EXIT_SUCCESS);
+	CHECK(timeMeta(tiler, 15, 2)    == EXIT_SUCCESS);
+
+	osmdb_tiler_delete(&tiler);
+
+	return EXIT_SUCCESS;
+}
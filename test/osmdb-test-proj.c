@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2021 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define LOG_TAG "osmdb"
+#include "libcc/cc_log.h"
+#include "osmdb/osmdb_proj.h"
+#include "osmdb_test.h"
+
+#define COUNT 4099
+
+static double lat[COUNT];
+static double lon[COUNT];
+
+static double rnd(uint64_t* seed, double a, double b)
+{
+	ASSERT(seed);
+
+	*seed = 6364136223846793005ULL*(*seed) +
+	        1442695040888963407ULL;
+	return a + (b - a)*((double) (*seed >> 11))/
+	                   ((double) (1ULL << 53));
+}
+
+static int testTile(int zoom)
+{
+	// batch results use the avx2 kernel when supported
+	// while single pts always use the scalar kernel
+	static double bx[COUNT];
+	static double by[COUNT];
+	osmdb_proj_coord2tile(COUNT, lat, lon, zoom, bx, by);
+
+	int    i;
+	double n    = (double) (((int64_t) 1) << zoom);
+	double err  = 0.0;
+	double errm = 0.0;
+	for(i = 0; i < COUNT; ++i)
+	{
+		double x;
+		double y;
+		osmdb_proj_coord2tile(1, &lat[i], &lon[i], zoom,
+		                      &x, &y);
+		err = fmax(err, fabs(x - bx[i]));
+		err = fmax(err, fabs(y - by[i]));
+
+		// compare with libm
+		double r  = lat[i]*M_PI/180.0;
+		double mx = n*(lon[i] + 180.0)/360.0;
+		double my = n*(1.0 - log(tan(r) + 1.0/cos(r))/M_PI)/2.0;
+		errm = fmax(errm, fabs(x - mx));
+		errm = fmax(errm, fabs(y - my));
+	}
+
+	// the error is in tiles where the batch error is the
+	// rounding error of the zoom 31 coordinates
+	printf("[TEST] coord2tile zoom=%i, batch=%le, libm=%le\n",
+	       zoom, err, errm);
+	CHECK(err <= 1e-6);
+	CHECK(errm <= 1e-3);
+
+	return EXIT_SUCCESS;
+}
+
+static int testWorld(void)
+{
+	static int bx[COUNT];
+	static int by[COUNT];
+	osmdb_proj_coord2world(COUNT, lat, lon, bx, by);
+
+	int i;
+	int diff = 0;
+	for(i = 0; i < COUNT; ++i)
+	{
+		int x;
+		int y;
+		osmdb_proj_coord2world(1, &lat[i], &lon[i], &x, &y);
+		diff = (int) fmax(diff, abs(x - bx[i]));
+		diff = (int) fmax(diff, abs(y - by[i]));
+	}
+
+	// truncation may differ by one unit at zoom 31
+	printf("[TEST] coord2world diff=%i\n", diff);
+	CHECK(diff <= 1);
+
+	return EXIT_SUCCESS;
+}
+
+static int testXyz(void)
+{
+	static double bx[COUNT];
+	static double by[COUNT];
+	static double bz[COUNT];
+	osmdb_proj_geo2xyz(COUNT, lat, lon, 100.0, bx, by, bz);
+
+	int    i;
+	double err  = 0.0;
+	double errm = 0.0;
+	for(i = 0; i < COUNT; ++i)
+	{
+		double x;
+		double y;
+		double z;
+		osmdb_proj_geo2xyz(1, &lat[i], &lon[i], 100.0,
+		                   &x, &y, &z);
+		err = fmax(err, fabs(x - bx[i]));
+		err = fmax(err, fabs(y - by[i]));
+		err = fmax(err, fabs(z - bz[i]));
+
+		// compare with libm
+		double a  = 6378137.0;
+		double e2 = 6.69437999014e-3;
+		double p  = lat[i]*M_PI/180.0;
+		double l  = lon[i]*M_PI/180.0;
+		double nn = a/sqrt(1.0 - e2*sin(p)*sin(p));
+		errm = fmax(errm, fabs(x - (nn + 100.0)*cos(p)*cos(l)));
+		errm = fmax(errm, fabs(y - (nn + 100.0)*cos(p)*sin(l)));
+		errm = fmax(errm, fabs(z - (nn*(1.0 - e2) + 100.0)*sin(p)));
+	}
+
+	// the error is in meters
+	printf("[TEST] geo2xyz batch=%le, libm=%le\n", err, errm);
+	CHECK(err <= 1e-6);
+	CHECK(errm <= 1e-5);
+
+	return EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv)
+{
+	// COUNT is not a multiple of the batch size so the
+	// batch includes a scalar tail
+	int      i;
+	uint64_t seed = 1;
+	for(i = 0; i < COUNT; ++i)
+	{
+		lat[i] = rnd(&seed, -85.0, 85.0);
+		lon[i] = rnd(&seed, -180.0, 180.0);
+	}
+
+	CHECK(testTile(15) == EXIT_SUCCESS);
+	CHECK(testTile(31) == EXIT_SUCCESS);
+	CHECK(testWorld() == EXIT_SUCCESS);
+	CHECK(testXyz() == EXIT_SUCCESS);
+
+	return EXIT_SUCCESS;
+}
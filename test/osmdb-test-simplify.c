@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2021 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define LOG_TAG "osmdb"
+#include "libcc/cc_log.h"
+#include "osmdb/tiler/osmdb_ostream.h"
+#include "osmdb/tiler/osmdb_tiler.h"
+#include "osmdb/osmdb_proj.h"
+#include "osmdb/osmdb_util.h"
+#include "terrain/terrain_util.h"
+#include "osmdb_test.h"
+
+#define COUNT 200
+
+// zoom 15 tile of the fixture
+#define X 6826
+#define Y 12415
+
+static double lat[COUNT];
+static double lon[COUNT];
+
+static int createDb(void)
+{
+	osmdb_index_t* index = osmdb_test_newDb(OSMDB_TEST_DB);
+	if(index == NULL)
+	{
+		return 0;
+	}
+
+	double latT;
+	double lonL;
+	double latB;
+	double lonR;
+	terrain_bounds(X, Y, 15, &latT, &lonL, &latB, &lonR);
+
+	// a wavy line inside the zoom 15 tile with small
+	// wiggles and a few spikes which must be kept
+	int     i;
+	int64_t nds[COUNT];
+	double  w = lonR - lonL;
+	double  h = latT - latB;
+	for(i = 0; i < COUNT; ++i)
+	{
+		double t = ((double) i)/((double) (COUNT - 1));
+		double a = 0.002*sin(40.0*t);
+		if((i%37) == 18)
+		{
+			a += 0.1;
+		}
+
+		nds[i] = 100 + i;
+		lat[i] = latB + h*(0.5 + 0.3*sin(3.0*t) + a);
+		lon[i] = lonL + w*(0.2 + 0.6*t);
+		if(osmdb_test_addNode(index, nds[i],
+		                      lat[i], lon[i]) == 0)
+		{
+			goto fail_add;
+		}
+	}
+
+	int class = osmdb_classNameToCode("highway:residential");
+	if(osmdb_test_addWay(index, 1000, class, 0,
+	                     COUNT, nds) == 0)
+	{
+		goto fail_add;
+	}
+
+	osmdb_index_delete(&index);
+
+	// success
+	return 1;
+
+	// failure
+	fail_add:
+		osmdb_index_delete(&index);
+	return 0;
+}
+
+static double
+dist(osmdb_tilePoint_t* p, osmdb_point_t* a, osmdb_point_t* b)
+{
+	// distance from p to the line segment ab
+	double abx = (double) (b->x - a->x);
+	double aby = (double) (b->y - a->y);
+	double apx = (double) (p->x - a->x);
+	double apy = (double) (p->y - a->y);
+	double ab2 = abx*abx + aby*aby;
+	double t   = 0.0;
+	if(ab2 > 0.0)
+	{
+		t = (apx*abx + apy*aby)/ab2;
+		if(t < 0.0)
+		{
+			t = 0.0;
+		}
+		else if(t > 1.0)
+		{
+			t = 1.0;
+		}
+	}
+
+	double dx = apx - t*abx;
+	double dy = apy - t*aby;
+	return sqrt(dx*dx + dy*dy);
+}
+
+static int checkZoom(osmdb_tiler_t* tiler, int zoom)
+{
+	ASSERT(tiler);
+
+	int x = X >> (15 - zoom);
+	int y = Y >> (15 - zoom);
+
+	// project the nds to the tile space
+	int               i;
+	int               wx;
+	int               wy;
+	osmdb_tilePoint_t pts[COUNT];
+	osmdb_ostream_t*  os = osmdb_ostream_new();
+	CHECK(os);
+	CHECK(osmdb_ostream_beginTile(os, zoom, x, y, 1));
+	for(i = 0; i < COUNT; ++i)
+	{
+		osmdb_proj_coord2world(1, &lat[i], &lon[i], &wx, &wy);
+		osmdb_ostream_world2tilePoint(os, wx, wy, &pts[i]);
+	}
+	osmdb_ostream_delete(&os);
+
+	size_t        size = 0;
+	osmdb_tile_t* tile;
+	tile = osmdb_tiler_makeShared(tiler, 0, zoom, x, y, &size);
+	CHECK(tile);
+	CHECK(tile->count_ways == 1);
+
+	osmdb_tileIter_t* iter = osmdb_tileIter_new();
+	CHECK(iter);
+	CHECK(osmdb_tileIter_init(iter, size, tile, 0));
+
+	osmdb_way_t    way;
+	osmdb_point_t* spts = NULL;
+	CHECK(osmdb_tileIter_way(iter, 0, &way, NULL, &spts));
+
+	// the tolerance is 1/2 pixel for zoom 13 and 1/32 pixel
+	// for zoom 15 (see osmdb_tilerState_init) plus the
+	// rounding of the tile pts
+	double tol = 32767.0/256.0/2.0;
+	if(zoom == 15)
+	{
+		tol = 32767.0/256.0/32.0;
+	}
+
+	printf("[TEST] zoom=%i, count=%i, simplified=%i\n",
+	       zoom, COUNT, way.count);
+	CHECK(way.count > 2);
+	CHECK(way.count < COUNT);
+
+	// the endpoints are kept
+	CHECK((spts[0].x == pts[0].x) &&
+	      (spts[0].y == pts[0].y));
+	CHECK((spts[way.count - 1].x == pts[COUNT - 1].x) &&
+	      (spts[way.count - 1].y == pts[COUNT - 1].y));
+
+	// every pt is within the tolerance of the segment of
+	// the simplified way which replaces it
+	int j = 0;
+	for(i = 0; i < COUNT; ++i)
+	{
+		if((j + 1 < way.count) &&
+		   (spts[j + 1].x == pts[i].x) &&
+		   (spts[j + 1].y == pts[i].y))
+		{
+			++j;
+		}
+
+		int k = (j + 1 < way.count) ? j + 1 : j;
+		CHECK(dist(&pts[i], &spts[j], &spts[k]) <= tol + 1.0);
+	}
+	CHECK(j == way.count - 1);
+
+	osmdb_tileIter_delete(&iter);
+
+	return EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv)
+{
+	CHECK(createDb());
+
+	osmdb_tiler_t* tiler;
+	tiler = osmdb_tiler_new(OSMDB_TEST_DB, 1, 1.0f);
+	CHECK(tiler);
+
+	CHECK(checkZoom(tiler, 13) == EXIT_SUCCESS);
+	CHECK(checkZoom(tiler, 15) == EXIT_SUCCESS);
+
+	osmdb_tiler_delete(&tiler);
+
+	return EXIT_SUCCESS;
+}
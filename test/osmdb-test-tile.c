@@ -0,0 +1,361 @@
+/*
+ * Copyright (c) 2021 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LOG_TAG "osmdb"
+#include "libcc/cc_log.h"
+#include "libcc/cc_memory.h"
+#include "libcc/cc_timestamp.h"
+#include "osmdb/tiler/osmdb_ostream.h"
+#include "osmdb/osmdb_proj.h"
+#include "osmdb_test.h"
+
+// protected functions
+void osmdb_nodeInfo_addName(osmdb_nodeInfo_t* self,
+                            const char* name);
+void osmdb_wayInfo_addName(osmdb_wayInfo_t* self,
+                           const char* name);
+
+// tile of the fixture
+#define ZOOM 12
+#define X    850
+#define Y    1552
+
+static const char* NAMES[] =
+{
+	NULL,
+	"Main Street",
+	"Broadway",
+	"Pearl Street Mall",
+};
+
+static int
+addWay(osmdb_ostream_t* os, int i, osmdb_wayRange_t* way_range)
+{
+	ASSERT(os);
+	ASSERT(way_range);
+
+	char buf[sizeof(osmdb_wayInfo_t) + 256];
+	memset((void*) buf, 0, sizeof(buf));
+
+	osmdb_wayInfo_t* way_info = (osmdb_wayInfo_t*) buf;
+	way_info->wid   = 1000 + i;
+	way_info->class = 1 + i%7;
+	way_info->flags = i%4;
+	way_info->layer = i%5 - 2;
+	if(NAMES[i%4])
+	{
+		osmdb_wayInfo_addName(way_info, NAMES[i%4]);
+	}
+
+	if(osmdb_ostream_beginWay(os, way_info, way_range, 0) == 0)
+	{
+		return 0;
+	}
+
+	// zig-zag across the tile to exercise the pt deltas
+	int j;
+	int count = 2 + 7*i%23;
+	for(j = 0; j < count; ++j)
+	{
+		osmdb_tilePoint_t pt =
+		{
+			.x = -16000 + 32000*j/count,
+			.y = (j%2) ? 1000*i%16000 : -1000*i%16000,
+		};
+		if(osmdb_ostream_addWayPoint(os, &pt) == 0)
+		{
+			return 0;
+		}
+	}
+	osmdb_ostream_endWay(os);
+
+	return 1;
+}
+
+static int
+addNode(osmdb_ostream_t* os, int i)
+{
+	ASSERT(os);
+
+	char buf[sizeof(osmdb_nodeInfo_t) + 256];
+	memset((void*) buf, 0, sizeof(buf));
+
+	osmdb_nodeInfo_t* node_info = (osmdb_nodeInfo_t*) buf;
+	node_info->nid   = 500 + i;
+	node_info->class = 1 + i%5;
+	node_info->ele   = 100*i - 500;
+	if(NAMES[i%4])
+	{
+		osmdb_nodeInfo_addName(node_info, NAMES[i%4]);
+	}
+
+	osmdb_nodeCoord_t node_coord =
+	{
+		.nid = node_info->nid,
+		.lat = 40.0 + 0.001*(i%10),
+		.lon = -105.3 + 0.001*(i/10),
+	};
+	osmdb_proj_coord2world(1, &node_coord.lat,
+	                       &node_coord.lon,
+	                       &node_coord.x, &node_coord.y);
+
+	return osmdb_ostream_addNode(os, node_info, &node_coord);
+}
+
+static int
+buildTile(osmdb_ostream_t* os)
+{
+	ASSERT(os);
+
+	osmdb_wayRange_t way_range =
+	{
+		.latT = 40.1,
+		.lonL = -105.3,
+		.latB = 40.0,
+		.lonR = -105.2,
+	};
+
+	osmdb_relRange_t rel_range =
+	{
+		.latT = 40.1,
+		.lonL = -105.3,
+		.latB = 40.0,
+		.lonR = -105.2,
+	};
+
+	osmdb_relInfo_t rel_info =
+	{
+		.rid   = 1,
+		.class = 3,
+		.type  = 2,
+	};
+
+	if(osmdb_ostream_beginTile(os, ZOOM, X, Y, 1234) == 0)
+	{
+		return 0;
+	}
+
+	// enough records for several blocks and the grid
+	int i;
+	int j;
+	for(i = 0; i < 3; ++i)
+	{
+		if(osmdb_ostream_beginRel(os, &rel_info, &rel_range,
+		                          8, "RelName", NULL) == 0)
+		{
+			return 0;
+		}
+
+		for(j = 0; j < 2; ++j)
+		{
+			if(addWay(os, 10*i + j, &way_range) == 0)
+			{
+				return 0;
+			}
+		}
+		osmdb_ostream_endRel(os);
+	}
+
+	for(i = 0; i < 40; ++i)
+	{
+		if(addWay(os, i, &way_range) == 0)
+		{
+			return 0;
+		}
+	}
+
+	for(i = 0; i < 40; ++i)
+	{
+		if(addNode(os, i) == 0)
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+static int
+initIndex(osmdb_tileIter_t* iter, size_t size,
+          const void* data, void* copy,
+          const osmdb_tileIndex_t* index)
+{
+	ASSERT(iter);
+	ASSERT(data);
+	ASSERT(copy);
+	ASSERT(index);
+
+	// replace the index of a copy of the tile
+	memcpy(copy, data, size);
+	memcpy((char*) copy + sizeof(osmdb_tile_t),
+	       (const void*) index, sizeof(osmdb_tileIndex_t));
+
+	return osmdb_tileIter_init(iter, size, copy, 0);
+}
+
+static int
+checkIndex(osmdb_tile_t* enc, size_t size)
+{
+	ASSERT(enc);
+
+	osmdb_tileIter_t* iter = osmdb_tileIter_new();
+	CHECK(iter);
+
+	void* copy = MALLOC(size);
+	CHECK(copy);
+
+	const osmdb_tileIndex_t* orig;
+	orig = (const osmdb_tileIndex_t*)
+	       ((const char*) enc + sizeof(osmdb_tile_t));
+	CHECK(orig->offset_grid > 0);
+
+	osmdb_tileIndex_t index = *orig;
+	CHECK(initIndex(iter, size, enc, copy, &index));
+
+	// the malformed offsets and counts are rejected
+	// rather than read out of bounds
+	index.offset_names = -4096;
+	index.count_names  = 1024;
+	CHECK(initIndex(iter, size, enc, copy, &index) == 0);
+
+	index              = *orig;
+	index.count_names  = INT_MAX;
+	CHECK(initIndex(iter, size, enc, copy, &index) == 0);
+
+	index              = *orig;
+	index.offset_names = INT_MAX - 3;
+	CHECK(initIndex(iter, size, enc, copy, &index) == 0);
+
+	index             = *orig;
+	index.offset_ways = -4;
+	CHECK(initIndex(iter, size, enc, copy, &index) == 0);
+
+	index             = *orig;
+	index.offset_grid = -4;
+	CHECK(initIndex(iter, size, enc, copy, &index) == 0);
+
+	index             = *orig;
+	index.offset_grid = ((int) size - 4) & ~3;
+	CHECK(initIndex(iter, size, enc, copy, &index) == 0);
+
+	index             = *orig;
+	index.offset_grid = INT_MAX - 3;
+	CHECK(initIndex(iter, size, enc, copy, &index) == 0);
+
+	printf("[TEST] malformed index rejected\n");
+
+	FREE(copy);
+	osmdb_tileIter_delete(&iter);
+
+	return EXIT_SUCCESS;
+}
+
+static int
+timeDecode(const void* data, size_t size, int* _ns)
+{
+	ASSERT(data);
+	ASSERT(_ns);
+
+	// osmdb_tile_new takes ownership of the copy where the
+	// V1 layout is validated in place and the encoding is
+	// decoded into a new tile
+	int    n  = 1000;
+	double t0 = cc_timestamp();
+
+	int i;
+	for(i = 0; i < n; ++i)
+	{
+		void* copy = MALLOC(size);
+		CHECK(copy);
+		memcpy(copy, data, size);
+
+		osmdb_tile_t* tile = osmdb_tile_new(size, copy, NULL);
+		CHECK(tile);
+		osmdb_tile_delete(&tile);
+	}
+
+	*_ns = (int) (1000000000.0*(cc_timestamp() - t0)/n);
+
+	return EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv)
+{
+	osmdb_ostream_t* os = osmdb_ostream_new();
+	CHECK(os);
+	os->grid_cells = 16;
+
+	CHECK(buildTile(os));
+
+	// the tile is built in the V1 layout and encoded by
+	// osmdb_ostream_endTile
+	size_t size_v1 = os->offset;
+	void*  data_v1 = MALLOC(size_v1);
+	CHECK(data_v1);
+	memcpy(data_v1, os->data, size_v1);
+	((osmdb_tile_t*) data_v1)->version = OSMDB_TILE_VERSION_V1;
+
+	size_t        size = 0;
+	osmdb_tile_t* enc  = osmdb_ostream_endTile(os, &size);
+	CHECK(enc);
+	CHECK(enc->version == OSMDB_TILE_VERSION);
+	CHECK(size < size_v1);
+	printf("[TEST] v1=%i, encoded=%i\n",
+	       (int) size_v1, (int) size);
+
+	// a truncated tile is rejected
+	osmdb_tile_t* tile = osmdb_tile_new(size/2, enc, NULL);
+	CHECK(tile == NULL);
+
+	CHECK(checkIndex(enc, size) == EXIT_SUCCESS);
+
+	// decode time per tile versus the V1 layout
+	int ns_v1  = 0;
+	int ns_enc = 0;
+	CHECK(timeDecode(data_v1, size_v1, &ns_v1) == EXIT_SUCCESS);
+	CHECK(timeDecode(enc, size, &ns_enc)       == EXIT_SUCCESS);
+	printf("[TEST] decode v1=%ins, encoded=%ins\n",
+	       ns_v1, ns_enc);
+
+	// the decoded tile matches the V1 layout
+	tile = osmdb_tile_new(size, enc, NULL);
+	CHECK(tile);
+	CHECK(tile->count_rels  == 3);
+	CHECK(tile->count_ways  == 40);
+	CHECK(tile->count_nodes == 40);
+	CHECK(memcmp(tile, data_v1, size_v1) == 0);
+	printf("[TEST] round trip rels=%i, ways=%i, nodes=%i\n",
+	       tile->count_rels, tile->count_ways,
+	       tile->count_nodes);
+
+	osmdb_tile_delete(&tile);
+	FREE(data_v1);
+	osmdb_ostream_delete(&os);
+
+	return EXIT_SUCCESS;
+}
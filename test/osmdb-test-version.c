@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2021 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define LOG_TAG "osmdb"
+#include "libcc/cc_log.h"
+#include "libsqlite3/sqlite3.h"
+#include "osmdb_test.h"
+
+static int setVersion(int version)
+{
+	sqlite3* db = NULL;
+	if(sqlite3_open_v2(OSMDB_TEST_DB, &db,
+	                   SQLITE_OPEN_READWRITE, NULL) != SQLITE_OK)
+	{
+		sqlite3_close(db);
+		return 0;
+	}
+
+	char sql[256];
+	snprintf(sql, 256, "PRAGMA user_version = %i;", version);
+	int ret = (sqlite3_exec(db, sql, NULL, NULL,
+	                        NULL) == SQLITE_OK);
+	sqlite3_close(db);
+
+	return ret;
+}
+
+int main(int argc, char** argv)
+{
+	osmdb_index_t* index = osmdb_test_newDb(OSMDB_TEST_DB);
+	CHECK(index);
+	CHECK(osmdb_test_addNode(index, 1, 40.0150, -105.2705));
+	osmdb_index_delete(&index);
+
+	// databases of the current version are accepted
+	index = osmdb_index_new(OSMDB_TEST_DB,
+	                        OSMDB_INDEX_MODE_READONLY,
+	                        1, 1.0f);
+	CHECK(index);
+	osmdb_index_delete(&index);
+
+	// databases of another version are refused
+	CHECK(setVersion(OSMDB_INDEX_VERSION - 1));
+	index = osmdb_index_new(OSMDB_TEST_DB,
+	                        OSMDB_INDEX_MODE_READONLY,
+	                        1, 1.0f);
+	CHECK(index == NULL);
+	index = osmdb_index_new(OSMDB_TEST_DB,
+	                        OSMDB_INDEX_MODE_APPEND,
+	                        1, 1.0f);
+	CHECK(index == NULL);
+
+	// databases created before the version was stored
+	CHECK(setVersion(0));
+	index = osmdb_index_new(OSMDB_TEST_DB,
+	                        OSMDB_INDEX_MODE_READONLY,
+	                        1, 1.0f);
+	CHECK(index == NULL);
+
+	printf("[TEST] version=%i\n", OSMDB_INDEX_VERSION);
+
+	return EXIT_SUCCESS;
+}
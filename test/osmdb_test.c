@@ -0,0 +1,384 @@
+/*
+ * Copyright (c) 2021 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define LOG_TAG "osmdb"
+#include "libcc/cc_log.h"
+#include "libcc/cc_memory.h"
+#include "osmdb/osmdb_proj.h"
+#include "terrain/terrain_util.h"
+#include "osmdb_test.h"
+
+// protected functions
+int osmdb_index_updateChangeset(osmdb_index_t* self,
+                                int64_t changeset);
+int osmdb_index_add(osmdb_index_t* self,
+                    int type, int64_t id,
+                    size_t size, void* data);
+int osmdb_index_addTile(osmdb_index_t* self,
+                        int type, int64_t id,
+                        int class, int64_t ref);
+void osmdb_nodeInfo_addName(osmdb_nodeInfo_t* self,
+                            const char* name);
+
+#define OSMDB_TEST_CHANGESET 1
+#define OSMDB_TEST_NDS_MAX   256
+
+static uint64_t osmdb_test_count_allocs;
+
+/***********************************************************
+* private                                                  *
+***********************************************************/
+
+static int
+osmdb_test_addTiles(osmdb_index_t* index, int type,
+                    int64_t ref, int class,
+                    double latT, double lonL,
+                    double latB, double lonR)
+{
+	ASSERT(index);
+
+	// the types are ordered from zoom 3 to zoom 15 and the
+	// fixture only references the zoom 11-15 tiles
+	int i;
+	int zoom[] = { 15, 13, 11 };
+	int step[] = { 6,  5,  4  };
+	for(i = 0; i < 3; ++i)
+	{
+		float x0;
+		float y0;
+		float x1;
+		float y1;
+		terrain_coord2tile(latT, lonL, zoom[i], &x0, &y0);
+		terrain_coord2tile(latB, lonR, zoom[i], &x1, &y1);
+
+		int64_t r;
+		int64_t c;
+		for(r = (int64_t) y0; r <= (int64_t) y1; ++r)
+		{
+			for(c = (int64_t) x0; c <= (int64_t) x1; ++c)
+			{
+				int64_t id = (r << zoom[i]) + c;
+				if(osmdb_index_addTile(index, type + step[i],
+				                       id, class, ref) == 0)
+				{
+					return 0;
+				}
+			}
+		}
+	}
+
+	return 1;
+}
+
+/***********************************************************
+* public                                                   *
+***********************************************************/
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size)
+{
+	++osmdb_test_count_allocs;
+	return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size)
+{
+	++osmdb_test_count_allocs;
+	return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size)
+{
+	++osmdb_test_count_allocs;
+	return __real_realloc(ptr, size);
+}
+
+uint64_t osmdb_test_allocs(void)
+{
+	return osmdb_test_count_allocs;
+}
+
+osmdb_index_t* osmdb_test_newDb(const char* fname)
+{
+	ASSERT(fname);
+
+	unlink(fname);
+
+	osmdb_index_t* index;
+	index = osmdb_index_new(fname, OSMDB_INDEX_MODE_CREATE,
+	                        1, 1.0f);
+	if(index == NULL)
+	{
+		return NULL;
+	}
+
+	if(osmdb_index_updateChangeset(index,
+	                               OSMDB_TEST_CHANGESET) == 0)
+	{
+		osmdb_index_delete(&index);
+		return NULL;
+	}
+
+	return index;
+}
+
+int osmdb_test_addNode(osmdb_index_t* index, int64_t nid,
+                       double lat, double lon)
+{
+	ASSERT(index);
+
+	osmdb_nodeCoord_t node_coord =
+	{
+		.nid = nid,
+		.lat = lat,
+		.lon = lon,
+	};
+	osmdb_proj_coord2world(1, &node_coord.lat,
+	                       &node_coord.lon,
+	                       &node_coord.x, &node_coord.y);
+
+	return osmdb_index_add(index, OSMDB_TYPE_NODECOORD, nid,
+	                       osmdb_nodeCoord_sizeof(&node_coord),
+	                       (void*) &node_coord);
+}
+
+int osmdb_test_addPoi(osmdb_index_t* index,
+                      int64_t nid, int class,
+                      double lat, double lon,
+                      const char* name)
+{
+	// name may be NULL
+	ASSERT(index);
+
+	char buf[sizeof(osmdb_nodeInfo_t) + 256];
+	memset((void*) buf, 0, sizeof(buf));
+
+	osmdb_nodeInfo_t* node_info = (osmdb_nodeInfo_t*) buf;
+	node_info->nid   = nid;
+	node_info->class = class;
+	if(name)
+	{
+		if(strlen(name) >= 252)
+		{
+			LOGE("invalid name=%s", name);
+			return 0;
+		}
+		osmdb_nodeInfo_addName(node_info, name);
+	}
+
+	if((osmdb_test_addNode(index, nid, lat, lon) == 0) ||
+	   (osmdb_index_add(index, OSMDB_TYPE_NODEINFO, nid,
+	                    osmdb_nodeInfo_sizeof(node_info),
+	                    (void*) node_info) == 0))
+	{
+		return 0;
+	}
+
+	return osmdb_test_addTiles(index,
+	                           OSMDB_TYPE_TILEREF_NODE3,
+	                           nid, class,
+	                           lat, lon, lat, lon);
+}
+
+int osmdb_test_addWay(osmdb_index_t* index,
+                      int64_t wid, int class, int flags,
+                      int count, const int64_t* nds)
+{
+	ASSERT(index);
+	ASSERT(nds);
+
+	if((count < 2) || (count > OSMDB_TEST_NDS_MAX))
+	{
+		LOGE("invalid count=%i", count);
+		return 0;
+	}
+
+	osmdb_wayInfo_t way_info =
+	{
+		.wid   = wid,
+		.class = class,
+		.flags = flags,
+	};
+
+	// compute the range from the node coords
+	int i;
+	osmdb_wayRange_t way_range =
+	{
+		.wid = wid,
+	};
+	for(i = 0; i < count; ++i)
+	{
+		osmdb_handle_t* hnd = NULL;
+		if((osmdb_index_get(index, 0, OSMDB_TYPE_NODECOORD,
+		                    nds[i], &hnd) == 0) ||
+		   (hnd == NULL))
+		{
+			LOGE("invalid nid=%" PRId64, nds[i]);
+			return 0;
+		}
+
+		double lat = hnd->node_coord->lat;
+		double lon = hnd->node_coord->lon;
+		osmdb_index_put(index, &hnd);
+
+		if((i == 0) || (lat > way_range.latT))
+		{
+			way_range.latT = lat;
+		}
+		if((i == 0) || (lon < way_range.lonL))
+		{
+			way_range.lonL = lon;
+		}
+		if((i == 0) || (lat < way_range.latB))
+		{
+			way_range.latB = lat;
+		}
+		if((i == 0) || (lon > way_range.lonR))
+		{
+			way_range.lonR = lon;
+		}
+	}
+
+	char buf[sizeof(osmdb_wayNds_t) +
+	         OSMDB_TEST_NDS_MAX*sizeof(int64_t)];
+	osmdb_wayNds_t* way_nds = (osmdb_wayNds_t*) buf;
+	way_nds->wid   = wid;
+	way_nds->count = count;
+	memcpy((void*) osmdb_wayNds_nds(way_nds),
+	       (const void*) nds, count*sizeof(int64_t));
+
+	if((osmdb_index_add(index, OSMDB_TYPE_WAYINFO, wid,
+	                    osmdb_wayInfo_sizeof(&way_info),
+	                    (void*) &way_info) == 0) ||
+	   (osmdb_index_add(index, OSMDB_TYPE_WAYRANGE, wid,
+	                    osmdb_wayRange_sizeof(&way_range),
+	                    (void*) &way_range) == 0) ||
+	   (osmdb_index_add(index, OSMDB_TYPE_WAYNDS, wid,
+	                    osmdb_wayNds_sizeof(way_nds),
+	                    (void*) way_nds) == 0))
+	{
+		return 0;
+	}
+
+	return osmdb_test_addTiles(index,
+	                           OSMDB_TYPE_TILEREF_WAY3,
+	                           wid, class,
+	                           way_range.latT, way_range.lonL,
+	                           way_range.latB, way_range.lonR);
+}
+
+int osmdb_test_addRel(osmdb_index_t* index,
+                      int64_t rid, int class, int flags,
+                      int count, const int64_t* wids)
+{
+	ASSERT(index);
+	ASSERT(wids);
+
+	if((count < 1) || (count > OSMDB_TEST_NDS_MAX))
+	{
+		LOGE("invalid count=%i", count);
+		return 0;
+	}
+
+	osmdb_relInfo_t rel_info =
+	{
+		.rid   = rid,
+		.class = class,
+		.flags = flags,
+	};
+
+	// compute the range from the member way ranges
+	int i;
+	osmdb_relRange_t rel_range =
+	{
+		.rid = rid,
+	};
+	char buf[sizeof(osmdb_relMembers_t) +
+	         OSMDB_TEST_NDS_MAX*sizeof(osmdb_relData_t)];
+	osmdb_relMembers_t* rel_members = (osmdb_relMembers_t*) buf;
+	osmdb_relData_t*    data = osmdb_relMembers_data(rel_members);
+	rel_members->rid   = rid;
+	rel_members->count = count;
+	for(i = 0; i < count; ++i)
+	{
+		osmdb_handle_t* hnd = NULL;
+		if((osmdb_index_get(index, 0, OSMDB_TYPE_WAYRANGE,
+		                    wids[i], &hnd) == 0) ||
+		   (hnd == NULL))
+		{
+			LOGE("invalid wid=%" PRId64, wids[i]);
+			return 0;
+		}
+
+		osmdb_wayRange_t* r = hnd->way_range;
+		if((i == 0) || (r->latT > rel_range.latT))
+		{
+			rel_range.latT = r->latT;
+		}
+		if((i == 0) || (r->lonL < rel_range.lonL))
+		{
+			rel_range.lonL = r->lonL;
+		}
+		if((i == 0) || (r->latB < rel_range.latB))
+		{
+			rel_range.latB = r->latB;
+		}
+		if((i == 0) || (r->lonR > rel_range.lonR))
+		{
+			rel_range.lonR = r->lonR;
+		}
+		osmdb_index_put(index, &hnd);
+
+		data[i].wid   = wids[i];
+		data[i].inner = 0;
+	}
+
+	if((osmdb_index_add(index, OSMDB_TYPE_RELINFO, rid,
+	                    osmdb_relInfo_sizeof(&rel_info),
+	                    (void*) &rel_info) == 0) ||
+	   (osmdb_index_add(index, OSMDB_TYPE_RELRANGE, rid,
+	                    osmdb_relRange_sizeof(&rel_range),
+	                    (void*) &rel_range) == 0) ||
+	   (osmdb_index_add(index, OSMDB_TYPE_RELMEMBERS, rid,
+	                    osmdb_relMembers_sizeof(rel_members),
+	                    (void*) rel_members) == 0))
+	{
+		return 0;
+	}
+
+	return osmdb_test_addTiles(index,
+	                           OSMDB_TYPE_TILEREF_REL3,
+	                           rid, class,
+	                           rel_range.latT, rel_range.lonL,
+	                           rel_range.latB, rel_range.lonR);
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2021 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+
+#ifndef osmdb_test_H
+#define osmdb_test_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "libcc/cc_log.h"
+#include "osmdb/index/osmdb_index.h"
+
+#define OSMDB_TEST_DB "osmdb-test.sqlite3"
+
+// check a condition and fail the test otherwise
+#define CHECK(cond) \
+	do \
+	{ \
+		if((cond) == 0) \
+		{ \
+			LOGE("CHECK failed: %s", #cond); \
+			return EXIT_FAILURE; \
+		} \
+	} while(0)
+
+// number of malloc/calloc/realloc calls since the start
+// of the test (see -Wl,--wrap in the Makefile)
+uint64_t osmdb_test_allocs(void);
+
+// fixture database which is flushed by osmdb_index_delete
+// nodes must be added before the ways which reference them
+// and ways before the rels which reference them
+// and pois/ways/rels are referenced by the tiles of zooms
+// 11-15 which they overlap
+// the way flags are the way_info flags (e.g. the area flag
+// which the importer sets for closed polygons)
+osmdb_index_t* osmdb_test_newDb(const char* fname);
+int            osmdb_test_addNode(osmdb_index_t* index,
+                                  int64_t nid,
+                                  double lat, double lon);
+int            osmdb_test_addPoi(osmdb_index_t* index,
+                                 int64_t nid, int class,
+                                 double lat, double lon,
+                                 const char* name);
+int            osmdb_test_addWay(osmdb_index_t* index,
+                                 int64_t wid, int class,
+                                 int flags, int count,
+                                 const int64_t* nds);
+int            osmdb_test_addRel(osmdb_index_t* index,
+                                 int64_t rid, int class,
+                                 int flags, int count,
+                                 const int64_t* wids);
+
+#endif
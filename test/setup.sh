@@ -0,0 +1,4 @@
+ln -s ../../libcc
+ln -s ../../libsqlite3
+ln -s ../../osmdb
+ln -s ../../terrain
@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2021 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+
+#define LOG_TAG "osmdb"
+#include "libcc/cc_log.h"
+#include "libcc/cc_memory.h"
+#include "osmdb_arena.h"
+
+// allocations are aligned to support int64_t/double/pointers
+#define OSMDB_ARENA_ALIGN 8
+
+/***********************************************************
+* private                                                  *
+***********************************************************/
+
+static size_t osmdb_arena_align(size_t size)
+{
+	return (size + OSMDB_ARENA_ALIGN - 1) &
+	       ~((size_t) (OSMDB_ARENA_ALIGN - 1));
+}
+
+static void*
+osmdb_arenaBlock_data(osmdb_arenaBlock_t* self)
+{
+	ASSERT(self);
+
+	size_t offset = osmdb_arena_align(sizeof(osmdb_arenaBlock_t));
+	return (void*) (((char*) self) + offset);
+}
+
+/***********************************************************
+* public                                                   *
+***********************************************************/
+
+osmdb_arena_t* osmdb_arena_new(size_t block_size,
+                               size_t max_size)
+{
+	osmdb_arena_t* self;
+	self = (osmdb_arena_t*)
+	       CALLOC(1, sizeof(osmdb_arena_t));
+	if(self == NULL)
+	{
+		LOGE("CALLOC failed");
+		return NULL;
+	}
+
+	self->block_size = osmdb_arena_align(block_size);
+	self->max_size   = max_size;
+
+	return self;
+}
+
+void osmdb_arena_delete(osmdb_arena_t** _self)
+{
+	ASSERT(_self);
+
+	osmdb_arena_t* self = *_self;
+	if(self)
+	{
+		osmdb_arenaBlock_t* block = self->head;
+		while(block)
+		{
+			osmdb_arenaBlock_t* next = block->next;
+			FREE(block);
+			block = next;
+		}
+		FREE(self);
+		*_self = NULL;
+	}
+}
+
+void* osmdb_arena_alloc(osmdb_arena_t* self, size_t size)
+{
+	ASSERT(self);
+
+	size = osmdb_arena_align(size);
+
+	// find the first block with enough space starting from
+	// the current block but only advance the current block
+	// for regular sized allocations
+	osmdb_arenaBlock_t* block = self->cur;
+	while(block)
+	{
+		if(block->offset + size <= block->size)
+		{
+			if(size <= self->block_size)
+			{
+				self->cur = block;
+			}
+
+			void* data = osmdb_arenaBlock_data(block);
+			data = (void*) (((char*) data) + block->offset);
+			block->offset += size;
+			return data;
+		}
+
+		block = block->next;
+	}
+
+	// oversized allocations receive a dedicated block
+	size_t block_size = self->block_size;
+	if(size > block_size)
+	{
+		block_size = size;
+	}
+
+	size_t header = osmdb_arena_align(sizeof(osmdb_arenaBlock_t));
+	block = (osmdb_arenaBlock_t*) MALLOC(header + block_size);
+	if(block == NULL)
+	{
+		LOGE("MALLOC failed");
+		return NULL;
+	}
+	block->next   = NULL;
+	block->size   = block_size;
+	block->offset = size;
+
+	// append block
+	if(self->tail)
+	{
+		self->tail->next = block;
+	}
+	else
+	{
+		self->head = block;
+	}
+	self->tail = block;
+
+	if((self->cur == NULL) || (size <= self->block_size))
+	{
+		self->cur = block;
+	}
+
+	return osmdb_arenaBlock_data(block);
+}
+
+void osmdb_arena_reset(osmdb_arena_t* self)
+{
+	ASSERT(self);
+
+	// rewind the regular blocks up to max_size and free
+	// the remaining blocks
+	size_t              size  = 0;
+	osmdb_arenaBlock_t* prev  = NULL;
+	osmdb_arenaBlock_t* block = self->head;
+	while(block)
+	{
+		osmdb_arenaBlock_t* next = block->next;
+		if((block->size == self->block_size) &&
+		   (size + block->size <= self->max_size))
+		{
+			size         += block->size;
+			block->offset = 0;
+			prev          = block;
+		}
+		else
+		{
+			if(prev)
+			{
+				prev->next = next;
+			}
+			else
+			{
+				self->head = next;
+			}
+			FREE(block);
+		}
+		block = next;
+	}
+	self->tail = prev;
+	self->cur  = self->head;
+}
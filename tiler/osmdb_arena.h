@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2021 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef osmdb_arena_H
+#define osmdb_arena_H
+
+#include <stddef.h>
+
+typedef struct osmdb_arenaBlock_s
+{
+	struct osmdb_arenaBlock_s* next;
+
+	size_t size;
+	size_t offset;
+} osmdb_arenaBlock_t;
+
+// blocks are retained by reset up to max_size bytes so
+// that steady state allocations do not require malloc
+// while the blocks of a rare large build are freed
+// oversized blocks are always freed by reset
+typedef struct
+{
+	size_t block_size;
+	size_t max_size;
+
+	osmdb_arenaBlock_t* head;
+	osmdb_arenaBlock_t* tail;
+	osmdb_arenaBlock_t* cur;
+} osmdb_arena_t;
+
+osmdb_arena_t* osmdb_arena_new(size_t block_size,
+                               size_t max_size);
+void           osmdb_arena_delete(osmdb_arena_t** _self);
+void*          osmdb_arena_alloc(osmdb_arena_t* self,
+                                 size_t size);
+void           osmdb_arena_reset(osmdb_arena_t* self);
+
+#endif
@@ -0,0 +1,415 @@
+/*
+ * Copyright (c) 2021 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+
+#define LOG_TAG "osmdb"
+#include "libcc/cc_log.h"
+#include "osmdb_clip.h"
+
+// outcodes for Cohen-Sutherland
+#define OSMDB_CLIP_TOP    1
+#define OSMDB_CLIP_LEFT   2
+#define OSMDB_CLIP_BOTTOM 4
+#define OSMDB_CLIP_RIGHT  8
+
+/***********************************************************
+* private                                                  *
+***********************************************************/
+
+static int
+osmdb_clip_code(osmdb_clipRect_t* rect,
+                osmdb_tilePoint_t* pt)
+{
+	ASSERT(rect);
+	ASSERT(pt);
+
+	int code = 0;
+	if(pt->y > rect->t)
+	{
+		code |= OSMDB_CLIP_TOP;
+	}
+	else if(pt->y < rect->b)
+	{
+		code |= OSMDB_CLIP_BOTTOM;
+	}
+
+	if(pt->x < rect->l)
+	{
+		code |= OSMDB_CLIP_LEFT;
+	}
+	else if(pt->x > rect->r)
+	{
+		code |= OSMDB_CLIP_RIGHT;
+	}
+
+	return code;
+}
+
+static int
+osmdb_clip_bounds(osmdb_clipRect_t* rect,
+                  int count, osmdb_tilePoint_t* pts)
+{
+	ASSERT(rect);
+	ASSERT(pts);
+
+	// returns the outcode shared by all pts which is
+	// non-zero if the pts are outside the rect or
+	// -1 if all pts are inside the rect
+	int i;
+	int code_and = OSMDB_CLIP_TOP | OSMDB_CLIP_LEFT |
+	               OSMDB_CLIP_BOTTOM | OSMDB_CLIP_RIGHT;
+	int code_or  = 0;
+	for(i = 0; i < count; ++i)
+	{
+		int code = osmdb_clip_code(rect, &pts[i]);
+		code_and &= code;
+		code_or  |= code;
+	}
+
+	if(code_or == 0)
+	{
+		return -1;
+	}
+	return code_and;
+}
+
+static void
+osmdb_clip_intersect(osmdb_tilePoint_t* a,
+                     osmdb_tilePoint_t* b,
+                     int code, int edge,
+                     osmdb_tilePoint_t* p)
+{
+	ASSERT(a);
+	ASSERT(b);
+	ASSERT(p);
+
+	// intersect ab with the horizontal (TOP/BOTTOM) or
+	// vertical (LEFT/RIGHT) edge using 64-bit math since
+	// pts may extend far outside of the tile
+	int64_t dx = (int64_t) b->x - (int64_t) a->x;
+	int64_t dy = (int64_t) b->y - (int64_t) a->y;
+	if(code & (OSMDB_CLIP_TOP | OSMDB_CLIP_BOTTOM))
+	{
+		p->x = (int) (a->x + dx*((int64_t) edge - a->y)/dy);
+		p->y = edge;
+	}
+	else
+	{
+		p->x = edge;
+		p->y = (int) (a->y + dy*((int64_t) edge - a->x)/dx);
+	}
+}
+
+static int
+osmdb_clip_edge(osmdb_clipRect_t* rect, int code)
+{
+	ASSERT(rect);
+
+	if(code & OSMDB_CLIP_TOP)
+	{
+		return rect->t;
+	}
+	else if(code & OSMDB_CLIP_LEFT)
+	{
+		return rect->l;
+	}
+	else if(code & OSMDB_CLIP_BOTTOM)
+	{
+		return rect->b;
+	}
+	return rect->r;
+}
+
+static int
+osmdb_clip_segment(osmdb_clipRect_t* rect,
+                   osmdb_tilePoint_t* a,
+                   osmdb_tilePoint_t* b)
+{
+	ASSERT(rect);
+	ASSERT(a);
+	ASSERT(b);
+
+	int code_a = osmdb_clip_code(rect, a);
+	int code_b = osmdb_clip_code(rect, b);
+	while(1)
+	{
+		if((code_a | code_b) == 0)
+		{
+			return 1;
+		}
+		else if(code_a & code_b)
+		{
+			return 0;
+		}
+
+		// move an outside point to the first edge it
+		// crosses where each step resolves one edge
+		osmdb_tilePoint_t p;
+		if(code_a)
+		{
+			int code = code_a & (~(code_a - 1));
+			osmdb_clip_intersect(a, b, code,
+			                     osmdb_clip_edge(rect, code),
+			                     &p);
+			*a     = p;
+			code_a = osmdb_clip_code(rect, a);
+		}
+		else
+		{
+			int code = code_b & (~(code_b - 1));
+			osmdb_clip_intersect(a, b, code,
+			                     osmdb_clip_edge(rect, code),
+			                     &p);
+			*b     = p;
+			code_b = osmdb_clip_code(rect, b);
+		}
+	}
+}
+
+static void
+osmdb_clip_emit(osmdb_tilePoint_t* pts, int* _count,
+                osmdb_tilePoint_t* pt)
+{
+	ASSERT(pts);
+	ASSERT(_count);
+	ASSERT(pt);
+
+	// skip duplicate pts
+	int count = *_count;
+	if((count > 0) &&
+	   (pts[count - 1].x == pt->x) &&
+	   (pts[count - 1].y == pt->y))
+	{
+		return;
+	}
+
+	pts[count] = *pt;
+	*_count    = count + 1;
+}
+
+/***********************************************************
+* public                                                   *
+***********************************************************/
+
+int osmdb_clip_ring(osmdb_clipRect_t* rect,
+                    osmdb_arena_t* arena,
+                    int count, osmdb_tilePoint_t* pts,
+                    int* _count, osmdb_tilePoint_t** _pts)
+{
+	ASSERT(rect);
+	ASSERT(arena);
+	ASSERT(pts);
+	ASSERT(_count);
+	ASSERT(_pts);
+
+	// check for trivial cases
+	int code = osmdb_clip_bounds(rect, count, pts);
+	if((count < 2) || (code == -1))
+	{
+		*_count = count;
+		*_pts   = pts;
+		return 1;
+	}
+	else if(code)
+	{
+		*_count = 0;
+		*_pts   = pts;
+		return 1;
+	}
+
+	// clip the open ring against each edge in turn where
+	// each pass at most doubles the number of pts
+	int edges[] =
+	{
+		OSMDB_CLIP_TOP,
+		OSMDB_CLIP_LEFT,
+		OSMDB_CLIP_BOTTOM,
+		OSMDB_CLIP_RIGHT,
+	};
+
+	int                e;
+	int                n   = count - 1;
+	osmdb_tilePoint_t* in  = pts;
+	osmdb_tilePoint_t* out = pts;
+	for(e = 0; e < 4; ++e)
+	{
+		out = (osmdb_tilePoint_t*)
+		      osmdb_arena_alloc(arena,
+		                        (2*n + 1)*sizeof(osmdb_tilePoint_t));
+		if(out == NULL)
+		{
+			return 0;
+		}
+
+		int i;
+		int m    = 0;
+		int edge = osmdb_clip_edge(rect, edges[e]);
+		osmdb_tilePoint_t* prev = &in[n - 1];
+		int prev_in = (osmdb_clip_code(rect, prev) & edges[e]) == 0;
+		for(i = 0; i < n; ++i)
+		{
+			osmdb_tilePoint_t  p;
+			osmdb_tilePoint_t* cur = &in[i];
+			int cur_in = (osmdb_clip_code(rect, cur) & edges[e]) == 0;
+			if(cur_in)
+			{
+				if(prev_in == 0)
+				{
+					osmdb_clip_intersect(prev, cur, edges[e],
+					                     edge, &p);
+					osmdb_clip_emit(out, &m, &p);
+				}
+				osmdb_clip_emit(out, &m, cur);
+			}
+			else if(prev_in)
+			{
+				osmdb_clip_intersect(prev, cur, edges[e],
+				                     edge, &p);
+				osmdb_clip_emit(out, &m, &p);
+			}
+
+			prev    = cur;
+			prev_in = cur_in;
+		}
+
+		// remove the duplicate closing pt
+		if((m > 1) &&
+		   (out[0].x == out[m - 1].x) &&
+		   (out[0].y == out[m - 1].y))
+		{
+			--m;
+		}
+
+		in = out;
+		n  = m;
+		if(n < 3)
+		{
+			*_count = 0;
+			*_pts   = pts;
+			return 1;
+		}
+	}
+
+	// close the ring
+	out[n]  = out[0];
+	*_count = n + 1;
+	*_pts   = out;
+
+	return 1;
+}
+
+int osmdb_clip_line(osmdb_clipRect_t* rect,
+                    osmdb_arena_t* arena,
+                    int count, osmdb_tilePoint_t* pts,
+                    int* _count, osmdb_tilePoint_t** _pts,
+                    int* _nparts, int** _parts)
+{
+	ASSERT(rect);
+	ASSERT(arena);
+	ASSERT(pts);
+	ASSERT(_count);
+	ASSERT(_pts);
+	ASSERT(_nparts);
+	ASSERT(_parts);
+
+	int* parts;
+	parts = (int*) osmdb_arena_alloc(arena, count*sizeof(int));
+	if(parts == NULL)
+	{
+		return 0;
+	}
+
+	// check for trivial cases
+	int code = osmdb_clip_bounds(rect, count, pts);
+	if((count < 2) || (code == -1))
+	{
+		parts[0] = count;
+		*_count  = count;
+		*_pts    = pts;
+		*_nparts = 1;
+		*_parts  = parts;
+		return 1;
+	}
+	else if(code)
+	{
+		*_count  = 0;
+		*_pts    = pts;
+		*_nparts = 0;
+		*_parts  = parts;
+		return 1;
+	}
+
+	// each segment adds at most two pts
+	osmdb_tilePoint_t* out;
+	out = (osmdb_tilePoint_t*)
+	      osmdb_arena_alloc(arena,
+	                        2*count*sizeof(osmdb_tilePoint_t));
+	if(out == NULL)
+	{
+		return 0;
+	}
+
+	// open indicates that the last pt of the current part
+	// is the unclipped start of the next segment
+	int i;
+	int m      = 0;
+	int nparts = 0;
+	int open   = 0;
+	for(i = 1; i < count; ++i)
+	{
+		osmdb_tilePoint_t a = pts[i - 1];
+		osmdb_tilePoint_t b = pts[i];
+		if(osmdb_clip_segment(rect, &a, &b) == 0)
+		{
+			open = 0;
+			continue;
+		}
+
+		if(open == 0)
+		{
+			// skip segments which only touch the rect
+			if((a.x == b.x) && (a.y == b.y))
+			{
+				continue;
+			}
+
+			// begin a new part
+			parts[nparts++] = 1;
+			out[m++]        = a;
+		}
+
+		int n = m;
+		osmdb_clip_emit(out, &m, &b);
+		parts[nparts - 1] += m - n;
+
+		open = (b.x == pts[i].x) && (b.y == pts[i].y);
+	}
+
+	*_count  = m;
+	*_pts    = out;
+	*_nparts = nparts;
+	*_parts  = parts;
+
+	return 1;
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2021 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef osmdb_clip_H
+#define osmdb_clip_H
+
+#include "osmdb_arena.h"
+#include "osmdb_ostream.h"
+
+// clipping rectangle in tile space
+// note that y is up such that t > b
+typedef struct
+{
+	int t;
+	int l;
+	int b;
+	int r;
+} osmdb_clipRect_t;
+
+// clip a closed ring (pts[0] == pts[count - 1]) with
+// Sutherland-Hodgman such that the output is a closed
+// ring or empty when the ring is outside the rect
+int osmdb_clip_ring(osmdb_clipRect_t* rect,
+                    osmdb_arena_t* arena,
+                    int count, osmdb_tilePoint_t* pts,
+                    int* _count, osmdb_tilePoint_t** _pts);
+
+// clip a polyline with Cohen-Sutherland such that the
+// output is split into parts where the polyline leaves
+// the rect and parts[i] is the number of pts in part i
+int osmdb_clip_line(osmdb_clipRect_t* rect,
+                    osmdb_arena_t* arena,
+                    int count, osmdb_tilePoint_t* pts,
+                    int* _count, osmdb_tilePoint_t** _pts,
+                    int* _nparts, int** _parts);
+
+#endif
@@ -0,0 +1,270 @@
+/*
+ * Copyright (c) 2021 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#define LOG_TAG "osmdb"
+#include "libcc/cc_log.h"
+#include "libcc/cc_memory.h"
+#include "osmdb_geomCache.h"
+
+/***********************************************************
+* private                                                  *
+***********************************************************/
+
+static void
+osmdb_geomCache_remove(osmdb_geomCache_t* self,
+                       cc_listIter_t** _iter)
+{
+	ASSERT(self);
+	ASSERT(_iter);
+
+	osmdb_geomCacheEntry_t* entry;
+	entry = (osmdb_geomCacheEntry_t*) cc_list_peekIter(*_iter);
+
+	cc_mapIter_t* miter;
+	miter = cc_map_findp(self->map,
+	                     sizeof(osmdb_geomCacheKey_t),
+	                     &entry->key);
+	cc_map_remove(self->map, &miter);
+	cc_list_remove(self->list, _iter);
+
+	self->size -= sizeof(osmdb_geomCacheEntry_t) + entry->size;
+	FREE(entry);
+}
+
+static void osmdb_geomCache_trim(osmdb_geomCache_t* self)
+{
+	ASSERT(self);
+
+	cc_listIter_t* iter = cc_list_head(self->list);
+	while(iter && (self->size > self->max_size))
+	{
+		osmdb_geomCache_remove(self, &iter);
+		++self->count_evict;
+	}
+}
+
+/***********************************************************
+* public                                                   *
+***********************************************************/
+
+osmdb_geomCache_t* osmdb_geomCache_new(size_t max_size)
+{
+	osmdb_geomCache_t* self;
+	self = (osmdb_geomCache_t*)
+	       CALLOC(1, sizeof(osmdb_geomCache_t));
+	if(self == NULL)
+	{
+		LOGE("CALLOC failed");
+		return NULL;
+	}
+
+	self->max_size = max_size;
+
+	if(pthread_mutex_init(&self->mutex, NULL) != 0)
+	{
+		LOGE("pthread_mutex_init failed");
+		goto fail_mutex;
+	}
+
+	self->map = cc_map_new();
+	if(self->map == NULL)
+	{
+		goto fail_map;
+	}
+
+	self->list = cc_list_new();
+	if(self->list == NULL)
+	{
+		goto fail_list;
+	}
+
+	// success
+	return self;
+
+	// failure
+	fail_list:
+		cc_map_delete(&self->map);
+	fail_map:
+		pthread_mutex_destroy(&self->mutex);
+	fail_mutex:
+		FREE(self);
+	return NULL;
+}
+
+void osmdb_geomCache_delete(osmdb_geomCache_t** _self)
+{
+	ASSERT(_self);
+
+	osmdb_geomCache_t* self = *_self;
+	if(self)
+	{
+		cc_listIter_t* iter = cc_list_head(self->list);
+		while(iter)
+		{
+			osmdb_geomCache_remove(self, &iter);
+		}
+
+		cc_list_delete(&self->list);
+		cc_map_delete(&self->map);
+		pthread_mutex_destroy(&self->mutex);
+		FREE(self);
+		*_self = NULL;
+	}
+}
+
+void* osmdb_geomCache_get(osmdb_geomCache_t* self,
+                          int type, int zoom, int64_t id,
+                          osmdb_arena_t* arena,
+                          size_t* _size)
+{
+	ASSERT(self);
+	ASSERT((type >= 0) && (type < OSMDB_GEOMCACHE_TYPE_COUNT));
+	ASSERT(arena);
+	ASSERT(_size);
+
+	osmdb_geomCacheKey_t key =
+	{
+		.id   = id,
+		.type = type,
+		.zoom = zoom,
+	};
+
+	pthread_mutex_lock(&self->mutex);
+
+	cc_mapIter_t* miter;
+	miter = cc_map_findp(self->map,
+	                     sizeof(osmdb_geomCacheKey_t), &key);
+	if(miter == NULL)
+	{
+		++self->count_miss[type];
+		pthread_mutex_unlock(&self->mutex);
+		return NULL;
+	}
+
+	cc_listIter_t*          iter;
+	osmdb_geomCacheEntry_t* entry;
+	iter  = (cc_listIter_t*) cc_map_val(miter);
+	entry = (osmdb_geomCacheEntry_t*) cc_list_peekIter(iter);
+
+	// return a copy in the arena of the tiler thread since
+	// the entry may be evicted once the mutex is unlocked
+	// and the geometry is modified in place by the tiler
+	void* data = osmdb_arena_alloc(arena, entry->size);
+	if(data == NULL)
+	{
+		pthread_mutex_unlock(&self->mutex);
+		return NULL;
+	}
+	memcpy(data, (const void*) &entry[1], entry->size);
+	*_size = entry->size;
+
+	// update LRU cache
+	cc_list_moven(self->list, iter, NULL);
+	++self->count_hit[type];
+
+	pthread_mutex_unlock(&self->mutex);
+
+	return data;
+}
+
+int osmdb_geomCache_put(osmdb_geomCache_t* self,
+                        int type, int zoom, int64_t id,
+                        size_t size, const void* data)
+{
+	ASSERT(self);
+	ASSERT((type >= 0) && (type < OSMDB_GEOMCACHE_TYPE_COUNT));
+	ASSERT(data);
+
+	// geometry larger than the cache is not stored
+	size_t entry_size = sizeof(osmdb_geomCacheEntry_t) + size;
+	if(entry_size > self->max_size)
+	{
+		return 1;
+	}
+
+	osmdb_geomCacheKey_t key =
+	{
+		.id   = id,
+		.type = type,
+		.zoom = zoom,
+	};
+
+	osmdb_geomCacheEntry_t* entry;
+	entry = (osmdb_geomCacheEntry_t*) MALLOC(entry_size);
+	if(entry == NULL)
+	{
+		LOGE("MALLOC failed");
+		return 0;
+	}
+	entry->key  = key;
+	entry->size = size;
+	memcpy((void*) &entry[1], data, size);
+
+	pthread_mutex_lock(&self->mutex);
+
+	// replace the existing entry which may have been put
+	// by another thread
+	cc_mapIter_t*  miter;
+	cc_listIter_t* iter;
+	miter = cc_map_findp(self->map,
+	                     sizeof(osmdb_geomCacheKey_t), &key);
+	if(miter)
+	{
+		iter = (cc_listIter_t*) cc_map_val(miter);
+		osmdb_geomCache_remove(self, &iter);
+	}
+
+	iter = cc_list_append(self->list, NULL,
+	                      (const void*) entry);
+	if(iter == NULL)
+	{
+		goto fail_append;
+	}
+
+	if(cc_map_addp(self->map, (const void*) iter,
+	               sizeof(osmdb_geomCacheKey_t), &key) == NULL)
+	{
+		goto fail_add;
+	}
+
+	self->size += entry_size;
+	osmdb_geomCache_trim(self);
+
+	pthread_mutex_unlock(&self->mutex);
+
+	// success
+	return 1;
+
+	// failure
+	fail_add:
+		cc_list_remove(self->list, &iter);
+	fail_append:
+	{
+		pthread_mutex_unlock(&self->mutex);
+		FREE(entry);
+	}
+	return 0;
+}
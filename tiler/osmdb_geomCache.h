@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2021 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef osmdb_geomCache_H
+#define osmdb_geomCache_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "libcc/cc_list.h"
+#include "libcc/cc_map.h"
+#include "osmdb_arena.h"
+
+#define OSMDB_GEOMCACHE_TYPE_WAY   0
+#define OSMDB_GEOMCACHE_TYPE_REL   1
+#define OSMDB_GEOMCACHE_TYPE_COUNT 2
+
+// id is the wid/cid for ways and the rid for rels
+typedef struct
+{
+	int64_t id;
+	int     type;
+	int     zoom;
+} osmdb_geomCacheKey_t;
+
+// the packed geometry follows the entry
+typedef struct
+{
+	osmdb_geomCacheKey_t key;
+	size_t               size;
+	// unsigned char data[];
+} osmdb_geomCacheEntry_t;
+
+// byte bounded LRU cache of packed way/rel geometry (see
+// osmdb_waySegment_pack) which is shared by the tiler
+// threads such that the geometry of long ways and large
+// rels is assembled once rather than once per tile
+// the map val is the list iter and the list head is the
+// least recently used entry
+typedef struct
+{
+	size_t max_size;
+	size_t size;
+
+	pthread_mutex_t mutex;
+	cc_map_t*       map;
+	cc_list_t*      list;
+
+	// stats
+	uint64_t count_hit[OSMDB_GEOMCACHE_TYPE_COUNT];
+	uint64_t count_miss[OSMDB_GEOMCACHE_TYPE_COUNT];
+	uint64_t count_evict;
+} osmdb_geomCache_t;
+
+osmdb_geomCache_t* osmdb_geomCache_new(size_t max_size);
+void               osmdb_geomCache_delete(osmdb_geomCache_t** _self);
+void*              osmdb_geomCache_get(osmdb_geomCache_t* self,
+                                       int type, int zoom,
+                                       int64_t id,
+                                       osmdb_arena_t* arena,
+                                       size_t* _size);
+int                osmdb_geomCache_put(osmdb_geomCache_t* self,
+                                       int type, int zoom,
+                                       int64_t id, size_t size,
+                                       const void* data);
+
+#endif
@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) 2021 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#define LOG_TAG "osmdb"
+#include "libcc/cc_log.h"
+#include "libcc/cc_memory.h"
+#include "osmdb_idmap.h"
+
+#define OSMDB_IDMAP_MIN_SLOTS 1024
+
+/***********************************************************
+* private                                                  *
+***********************************************************/
+
+static uint32_t osmdb_idmap_hash(int64_t id)
+{
+	// splitmix64 finalizer
+	uint64_t h = (uint64_t) id;
+	h ^= h >> 30;
+	h *= 0xBF58476D1CE4E5B9ULL;
+	h ^= h >> 27;
+	h *= 0x94D049BB133111EBULL;
+	h ^= h >> 31;
+	return (uint32_t) h;
+}
+
+static osmdb_idmapSlot_t*
+osmdb_idmap_slot(osmdb_idmap_t* self, int64_t id)
+{
+	ASSERT(self);
+
+	// find the slot for id or the empty slot where id
+	// should be inserted
+	uint32_t i = osmdb_idmap_hash(id) & self->mask;
+	while(1)
+	{
+		osmdb_idmapSlot_t* slot = &self->slots[i];
+		if((slot->stamp != self->stamp) ||
+		   (self->entries[slot->idx].id == id))
+		{
+			return slot;
+		}
+
+		i = (i + 1) & self->mask;
+	}
+}
+
+static int
+osmdb_idmap_resizeSlots(osmdb_idmap_t* self,
+                        uint32_t count)
+{
+	ASSERT(self);
+
+	osmdb_idmapSlot_t* slots;
+	slots = (osmdb_idmapSlot_t*)
+	        CALLOC(count, sizeof(osmdb_idmapSlot_t));
+	if(slots == NULL)
+	{
+		LOGE("CALLOC failed");
+		return 0;
+	}
+
+	FREE(self->slots);
+	self->slots = slots;
+	self->mask  = count - 1;
+	self->stamp = 1;
+
+	// rehash entries
+	int i;
+	for(i = 0; i < self->count; ++i)
+	{
+		osmdb_idmapEntry_t* entry = &self->entries[i];
+		if(entry->val == NULL)
+		{
+			continue;
+		}
+
+		osmdb_idmapSlot_t* slot;
+		slot = osmdb_idmap_slot(self, entry->id);
+		slot->stamp = self->stamp;
+		slot->idx   = i;
+	}
+
+	return 1;
+}
+
+/***********************************************************
+* public                                                   *
+***********************************************************/
+
+osmdb_idmap_t* osmdb_idmap_new(void)
+{
+	osmdb_idmap_t* self;
+	self = (osmdb_idmap_t*)
+	       CALLOC(1, sizeof(osmdb_idmap_t));
+	if(self == NULL)
+	{
+		LOGE("CALLOC failed");
+		return NULL;
+	}
+
+	if(osmdb_idmap_resizeSlots(self,
+	                           OSMDB_IDMAP_MIN_SLOTS) == 0)
+	{
+		goto fail_slots;
+	}
+
+	// success
+	return self;
+
+	// failure
+	fail_slots:
+		FREE(self);
+	return NULL;
+}
+
+void osmdb_idmap_delete(osmdb_idmap_t** _self)
+{
+	ASSERT(_self);
+
+	osmdb_idmap_t* self = *_self;
+	if(self)
+	{
+		FREE(self->slots);
+		FREE(self->entries);
+		FREE(self);
+		*_self = NULL;
+	}
+}
+
+void osmdb_idmap_clear(osmdb_idmap_t* self)
+{
+	ASSERT(self);
+
+	self->count = 0;
+
+	// invalidate slots
+	++self->stamp;
+	if(self->stamp == 0)
+	{
+		memset((void*) self->slots, 0,
+		       (self->mask + 1)*sizeof(osmdb_idmapSlot_t));
+		self->stamp = 1;
+	}
+}
+
+int osmdb_idmap_add(osmdb_idmap_t* self,
+                    int64_t id, void* val)
+{
+	ASSERT(self);
+	ASSERT(val);
+
+	osmdb_idmapSlot_t* slot = osmdb_idmap_slot(self, id);
+	if(slot->stamp == self->stamp)
+	{
+		// replace existing or removed entry
+		self->entries[slot->idx].val = val;
+		return 1;
+	}
+
+	// grow entries
+	if(self->count == self->max_count)
+	{
+		int max_count = 2*self->max_count;
+		if(max_count == 0)
+		{
+			max_count = OSMDB_IDMAP_MIN_SLOTS/2;
+		}
+
+		osmdb_idmapEntry_t* entries;
+		entries = (osmdb_idmapEntry_t*)
+		          REALLOC(self->entries,
+		                  max_count*sizeof(osmdb_idmapEntry_t));
+		if(entries == NULL)
+		{
+			LOGE("REALLOC failed");
+			return 0;
+		}
+
+		self->entries   = entries;
+		self->max_count = max_count;
+	}
+
+	// maintain a load factor of at most 1/2
+	uint32_t count_slots = self->mask + 1;
+	if(2*((uint32_t) self->count + 1) > count_slots)
+	{
+		if(osmdb_idmap_resizeSlots(self, 2*count_slots) == 0)
+		{
+			return 0;
+		}
+		slot = osmdb_idmap_slot(self, id);
+	}
+
+	osmdb_idmapEntry_t* entry = &self->entries[self->count];
+	entry->id   = id;
+	entry->val  = val;
+	slot->stamp = self->stamp;
+	slot->idx   = self->count;
+	++self->count;
+
+	return 1;
+}
+
+void* osmdb_idmap_find(osmdb_idmap_t* self, int64_t id)
+{
+	ASSERT(self);
+
+	osmdb_idmapSlot_t* slot = osmdb_idmap_slot(self, id);
+	if(slot->stamp == self->stamp)
+	{
+		return self->entries[slot->idx].val;
+	}
+
+	return NULL;
+}
+
+void* osmdb_idmap_remove(osmdb_idmap_t* self, int64_t id)
+{
+	ASSERT(self);
+
+	// the slot is kept so that the probe sequence
+	// remains intact
+	void* val = NULL;
+	osmdb_idmapSlot_t* slot = osmdb_idmap_slot(self, id);
+	if(slot->stamp == self->stamp)
+	{
+		osmdb_idmapEntry_t* entry = &self->entries[slot->idx];
+		val        = entry->val;
+		entry->val = NULL;
+	}
+
+	return val;
+}
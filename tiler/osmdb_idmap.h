@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2021 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef osmdb_idmap_H
+#define osmdb_idmap_H
+
+#include <stdint.h>
+
+typedef struct
+{
+	int64_t id;
+	void*   val;
+} osmdb_idmapEntry_t;
+
+typedef struct
+{
+	uint32_t stamp;
+	int      idx;
+} osmdb_idmapSlot_t;
+
+// int64_t id => val mapping implemented as an open
+// addressing hash table
+// entries are stored in insertion order and removed
+// entries are marked with a NULL val
+// clear reuses the entries/slots and invalidates the
+// slots by incrementing the stamp
+typedef struct
+{
+	int                 count;
+	int                 max_count;
+	osmdb_idmapEntry_t* entries;
+
+	uint32_t           stamp;
+	uint32_t           mask;
+	osmdb_idmapSlot_t* slots;
+} osmdb_idmap_t;
+
+osmdb_idmap_t* osmdb_idmap_new(void);
+void           osmdb_idmap_delete(osmdb_idmap_t** _self);
+void           osmdb_idmap_clear(osmdb_idmap_t* self);
+int            osmdb_idmap_add(osmdb_idmap_t* self,
+                               int64_t id, void* val);
+void*          osmdb_idmap_find(osmdb_idmap_t* self,
+                                int64_t id);
+void*          osmdb_idmap_remove(osmdb_idmap_t* self,
+                                  int64_t id);
+
+#endif
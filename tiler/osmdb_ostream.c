@@ -29,9 +29,12 @@
 #include "libcc/math/cc_vec2f.h"
 #include "libcc/cc_log.h"
 #include "libcc/cc_memory.h"
-#include "terrain/terrain_util.h"
+#include "../osmdb_proj.h"
 #include "osmdb_ostream.h"
 
+// max coords projected per batch (center, tl and br)
+#define OSMDB_OSTREAM_COORDS 3
+
 /***********************************************************
 * private                                                  *
 ***********************************************************/
@@ -40,8 +43,34 @@ static void osmdb_ostream_reset(osmdb_ostream_t* self)
 {
 	ASSERT(self);
 
-	FREE(self->data);
+	// retain the buffers for the next tile
+	size_t                   size       = self->size;
+	void*                    data       = self->data;
+	size_t                   enc_size   = self->enc_size;
+	unsigned char*           enc_data   = self->enc_data;
+	int                      max_names  = self->max_names;
+	const char**             names      = self->names;
+	osmdb_idmap_t*           name_map   = self->name_map;
+	int                      grid_cells = self->grid_cells;
+	int                      max_items  = self->max_items;
+	osmdb_ostreamGridItem_t* items      = self->items;
+	int                      max_lod    = self->max_lod;
+	char*                    lod_level  = self->lod_level;
+	int*                     lod_stack  = self->lod_stack;
 	memset((void*) self, 0, sizeof(osmdb_ostream_t));
+	self->size       = size;
+	self->data       = data;
+	self->enc_size   = enc_size;
+	self->enc_data   = enc_data;
+	self->max_names  = max_names;
+	self->names      = names;
+	self->name_map   = name_map;
+	self->grid_cells = grid_cells;
+	self->max_items  = max_items;
+	self->items      = items;
+	self->max_lod    = max_lod;
+	self->lod_level  = lod_level;
+	self->lod_stack  = lod_stack;
 }
 
 static void*
@@ -49,11 +78,12 @@ osmdb_ostream_data(osmdb_ostream_t* self, size_t offset)
 {
 	ASSERT(self);
 
-	if(self->data == NULL)
+	// the stream is invalid when no data has been added
+	if(self->offset == 0)
 	{
 		return NULL;
 	}
-	else if(offset >= self->size)
+	else if(offset >= self->offset)
 	{
 		LOGE("invalid offset=%" PRId64, (int64_t) offset);
 		osmdb_ostream_reset(self);
@@ -78,10 +108,15 @@ osmdb_ostream_add(osmdb_ostream_t* self, size_t size,
 	size_t resize = offset + size;
 	if(self->size < resize)
 	{
-		size_t tmp_size = self->size;
+		// grow geometrically
+		size_t tmp_size = 2*self->size;
+		if(tmp_size < 4096)
+		{
+			tmp_size = 4096;
+		}
 		while(tmp_size < resize)
 		{
-			tmp_size += 4096;
+			tmp_size *= 2;
 		}
 
 		void* tmp = REALLOC(self->data, tmp_size);
@@ -137,13 +172,15 @@ osmdb_ostream_xy2pt(float x, float y, osmdb_point_t* pt)
 }
 
 static void
-osmdb_ostream_coord2xy(osmdb_ostream_t* self,
-                       double lat, double lon,
-                       float* _x, float* _y)
+osmdb_ostream_coord2pts(osmdb_ostream_t* self, int count,
+                        const double* lat, const double* lon,
+                        osmdb_point_t* pts)
 {
 	ASSERT(self);
-	ASSERT(_x);
-	ASSERT(_y);
+	ASSERT(lat);
+	ASSERT(lon);
+	ASSERT(pts);
+	ASSERT(count <= OSMDB_OSTREAM_COORDS);
 
 	osmdb_tile_t* tile;
 	tile = (osmdb_tile_t*) osmdb_ostream_data(self, 0);
@@ -152,41 +189,1011 @@ osmdb_ostream_coord2xy(osmdb_ostream_t* self,
 		return;
 	}
 
-	float tileX;
-	float tileY;
-	terrain_coord2tile(lat, lon, tile->zoom,
-	                   &tileX, &tileY);
+	double tileX[OSMDB_OSTREAM_COORDS];
+	double tileY[OSMDB_OSTREAM_COORDS];
+	osmdb_proj_coord2tile(count, lat, lon, tile->zoom,
+	                      tileX, tileY);
 
-	// compute the uv coordinates
-	// tr = (1.0f, 1.0f)
-	// bl = (0.0f, 0.0f)
-	float x = (tileX - self->tileL)/
-	          (self->tileR - self->tileL);
-	float y = (tileY - self->tileB)/
-	          (self->tileT - self->tileB);
+	int i;
+	for(i = 0; i < count; ++i)
+	{
+		// compute the uv coordinates
+		// tr = (1.0f, 1.0f)
+		// bl = (0.0f, 0.0f)
+		float x = (float) (tileX[i] - (double) tile->x);
+		float y = (float) ((double) (tile->y + 1) - tileY[i]);
+
+		// translate to pt coordinates
+		// tr = (16383.0f, 16383.0f)
+		// bl = (-16384.0f, -16384.0f)
+		x = 32767.0f*x - 16384.0f;
+		y = 32767.0f*y - 16384.0f;
+
+		osmdb_ostream_xy2pt(x, y, &pts[i]);
+	}
+}
 
-	// translate to pt coordinates
-	// tr = (16383.0f, 16383.0f)
-	// bl = (-16384.0f, -16384.0f)
-	x = 32767.0f*x - 16384.0f;
-	y = 32767.0f*y - 16384.0f;
+static void
+osmdb_ostream_world2pt(osmdb_ostream_t* self,
+                       int x, int y, osmdb_point_t* pt)
+{
+	ASSERT(self);
+	ASSERT(pt);
 
-	*_x = x;
-	*_y = y;
+	osmdb_tilePoint_t tp = { 0 };
+	osmdb_ostream_world2tilePoint(self, x, y, &tp);
+	osmdb_ostream_xy2pt((float) tp.x, (float) tp.y, pt);
 }
 
-static void
-osmdb_ostream_coord2pt(osmdb_ostream_t* self,
-                       double lat, double lon,
+static uint64_t osmdb_ostream_hashName(const char* name)
+{
+	ASSERT(name);
+
+	// FNV-1a
+	uint64_t h = 0xCBF29CE484222325ULL;
+	while(*name)
+	{
+		h ^= (uint64_t) ((unsigned char) *name);
+		h *= 0x100000001B3ULL;
+		++name;
+	}
+	return h;
+}
+
+static unsigned char*
+osmdb_ostream_encReserve(osmdb_ostream_t* self, size_t size)
+{
+	ASSERT(self);
+
+	// reserve size bytes at enc_offset but the caller
+	// must advance enc_offset by the bytes written
+
+	size_t resize = self->enc_offset + size;
+	if(self->enc_size < resize)
+	{
+		// grow geometrically
+		size_t tmp_size = 2*self->enc_size;
+		if(tmp_size < 4096)
+		{
+			tmp_size = 4096;
+		}
+		while(tmp_size < resize)
+		{
+			tmp_size *= 2;
+		}
+
+		void* tmp = REALLOC(self->enc_data, tmp_size);
+		if(tmp == NULL)
+		{
+			LOGE("REALLOC failed");
+			return NULL;
+		}
+
+		self->enc_data = (unsigned char*) tmp;
+		self->enc_size = tmp_size;
+	}
+
+	return &self->enc_data[self->enc_offset];
+}
+
+static int
+osmdb_ostream_encBytes(osmdb_ostream_t* self,
+                       size_t size, const void* data)
+{
+	ASSERT(self);
+	ASSERT(data);
+
+	unsigned char* ptr = osmdb_ostream_encReserve(self, size);
+	if(ptr == NULL)
+	{
+		return 0;
+	}
+
+	memcpy((void*) ptr, data, size);
+	self->enc_offset += size;
+
+	return 1;
+}
+
+static int
+osmdb_ostream_encVarint(osmdb_ostream_t* self, uint32_t v)
+{
+	ASSERT(self);
+
+	// a uint32_t fits in 5 bytes
+	unsigned char* ptr = osmdb_ostream_encReserve(self, 5);
+	if(ptr == NULL)
+	{
+		return 0;
+	}
+
+	while(v >= 0x80)
+	{
+		*ptr = (unsigned char) ((v & 0x7F) | 0x80);
+		v >>= 7;
+		++ptr;
+		++self->enc_offset;
+	}
+	*ptr = (unsigned char) v;
+	++self->enc_offset;
+
+	return 1;
+}
+
+static int
+osmdb_ostream_encZigzag(osmdb_ostream_t* self, int i)
+{
+	ASSERT(self);
+
+	uint32_t v = (((uint32_t) i) << 1) ^ ((uint32_t) (i >> 31));
+	return osmdb_ostream_encVarint(self, v);
+}
+
+static int
+osmdb_ostream_encPoint(osmdb_ostream_t* self,
                        osmdb_point_t* pt)
 {
 	ASSERT(self);
 	ASSERT(pt);
 
-	float x = 0.0f;
-	float y = 0.0f;
-	osmdb_ostream_coord2xy(self, lat, lon, &x, &y);
-	osmdb_ostream_xy2pt(x, y, pt);
+	if((osmdb_ostream_encZigzag(self, pt->x - self->enc_x) == 0) ||
+	   (osmdb_ostream_encZigzag(self, pt->y - self->enc_y) == 0))
+	{
+		return 0;
+	}
+
+	self->enc_x = pt->x;
+	self->enc_y = pt->y;
+
+	return 1;
+}
+
+static int
+osmdb_ostream_encRange(osmdb_ostream_t* self,
+                       osmdb_point_t* center,
+                       osmdb_range_t* range)
+{
+	ASSERT(self);
+	ASSERT(center);
+	ASSERT(range);
+
+	return osmdb_ostream_encZigzag(self, range->t - center->y) &&
+	       osmdb_ostream_encZigzag(self, range->l - center->x) &&
+	       osmdb_ostream_encZigzag(self, range->b - center->y) &&
+	       osmdb_ostream_encZigzag(self, range->r - center->x);
+}
+
+static int
+osmdb_ostream_addName(osmdb_ostream_t* self,
+                      const char* name)
+{
+	// name may be NULL
+	ASSERT(self);
+
+	if((name == NULL) || (name[0] == '\0'))
+	{
+		return 1;
+	}
+
+	// names are deduplicated by hash and collisions are
+	// stored as separate names
+	uint64_t h = osmdb_ostream_hashName(name);
+	intptr_t idx;
+	idx = (intptr_t) osmdb_idmap_find(self->name_map,
+	                                  (int64_t) h);
+	if(idx && (strcmp(self->names[idx - 1], name) == 0))
+	{
+		return 1;
+	}
+
+	if(self->count_names == self->max_names)
+	{
+		int max_names = 2*self->max_names;
+		if(max_names == 0)
+		{
+			max_names = 256;
+		}
+
+		const char** names;
+		names = (const char**)
+		        REALLOC(self->names,
+		                max_names*sizeof(const char*));
+		if(names == NULL)
+		{
+			LOGE("REALLOC failed");
+			return 0;
+		}
+
+		self->names     = names;
+		self->max_names = max_names;
+	}
+
+	self->names[self->count_names] = name;
+	++self->count_names;
+
+	// the map val is the index + 1 since NULL is invalid
+	if(idx == 0)
+	{
+		idx = self->count_names;
+		if(osmdb_idmap_add(self->name_map, (int64_t) h,
+		                   (void*) idx) == 0)
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+static int
+osmdb_ostream_encName(osmdb_ostream_t* self,
+                      const char* name)
+{
+	// name may be NULL
+	ASSERT(self);
+
+	if((name == NULL) || (name[0] == '\0'))
+	{
+		return osmdb_ostream_encVarint(self, 0);
+	}
+
+	uint64_t h = osmdb_ostream_hashName(name);
+	intptr_t idx;
+	idx = (intptr_t) osmdb_idmap_find(self->name_map,
+	                                  (int64_t) h);
+	if((idx == 0) || strcmp(self->names[idx - 1], name))
+	{
+		// hash collision
+		for(idx = 1; idx <= self->count_names; ++idx)
+		{
+			if(strcmp(self->names[idx - 1], name) == 0)
+			{
+				break;
+			}
+		}
+	}
+
+	return osmdb_ostream_encVarint(self, (uint32_t) idx);
+}
+
+static double
+osmdb_ostream_lodDist2(osmdb_point_t* p,
+                       osmdb_point_t* a,
+                       osmdb_point_t* b)
+{
+	ASSERT(p);
+	ASSERT(a);
+	ASSERT(b);
+
+	// squared distance from p to the line segment ab
+	double abx = (double) (b->x - a->x);
+	double aby = (double) (b->y - a->y);
+	double apx = (double) (p->x - a->x);
+	double apy = (double) (p->y - a->y);
+	double ab2 = abx*abx + aby*aby;
+	if(ab2 > 0.0)
+	{
+		double t = (apx*abx + apy*aby)/ab2;
+		if(t > 1.0)
+		{
+			apx = (double) (p->x - b->x);
+			apy = (double) (p->y - b->y);
+		}
+		else if(t > 0.0)
+		{
+			apx -= t*abx;
+			apy -= t*aby;
+		}
+	}
+
+	return apx*apx + apy*apy;
+}
+
+static int
+osmdb_ostream_lodLevel(osmdb_ostream_t* self, double d2)
+{
+	ASSERT(self);
+
+	// the tolerance doubles for each lower level
+	int    i;
+	int    n   = OSMDB_TILE_LOD_COUNT;
+	double tol = self->lod_tolerance*((double) (1 << (n - 1)));
+	for(i = 0; i < n - 1; ++i)
+	{
+		if(d2 > tol*tol)
+		{
+			return i;
+		}
+		tol *= 0.5;
+	}
+
+	return n - 1;
+}
+
+static int
+osmdb_ostream_lodLevels(osmdb_ostream_t* self,
+                        int count, osmdb_point_t* pts)
+{
+	ASSERT(self);
+
+	if(count > self->max_lod)
+	{
+		int max_lod = 2*self->max_lod;
+		if(max_lod < 256)
+		{
+			max_lod = 256;
+		}
+		while(max_lod < count)
+		{
+			max_lod *= 2;
+		}
+
+		char* lod_level;
+		lod_level = (char*) REALLOC(self->lod_level,
+		                            max_lod*sizeof(char));
+		if(lod_level == NULL)
+		{
+			LOGE("REALLOC failed");
+			return 0;
+		}
+		self->lod_level = lod_level;
+
+		int* lod_stack;
+		lod_stack = (int*) REALLOC(self->lod_stack,
+		                           2*max_lod*sizeof(int));
+		if(lod_stack == NULL)
+		{
+			LOGE("REALLOC failed");
+			return 0;
+		}
+		self->lod_stack = lod_stack;
+		self->max_lod   = max_lod;
+	}
+
+	// the endpoints are required by every level
+	int   i;
+	char* level = self->lod_level;
+	for(i = 0; i < count; ++i)
+	{
+		level[i] = OSMDB_TILE_LOD_COUNT - 1;
+	}
+	if(count == 0)
+	{
+		return 1;
+	}
+	level[0]         = 0;
+	level[count - 1] = 0;
+
+	// Douglas-Peucker simplification where the level of
+	// the farthest pt is determined by its distance but
+	// may not be lower than the level of the segment
+	int* stack = self->lod_stack;
+	int  top   = 0;
+	stack[top++] = 0;
+	stack[top++] = count - 1;
+	while(top)
+	{
+		int i1 = stack[--top];
+		int i0 = stack[--top];
+		if(i1 - i0 < 2)
+		{
+			continue;
+		}
+
+		int    k    = i0 + 1;
+		double max2 = -1.0;
+		for(i = i0 + 1; i < i1; ++i)
+		{
+			double d2 = osmdb_ostream_lodDist2(&pts[i],
+			                                   &pts[i0],
+			                                   &pts[i1]);
+			if(d2 > max2)
+			{
+				k    = i;
+				max2 = d2;
+			}
+		}
+
+		int lod = osmdb_ostream_lodLevel(self, max2);
+		if(lod < level[i0])
+		{
+			lod = level[i0];
+		}
+		if(lod < level[i1])
+		{
+			lod = level[i1];
+		}
+		level[k] = (char) lod;
+
+		stack[top++] = i0;
+		stack[top++] = k;
+		stack[top++] = k;
+		stack[top++] = i1;
+	}
+
+	return 1;
+}
+
+static int
+osmdb_ostream_encLod(osmdb_ostream_t* self,
+                     osmdb_way_t* way)
+{
+	ASSERT(self);
+	ASSERT(way);
+
+	osmdb_point_t* pts = osmdb_way_pts(way);
+	if(osmdb_ostream_lodLevels(self, way->count, pts) == 0)
+	{
+		return 0;
+	}
+
+	// encode the pts of each level
+	int    i;
+	int    j;
+	int    count[OSMDB_TILE_LOD_COUNT];
+	int    bytes[OSMDB_TILE_LOD_COUNT];
+	size_t offset0 = self->enc_offset;
+	for(i = 0; i < OSMDB_TILE_LOD_COUNT; ++i)
+	{
+		size_t offset = self->enc_offset;
+		int    idx    = -1;
+		count[i] = 0;
+		for(j = 0; j < way->count; ++j)
+		{
+			if(self->lod_level[j] != i)
+			{
+				continue;
+			}
+
+			if((osmdb_ostream_encVarint(self, j - idx - 1) == 0) ||
+			   (osmdb_ostream_encPoint(self, &pts[j])      == 0))
+			{
+				return 0;
+			}
+			idx = j;
+			++count[i];
+		}
+		bytes[i] = (int) (self->enc_offset - offset);
+	}
+
+	// encode the level sizes and move them before the pts
+	size_t offset1 = self->enc_offset;
+	for(i = 0; i < OSMDB_TILE_LOD_COUNT; ++i)
+	{
+		if((osmdb_ostream_encVarint(self, count[i]) == 0) ||
+		   (osmdb_ostream_encVarint(self, bytes[i]) == 0))
+		{
+			return 0;
+		}
+	}
+
+	// a uint32_t varint fits in 5 bytes
+	unsigned char header[2*5*OSMDB_TILE_LOD_COUNT];
+	size_t        size_header = self->enc_offset - offset1;
+	memcpy((void*) header,
+	       (const void*) &self->enc_data[offset1],
+	       size_header);
+	memmove((void*) &self->enc_data[offset0 + size_header],
+	        (const void*) &self->enc_data[offset0],
+	        offset1 - offset0);
+	memcpy((void*) &self->enc_data[offset0],
+	       (const void*) header, size_header);
+
+	return 1;
+}
+
+static int
+osmdb_ostream_encWay(osmdb_ostream_t* self,
+                     osmdb_way_t* way, int pass)
+{
+	ASSERT(self);
+	ASSERT(way);
+
+	char* name = osmdb_way_name(way);
+	if(pass == 0)
+	{
+		return osmdb_ostream_addName(self, name);
+	}
+
+	if((osmdb_ostream_encVarint(self, way->class) == 0) ||
+	   (osmdb_ostream_encVarint(self, way->flags) == 0) ||
+	   (osmdb_ostream_encZigzag(self, way->layer) == 0) ||
+	   (osmdb_ostream_encName(self, name)         == 0) ||
+	   (osmdb_ostream_encPoint(self, &way->center) == 0) ||
+	   (osmdb_ostream_encRange(self, &way->center,
+	                           &way->range)       == 0) ||
+	   (osmdb_ostream_encVarint(self, way->count) == 0))
+	{
+		return 0;
+	}
+
+	// pts are relative to the previous pt which starts at
+	// the center and the cursor is restored to the center
+	if(self->lod_tolerance > 0.0)
+	{
+		if(osmdb_ostream_encLod(self, way) == 0)
+		{
+			return 0;
+		}
+	}
+	else
+	{
+		int i;
+		osmdb_point_t* pts = osmdb_way_pts(way);
+		for(i = 0; i < way->count; ++i)
+		{
+			if(osmdb_ostream_encPoint(self, &pts[i]) == 0)
+			{
+				return 0;
+			}
+		}
+	}
+	self->enc_x = way->center.x;
+	self->enc_y = way->center.y;
+
+	return 1;
+}
+
+static void
+osmdb_ostream_encSetInt(osmdb_ostream_t* self,
+                        size_t offset, int val)
+{
+	ASSERT(self);
+
+	memcpy((void*) &self->enc_data[offset],
+	       (const void*) &val, sizeof(int));
+}
+
+static int
+osmdb_ostream_encArray(osmdb_ostream_t* self, int count,
+                       int* _offset)
+{
+	ASSERT(self);
+	ASSERT(_offset);
+
+	size_t size = 4*((size_t) count);
+
+	unsigned char* ptr = osmdb_ostream_encReserve(self, size);
+	if(ptr == NULL)
+	{
+		return 0;
+	}
+	memset((void*) ptr, 0, size);
+
+	*_offset          = (int) self->enc_offset;
+	self->enc_offset += size;
+
+	return 1;
+}
+
+static void
+osmdb_ostream_encBlock(osmdb_ostream_t* self,
+                       int offset_blocks, int i)
+{
+	ASSERT(self);
+
+	// the delta cursor restarts at each block
+	if((i%OSMDB_TILE_BLOCK_SIZE) == 0)
+	{
+		size_t offset = (size_t) offset_blocks +
+		                4*(i/OSMDB_TILE_BLOCK_SIZE);
+		osmdb_ostream_encSetInt(self, offset,
+		                        (int) self->enc_offset);
+		self->enc_x = 0;
+		self->enc_y = 0;
+	}
+}
+
+static int
+osmdb_ostream_gridAdd(osmdb_ostream_t* self, int section,
+                      int idx, osmdb_range_t* range)
+{
+	ASSERT(self);
+	ASSERT(range);
+
+	if(self->grid_cells == 0)
+	{
+		return 1;
+	}
+
+	if(self->count_items == self->max_items)
+	{
+		int max_items = 2*self->max_items;
+		if(max_items == 0)
+		{
+			max_items = 256;
+		}
+
+		osmdb_ostreamGridItem_t* items;
+		items = (osmdb_ostreamGridItem_t*)
+		        REALLOC(self->items, max_items*
+		                sizeof(osmdb_ostreamGridItem_t));
+		if(items == NULL)
+		{
+			LOGE("REALLOC failed");
+			return 0;
+		}
+
+		self->items     = items;
+		self->max_items = max_items;
+	}
+
+	osmdb_ostreamGridItem_t* item;
+	item        = &self->items[self->count_items];
+	item->ref   = (((uint32_t) section) << OSMDB_TILE_GRID_SHIFT) |
+	              ((uint32_t) idx);
+	item->range = *range;
+	++self->count_items;
+
+	return 1;
+}
+
+static void
+osmdb_ostream_gridCells(int cells, osmdb_range_t* range,
+                        int* x0, int* y0, int* x1, int* y1)
+{
+	ASSERT(range);
+	ASSERT(x0);
+	ASSERT(y0);
+	ASSERT(x1);
+	ASSERT(y1);
+
+	// ranges are clamped so the t/b and l/r may be swapped
+	int l     = (range->l < range->r) ? range->l : range->r;
+	int r     = (range->l < range->r) ? range->r : range->l;
+	int b     = (range->b < range->t) ? range->b : range->t;
+	int t     = (range->b < range->t) ? range->t : range->b;
+	*x0 = osmdb_tile_gridCell(cells, l);
+	*x1 = osmdb_tile_gridCell(cells, r);
+	*y0 = osmdb_tile_gridCell(cells, b);
+	*y1 = osmdb_tile_gridCell(cells, t);
+}
+
+static int
+osmdb_ostream_countRefs(osmdb_ostream_t* self, int cells)
+{
+	ASSERT(self);
+
+	int count_refs = 0;
+
+	int i;
+	int x0;
+	int y0;
+	int x1;
+	int y1;
+	for(i = 0; i < self->count_items; ++i)
+	{
+		osmdb_ostreamGridItem_t* item = &self->items[i];
+		osmdb_ostream_gridCells(cells, &item->range,
+		                        &x0, &y0, &x1, &y1);
+		count_refs += (x1 - x0 + 1)*(y1 - y0 + 1);
+	}
+
+	return count_refs;
+}
+
+static int
+osmdb_ostream_encGrid(osmdb_ostream_t* self,
+                      osmdb_tileIndex_t* index)
+{
+	ASSERT(self);
+	ASSERT(index);
+
+	osmdb_tile_t* tile = (osmdb_tile_t*) self->data;
+	if((self->grid_cells == 0) ||
+	   (self->count_items < OSMDB_TILE_GRID_MIN_COUNT) ||
+	   (tile->count_rels  > OSMDB_TILE_GRID_MASK + 1)  ||
+	   (tile->count_ways  > OSMDB_TILE_GRID_MASK + 1)  ||
+	   (tile->count_nodes > OSMDB_TILE_GRID_MASK + 1))
+	{
+		return 1;
+	}
+
+	// halve the cells until the grid fits in the bytes
+	// saved by the compact records such that the encoded
+	// tile is never larger than the V1 layout
+	size_t size_pad = (4 - (self->enc_offset%4))%4;
+	size_t size     = 0;
+	int    cells    = self->grid_cells;
+	int    count_start = 0;
+	int    count_refs  = 0;
+	while(cells >= 2)
+	{
+		count_start = cells*cells + 1;
+		count_refs  = osmdb_ostream_countRefs(self, cells);
+		size        = 4 + 2*count_start + 2*count_refs;
+		if((count_refs <= OSMDB_TILE_GRID_MAX_REFS) &&
+		   (self->enc_offset + size_pad + size <= self->offset))
+		{
+			break;
+		}
+		cells /= 2;
+	}
+
+	if(cells < 2)
+	{
+		return 1;
+	}
+
+	// count the refs per cell
+	uint16_t fill[OSMDB_TILE_GRID_MAX*OSMDB_TILE_GRID_MAX + 1];
+	memset((void*) fill, 0, count_start*sizeof(uint16_t));
+
+	int i;
+	int x;
+	int y;
+	int x0;
+	int y0;
+	int x1;
+	int y1;
+	for(i = 0; i < self->count_items; ++i)
+	{
+		osmdb_ostreamGridItem_t* item = &self->items[i];
+		osmdb_ostream_gridCells(cells, &item->range,
+		                        &x0, &y0, &x1, &y1);
+		for(y = y0; y <= y1; ++y)
+		{
+			for(x = x0; x <= x1; ++x)
+			{
+				++fill[y*cells + x + 1];
+			}
+		}
+	}
+
+	for(i = 1; i < count_start; ++i)
+	{
+		fill[i] += fill[i - 1];
+	}
+
+	// pad the grid to 4 bytes
+	unsigned char pad[4] = { 0 };
+	if(osmdb_ostream_encBytes(self, size_pad,
+	                          (const void*) pad) == 0)
+	{
+		return 0;
+	}
+
+	unsigned char* ptr = osmdb_ostream_encReserve(self, size);
+	if(ptr == NULL)
+	{
+		return 0;
+	}
+
+	uint16_t* start = (uint16_t*) &ptr[4];
+	uint16_t* refs  = &start[count_start];
+	memcpy((void*) ptr, (const void*) &cells, sizeof(int));
+	memcpy((void*) start, (const void*) fill,
+	       count_start*sizeof(uint16_t));
+
+	// fill the refs in record order
+	for(i = 0; i < self->count_items; ++i)
+	{
+		osmdb_ostreamGridItem_t* item = &self->items[i];
+		osmdb_ostream_gridCells(cells, &item->range,
+		                        &x0, &y0, &x1, &y1);
+		for(y = y0; y <= y1; ++y)
+		{
+			for(x = x0; x <= x1; ++x)
+			{
+				int c = y*cells + x;
+				refs[fill[c]] = (uint16_t) item->ref;
+				++fill[c];
+			}
+		}
+	}
+
+	index->offset_grid = (int) self->enc_offset;
+	self->enc_offset  += size;
+
+	return 1;
+}
+
+static int
+osmdb_ostream_encode(osmdb_ostream_t* self, int pass,
+                     osmdb_tileIndex_t* index)
+{
+	// index may be NULL for pass 0
+	ASSERT(self);
+
+	// pass 0 builds the string table
+	// pass 1 encodes the rels/ways/nodes
+
+	char*         ptr  = (char*) self->data;
+	osmdb_tile_t* tile = (osmdb_tile_t*) ptr;
+	size_t        offset = sizeof(osmdb_tile_t);
+
+	int i;
+	int j;
+	for(i = 0; i < tile->count_rels; ++i)
+	{
+		osmdb_rel_t* rel  = (osmdb_rel_t*) &ptr[offset];
+		char*        name = osmdb_rel_name(rel);
+		offset += sizeof(osmdb_rel_t) + rel->size_name;
+
+		if(pass == 0)
+		{
+			if(osmdb_ostream_addName(self, name) == 0)
+			{
+				return 0;
+			}
+		}
+		else
+		{
+			osmdb_ostream_encBlock(self, index->offset_rels, i);
+			if((osmdb_ostream_gridAdd(self,
+			                          OSMDB_TILEITER_SECTION_RELS,
+			                          i, &rel->range)     == 0) ||
+			   (osmdb_ostream_encVarint(self, rel->class) == 0) ||
+			   (osmdb_ostream_encVarint(self, rel->flags) == 0) ||
+			   (osmdb_ostream_encVarint(self, rel->type)  == 0) ||
+			   (osmdb_ostream_encName(self, name)         == 0) ||
+			   (osmdb_ostream_encPoint(self, &rel->center) == 0) ||
+			   (osmdb_ostream_encRange(self, &rel->center,
+			                           &rel->range)       == 0) ||
+			   (osmdb_ostream_encVarint(self, rel->count) == 0))
+			{
+				return 0;
+			}
+		}
+
+		for(j = 0; j < rel->count; ++j)
+		{
+			osmdb_way_t* way = (osmdb_way_t*) &ptr[offset];
+			offset += sizeof(osmdb_way_t) + way->size_name +
+			          way->count*sizeof(osmdb_point_t);
+			if(osmdb_ostream_encWay(self, way, pass) == 0)
+			{
+				return 0;
+			}
+		}
+	}
+
+	for(i = 0; i < tile->count_ways; ++i)
+	{
+		osmdb_way_t* way = (osmdb_way_t*) &ptr[offset];
+		offset += sizeof(osmdb_way_t) + way->size_name +
+		          way->count*sizeof(osmdb_point_t);
+		if(pass)
+		{
+			osmdb_ostream_encBlock(self, index->offset_ways, i);
+			if(osmdb_ostream_gridAdd(self,
+			                         OSMDB_TILEITER_SECTION_WAYS,
+			                         i, &way->range) == 0)
+			{
+				return 0;
+			}
+		}
+
+		if(osmdb_ostream_encWay(self, way, pass) == 0)
+		{
+			return 0;
+		}
+	}
+
+	for(i = 0; i < tile->count_nodes; ++i)
+	{
+		osmdb_node_t* node = (osmdb_node_t*) &ptr[offset];
+		char*         name = osmdb_node_name(node);
+		offset += sizeof(osmdb_node_t) + node->size_name;
+
+		if(pass == 0)
+		{
+			if(osmdb_ostream_addName(self, name) == 0)
+			{
+				return 0;
+			}
+		}
+		else
+		{
+			osmdb_range_t pt =
+			{
+				.t = node->pt.y,
+				.l = node->pt.x,
+				.b = node->pt.y,
+				.r = node->pt.x,
+			};
+
+			osmdb_ostream_encBlock(self, index->offset_nodes, i);
+			if((osmdb_ostream_gridAdd(self,
+			                          OSMDB_TILEITER_SECTION_NODES,
+			                          i, &pt)              == 0) ||
+			   (osmdb_ostream_encVarint(self, node->class) == 0) ||
+			   (osmdb_ostream_encVarint(self, node->flags) == 0) ||
+			   (osmdb_ostream_encZigzag(self, node->ele)   == 0) ||
+			   (osmdb_ostream_encName(self, name)          == 0) ||
+			   (osmdb_ostream_encPoint(self, &node->pt)    == 0))
+			{
+				return 0;
+			}
+		}
+	}
+
+	return 1;
+}
+
+static int osmdb_ostream_encTile(osmdb_ostream_t* self)
+{
+	ASSERT(self);
+
+	osmdb_idmap_clear(self->name_map);
+	self->count_names = 0;
+	self->count_items = 0;
+	self->enc_offset  = 0;
+	self->enc_x       = 0;
+	self->enc_y       = 0;
+
+	if(osmdb_ostream_encode(self, 0, NULL) == 0)
+	{
+		return 0;
+	}
+
+	// header
+	osmdb_tile_t tile;
+	memcpy((void*) &tile, self->data, sizeof(osmdb_tile_t));
+	tile.version = OSMDB_TILE_VERSION;
+
+	osmdb_tileIndex_t index =
+	{
+		.count_names = self->count_names,
+		.flags       = self->flags,
+	};
+
+	if(self->lod_tolerance > 0.0)
+	{
+		index.count_lod = OSMDB_TILE_LOD_COUNT;
+	}
+
+	int b = OSMDB_TILE_BLOCK_SIZE;
+	if((osmdb_ostream_encBytes(self, sizeof(osmdb_tile_t),
+	                           (const void*) &tile) == 0) ||
+	   (osmdb_ostream_encBytes(self, sizeof(osmdb_tileIndex_t),
+	                           (const void*) &index) == 0) ||
+	   (osmdb_ostream_encArray(self, self->count_names,
+	                           &index.offset_names) == 0) ||
+	   (osmdb_ostream_encArray(self, (tile.count_rels + b - 1)/b,
+	                           &index.offset_rels) == 0) ||
+	   (osmdb_ostream_encArray(self, (tile.count_ways + b - 1)/b,
+	                           &index.offset_ways) == 0) ||
+	   (osmdb_ostream_encArray(self, (tile.count_nodes + b - 1)/b,
+	                           &index.offset_nodes) == 0))
+	{
+		return 0;
+	}
+
+	// string table
+	int i;
+	for(i = 0; i < self->count_names; ++i)
+	{
+		osmdb_ostream_encSetInt(self, index.offset_names + 4*i,
+		                        (int) self->enc_offset);
+
+		const char* name = self->names[i];
+		if(osmdb_ostream_encBytes(self, strlen(name) + 1,
+		                          (const void*) name) == 0)
+		{
+			return 0;
+		}
+	}
+
+	// rels/ways/nodes
+	if((osmdb_ostream_encode(self, 1, &index) == 0) ||
+	   (osmdb_ostream_encGrid(self, &index)   == 0))
+	{
+		return 0;
+	}
+
+	// the checksum covers the bytes after the checksum
+	size_t offset = sizeof(osmdb_tile_t);
+	memcpy((void*) &self->enc_data[offset],
+	       (const void*) &index, sizeof(osmdb_tileIndex_t));
+
+	offset += sizeof(uint32_t);
+	index.checksum = osmdb_tile_checksum(self->enc_offset - offset,
+	                                     &self->enc_data[offset]);
+	memcpy((void*) &self->enc_data[sizeof(osmdb_tile_t)],
+	       (const void*) &index.checksum, sizeof(uint32_t));
+
+	return 1;
 }
 
 /***********************************************************
@@ -204,7 +1211,19 @@ osmdb_ostream_t* osmdb_ostream_new(void)
 		return NULL;
 	}
 
+	self->name_map = osmdb_idmap_new();
+	if(self->name_map == NULL)
+	{
+		goto fail_name_map;
+	}
+
+	// success
 	return self;
+
+	// failure
+	fail_name_map:
+		FREE(self);
+	return NULL;
 }
 
 void osmdb_ostream_delete(osmdb_ostream_t** _self)
@@ -214,6 +1233,12 @@ void osmdb_ostream_delete(osmdb_ostream_t** _self)
 	osmdb_ostream_t* self = *_self;
 	if(self)
 	{
+		osmdb_idmap_delete(&self->name_map);
+		FREE(self->lod_stack);
+		FREE(self->lod_level);
+		FREE(self->items);
+		FREE(self->names);
+		FREE(self->enc_data);
 		FREE(self->data);
 		FREE(self);
 		*_self = NULL;
@@ -247,16 +1272,6 @@ int osmdb_ostream_beginTile(osmdb_ostream_t* self,
 	tile->y         = y;
 	tile->changeset = changeset;
 
-	double latT;
-	double lonL;
-	double latB;
-	double lonR;
-	terrain_bounds(x, y, zoom, &latT, &lonL, &latB, &lonR);
-	terrain_coord2tile(latT, lonL, zoom,
-	                   &self->tileL, &self->tileT);
-	terrain_coord2tile(latB, lonR, zoom,
-	                   &self->tileR, &self->tileB);
-
 	return 1;
 }
 
@@ -267,18 +1282,62 @@ osmdb_ostream_endTile(osmdb_ostream_t* self,
 	// _size may be NULL
 	ASSERT(self);
 
-	// get tile data
+	size_t        size = 0;
+	osmdb_tile_t* shared;
+	shared = osmdb_ostream_endTileShared(self, &size);
+	if(shared == NULL)
+	{
+		return NULL;
+	}
+
 	osmdb_tile_t* tile;
-	tile = (osmdb_tile_t*) self->data;
+	tile = (osmdb_tile_t*) MALLOC(size);
+	if(tile == NULL)
+	{
+		LOGE("MALLOC failed");
+		return NULL;
+	}
+	memcpy((void*) tile, (const void*) shared, size);
+
+	if(_size)
+	{
+		*_size = size;
+	}
+
+	return tile;
+}
+
+osmdb_tile_t*
+osmdb_ostream_endTileShared(osmdb_ostream_t* self,
+                            size_t* _size)
+{
+	// _size may be NULL
+	ASSERT(self);
+
+	// check tile data
+	if(osmdb_ostream_data(self, 0) == NULL)
+	{
+		return NULL;
+	}
+
+	// encode the tile data since the stream retains the
+	// buffers for the next tile
+	// enc_size is the allocation size and
+	// enc_offset is the tile size
+	if(osmdb_ostream_encTile(self) == 0)
+	{
+		osmdb_ostream_reset(self);
+		return NULL;
+	}
+
+	// the encoded tile is owned by the stream and remains
+	// valid until the next osmdb_ostream_beginTile
+	osmdb_tile_t* tile = (osmdb_tile_t*) self->enc_data;
 	if(_size)
 	{
-		// size is the allocation size and
-		// offset is the tile size
-		*_size = self->offset;
+		*_size = self->enc_offset;
 	}
 
-	// take ownership of data
-	self->data = NULL;
 	osmdb_ostream_reset(self);
 
 	return tile;
@@ -335,18 +1394,26 @@ int osmdb_ostream_beginRel(osmdb_ostream_t* self,
 	double lonR = rel_range->lonR;
 	double lat = latB + (latT - latB)/2.0;
 	double lon = lonL + (lonR - lonL)/2.0;
+
+	// project the center and range in a single batch
+	double        plat[3] = { lat, latT, latB };
+	double        plon[3] = { lon, lonL, lonR };
+	osmdb_point_t pts[3];
+	memset((void*) pts, 0, sizeof(pts));
+	osmdb_ostream_coord2pts(self, 3, plat, plon, pts);
 	if(node_coord)
 	{
-		lat = node_coord->lat;
-		lon = node_coord->lon;
+		osmdb_ostream_world2pt(self, node_coord->x,
+		                       node_coord->y, &rel->center);
+	}
+	else
+	{
+		rel->center = pts[0];
 	}
-	osmdb_ostream_coord2pt(self, lat, lon, &rel->center);
 
 	// initialize range
-	osmdb_point_t tl = { 0 };
-	osmdb_point_t br = { 0 };
-	osmdb_ostream_coord2pt(self, latT, lonL, &tl);
-	osmdb_ostream_coord2pt(self, latB, lonR, &br);
+	osmdb_point_t tl = pts[1];
+	osmdb_point_t br = pts[2];
 	rel->range.t = tl.y;
 	rel->range.l = tl.x;
 	rel->range.b = br.y;
@@ -389,6 +1456,20 @@ void osmdb_ostream_endRel(osmdb_ostream_t* self)
 	self->offset_rel = 0;
 }
 
+void osmdb_ostream_discardRel(osmdb_ostream_t* self)
+{
+	ASSERT(self);
+
+	// rewind the stream to discard the rel and its member
+	// ways since the rel is the last record in the stream
+	if(self->offset_rel)
+	{
+		self->offset     = self->offset_rel;
+		self->offset_rel = 0;
+		self->offset_way = 0;
+	}
+}
+
 int osmdb_ostream_beginWay(osmdb_ostream_t* self,
                            osmdb_wayInfo_t* way_info,
                            osmdb_wayRange_t* way_range,
@@ -427,7 +1508,10 @@ int osmdb_ostream_beginWay(osmdb_ostream_t* self,
 		return 0;
 	}
 	way->class = way_info->class;
-	way->flags = way_info->flags | flags;
+	// the area flag of members is set by the tiler
+	// since it depends on the rel rather than the way
+	way->flags = (way_info->flags & ~OSMDB_WAYINFO_FLAG_AREA) |
+	             flags;
 	way->layer = way_info->layer;
 	way->count = 0;
 
@@ -438,13 +1522,18 @@ int osmdb_ostream_beginWay(osmdb_ostream_t* self,
 	double lonR = way_range->lonR;
 	double lat = latB + (latT - latB)/2.0;
 	double lon = lonL + (lonR - lonL)/2.0;
-	osmdb_ostream_coord2pt(self, lat, lon, &way->center);
+
+	// project the center and range in a single batch
+	double        plat[3] = { lat, latT, latB };
+	double        plon[3] = { lon, lonL, lonR };
+	osmdb_point_t pts[3];
+	memset((void*) pts, 0, sizeof(pts));
+	osmdb_ostream_coord2pts(self, 3, plat, plon, pts);
+	way->center = pts[0];
 
 	// initialize range
-	osmdb_point_t tl = { 0 };
-	osmdb_point_t br = { 0 };
-	osmdb_ostream_coord2pt(self, latT, lonL, &tl);
-	osmdb_ostream_coord2pt(self, latB, lonR, &br);
+	osmdb_point_t tl = pts[1];
+	osmdb_point_t br = pts[2];
 	way->range.t = tl.y;
 	way->range.l = tl.x;
 	way->range.b = br.y;
@@ -534,17 +1623,40 @@ int osmdb_ostream_addWayPt(osmdb_ostream_t* self,
 	return 1;
 }
 
-int osmdb_ostream_addWayCoord(osmdb_ostream_t* self,
-                              osmdb_nodeCoord_t* node_coord)
+void osmdb_ostream_world2tilePoint(osmdb_ostream_t* self,
+                                   int x, int y,
+                                   osmdb_tilePoint_t* pt)
 {
 	ASSERT(self);
-	ASSERT(node_coord);
+	ASSERT(pt);
+
+	osmdb_tile_t* tile;
+	tile = (osmdb_tile_t*) osmdb_ostream_data(self, 0);
+	if(tile == NULL)
+	{
+		return;
+	}
+
+	// translate the world coordinates relative to the
+	// bottom-left corner of the tile and scale to pt
+	// coordinates with a shift
+	// tr = (16383, 16383)
+	// bl = (-16384, -16384)
+	int     shift = OSMDB_PROJ_WORLD_ZOOM - tile->zoom;
+	int64_t l     = ((int64_t) tile->x) << shift;
+	int64_t b     = ((int64_t) (tile->y + 1)) << shift;
+	pt->x = (int) (((((int64_t) x) - l)*32767) >> shift) - 16384;
+	pt->y = (int) (((b - ((int64_t) y))*32767) >> shift) - 16384;
+}
+
+int osmdb_ostream_addWayPoint(osmdb_ostream_t* self,
+                              osmdb_tilePoint_t* pt)
+{
+	ASSERT(self);
+	ASSERT(pt);
 
-	float  x   = 0.0f;
-	float  y   = 0.0f;
-	double lat = node_coord->lat;
-	double lon = node_coord->lon;
-	osmdb_ostream_coord2xy(self, lat, lon, &x, &y);
+	float x = (float) pt->x;
+	float y = (float) pt->y;
 
 	int ret = 1;
 	if(self->way_pts)
@@ -634,9 +1746,8 @@ int osmdb_ostream_addNode(osmdb_ostream_t* self,
 	node->flags = node_info->flags;
 	node->ele   = node_info->ele;
 
-	double lat = node_coord->lat;
-	double lon = node_coord->lon;
-	osmdb_ostream_coord2pt(self, lat, lon, &node->pt);
+	osmdb_ostream_world2pt(self, node_coord->x, node_coord->y,
+	                       &node->pt);
 
 	// initialize name
 	char* name      = osmdb_nodeInfo_name(node_info);
@@ -27,8 +27,24 @@
 #include <stdint.h>
 
 #include "../index/osmdb_type.h"
+#include "osmdb_idmap.h"
 #include "osmdb_tile.h"
 
+// unclamped point in tile space (same units as
+// osmdb_point_t) which may extend outside the tile
+typedef struct
+{
+	int x;
+	int y;
+} osmdb_tilePoint_t;
+
+// record range for the grid (see osmdb_tileIndex_t)
+typedef struct
+{
+	uint32_t      ref;
+	osmdb_range_t range;
+} osmdb_ostreamGridItem_t;
+
 typedef struct
 {
 	size_t size;
@@ -44,11 +60,37 @@ typedef struct
 	short waypt_x;
 	short waypt_y;
 
-	// bounding tile rect
-	float tileT;
-	float tileL;
-	float tileB;
-	float tileR;
+	// compact encoding
+	// the tile is built in the V1 layout and encoded by
+	// osmdb_ostream_endTile
+	size_t         enc_size;
+	size_t         enc_offset;
+	unsigned char* enc_data;
+	int            enc_x;
+	int            enc_y;
+
+	// index flags (see OSMDB_TILE_FLAG_*)
+	int flags;
+
+	// string table
+	int            count_names;
+	int            max_names;
+	const char**   names;
+	osmdb_idmap_t* name_map;
+
+	// optional grid where grid_cells is 0 to omit the grid
+	int                      grid_cells;
+	int                      count_items;
+	int                      max_items;
+	osmdb_ostreamGridItem_t* items;
+
+	// optional level of detail where lod_tolerance is the
+	// tolerance of the highest level or 0 to keep the pts
+	// in order (see OSMDB_TILE_LOD_COUNT)
+	double lod_tolerance;
+	int    max_lod;
+	char*  lod_level;
+	int*   lod_stack;
 } osmdb_ostream_t;
 
 osmdb_ostream_t* osmdb_ostream_new(void);
@@ -58,6 +100,8 @@ int              osmdb_ostream_beginTile(osmdb_ostream_t* self,
                                          int64_t changeset);
 osmdb_tile_t*    osmdb_ostream_endTile(osmdb_ostream_t* self,
                                        size_t* _size);
+osmdb_tile_t*    osmdb_ostream_endTileShared(osmdb_ostream_t* self,
+                                             size_t* _size);
 int              osmdb_ostream_beginRel(osmdb_ostream_t* self,
                                         osmdb_relInfo_t* rel_info,
                                         osmdb_relRange_t* rel_range,
@@ -65,12 +109,16 @@ int              osmdb_ostream_beginRel(osmdb_ostream_t* self,
                                         const char* name,
                                         osmdb_nodeCoord_t* node_coord);
 void             osmdb_ostream_endRel(osmdb_ostream_t* self);
+void             osmdb_ostream_discardRel(osmdb_ostream_t* self);
 int              osmdb_ostream_beginWay(osmdb_ostream_t* self,
                                         osmdb_wayInfo_t* way_info,
                                         osmdb_wayRange_t* way_range,
                                         int flags);
-int              osmdb_ostream_addWayCoord(osmdb_ostream_t* self,
-                                           osmdb_nodeCoord_t* node_coord);
+void             osmdb_ostream_world2tilePoint(osmdb_ostream_t* self,
+                                               int x, int y,
+                                               osmdb_tilePoint_t* pt);
+int              osmdb_ostream_addWayPoint(osmdb_ostream_t* self,
+                                           osmdb_tilePoint_t* pt);
 void             osmdb_ostream_endWay(osmdb_ostream_t* self);
 int              osmdb_ostream_addNode(osmdb_ostream_t* self,
                                        osmdb_nodeInfo_t* node_info,
@@ -0,0 +1,596 @@
+/*
+ * Copyright (c) 2021 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#define LOG_TAG "osmdb"
+#include "libcc/cc_log.h"
+#include "libcc/cc_memory.h"
+#include "libcc/cc_timestamp.h"
+#include "osmdb_scheduler.h"
+
+/***********************************************************
+* private                                                  *
+***********************************************************/
+
+static void
+osmdb_scheduler_push(osmdb_scheduler_t* self,
+                     osmdb_schedulerJob_t* job)
+{
+	ASSERT(self);
+	ASSERT(job);
+
+	int p = job->priority;
+
+	job->next = NULL;
+	if(self->tail[p])
+	{
+		self->tail[p]->next = job;
+	}
+	else
+	{
+		self->head[p] = job;
+	}
+	self->tail[p] = job;
+}
+
+static osmdb_schedulerJob_t*
+osmdb_scheduler_pop(osmdb_scheduler_t* self)
+{
+	ASSERT(self);
+
+	// the highest priority is the lowest index
+	int p;
+	for(p = 0; p < OSMDB_SCHEDULER_PRIORITY_COUNT; ++p)
+	{
+		osmdb_schedulerJob_t* job = self->head[p];
+		if(job)
+		{
+			self->head[p] = job->next;
+			if(self->head[p] == NULL)
+			{
+				self->tail[p] = NULL;
+			}
+			job->next = NULL;
+			return job;
+		}
+	}
+
+	return NULL;
+}
+
+static void
+osmdb_scheduler_unlink(osmdb_scheduler_t* self,
+                       osmdb_schedulerJob_t* job)
+{
+	ASSERT(self);
+	ASSERT(job);
+
+	int p = job->priority;
+
+	osmdb_schedulerJob_t* prev = NULL;
+	osmdb_schedulerJob_t* iter = self->head[p];
+	while(iter && (iter != job))
+	{
+		prev = iter;
+		iter = iter->next;
+	}
+
+	if(iter == NULL)
+	{
+		return;
+	}
+
+	if(prev)
+	{
+		prev->next = job->next;
+	}
+	else
+	{
+		self->head[p] = job->next;
+	}
+
+	if(self->tail[p] == job)
+	{
+		self->tail[p] = prev;
+	}
+	job->next = NULL;
+}
+
+static osmdb_schedulerJob_t*
+osmdb_scheduler_find(osmdb_scheduler_t* self,
+                     int zoom, int x, int y)
+{
+	ASSERT(self);
+
+	// the jobs are bounded by the number of concurrent
+	// requests so a linear search is sufficient
+	int i;
+	for(i = 0; i < self->count_jobs; ++i)
+	{
+		osmdb_schedulerJob_t* job = self->jobs[i];
+		if((job->zoom == zoom) && (job->x == x) &&
+		   (job->y == y) && (job->mask == NULL))
+		{
+			return job;
+		}
+	}
+
+	return NULL;
+}
+
+static int
+osmdb_scheduler_addJob(osmdb_scheduler_t* self,
+                       osmdb_schedulerJob_t* job)
+{
+	ASSERT(self);
+	ASSERT(job);
+
+	if(self->count_jobs == self->max_jobs)
+	{
+		int max_jobs = 2*self->max_jobs;
+		if(max_jobs == 0)
+		{
+			max_jobs = 64;
+		}
+
+		osmdb_schedulerJob_t** jobs;
+		jobs = (osmdb_schedulerJob_t**)
+		       REALLOC(self->jobs, max_jobs*
+		               sizeof(osmdb_schedulerJob_t*));
+		if(jobs == NULL)
+		{
+			LOGE("REALLOC failed");
+			return 0;
+		}
+
+		self->jobs     = jobs;
+		self->max_jobs = max_jobs;
+	}
+
+	self->jobs[self->count_jobs] = job;
+	++self->count_jobs;
+
+	return 1;
+}
+
+static void
+osmdb_scheduler_removeJob(osmdb_scheduler_t* self,
+                          osmdb_schedulerJob_t* job)
+{
+	ASSERT(self);
+	ASSERT(job);
+
+	int i;
+	for(i = 0; i < self->count_jobs; ++i)
+	{
+		if(self->jobs[i] == job)
+		{
+			--self->count_jobs;
+			self->jobs[i] = self->jobs[self->count_jobs];
+			return;
+		}
+	}
+}
+
+static osmdb_schedulerJob_t*
+osmdb_scheduler_submit(osmdb_scheduler_t* self, int priority,
+                       int zoom, int x, int y,
+                       const char* mask, int full)
+{
+	// mask may be NULL
+	ASSERT(self);
+
+	// join the in-flight job for the same tile unless the
+	// waiter requires a full build
+	osmdb_schedulerJob_t* job = NULL;
+	if((mask == NULL) && (full == 0))
+	{
+		job = osmdb_scheduler_find(self, zoom, x, y);
+	}
+
+	if(job)
+	{
+		self->stats[priority].count_coalesced += 1;
+		job->refcount += 1;
+
+		// promote a queued job to the higher priority where
+		// the deadline starts from the promotion
+		if((priority < job->priority) && (job->t_start == 0.0))
+		{
+			osmdb_scheduler_unlink(self, job);
+			job->priority = priority;
+			job->t_submit = cc_timestamp();
+			osmdb_scheduler_push(self, job);
+		}
+		return job;
+	}
+
+	job = (osmdb_schedulerJob_t*)
+	      CALLOC(1, sizeof(osmdb_schedulerJob_t));
+	if(job == NULL)
+	{
+		LOGE("CALLOC failed");
+		return NULL;
+	}
+
+	job->zoom     = zoom;
+	job->x        = x;
+	job->y        = y;
+	job->priority = priority;
+	job->refcount = 1;
+	job->full     = full;
+	job->mask     = mask;
+	job->t_submit = cc_timestamp();
+
+	if(osmdb_scheduler_addJob(self, job) == 0)
+	{
+		FREE(job);
+		return NULL;
+	}
+
+	osmdb_scheduler_push(self, job);
+	pthread_cond_signal(&self->cond_queue);
+
+	return job;
+}
+
+static osmdb_tile_t*
+osmdb_scheduler_wait(osmdb_scheduler_t* self,
+                     osmdb_schedulerJob_t* job,
+                     size_t* _size)
+{
+	ASSERT(self);
+	ASSERT(job);
+	ASSERT(_size);
+
+	while(job->done == 0)
+	{
+		pthread_cond_wait(&self->cond_done, &self->mutex);
+	}
+
+	// the last waiter takes ownership of the tile and the
+	// other waiters receive a copy
+	osmdb_tile_t* tile = NULL;
+	job->refcount -= 1;
+	if(job->tile && (job->refcount == 0))
+	{
+		tile      = job->tile;
+		job->tile = NULL;
+	}
+	else if(job->tile)
+	{
+		tile = (osmdb_tile_t*) MALLOC(job->size);
+		if(tile)
+		{
+			memcpy((void*) tile, (const void*) job->tile,
+			       job->size);
+		}
+		else
+		{
+			LOGE("MALLOC failed");
+		}
+	}
+	*_size = job->size;
+
+	if(job->refcount == 0)
+	{
+		FREE(job->tile);
+		FREE(job);
+	}
+
+	return tile;
+}
+
+static void* osmdb_scheduler_run(void* arg)
+{
+	ASSERT(arg);
+
+	osmdb_schedulerBuilder_t* builder;
+	osmdb_scheduler_t*        self;
+	builder = (osmdb_schedulerBuilder_t*) arg;
+	self    = builder->scheduler;
+
+	pthread_mutex_lock(&self->mutex);
+	while(1)
+	{
+		osmdb_schedulerJob_t* job = osmdb_scheduler_pop(self);
+		if(job == NULL)
+		{
+			// drain the queues before exiting
+			if(self->running == 0)
+			{
+				break;
+			}
+
+			pthread_cond_wait(&self->cond_queue, &self->mutex);
+			continue;
+		}
+
+		job->t_start = cc_timestamp();
+
+		// the deadline includes the queue wait time
+		osmdb_tilerToken_t  token  = { .partial = 1 };
+		osmdb_tilerToken_t* ptoken = NULL;
+		if((self->timeout[job->priority] > 0.0) &&
+		   (job->full == 0))
+		{
+			token.deadline = job->t_submit +
+			                 self->timeout[job->priority];
+			ptoken = &token;
+		}
+		pthread_mutex_unlock(&self->mutex);
+
+		size_t        size = 0;
+		osmdb_tile_t* tile;
+		tile = osmdb_tiler_makeToken(self->tiler, builder->tid,
+		                             job->zoom, job->x, job->y,
+		                             job->mask, ptoken, &size);
+		double t_end = cc_timestamp();
+
+		pthread_mutex_lock(&self->mutex);
+		job->tile = tile;
+		job->size = size;
+		job->done = 1;
+		osmdb_scheduler_removeJob(self, job);
+
+		// queue wait time is reported separately from the
+		// build time
+		osmdb_schedulerStats_t* stats;
+		double                  wait_dt;
+		double                  build_dt;
+		stats    = &self->stats[job->priority];
+		wait_dt  = job->t_start - job->t_submit;
+		build_dt = t_end - job->t_start;
+		stats->count_built += 1;
+		if(tile && (osmdb_tile_flags(size, tile) &
+		            OSMDB_TILE_FLAG_PARTIAL))
+		{
+			stats->count_partial += 1;
+		}
+		stats->wait_dt     += wait_dt;
+		stats->build_dt    += build_dt;
+		if(wait_dt > stats->wait_max)
+		{
+			stats->wait_max = wait_dt;
+		}
+		if(build_dt > stats->build_max)
+		{
+			stats->build_max = build_dt;
+		}
+
+		pthread_cond_broadcast(&self->cond_done);
+	}
+	pthread_mutex_unlock(&self->mutex);
+
+	return NULL;
+}
+
+/***********************************************************
+* public                                                   *
+***********************************************************/
+
+osmdb_scheduler_t* osmdb_scheduler_new(osmdb_tiler_t* tiler)
+{
+	ASSERT(tiler);
+
+	osmdb_scheduler_t* self;
+	self = (osmdb_scheduler_t*)
+	       CALLOC(1, sizeof(osmdb_scheduler_t));
+	if(self == NULL)
+	{
+		LOGE("CALLOC failed");
+		return NULL;
+	}
+
+	self->tiler   = tiler;
+	self->running = 1;
+	self->nth     = tiler->nth;
+
+	if(pthread_mutex_init(&self->mutex, NULL) != 0)
+	{
+		LOGE("pthread_mutex_init failed");
+		goto fail_mutex;
+	}
+
+	if(pthread_cond_init(&self->cond_queue, NULL) != 0)
+	{
+		LOGE("pthread_cond_init failed");
+		goto fail_cond_queue;
+	}
+
+	if(pthread_cond_init(&self->cond_done, NULL) != 0)
+	{
+		LOGE("pthread_cond_init failed");
+		goto fail_cond_done;
+	}
+
+	self->builders = (osmdb_schedulerBuilder_t*)
+	                 CALLOC(self->nth,
+	                        sizeof(osmdb_schedulerBuilder_t));
+	if(self->builders == NULL)
+	{
+		LOGE("CALLOC failed");
+		goto fail_builders;
+	}
+
+	int i;
+	for(i = 0; i < self->nth; ++i)
+	{
+		osmdb_schedulerBuilder_t* builder = &self->builders[i];
+		builder->tid       = i;
+		builder->scheduler = self;
+		if(pthread_create(&builder->thread, NULL,
+		                  osmdb_scheduler_run,
+		                  (void*) builder) != 0)
+		{
+			LOGE("pthread_create failed");
+			goto fail_thread;
+		}
+	}
+
+	// success
+	return self;
+
+	// failure
+	fail_thread:
+	{
+		pthread_mutex_lock(&self->mutex);
+		self->running = 0;
+		pthread_cond_broadcast(&self->cond_queue);
+		pthread_mutex_unlock(&self->mutex);
+
+		int j;
+		for(j = 0; j < i; ++j)
+		{
+			pthread_join(self->builders[j].thread, NULL);
+		}
+		FREE(self->builders);
+	}
+	fail_builders:
+		pthread_cond_destroy(&self->cond_done);
+	fail_cond_done:
+		pthread_cond_destroy(&self->cond_queue);
+	fail_cond_queue:
+		pthread_mutex_destroy(&self->mutex);
+	fail_mutex:
+		FREE(self);
+	return NULL;
+}
+
+void osmdb_scheduler_delete(osmdb_scheduler_t** _self)
+{
+	ASSERT(_self);
+
+	osmdb_scheduler_t* self = *_self;
+	if(self)
+	{
+		// the builders drain the queues before exiting
+		pthread_mutex_lock(&self->mutex);
+		self->running = 0;
+		pthread_cond_broadcast(&self->cond_queue);
+		pthread_mutex_unlock(&self->mutex);
+
+		int i;
+		for(i = 0; i < self->nth; ++i)
+		{
+			pthread_join(self->builders[i].thread, NULL);
+		}
+
+		FREE(self->builders);
+		FREE(self->jobs);
+		pthread_cond_destroy(&self->cond_done);
+		pthread_cond_destroy(&self->cond_queue);
+		pthread_mutex_destroy(&self->mutex);
+		FREE(self);
+		*_self = NULL;
+	}
+}
+
+int osmdb_scheduler_timeout(osmdb_scheduler_t* self,
+                            int priority, double timeout)
+{
+	ASSERT(self);
+
+	// timeout is in seconds where 0.0 disables the timeout
+	if((priority < 0) ||
+	   (priority >= OSMDB_SCHEDULER_PRIORITY_COUNT) ||
+	   (timeout < 0.0))
+	{
+		LOGE("invalid priority=%i, timeout=%lf",
+		     priority, timeout);
+		return 0;
+	}
+
+	pthread_mutex_lock(&self->mutex);
+	self->timeout[priority] = timeout;
+	pthread_mutex_unlock(&self->mutex);
+
+	return 1;
+}
+
+osmdb_tile_t*
+osmdb_scheduler_make(osmdb_scheduler_t* self, int priority,
+                     int zoom, int x, int y, size_t* _size)
+{
+	ASSERT(self);
+	ASSERT(_size);
+
+	return osmdb_scheduler_makeMask(self, priority,
+	                                zoom, x, y, NULL, _size);
+}
+
+osmdb_tile_t*
+osmdb_scheduler_makeMask(osmdb_scheduler_t* self,
+                         int priority,
+                         int zoom, int x, int y,
+                         const char* mask, size_t* _size)
+{
+	// mask may be NULL
+	ASSERT(self);
+	ASSERT(_size);
+
+	if((priority < 0) ||
+	   (priority >= OSMDB_SCHEDULER_PRIORITY_COUNT))
+	{
+		LOGE("invalid priority=%i", priority);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&self->mutex);
+
+	self->stats[priority].count += 1;
+
+	// a shared job may expire with the timeout of another
+	// priority (e.g. promoted to interactive) so waiters
+	// without a timeout rebuild a partial tile in full
+	osmdb_tile_t* tile = NULL;
+	int           full = 0;
+	while(1)
+	{
+		osmdb_schedulerJob_t* job;
+		job = osmdb_scheduler_submit(self, priority,
+		                             zoom, x, y, mask, full);
+		if(job == NULL)
+		{
+			break;
+		}
+
+		tile = osmdb_scheduler_wait(self, job, _size);
+		if(tile && (full == 0) &&
+		   (self->timeout[priority] == 0.0) &&
+		   (osmdb_tile_flags(*_size, tile) &
+		    OSMDB_TILE_FLAG_PARTIAL))
+		{
+			FREE(tile);
+			full = 1;
+			continue;
+		}
+		break;
+	}
+
+	pthread_mutex_unlock(&self->mutex);
+
+	return tile;
+}
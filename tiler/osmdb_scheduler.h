@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2021 Jeff Boody
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef osmdb_scheduler_H
+#define osmdb_scheduler_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "osmdb_tiler.h"
+
+// interactive requests are built ahead of background
+// requests (e.g. prefetch)
+#define OSMDB_SCHEDULER_PRIORITY_INTERACTIVE 0
+#define OSMDB_SCHEDULER_PRIORITY_BACKGROUND  1
+#define OSMDB_SCHEDULER_PRIORITY_COUNT       2
+
+// a job is shared by every request for the same tile
+// (single-flight) and is freed by the last waiter
+// jobs with a class mask (see osmdb_tiler_makeMask) are
+// not shared and the mask is owned by the waiter
+// full jobs are built without a deadline for waiters
+// which received a partial tile but have no timeout
+typedef struct osmdb_schedulerJob_s
+{
+	int zoom;
+	int x;
+	int y;
+	int priority;
+	int refcount;
+	int done;
+	int full;
+
+	const char* mask;
+
+	// result
+	size_t        size;
+	osmdb_tile_t* tile;
+
+	// timestamps
+	double t_submit;
+	double t_start;
+
+	// priority queue
+	struct osmdb_schedulerJob_s* next;
+} osmdb_schedulerJob_t;
+
+typedef struct
+{
+	uint64_t count;
+	uint64_t count_coalesced;
+	uint64_t count_built;
+	uint64_t count_partial;
+	double   wait_dt;
+	double   wait_max;
+	double   build_dt;
+	double   build_max;
+} osmdb_schedulerStats_t;
+
+struct osmdb_scheduler_s;
+
+typedef struct
+{
+	int                       tid;
+	pthread_t                 thread;
+	struct osmdb_scheduler_s* scheduler;
+} osmdb_schedulerBuilder_t;
+
+typedef struct osmdb_scheduler_s
+{
+	osmdb_tiler_t* tiler;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t  cond_queue;
+	pthread_cond_t  cond_done;
+	int             running;
+
+	// jobs which are queued or being built
+	int                    count_jobs;
+	int                    max_jobs;
+	osmdb_schedulerJob_t** jobs;
+
+	// priority queues
+	osmdb_schedulerJob_t* head[OSMDB_SCHEDULER_PRIORITY_COUNT];
+	osmdb_schedulerJob_t* tail[OSMDB_SCHEDULER_PRIORITY_COUNT];
+
+	// builder threads are mapped to the tiler tids
+	int                       nth;
+	osmdb_schedulerBuilder_t* builders;
+
+	// optional build timeout per priority which includes
+	// the queue wait time where expired builds return a
+	// partial tile (see OSMDB_TILE_FLAG_PARTIAL)
+	double timeout[OSMDB_SCHEDULER_PRIORITY_COUNT];
+
+	osmdb_schedulerStats_t stats[OSMDB_SCHEDULER_PRIORITY_COUNT];
+} osmdb_scheduler_t;
+
+osmdb_scheduler_t* osmdb_scheduler_new(osmdb_tiler_t* tiler);
+void               osmdb_scheduler_delete(osmdb_scheduler_t** _self);
+int                osmdb_scheduler_timeout(osmdb_scheduler_t* self,
+                                           int priority,
+                                           double timeout);
+osmdb_tile_t*      osmdb_scheduler_make(osmdb_scheduler_t* self,
+                                        int priority,
+                                        int zoom, int x, int y,
+                                        size_t* _size);
+osmdb_tile_t*      osmdb_scheduler_makeMask(osmdb_scheduler_t* self,
+                                            int priority,
+                                            int zoom, int x, int y,
+                                            const char* mask,
+                                            size_t* _size);
+
+#endif
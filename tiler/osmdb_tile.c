@@ -22,7 +22,9 @@
  */
 
 #include <inttypes.h>
+#include <limits.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define LOG_TAG "osmdb"
 #include "../../libcc/math/cc_pow2n.h"
@@ -253,6 +255,1119 @@ osmdb_tile_validateRel(size_t* _offset,
 	return 1;
 }
 
+static int
+osmdb_tile_validateHeader(osmdb_tile_t* self, size_t size)
+{
+	ASSERT(self);
+
+	if(size < sizeof(osmdb_tile_t))
+	{
+		LOGE("invalid size=%i", (int) size);
+		return 0;
+	}
+
+	// check header
+	if(self->magic != OSMDB_TILE_MAGIC)
+	{
+		LOGE("invalid magic=0x%X:0x%X",
+		     self->magic, OSMDB_TILE_MAGIC);
+		return 0;
+	}
+	else if((self->version != OSMDB_TILE_VERSION) &&
+	        (self->version != OSMDB_TILE_VERSION_V1))
+	{
+		LOGE("invalid version=%i:%i",
+		     self->version, OSMDB_TILE_VERSION);
+		return 0;
+	}
+
+	// check address
+	if((self->zoom < 0) || (self->zoom > 15) ||
+	   (self->x < 0) || (self->x >= cc_pow2n(self->zoom)) ||
+	   (self->y < 0) || (self->y >= cc_pow2n(self->zoom)))
+	{
+		LOGE("invalid %i/%i/%i",
+		     self->zoom, self->x, self->y);
+		return 0;
+	}
+
+	// check count
+	if((self->count_rels  < 0) ||
+	   (self->count_ways  < 0) ||
+	   (self->count_nodes < 0))
+	{
+		LOGE("invalid %i/%i/%i",
+		     self->count_rels, self->count_ways,
+		     self->count_nodes);
+		return 0;
+	}
+
+	return 1;
+}
+
+static int
+osmdb_tileIter_validateArray(osmdb_tileIter_t* self,
+                             int offset, int count)
+{
+	ASSERT(self);
+
+	// the offset is checked before the count such that
+	// the remaining size cannot overflow
+	size_t min = sizeof(osmdb_tile_t) +
+	             sizeof(osmdb_tileIndex_t);
+	if((offset < 0) || (count < 0) || (offset%4) ||
+	   ((size_t) offset < min) ||
+	   ((size_t) offset > self->size) ||
+	   ((size_t) count > (self->size - (size_t) offset)/4))
+	{
+		LOGE("invalid offset=%i, count=%i", offset, count);
+		return 0;
+	}
+
+	return 1;
+}
+
+static int
+osmdb_tileIter_varint(osmdb_tileIter_t* self, uint32_t* _v)
+{
+	ASSERT(self);
+	ASSERT(_v);
+
+	int trust = self->flags & OSMDB_TILEITER_FLAG_TRUST;
+
+	uint32_t v     = 0;
+	int      shift = 0;
+	while(trust || (self->offset < self->size))
+	{
+		uint32_t b = (uint32_t) self->data[self->offset];
+		++self->offset;
+
+		// a uint32_t fits in 5 bytes
+		if((shift == 28) && (b & 0xF0))
+		{
+			break;
+		}
+
+		v |= (b & 0x7F) << shift;
+		if((b & 0x80) == 0)
+		{
+			*_v = v;
+			return 1;
+		}
+		shift += 7;
+	}
+
+	LOGE("invalid varint");
+	return 0;
+}
+
+static int
+osmdb_tileIter_int(osmdb_tileIter_t* self, int* _i)
+{
+	ASSERT(self);
+	ASSERT(_i);
+
+	uint32_t v;
+	if(osmdb_tileIter_varint(self, &v) == 0)
+	{
+		return 0;
+	}
+	else if(v > INT_MAX)
+	{
+		LOGE("invalid v=%u", v);
+		return 0;
+	}
+
+	*_i = (int) v;
+	return 1;
+}
+
+static int
+osmdb_tileIter_zigzag(osmdb_tileIter_t* self, int* _i)
+{
+	ASSERT(self);
+	ASSERT(_i);
+
+	uint32_t v;
+	if(osmdb_tileIter_varint(self, &v) == 0)
+	{
+		return 0;
+	}
+
+	*_i = (int) ((v >> 1) ^ (~(v & 1) + 1));
+	return 1;
+}
+
+static int
+osmdb_tileIter_short(osmdb_tileIter_t* self,
+                     int base, short* _s)
+{
+	ASSERT(self);
+	ASSERT(_s);
+
+	int delta;
+	if(osmdb_tileIter_zigzag(self, &delta) == 0)
+	{
+		return 0;
+	}
+
+	// short: -32768 => 32767
+	int s = base + delta;
+	if((s < -32768) || (s > 32767))
+	{
+		LOGE("invalid s=%i", s);
+		return 0;
+	}
+
+	*_s = (short) s;
+	return 1;
+}
+
+static int
+osmdb_tileIter_point(osmdb_tileIter_t* self,
+                     osmdb_point_t* pt)
+{
+	ASSERT(self);
+	ASSERT(pt);
+
+	if((osmdb_tileIter_short(self, self->x, &pt->x) == 0) ||
+	   (osmdb_tileIter_short(self, self->y, &pt->y) == 0))
+	{
+		return 0;
+	}
+
+	self->x = pt->x;
+	self->y = pt->y;
+
+	return 1;
+}
+
+static int
+osmdb_tileIter_range(osmdb_tileIter_t* self,
+                     osmdb_point_t* center,
+                     osmdb_range_t* range)
+{
+	ASSERT(self);
+	ASSERT(center);
+	ASSERT(range);
+
+	short t;
+	short l;
+	short b;
+	short r;
+	if((osmdb_tileIter_short(self, center->y, &t) == 0) ||
+	   (osmdb_tileIter_short(self, center->x, &l) == 0) ||
+	   (osmdb_tileIter_short(self, center->y, &b) == 0) ||
+	   (osmdb_tileIter_short(self, center->x, &r) == 0))
+	{
+		return 0;
+	}
+
+	range->t = t;
+	range->l = l;
+	range->b = b;
+	range->r = r;
+
+	return 1;
+}
+
+static int
+osmdb_tileIter_name(osmdb_tileIter_t* self,
+                    const char** _name, int* _size_name)
+{
+	// _name may be NULL
+	ASSERT(self);
+	ASSERT(_size_name);
+
+	int idx;
+	if(osmdb_tileIter_int(self, &idx) == 0)
+	{
+		return 0;
+	}
+	else if(idx > self->index->count_names)
+	{
+		LOGE("invalid idx=%i, count=%i",
+		     idx, self->index->count_names);
+		return 0;
+	}
+
+	const char* name = NULL;
+	*_size_name = 0;
+	if(idx)
+	{
+		// size_name must be multiple of 4 bytes
+		name = (const char*) &self->data[self->names[idx - 1]];
+		*_size_name = 4*((((int) strlen(name)) + 4)/4);
+	}
+
+	if(_name)
+	{
+		*_name = name;
+	}
+
+	return 1;
+}
+
+static int
+osmdb_tileIter_readNode(osmdb_tileIter_t* self,
+                        osmdb_node_t* node,
+                        const char** _name)
+{
+	// _name may be NULL
+	ASSERT(self);
+	ASSERT(node);
+
+	if((osmdb_tileIter_int(self, &node->class)  == 0) ||
+	   (osmdb_tileIter_int(self, &node->flags)  == 0) ||
+	   (osmdb_tileIter_zigzag(self, &node->ele) == 0) ||
+	   (osmdb_tileIter_name(self, _name,
+	                        &node->size_name)   == 0) ||
+	   (osmdb_tileIter_point(self, &node->pt)   == 0))
+	{
+		return 0;
+	}
+
+	return 1;
+}
+
+static int
+osmdb_tileIter_growPts(osmdb_tileIter_t* self, int count)
+{
+	ASSERT(self);
+
+	if(count <= self->max_pts)
+	{
+		return 1;
+	}
+
+	int max_pts = 2*self->max_pts;
+	if(max_pts < 256)
+	{
+		max_pts = 256;
+	}
+	while(max_pts < count)
+	{
+		max_pts *= 2;
+	}
+
+	osmdb_point_t* pts;
+	pts = (osmdb_point_t*)
+	      REALLOC(self->pts, max_pts*sizeof(osmdb_point_t));
+	if(pts == NULL)
+	{
+		LOGE("REALLOC failed");
+		return 0;
+	}
+	self->pts = pts;
+
+	int* idx_pts;
+	idx_pts = (int*)
+	          REALLOC(self->idx_pts, max_pts*sizeof(int));
+	if(idx_pts == NULL)
+	{
+		LOGE("REALLOC failed");
+		return 0;
+	}
+	self->idx_pts = idx_pts;
+	self->max_pts = max_pts;
+
+	return 1;
+}
+
+static int
+osmdb_tileIter_readLod(osmdb_tileIter_t* self,
+                       osmdb_way_t* way,
+                       osmdb_point_t** _pts)
+{
+	// _pts may be NULL
+	ASSERT(self);
+	ASSERT(way);
+
+	int count_lod = self->index->count_lod;
+
+	int    i;
+	int    count[OSMDB_TILE_LOD_COUNT];
+	int    bytes[OSMDB_TILE_LOD_COUNT];
+	size_t total_count = 0;
+	size_t total_bytes = 0;
+	for(i = 0; i < count_lod; ++i)
+	{
+		if((osmdb_tileIter_int(self, &count[i]) == 0) ||
+		   (osmdb_tileIter_int(self, &bytes[i]) == 0))
+		{
+			return 0;
+		}
+		total_count += (size_t) count[i];
+		total_bytes += (size_t) bytes[i];
+	}
+
+	if((total_count != (size_t) way->count) ||
+	   (((self->flags & OSMDB_TILEITER_FLAG_TRUST) == 0) &&
+	    (total_bytes > self->size - self->offset)))
+	{
+		LOGE("invalid count=%i, bytes=%i",
+		     way->count, (int) total_bytes);
+		return 0;
+	}
+
+	int lod = self->lod;
+	if(lod >= count_lod)
+	{
+		lod = count_lod - 1;
+	}
+
+	int n = 0;
+	for(i = 0; i <= lod; ++i)
+	{
+		n += count[i];
+	}
+
+	// skip the pts of the higher levels of detail
+	size_t end = self->offset + total_bytes;
+	if(_pts == NULL)
+	{
+		way->count   = n;
+		self->offset = end;
+		return 1;
+	}
+
+	// the pts of each level are read after the merged pts
+	// and merged from the back by idx
+	if(osmdb_tileIter_growPts(self, 2*n) == 0)
+	{
+		return 0;
+	}
+
+	int j;
+	int k;
+	int m = 0;
+	osmdb_point_t* pts     = self->pts;
+	int*           idx_pts = self->idx_pts;
+	for(i = 0; i <= lod; ++i)
+	{
+		size_t offset = self->offset;
+		int    idx    = -1;
+		for(j = n; j < n + count[i]; ++j)
+		{
+			int delta;
+			if(osmdb_tileIter_int(self, &delta) == 0)
+			{
+				return 0;
+			}
+			else if(delta >= way->count - idx - 1)
+			{
+				LOGE("invalid delta=%i", delta);
+				return 0;
+			}
+			idx += delta + 1;
+
+			idx_pts[j] = idx;
+			if(osmdb_tileIter_point(self, &pts[j]) == 0)
+			{
+				return 0;
+			}
+		}
+
+		if(self->offset - offset != (size_t) bytes[i])
+		{
+			LOGE("invalid bytes=%i", bytes[i]);
+			return 0;
+		}
+
+		j = m - 1;
+		k = n + count[i] - 1;
+		m += count[i];
+		while(k >= n)
+		{
+			int dst = j + k - n + 1;
+			if((j >= 0) && (idx_pts[j] > idx_pts[k]))
+			{
+				pts[dst]     = pts[j];
+				idx_pts[dst] = idx_pts[j];
+				--j;
+			}
+			else
+			{
+				pts[dst]     = pts[k];
+				idx_pts[dst] = idx_pts[k];
+				--k;
+			}
+		}
+	}
+
+	self->size_pts += self->offset - (end - total_bytes);
+	self->offset    = end;
+	self->x         = way->center.x;
+	self->y         = way->center.y;
+
+	way->count = n;
+	*_pts      = n ? pts : NULL;
+
+	return 1;
+}
+
+static int
+osmdb_tileIter_readWay(osmdb_tileIter_t* self,
+                       osmdb_way_t* way,
+                       const char** _name,
+                       osmdb_point_t** _pts)
+{
+	// _name and _pts may be NULL
+	ASSERT(self);
+	ASSERT(way);
+
+	if((osmdb_tileIter_int(self, &way->class)    == 0) ||
+	   (osmdb_tileIter_int(self, &way->flags)    == 0) ||
+	   (osmdb_tileIter_zigzag(self, &way->layer) == 0) ||
+	   (osmdb_tileIter_name(self, _name,
+	                        &way->size_name)     == 0) ||
+	   (osmdb_tileIter_point(self, &way->center) == 0) ||
+	   (osmdb_tileIter_range(self, &way->center,
+	                         &way->range)        == 0) ||
+	   (osmdb_tileIter_int(self, &way->count)    == 0))
+	{
+		return 0;
+	}
+
+	if(self->index->count_lod)
+	{
+		return osmdb_tileIter_readLod(self, way, _pts);
+	}
+
+	// each point requires at least two bytes
+	if(((self->flags & OSMDB_TILEITER_FLAG_TRUST) == 0) &&
+	   ((size_t) way->count > (self->size - self->offset)/2))
+	{
+		LOGE("invalid count=%i", way->count);
+		return 0;
+	}
+
+	if(_pts && (osmdb_tileIter_growPts(self, way->count) == 0))
+	{
+		return 0;
+	}
+
+	// pts are relative to the previous pt which starts at
+	// the center and the cursor is restored to the center
+	int    i;
+	size_t offset = self->offset;
+	osmdb_point_t pt;
+	for(i = 0; i < way->count; ++i)
+	{
+		if(osmdb_tileIter_point(self, &pt) == 0)
+		{
+			return 0;
+		}
+
+		if(_pts)
+		{
+			self->pts[i] = pt;
+		}
+	}
+	self->x = way->center.x;
+	self->y = way->center.y;
+
+	if(_pts)
+	{
+		self->size_pts += self->offset - offset;
+		*_pts = way->count ? self->pts : NULL;
+	}
+
+	return 1;
+}
+
+static int
+osmdb_tileIter_readRel(osmdb_tileIter_t* self,
+                       osmdb_rel_t* rel,
+                       const char** _name)
+{
+	// _name may be NULL
+	ASSERT(self);
+	ASSERT(rel);
+
+	if((osmdb_tileIter_int(self, &rel->class)    == 0) ||
+	   (osmdb_tileIter_int(self, &rel->flags)    == 0) ||
+	   (osmdb_tileIter_int(self, &rel->type)     == 0) ||
+	   (osmdb_tileIter_name(self, _name,
+	                        &rel->size_name)     == 0) ||
+	   (osmdb_tileIter_point(self, &rel->center) == 0) ||
+	   (osmdb_tileIter_range(self, &rel->center,
+	                         &rel->range)        == 0) ||
+	   (osmdb_tileIter_int(self, &rel->count)    == 0))
+	{
+		return 0;
+	}
+
+	return 1;
+}
+
+static int
+osmdb_tileIter_skip(osmdb_tileIter_t* self, int section)
+{
+	ASSERT(self);
+
+	osmdb_rel_t  rel;
+	osmdb_way_t  way;
+	osmdb_node_t node;
+	if(section == OSMDB_TILEITER_SECTION_RELS)
+	{
+		if(osmdb_tileIter_readRel(self, &rel, NULL) == 0)
+		{
+			return 0;
+		}
+
+		int i;
+		for(i = 0; i < rel.count; ++i)
+		{
+			if(osmdb_tileIter_readWay(self, &way,
+			                          NULL, NULL) == 0)
+			{
+				return 0;
+			}
+		}
+
+		return 1;
+	}
+	else if(section == OSMDB_TILEITER_SECTION_WAYS)
+	{
+		return osmdb_tileIter_readWay(self, &way, NULL, NULL);
+	}
+
+	return osmdb_tileIter_readNode(self, &node, NULL);
+}
+
+static int
+osmdb_tileIter_seek(osmdb_tileIter_t* self,
+                    int section, int idx)
+{
+	ASSERT(self);
+
+	int count[OSMDB_TILEITER_SECTION_COUNT] =
+	{
+		self->tile->count_rels,
+		self->tile->count_ways,
+		self->tile->count_nodes,
+	};
+
+	if((idx < 0) || (idx >= count[section]))
+	{
+		LOGE("invalid section=%i, idx=%i", section, idx);
+		return 0;
+	}
+
+	// continue from the cursor when reading sequentially
+	// within a block
+	if((self->section == section) && (self->idx == idx) &&
+	   (self->members == 0) && (idx%OSMDB_TILE_BLOCK_SIZE))
+	{
+		return 1;
+	}
+
+	// restart at the block and skip to the idx
+	int b = idx/OSMDB_TILE_BLOCK_SIZE;
+	self->section = -1;
+	self->members = 0;
+	self->offset  = (size_t) self->blocks[section][b];
+	self->x       = 0;
+	self->y       = 0;
+
+	int i;
+	for(i = b*OSMDB_TILE_BLOCK_SIZE; i < idx; ++i)
+	{
+		if(osmdb_tileIter_skip(self, section) == 0)
+		{
+			return 0;
+		}
+	}
+
+	self->section = section;
+	self->idx     = idx;
+
+	return 1;
+}
+
+static int
+osmdb_tileIter_validateGrid(osmdb_tileIter_t* self)
+{
+	ASSERT(self);
+
+	int offset = self->index->offset_grid;
+	if((offset == 0) ||
+	   (self->flags & OSMDB_TILEITER_FLAG_NOGRID))
+	{
+		return 1;
+	}
+	else if(osmdb_tileIter_validateArray(self, offset, 1) == 0)
+	{
+		return 0;
+	}
+
+	int cells = *((const int*) &self->data[offset]);
+	if((cells <= 0) || (cells > OSMDB_TILE_GRID_MAX))
+	{
+		LOGE("invalid cells=%i", cells);
+		return 0;
+	}
+
+	// the start and refs are uint16_t arrays which are
+	// checked in bytes since the offset of the cells is
+	// valid and the arrays have at most 64K entries
+	int    count_start  = cells*cells + 1;
+	size_t offset_start = (size_t) offset + 4;
+	size_t size_start   = 2*((size_t) count_start);
+	if(size_start > self->size - offset_start)
+	{
+		LOGE("invalid cells=%i, size=%" PRId64,
+		     cells, (int64_t) self->size);
+		return 0;
+	}
+
+	const uint16_t* start;
+	start = (const uint16_t*) &self->data[offset_start];
+
+	int    count_refs  = start[count_start - 1];
+	size_t offset_refs = offset_start + size_start;
+	if(2*((size_t) count_refs) > self->size - offset_refs)
+	{
+		LOGE("invalid count_refs=%i, size=%" PRId64,
+		     count_refs, (int64_t) self->size);
+		return 0;
+	}
+
+	self->cells = cells;
+	self->start = start;
+	self->refs  = (const uint16_t*) &self->data[offset_refs];
+
+	if(self->flags & OSMDB_TILEITER_FLAG_TRUST)
+	{
+		return 1;
+	}
+
+	osmdb_tile_t* tile = self->tile;
+	int count[OSMDB_TILEITER_SECTION_COUNT] =
+	{
+		tile->count_rels,
+		tile->count_ways,
+		tile->count_nodes,
+	};
+
+	int i;
+	for(i = 0; i < count_start - 1; ++i)
+	{
+		if((start[0] != 0) || (start[i] > start[i + 1]))
+		{
+			LOGE("invalid start=%i", i);
+			return 0;
+		}
+	}
+
+	for(i = 0; i < count_refs; ++i)
+	{
+		int section = self->refs[i] >> OSMDB_TILE_GRID_SHIFT;
+		int idx     = self->refs[i] & OSMDB_TILE_GRID_MASK;
+		if((section >= OSMDB_TILEITER_SECTION_COUNT) ||
+		   (idx >= count[section]))
+		{
+			LOGE("invalid ref=0x%X", (unsigned int) self->refs[i]);
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+static int
+osmdb_tileIter_addHit(osmdb_tileIter_t* self, int* _count,
+                      int section, int idx)
+{
+	ASSERT(self);
+	ASSERT(_count);
+
+	int count = *_count;
+	if(count == self->max_hits)
+	{
+		int max_hits = 2*self->max_hits;
+		if(max_hits == 0)
+		{
+			max_hits = 256;
+		}
+
+		osmdb_tileHit_t* hits;
+		hits = (osmdb_tileHit_t*)
+		       REALLOC(self->hits,
+		               max_hits*sizeof(osmdb_tileHit_t));
+		if(hits == NULL)
+		{
+			LOGE("REALLOC failed");
+			return 0;
+		}
+
+		self->hits     = hits;
+		self->max_hits = max_hits;
+	}
+
+	self->hits[count].section = section;
+	self->hits[count].idx     = idx;
+	*_count = count + 1;
+
+	return 1;
+}
+
+static int osmdb_tileIter_cmpHit(const void* a, const void* b)
+{
+	ASSERT(a);
+	ASSERT(b);
+
+	const osmdb_tileHit_t* ha = (const osmdb_tileHit_t*) a;
+	const osmdb_tileHit_t* hb = (const osmdb_tileHit_t*) b;
+	if(ha->section != hb->section)
+	{
+		return ha->section - hb->section;
+	}
+	return ha->idx - hb->idx;
+}
+
+static int
+osmdb_tileIter_overlap(osmdb_range_t* a, osmdb_range_t* b)
+{
+	ASSERT(a);
+	ASSERT(b);
+
+	// ranges are clamped so the t/b and l/r may be swapped
+	int al = (a->l < a->r) ? a->l : a->r;
+	int ar = (a->l < a->r) ? a->r : a->l;
+	int ab = (a->b < a->t) ? a->b : a->t;
+	int at = (a->b < a->t) ? a->t : a->b;
+	int bl = (b->l < b->r) ? b->l : b->r;
+	int br = (b->l < b->r) ? b->r : b->l;
+	int bb = (b->b < b->t) ? b->b : b->t;
+	int bt = (b->b < b->t) ? b->t : b->b;
+
+	return (al <= br) && (ar >= bl) && (ab <= bt) && (at >= bb);
+}
+
+static int
+osmdb_tileIter_hit(osmdb_tileIter_t* self,
+                   osmdb_tileHit_t* hit,
+                   osmdb_range_t* range, int* _hit)
+{
+	ASSERT(self);
+	ASSERT(hit);
+	ASSERT(range);
+	ASSERT(_hit);
+
+	osmdb_rel_t   rel;
+	osmdb_way_t   way;
+	osmdb_node_t  node;
+	osmdb_range_t pt;
+
+	*_hit = 0;
+	if(hit->section == OSMDB_TILEITER_SECTION_RELS)
+	{
+		if(osmdb_tileIter_rel(self, hit->idx, &rel, NULL) == 0)
+		{
+			return 0;
+		}
+
+		// skip members so that the next rel continues
+		// from the cursor
+		int i;
+		for(i = 0; i < rel.count; ++i)
+		{
+			if(osmdb_tileIter_member(self, &way,
+			                         NULL, NULL) == 0)
+			{
+				return 0;
+			}
+		}
+
+		*_hit = osmdb_tileIter_overlap(&rel.range, range);
+	}
+	else if(hit->section == OSMDB_TILEITER_SECTION_WAYS)
+	{
+		if(osmdb_tileIter_way(self, hit->idx, &way,
+		                      NULL, NULL) == 0)
+		{
+			return 0;
+		}
+
+		*_hit = osmdb_tileIter_overlap(&way.range, range);
+	}
+	else
+	{
+		if(osmdb_tileIter_node(self, hit->idx,
+		                       &node, NULL) == 0)
+		{
+			return 0;
+		}
+
+		pt.t = node.pt.y;
+		pt.l = node.pt.x;
+		pt.b = node.pt.y;
+		pt.r = node.pt.x;
+		*_hit = osmdb_tileIter_overlap(&pt, range);
+	}
+
+	return 1;
+}
+
+// decoder state for the V1 layout
+typedef struct
+{
+	size_t size;
+	size_t offset;
+	char*  data;
+} osmdb_tileDecoder_t;
+
+static void*
+osmdb_tileDecoder_add(osmdb_tileDecoder_t* self,
+                      size_t size, const void* data,
+                      int size_name, const char* name)
+{
+	// name may be NULL
+	ASSERT(self);
+	ASSERT(data);
+
+	// osmdb_tileDecoder_add may invalidate pointers into
+	// the output data
+
+	size_t offset = self->offset;
+	size_t resize = offset + size + size_name;
+	if(self->size < resize)
+	{
+		// grow geometrically
+		size_t tmp_size = 2*self->size;
+		if(tmp_size < 4096)
+		{
+			tmp_size = 4096;
+		}
+		while(tmp_size < resize)
+		{
+			tmp_size *= 2;
+		}
+
+		void* tmp = REALLOC(self->data, tmp_size);
+		if(tmp == NULL)
+		{
+			LOGE("REALLOC failed");
+			return NULL;
+		}
+
+		self->data = (char*) tmp;
+		self->size = tmp_size;
+	}
+
+	// pad name with null characters
+	char* ptr = &self->data[offset];
+	memcpy((void*) ptr, data, size);
+	if(name)
+	{
+		size_t len = strlen(name);
+		memcpy((void*) &ptr[size], (const void*) name, len);
+		memset((void*) &ptr[size + len], 0,
+		       (size_t) size_name - len);
+	}
+	self->offset = resize;
+
+	return (void*) ptr;
+}
+
+static int
+osmdb_tileDecoder_way(osmdb_tileDecoder_t* self,
+                      osmdb_tileIter_t* iter,
+                      osmdb_tileParser_t* parser,
+                      int idx)
+{
+	// parser may be NULL
+	ASSERT(self);
+	ASSERT(iter);
+
+	// members are read when idx is -1
+	osmdb_way_t    tmp;
+	const char*    name = NULL;
+	osmdb_point_t* pts  = NULL;
+	if(idx < 0)
+	{
+		if(osmdb_tileIter_member(iter, &tmp, &name, &pts) == 0)
+		{
+			return 0;
+		}
+	}
+	else if(osmdb_tileIter_way(iter, idx, &tmp,
+	                           &name, &pts) == 0)
+	{
+		return 0;
+	}
+
+	size_t       offset = self->offset;
+	osmdb_way_t* way;
+	way = (osmdb_way_t*)
+	      osmdb_tileDecoder_add(self, sizeof(osmdb_way_t),
+	                            (const void*) &tmp,
+	                            tmp.size_name, name);
+	if(way == NULL)
+	{
+		return 0;
+	}
+
+	if(tmp.count)
+	{
+		if(osmdb_tileDecoder_add(self,
+		                         tmp.count*sizeof(osmdb_point_t),
+		                         (const void*) pts,
+		                         0, NULL) == NULL)
+		{
+			return 0;
+		}
+
+		// restore way in case data was reallocated
+		way = (osmdb_way_t*) &self->data[offset];
+	}
+
+	if(parser)
+	{
+		osmdb_tileParser_wayFn way_fn = parser->way_fn;
+		if(idx < 0)
+		{
+			way_fn = parser->member_fn;
+		}
+		return (*way_fn)(parser->priv, way);
+	}
+
+	return 1;
+}
+
+static osmdb_tile_t*
+osmdb_tile_decode(size_t size, void* data,
+                  osmdb_tileParser_t* parser)
+{
+	// parser may be NULL
+	ASSERT(data);
+
+	osmdb_tileIter_t iter;
+	memset((void*) &iter, 0, sizeof(osmdb_tileIter_t));
+	if(osmdb_tileIter_init(&iter, size, data, 0) == 0)
+	{
+		return NULL;
+	}
+
+	osmdb_tileDecoder_t self =
+	{
+		.size = 0,
+	};
+
+	osmdb_tile_t tile;
+	memcpy((void*) &tile, data, sizeof(osmdb_tile_t));
+	tile.version = OSMDB_TILE_VERSION_V1;
+	if(osmdb_tileDecoder_add(&self, sizeof(osmdb_tile_t),
+	                         (const void*) &tile,
+	                         0, NULL) == NULL)
+	{
+		goto fail_decode;
+	}
+
+	int i;
+	int j;
+	for(i = 0; i < tile.count_rels; ++i)
+	{
+		osmdb_rel_t  tmp;
+		const char*  name = NULL;
+		osmdb_rel_t* rel;
+		if(osmdb_tileIter_rel(&iter, i, &tmp, &name) == 0)
+		{
+			goto fail_decode;
+		}
+
+		rel = (osmdb_rel_t*)
+		      osmdb_tileDecoder_add(&self, sizeof(osmdb_rel_t),
+		                            (const void*) &tmp,
+		                            tmp.size_name, name);
+		if(rel == NULL)
+		{
+			goto fail_decode;
+		}
+
+		if(parser)
+		{
+			osmdb_tileParser_relFn rel_fn = parser->rel_fn;
+			if((*rel_fn)(parser->priv, rel) == 0)
+			{
+				goto fail_decode;
+			}
+		}
+
+		for(j = 0; j < tmp.count; ++j)
+		{
+			if(osmdb_tileDecoder_way(&self, &iter,
+			                         parser, -1) == 0)
+			{
+				goto fail_decode;
+			}
+		}
+	}
+
+	for(i = 0; i < tile.count_ways; ++i)
+	{
+		if(osmdb_tileDecoder_way(&self, &iter,
+		                         parser, i) == 0)
+		{
+			goto fail_decode;
+		}
+	}
+
+	for(i = 0; i < tile.count_nodes; ++i)
+	{
+		osmdb_node_t  tmp;
+		const char*   name = NULL;
+		osmdb_node_t* node;
+		if(osmdb_tileIter_node(&iter, i, &tmp, &name) == 0)
+		{
+			goto fail_decode;
+		}
+
+		node = (osmdb_node_t*)
+		       osmdb_tileDecoder_add(&self, sizeof(osmdb_node_t),
+		                             (const void*) &tmp,
+		                             tmp.size_name, name);
+		if(node == NULL)
+		{
+			goto fail_decode;
+		}
+
+		if(parser)
+		{
+			osmdb_tileParser_nodeFn node_fn = parser->node_fn;
+			if((*node_fn)(parser->priv, node) == 0)
+			{
+				goto fail_decode;
+			}
+		}
+	}
+
+	FREE(iter.idx_pts);
+	FREE(iter.pts);
+
+	// shrink the tile to the decoded size
+	void* tmp = REALLOC(self.data, self.offset);
+	if(tmp)
+	{
+		self.data = (char*) tmp;
+	}
+
+	// take ownership of data
+	FREE(data);
+
+	// success
+	return (osmdb_tile_t*) self.data;
+
+	// failure
+	fail_decode:
+		FREE(self.data);
+		FREE(iter.idx_pts);
+		FREE(iter.pts);
+	return NULL;
+}
+
 /***********************************************************
 * public                                                   *
 ***********************************************************/
@@ -316,45 +1431,19 @@ osmdb_tile_t* osmdb_tile_new(size_t size, void* data,
 	// parser may be NULL
 	ASSERT(data);
 
-	osmdb_tile_t* self  = (osmdb_tile_t*) data;
-	size_t        dsize = sizeof(osmdb_tile_t);
-	if((self == NULL) || (size < dsize))
+	osmdb_tile_t* self = (osmdb_tile_t*) data;
+	if(osmdb_tile_validateHeader(self, size) == 0)
 	{
-		LOGE("invalid tile=%p, size=%i", self, (int) size);
-		return NULL;
-	}
-	size -= dsize;
-
-	// check header
-	if((self->magic   != OSMDB_TILE_MAGIC) &&
-	   (self->version != OSMDB_TILE_VERSION))
-	{
-		LOGE("invalid magic=0x%X:%0x%X, version=%i:%i",
-		     self->magic, OSMDB_TILE_MAGIC,
-		     self->version, OSMDB_TILE_VERSION);
 		return NULL;
 	}
 
-	// check address
-	if((self->zoom < 0) || (self->zoom > 15) ||
-	   (self->x < 0) || (self->x >= cc_pow2n(self->zoom)) ||
-	   (self->y < 0) || (self->y >= cc_pow2n(self->zoom)))
+	if(self->version == OSMDB_TILE_VERSION)
 	{
-		LOGE("invalid %i/%i/%i",
-		     self->zoom, self->x, self->y);
-		return NULL;
+		return osmdb_tile_decode(size, data, parser);
 	}
 
-	// check count
-	if((self->count_rels  < 0) ||
-	   (self->count_ways  < 0) ||
-	   (self->count_nodes < 0))
-	{
-		LOGE("invalid %i/%i/%i",
-		     self->count_rels, self->count_ways,
-		     self->count_nodes);
-		return NULL;
-	}
+	size_t dsize = sizeof(osmdb_tile_t);
+	size -= dsize;
 
 	int i;
 	size_t offset = dsize;
@@ -414,3 +1503,464 @@ void osmdb_tile_range(osmdb_tile_t* self,
 
 	osmdb_range_init(range, self->zoom, self->x, self->y);
 }
+
+uint32_t osmdb_tile_checksum(size_t size, const void* data)
+{
+	ASSERT(data);
+
+	const unsigned char* ptr = (const unsigned char*) data;
+
+	// Adler-32 where the modulo is deferred for 5552 bytes
+	uint32_t a = 1;
+	uint32_t b = 0;
+	while(size)
+	{
+		size_t n = (size < 5552) ? size : 5552;
+		size -= n;
+		while(n)
+		{
+			a += *ptr;
+			b += a;
+			++ptr;
+			--n;
+		}
+		a %= 65521;
+		b %= 65521;
+	}
+
+	return (b << 16) | a;
+}
+
+int osmdb_tile_gridCell(int cells, int v)
+{
+	// tile coordinates: -16384 => 16383
+	int c = ((v + 16384)*cells) >> 15;
+	if(c < 0)
+	{
+		return 0;
+	}
+	else if(c >= cells)
+	{
+		return cells - 1;
+	}
+	return c;
+}
+
+int osmdb_tile_flags(size_t size, const void* data)
+{
+	ASSERT(data);
+
+	// the V1 layout does not include the flags
+	const osmdb_tile_t* tile = (const osmdb_tile_t*) data;
+	if((size < sizeof(osmdb_tile_t) +
+	           sizeof(osmdb_tileIndex_t)) ||
+	   (tile->magic   != OSMDB_TILE_MAGIC) ||
+	   (tile->version != OSMDB_TILE_VERSION))
+	{
+		return 0;
+	}
+
+	const unsigned char* ptr = (const unsigned char*) data;
+	osmdb_tileIndex_t    index;
+	memcpy((void*) &index,
+	       (const void*) &ptr[sizeof(osmdb_tile_t)],
+	       sizeof(osmdb_tileIndex_t));
+
+	return index.flags;
+}
+
+osmdb_tileIter_t* osmdb_tileIter_new(void)
+{
+	osmdb_tileIter_t* self;
+	self = (osmdb_tileIter_t*)
+	       CALLOC(1, sizeof(osmdb_tileIter_t));
+	if(self == NULL)
+	{
+		LOGE("CALLOC failed");
+		return NULL;
+	}
+
+	return self;
+}
+
+void osmdb_tileIter_delete(osmdb_tileIter_t** _self)
+{
+	ASSERT(_self);
+
+	osmdb_tileIter_t* self = *_self;
+	if(self)
+	{
+		FREE(self->hits);
+		FREE(self->idx_pts);
+		FREE(self->pts);
+		FREE(self);
+		*_self = NULL;
+	}
+}
+
+int osmdb_tileIter_init(osmdb_tileIter_t* self,
+                        size_t size, const void* data,
+                        int flags)
+{
+	ASSERT(self);
+	ASSERT(data);
+
+	// retain the pts and hits buffers
+	int              max_pts  = self->max_pts;
+	osmdb_point_t*   pts      = self->pts;
+	int*             idx_pts  = self->idx_pts;
+	int              max_hits = self->max_hits;
+	osmdb_tileHit_t* hits     = self->hits;
+	memset((void*) self, 0, sizeof(osmdb_tileIter_t));
+	self->max_pts  = max_pts;
+	self->pts      = pts;
+	self->idx_pts  = idx_pts;
+	self->max_hits = max_hits;
+	self->hits     = hits;
+	self->section  = -1;
+	self->lod      = OSMDB_TILE_LOD_COUNT - 1;
+
+	osmdb_tile_t* tile = (osmdb_tile_t*) data;
+	if(osmdb_tile_validateHeader(tile, size) == 0)
+	{
+		return 0;
+	}
+	else if((tile->version != OSMDB_TILE_VERSION) ||
+	        (size < sizeof(osmdb_tile_t) +
+	                sizeof(osmdb_tileIndex_t)) ||
+	        (size > INT_MAX))
+	{
+		LOGE("invalid version=%i, size=%i",
+		     tile->version, (int) size);
+		return 0;
+	}
+
+	const unsigned char* ptr = (const unsigned char*) data;
+	osmdb_tileIndex_t*   index;
+	index = (osmdb_tileIndex_t*) &ptr[sizeof(osmdb_tile_t)];
+
+	self->size  = size;
+	self->data  = ptr;
+	self->flags = flags;
+	self->tile  = tile;
+	self->index = index;
+
+	// check the index arrays
+	int b = OSMDB_TILE_BLOCK_SIZE;
+	int count_blocks[OSMDB_TILEITER_SECTION_COUNT] =
+	{
+		(tile->count_rels  + b - 1)/b,
+		(tile->count_ways  + b - 1)/b,
+		(tile->count_nodes + b - 1)/b,
+	};
+	int offset_blocks[OSMDB_TILEITER_SECTION_COUNT] =
+	{
+		index->offset_rels,
+		index->offset_ways,
+		index->offset_nodes,
+	};
+	if(osmdb_tileIter_validateArray(self, index->offset_names,
+	                                index->count_names) == 0)
+	{
+		return 0;
+	}
+	self->names = (const int*) &ptr[index->offset_names];
+
+	if((index->count_lod < 0) ||
+	   (index->count_lod > OSMDB_TILE_LOD_COUNT))
+	{
+		LOGE("invalid count_lod=%i", index->count_lod);
+		return 0;
+	}
+
+	int i;
+	int j;
+	for(i = 0; i < OSMDB_TILEITER_SECTION_COUNT; ++i)
+	{
+		if(osmdb_tileIter_validateArray(self, offset_blocks[i],
+		                                count_blocks[i]) == 0)
+		{
+			return 0;
+		}
+		self->blocks[i] = (const int*) &ptr[offset_blocks[i]];
+	}
+
+	if(osmdb_tileIter_validateGrid(self) == 0)
+	{
+		return 0;
+	}
+
+	// the checksum replaces the checks of each name, block
+	// and record
+	if(flags & OSMDB_TILEITER_FLAG_TRUST)
+	{
+		size_t   offset = sizeof(osmdb_tile_t) + sizeof(uint32_t);
+		uint32_t checksum;
+		checksum = osmdb_tile_checksum(size - offset,
+		                               &ptr[offset]);
+		if(checksum != index->checksum)
+		{
+			LOGE("invalid checksum=0x%X:0x%X",
+			     checksum, index->checksum);
+			return 0;
+		}
+
+		return 1;
+	}
+
+	// names must be terminated by null character
+	for(i = 0; i < index->count_names; ++i)
+	{
+		int offset = self->names[i];
+		if((offset < 0) || ((size_t) offset >= size) ||
+		   (memchr((const void*) &ptr[offset], '\0',
+		           size - (size_t) offset) == NULL))
+		{
+			LOGE("invalid name=%i", i);
+			return 0;
+		}
+	}
+
+	for(i = 0; i < OSMDB_TILEITER_SECTION_COUNT; ++i)
+	{
+		for(j = 0; j < count_blocks[i]; ++j)
+		{
+			int offset = self->blocks[i][j];
+			if((offset < 0) || ((size_t) offset >= size))
+			{
+				LOGE("invalid block=%i:%i", i, j);
+				return 0;
+			}
+		}
+	}
+
+	return 1;
+}
+
+void osmdb_tileIter_lod(osmdb_tileIter_t* self, int zoom)
+{
+	ASSERT(self);
+
+	int lod = zoom - OSMDB_TILE_LOD_ZOOM;
+	if(lod < 0)
+	{
+		lod = 0;
+	}
+	else if(lod >= OSMDB_TILE_LOD_COUNT)
+	{
+		lod = OSMDB_TILE_LOD_COUNT - 1;
+	}
+
+	self->lod = lod;
+}
+
+int osmdb_tileIter_rel(osmdb_tileIter_t* self, int idx,
+                       osmdb_rel_t* rel, const char** _name)
+{
+	// _name may be NULL
+	ASSERT(self);
+	ASSERT(rel);
+
+	int section = OSMDB_TILEITER_SECTION_RELS;
+	if((osmdb_tileIter_seek(self, section, idx)   == 0) ||
+	   (osmdb_tileIter_readRel(self, rel, _name) == 0))
+	{
+		self->section = -1;
+		return 0;
+	}
+
+	self->idx     = idx + 1;
+	self->members = rel->count;
+
+	return 1;
+}
+
+int osmdb_tileIter_member(osmdb_tileIter_t* self,
+                          osmdb_way_t* way,
+                          const char** _name,
+                          osmdb_point_t** _pts)
+{
+	// _name and _pts may be NULL
+	ASSERT(self);
+	ASSERT(way);
+
+	if((self->section != OSMDB_TILEITER_SECTION_RELS) ||
+	   (self->members <= 0))
+	{
+		LOGE("invalid section=%i, members=%i",
+		     self->section, self->members);
+		return 0;
+	}
+
+	if(osmdb_tileIter_readWay(self, way, _name, _pts) == 0)
+	{
+		self->section = -1;
+		return 0;
+	}
+
+	--self->members;
+
+	return 1;
+}
+
+int osmdb_tileIter_way(osmdb_tileIter_t* self, int idx,
+                       osmdb_way_t* way, const char** _name,
+                       osmdb_point_t** _pts)
+{
+	// _name and _pts may be NULL
+	ASSERT(self);
+	ASSERT(way);
+
+	int section = OSMDB_TILEITER_SECTION_WAYS;
+	if((osmdb_tileIter_seek(self, section, idx) == 0) ||
+	   (osmdb_tileIter_readWay(self, way, _name, _pts) == 0))
+	{
+		self->section = -1;
+		return 0;
+	}
+
+	self->idx = idx + 1;
+
+	return 1;
+}
+
+int osmdb_tileIter_node(osmdb_tileIter_t* self, int idx,
+                        osmdb_node_t* node, const char** _name)
+{
+	// _name may be NULL
+	ASSERT(self);
+	ASSERT(node);
+
+	int section = OSMDB_TILEITER_SECTION_NODES;
+	if((osmdb_tileIter_seek(self, section, idx)     == 0) ||
+	   (osmdb_tileIter_readNode(self, node, _name) == 0))
+	{
+		self->section = -1;
+		return 0;
+	}
+
+	self->idx = idx + 1;
+
+	return 1;
+}
+
+int osmdb_tileIter_query(osmdb_tileIter_t* self,
+                         osmdb_range_t* range,
+                         int* _count,
+                         osmdb_tileHit_t** _hits)
+{
+	ASSERT(self);
+	ASSERT(range);
+	ASSERT(_count);
+	ASSERT(_hits);
+
+	osmdb_tile_t* tile = self->tile;
+	if(tile == NULL)
+	{
+		LOGE("invalid");
+		return 0;
+	}
+
+	// collect the candidates from the grid cells or every
+	// record when the grid was omitted
+	int i;
+	int j;
+	int k;
+	int count = 0;
+	if(self->cells)
+	{
+		int cells = self->cells;
+		int l     = (range->l < range->r) ? range->l : range->r;
+		int r     = (range->l < range->r) ? range->r : range->l;
+		int b     = (range->b < range->t) ? range->b : range->t;
+		int t     = (range->b < range->t) ? range->t : range->b;
+		int x0    = osmdb_tile_gridCell(cells, l);
+		int x1    = osmdb_tile_gridCell(cells, r);
+		int y0    = osmdb_tile_gridCell(cells, b);
+		int y1    = osmdb_tile_gridCell(cells, t);
+		for(i = y0; i <= y1; ++i)
+		{
+			for(j = x0; j <= x1; ++j)
+			{
+				int c = i*cells + j;
+				for(k = self->start[c]; k < self->start[c + 1]; ++k)
+				{
+					int ref     = self->refs[k];
+					int section = ref >> OSMDB_TILE_GRID_SHIFT;
+					int idx     = ref & OSMDB_TILE_GRID_MASK;
+					if(osmdb_tileIter_addHit(self, &count,
+					                         section, idx) == 0)
+					{
+						return 0;
+					}
+				}
+			}
+		}
+
+		// remove duplicates of records which overlap
+		// several cells and sort by section/idx so that
+		// records are read sequentially when possible
+		if(count > 1)
+		{
+			qsort((void*) self->hits, (size_t) count,
+			      sizeof(osmdb_tileHit_t),
+			      osmdb_tileIter_cmpHit);
+
+			k = 1;
+			for(i = 1; i < count; ++i)
+			{
+				if(osmdb_tileIter_cmpHit(&self->hits[i],
+				                         &self->hits[k - 1]))
+				{
+					self->hits[k] = self->hits[i];
+					++k;
+				}
+			}
+			count = k;
+		}
+	}
+	else
+	{
+		int n[OSMDB_TILEITER_SECTION_COUNT] =
+		{
+			tile->count_rels,
+			tile->count_ways,
+			tile->count_nodes,
+		};
+
+		for(i = 0; i < OSMDB_TILEITER_SECTION_COUNT; ++i)
+		{
+			for(j = 0; j < n[i]; ++j)
+			{
+				if(osmdb_tileIter_addHit(self, &count,
+				                         i, j) == 0)
+				{
+					return 0;
+				}
+			}
+		}
+	}
+
+	// keep the candidates which overlap the range
+	k = 0;
+	for(i = 0; i < count; ++i)
+	{
+		int hit = 0;
+		if(osmdb_tileIter_hit(self, &self->hits[i],
+		                      range, &hit) == 0)
+		{
+			return 0;
+		}
+
+		if(hit)
+		{
+			self->hits[k] = self->hits[i];
+			++k;
+		}
+	}
+
+	*_count = k;
+	*_hits  = self->hits;
+
+	return 1;
+}
@@ -28,8 +28,9 @@
 
 #include "../osmdb_range.h"
 
-#define OSMDB_TILE_MAGIC   0xB00D90DB
-#define OSMDB_TILE_VERSION 20220523
+#define OSMDB_TILE_MAGIC      0xB00D90DB
+#define OSMDB_TILE_VERSION    20261016
+#define OSMDB_TILE_VERSION_V1 20220523
 
 typedef struct
 {
@@ -68,6 +69,7 @@ char* osmdb_node_name(osmdb_node_t* self);
 #define OSMDB_WAY_FLAG_CUTTING  0x0010
 #define OSMDB_WAY_FLAG_BUILDING 0x0020
 #define OSMDB_WAY_FLAG_NAMEREF  0x0040
+#define OSMDB_WAY_FLAG_AREA     0x0080
 #define OSMDB_WAY_FLAG_INNER    0x1000
 
 typedef struct
@@ -91,6 +93,7 @@ osmdb_point_t* osmdb_way_pts(osmdb_way_t* self);
 
 #define OSMDB_REL_FLAG_BUILDING 0x0020
 #define OSMDB_REL_FLAG_NAMEREF  0x0040
+#define OSMDB_REL_FLAG_AREA     0x0080
 
 typedef struct
 {
@@ -113,6 +116,65 @@ char* osmdb_rel_name(osmdb_rel_t* self);
 // tl: (0.0, 0.0) => (16383, -16384)
 // br: (1.0, 1.0) => (-16384, 16383)
 // short: -32768 => 32767
+//
+// OSMDB_TILE_VERSION_V1 is the decoded tile layout where
+// the rels/ways/nodes follow the header as raw structs.
+//
+// OSMDB_TILE_VERSION is the compact encoding which is
+// stored in the cache. The header is unchanged and is
+// followed by osmdb_tileIndex_t, the index arrays, the
+// string table and the rels/ways/nodes where every field
+// is a varint (zz is a zigzag varint).
+//
+// rel:  class, flags, type, name, zz center, zz range,
+//       count, way[count]
+// way:  class, flags, zz layer, name, zz center,
+//       zz range, count, zz pts[count]
+// node: class, flags, zz ele, name, zz pt
+//
+// name is 0 for no name or the string table index + 1
+// and the zz fields are deltas. The center and node pt
+// are relative to the previous center/pt, the range is
+// relative to the center and the pts are relative to the
+// previous pt which starts at the center.
+//
+// The rels/ways/nodes are split into blocks of
+// OSMDB_TILE_BLOCK_SIZE records where the delta cursor
+// restarts at (0, 0) so that a record may be found by
+// index after skipping at most one block of records.
+//
+// The optional grid follows the records and divides the
+// tile into cells*cells cells where each cell lists the
+// rels/ways/nodes whose range overlaps the cell. The
+// encoder halves the cells until the grid fits in the
+// bytes saved versus the V1 layout and omits the grid for
+// small tiles, for sections with more records than the
+// refs can index or when no grid fits.
+//
+// Zoom 15 tiles serve zooms 15-20 so the way pts are
+// ordered by level of detail when count_lod is non-zero.
+// The zz pts[count] are replaced by the size of each
+// level followed by the pts of each level in order.
+//
+// way:  ..., count, lod[count_lod], pts[count_lod]
+// lod:  count, bytes
+// pts:  (idx, zz pt)[count]
+//
+// The pts of level i are required for zoom 16 + i (see
+// OSMDB_TILE_LOD_ZOOM) and the idx is the delta to the
+// previous idx of the level (starting at -1) minus one
+// such that the pts of the levels up to i are merged by
+// idx to produce the way. The endpoints are level 0.
+//
+// The index flags are set by the tiler where the PARTIAL
+// flag marks a degraded tile whose build expired before
+// all of the rels/ways/nodes were added (see
+// osmdb_tiler_makeToken) and the SUBSET flag marks a tile
+// which only includes the classes selected by a class mask
+// (see osmdb_tiler_makeMask). Such tiles must not be
+// cached in place of the full tile. The flags are not
+// preserved by the V1 layout.
+//
 typedef struct
 {
 	int     magic;
@@ -129,6 +191,48 @@ typedef struct
 	// osmdb_node_t nodes[];
 } osmdb_tile_t;
 
+#define OSMDB_TILE_BLOCK_SIZE 16
+
+// the grid is omitted for tiles with fewer records
+#define OSMDB_TILE_GRID_MAX       32
+#define OSMDB_TILE_GRID_MIN_COUNT 64
+
+// grid refs are (section << 14) | idx
+// see OSMDB_TILEITER_SECTION_RELS
+#define OSMDB_TILE_GRID_SHIFT    14
+#define OSMDB_TILE_GRID_MASK     0x3FFF
+#define OSMDB_TILE_GRID_MAX_REFS 0xFFFF
+
+#define OSMDB_TILE_FLAG_PARTIAL 0x0001
+#define OSMDB_TILE_FLAG_SUBSET  0x0002
+
+// levels of detail for zoom 15 tiles which serve zooms
+// 16-20 where level 0 also serves zoom 15
+#define OSMDB_TILE_LOD_COUNT 5
+#define OSMDB_TILE_LOD_ZOOM  16
+
+// offsets are relative to the start of the tile
+// the checksum (Adler-32) covers the bytes which follow
+// the checksum field
+typedef struct
+{
+	uint32_t checksum;
+	int      count_names;
+	int      offset_names;  // int offset[count_names]
+	int      offset_rels;   // int offset[count_blocks]
+	int      offset_ways;   // int offset[count_blocks]
+	int      offset_nodes;  // int offset[count_blocks]
+	int      offset_grid;   // 0 if the grid is omitted
+	int      count_lod;     // 0 if the pts are in order
+	int      flags;         // see OSMDB_TILE_FLAG_*
+	// int  index[];
+	// char names[];
+	// records[];
+	// int      cells;
+	// uint16_t start[cells*cells + 1];
+	// uint16_t refs[start[cells*cells]];
+} osmdb_tileIndex_t;
+
 typedef int (*osmdb_tileParser_relFn)(void* priv,
                                       osmdb_rel_t* rel);
 typedef int (*osmdb_tileParser_wayFn)(void* priv,
@@ -145,10 +249,115 @@ typedef struct
 	osmdb_tileParser_nodeFn node_fn;
 } osmdb_tileParser_t;
 
+// osmdb_tile_new takes ownership of data on success and
+// the returned tile is always in the V1 layout
 osmdb_tile_t* osmdb_tile_new(size_t size, void* data,
                              osmdb_tileParser_t* parser);
 void          osmdb_tile_delete(osmdb_tile_t** _self);
 void          osmdb_tile_range(osmdb_tile_t* self,
                                osmdb_range_t* range);
+uint32_t      osmdb_tile_checksum(size_t size,
+                                  const void* data);
+int           osmdb_tile_gridCell(int cells, int v);
+int           osmdb_tile_flags(size_t size,
+                               const void* data);
+
+// the iterator provides random access to the rels/ways/
+// nodes of an encoded tile without decoding the tile
+// names point into the tile data and pts are decoded into
+// a buffer owned by the iterator which is valid until the
+// next call
+// the rel/way/node structs only contain the fields so the
+// name/pts functions (e.g. osmdb_way_pts) do not apply
+// iterators may share the same tile data so that a tile
+// may be decoded on multiple threads
+// the TRUST flag verifies the checksum rather than
+// validating the index and bounds of each record
+// the NOGRID flag ignores the grid so that queries scan
+// every record
+// osmdb_tileIter_lod selects the level of detail of the
+// way pts for the zoom level (e.g. 15-20) which is reset
+// to the full detail by osmdb_tileIter_init
+#define OSMDB_TILEITER_FLAG_TRUST  0x0001
+#define OSMDB_TILEITER_FLAG_NOGRID 0x0002
+
+#define OSMDB_TILEITER_SECTION_RELS  0
+#define OSMDB_TILEITER_SECTION_WAYS  1
+#define OSMDB_TILEITER_SECTION_NODES 2
+#define OSMDB_TILEITER_SECTION_COUNT 3
+
+typedef struct
+{
+	int section;
+	int idx;
+} osmdb_tileHit_t;
+
+typedef struct
+{
+	// tile data
+	size_t               size;
+	const unsigned char* data;
+	int                  flags;
+	osmdb_tile_t*        tile;
+	osmdb_tileIndex_t*   index;
+	const int*           names;
+	const int*           blocks[OSMDB_TILEITER_SECTION_COUNT];
+	int                  cells;
+	const uint16_t*      start;
+	const uint16_t*      refs;
+
+	// cursor
+	int    section;
+	int    idx;
+	int    members;
+	size_t offset;
+	int    x;
+	int    y;
+
+	// decoded pts
+	// idx_pts is the scratch buffer to merge the lod pts
+	int            max_pts;
+	osmdb_point_t* pts;
+	int*           idx_pts;
+
+	// lod is the highest level of detail decoded and
+	// size_pts counts the bytes of pts decoded
+	int    lod;
+	size_t size_pts;
+
+	// query hits
+	int              max_hits;
+	osmdb_tileHit_t* hits;
+} osmdb_tileIter_t;
+
+osmdb_tileIter_t* osmdb_tileIter_new(void);
+void              osmdb_tileIter_delete(osmdb_tileIter_t** _self);
+int               osmdb_tileIter_init(osmdb_tileIter_t* self,
+                                      size_t size,
+                                      const void* data,
+                                      int flags);
+void              osmdb_tileIter_lod(osmdb_tileIter_t* self,
+                                     int zoom);
+int               osmdb_tileIter_rel(osmdb_tileIter_t* self,
+                                     int idx,
+                                     osmdb_rel_t* rel,
+                                     const char** _name);
+int               osmdb_tileIter_member(osmdb_tileIter_t* self,
+                                        osmdb_way_t* way,
+                                        const char** _name,
+                                        osmdb_point_t** _pts);
+int               osmdb_tileIter_way(osmdb_tileIter_t* self,
+                                     int idx,
+                                     osmdb_way_t* way,
+                                     const char** _name,
+                                     osmdb_point_t** _pts);
+int               osmdb_tileIter_node(osmdb_tileIter_t* self,
+                                      int idx,
+                                      osmdb_node_t* node,
+                                      const char** _name);
+int               osmdb_tileIter_query(osmdb_tileIter_t* self,
+                                       osmdb_range_t* range,
+                                       int* _count,
+                                       osmdb_tileHit_t** _hits);
 
 #endif
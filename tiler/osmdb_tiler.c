@@ -31,32 +31,54 @@
 #include "libcc/math/cc_vec3d.h"
 #include "libcc/cc_log.h"
 #include "libcc/cc_memory.h"
-#include "terrain/terrain_util.h"
+#include "libcc/cc_timestamp.h"
+#include "../osmdb_proj.h"
+#include "../osmdb_util.h"
+#include "osmdb_clip.h"
 #include "osmdb_tiler.h"
 #include "osmdb_waySegment.h"
 
 const int OSMDB_ONE = 1;
 
-#define OSMDB_QUADRANT_NONE   0
-#define OSMDB_QUADRANT_TOP    1
-#define OSMDB_QUADRANT_LEFT   2
-#define OSMDB_QUADRANT_BOTTOM 3
-#define OSMDB_QUADRANT_RIGHT  4
-
-#define OSMDB_EXPORT_TYPE_NODE     0
-#define OSMDB_EXPORT_TYPE_WAY      1
-#define OSMDB_EXPORT_TYPE_RELATION 2
-
+// cached rels are packed as the header followed by the
+// wids of the member ways drawn by the rel and the packed
+// segs (see osmdb_waySegment_pack)
 typedef struct
 {
-	int     type;
-	int64_t id;
-} osmdb_exportKey_t;
+	int count_wids;
+	int count_segs;
+} osmdb_tilerRelPack_t;
 
 /***********************************************************
 * private                                                  *
 ***********************************************************/
 
+static int osmdb_tiler_expired(osmdb_tiler_t* self, int tid)
+{
+	ASSERT(self);
+
+	osmdb_tilerState_t* state = self->state[tid];
+	osmdb_tilerToken_t* token = state->token;
+
+	if(state->expired)
+	{
+		return 1;
+	}
+	else if(token == NULL)
+	{
+		return 0;
+	}
+
+	if(token->cancel ||
+	   ((token->deadline > 0.0) &&
+	    (cc_timestamp() >= token->deadline)))
+	{
+		state->expired = 1;
+	}
+
+	return state->expired;
+}
+
 static int
 osmdb_tiler_gatherNode(osmdb_tiler_t* self,
                        int tid,
@@ -66,17 +88,11 @@ osmdb_tiler_gatherNode(osmdb_tiler_t* self,
 
 	osmdb_tilerState_t* state = self->state[tid];
 
-	osmdb_exportKey_t key =
-	{
-		.type = OSMDB_EXPORT_TYPE_NODE,
-		.id   = nid
-	};
-
 	// check if node is already included by a relation
-	cc_mapIter_t* miter;
-	miter = cc_map_findp(state->map_export,
-	                     sizeof(osmdb_exportKey_t), &key);
-	if(miter)
+	uintptr_t bits;
+	bits = (uintptr_t) osmdb_idmap_find(state->map_export_nodes,
+	                                    nid);
+	if(bits & (1 << state->meta_k))
 	{
 		return 1;
 	}
@@ -128,6 +144,201 @@ osmdb_tiler_gatherNode(osmdb_tiler_t* self,
 	return 0;
 }
 
+static int64_t
+osmdb_tiler_thinScore(osmdb_tiler_t* self,
+                      osmdb_nodeInfo_t* node_info)
+{
+	ASSERT(self);
+	ASSERT(node_info);
+
+	// nodes are ordered by capital flags, class importance
+	// (e.g. the style min_zoom), name presence and then by
+	// elevation (e.g. for peaks)
+	int64_t score = 0;
+	if(node_info->flags & OSMDB_NODEINFO_FLAG_COUNTRY_CAPITAL)
+	{
+		score = 2;
+	}
+	else if(node_info->flags & OSMDB_NODEINFO_FLAG_STATE_CAPITAL)
+	{
+		score = 1;
+	}
+
+	int min_zoom = 255;
+	if(self->thin_min_zoom &&
+	   (node_info->class >= 0) &&
+	   (node_info->class < osmdb_classCount()))
+	{
+		min_zoom = self->thin_min_zoom[node_info->class];
+		if(min_zoom < 0)
+		{
+			min_zoom = 0;
+		}
+		else if(min_zoom > 255)
+		{
+			min_zoom = 255;
+		}
+	}
+	score = (score << 8) + (255 - min_zoom);
+
+	score = score << 1;
+	if(node_info->size_name)
+	{
+		score += 1;
+	}
+
+	int ele = node_info->ele;
+	if(ele < 0)
+	{
+		ele = 0;
+	}
+	else if(ele > 0xFFFFFF)
+	{
+		ele = 0xFFFFFF;
+	}
+	score = (score << 24) + ele;
+
+	return score;
+}
+
+static void
+osmdb_tiler_discardThin(osmdb_tiler_t* self, int tid)
+{
+	ASSERT(self);
+
+	osmdb_tilerState_t* state = self->state[tid];
+
+	int i;
+	int count = self->thin_cells*self->thin_cells;
+	for(i = 0; i < count; ++i)
+	{
+		osmdb_tilerThin_t* thin = &state->thin[i];
+		osmdb_index_put(self->index, &thin->hnc);
+		osmdb_index_put(self->index, &thin->hni);
+	}
+}
+
+static int
+osmdb_tiler_thinNode(osmdb_tiler_t* self,
+                     int tid,
+                     int64_t nid)
+{
+	ASSERT(self);
+
+	osmdb_tilerState_t* state = self->state[tid];
+
+	// check if node is already included by a relation
+	uintptr_t bits;
+	bits = (uintptr_t) osmdb_idmap_find(state->map_export_nodes,
+	                                    nid);
+	if(bits & (1 << state->meta_k))
+	{
+		return 1;
+	}
+
+	// handles may not exist due to osmosis
+	osmdb_handle_t* hni;
+	if(osmdb_index_get(self->index, tid,
+	                   OSMDB_TYPE_NODEINFO,
+	                   nid, &hni) == 0)
+	{
+		return 0;
+	}
+	else if(hni == NULL)
+	{
+		return 1;
+	}
+
+	osmdb_handle_t* hnc;
+	if(osmdb_index_get(self->index, tid,
+	                   OSMDB_TYPE_NODECOORD,
+	                   nid, &hnc) == 0)
+	{
+		osmdb_index_put(self->index, &hni);
+		return 0;
+	}
+	else if(hnc == NULL)
+	{
+		osmdb_index_put(self->index, &hni);
+		return 1;
+	}
+
+	// find the cell from the world coordinates
+	int     cells = self->thin_cells;
+	int     s     = 31 - state->zoom;
+	int64_t x0    = ((int64_t) state->x) << s;
+	int64_t y0    = ((int64_t) state->y) << s;
+	int64_t cx    = ((hnc->node_coord->x - x0)*cells) >> s;
+	int64_t cy    = ((hnc->node_coord->y - y0)*cells) >> s;
+	if(cx < 0)
+	{
+		cx = 0;
+	}
+	else if(cx >= cells)
+	{
+		cx = cells - 1;
+	}
+	if(cy < 0)
+	{
+		cy = 0;
+	}
+	else if(cy >= cells)
+	{
+		cy = cells - 1;
+	}
+
+	// keep the best candidate for the cell
+	osmdb_tilerThin_t* thin = &state->thin[cells*cy + cx];
+	if((thin->hni == NULL) ||
+	   (osmdb_tiler_thinScore(self, hni->node_info) >
+	    osmdb_tiler_thinScore(self, thin->hni->node_info)))
+	{
+		osmdb_index_put(self->index, &thin->hnc);
+		osmdb_index_put(self->index, &thin->hni);
+		thin->hni = hni;
+		thin->hnc = hnc;
+	}
+	else
+	{
+		osmdb_index_put(self->index, &hnc);
+		osmdb_index_put(self->index, &hni);
+	}
+
+	return 1;
+}
+
+static int
+osmdb_tiler_exportThin(osmdb_tiler_t* self, int tid)
+{
+	ASSERT(self);
+
+	osmdb_tilerState_t* state = self->state[tid];
+
+	int i;
+	int count = self->thin_cells*self->thin_cells;
+	for(i = 0; i < count; ++i)
+	{
+		osmdb_tilerThin_t* thin = &state->thin[i];
+		if(thin->hni == NULL)
+		{
+			continue;
+		}
+
+		if(osmdb_ostream_addNode(state->os,
+		                         thin->hni->node_info,
+		                         thin->hnc->node_coord) == 0)
+		{
+			osmdb_tiler_discardThin(self, tid);
+			return 0;
+		}
+
+		osmdb_index_put(self->index, &thin->hnc);
+		osmdb_index_put(self->index, &thin->hni);
+	}
+
+	return 1;
+}
+
 static int
 osmdb_tiler_gatherNodes(osmdb_tiler_t* self, int tid)
 {
@@ -190,23 +401,79 @@ osmdb_tiler_gatherNodes(osmdb_tiler_t* self, int tid)
 		return 1;
 	}
 
+	// nodes are thinned to the best candidate per cell
+	// except for zoom 15 which includes all nodes for the
+	// higher zoom levels
+	int thin = (self->thin_cells > 0) && (state->zoom < 15);
+
 	// gather nodes in tile
+	// refs are sorted by class so the mask is applied
+	// before the nodes are looked up
 	int      i;
-	int      ret   = 1;
-	int      count = htr->tile_refs->count;
-	int64_t* refs  = osmdb_tileRefs_refs(htr->tile_refs);
-	for(i = 0; i < count; ++i)
-	{
-		if(osmdb_tiler_gatherNode(self, tid, refs[i]) == 0)
+	int      j;
+	int      class;
+	int      count;
+	int64_t* refs;
+	for(j = 0; j < htr->tile_refs->count_classes; ++j)
+	{
+		refs = osmdb_tileRefs_classRefs(htr->tile_refs, j,
+		                                &class, &count);
+		if(state->mask && (state->mask[class] == 0))
+		{
+			continue;
+		}
+
+		for(i = 0; i < count; ++i)
+		{
+			if(osmdb_tiler_expired(self, tid))
+			{
+				break;
+			}
+
+			if(thin)
+			{
+				if(osmdb_tiler_thinNode(self, tid, refs[i]) == 0)
+				{
+					goto fail_gather_node;
+				}
+			}
+			else if(osmdb_tiler_gatherNode(self, tid,
+			                               refs[i]) == 0)
+			{
+				goto fail_gather_node;
+			}
+		}
+
+		if(state->expired)
 		{
-			ret = 0;
 			break;
 		}
 	}
 
+	// the thinned nodes are incomplete on expiry
+	if(thin && state->expired)
+	{
+		osmdb_tiler_discardThin(self, tid);
+	}
+	else if(thin && (osmdb_tiler_exportThin(self, tid) == 0))
+	{
+		goto fail_export;
+	}
+
 	osmdb_index_put(self->index, &htr);
 
-	return ret;
+	// success
+	return 1;
+
+	// failure
+	fail_gather_node:
+		if(thin)
+		{
+			osmdb_tiler_discardThin(self, tid);
+		}
+	fail_export:
+		osmdb_index_put(self->index, &htr);
+	return 0;
 }
 
 static int
@@ -227,33 +494,67 @@ osmdb_tiler_joinWay(osmdb_tiler_t* self, int tid,
 		return 0;
 	}
 
-	// check if way is complete
-	int64_t* refa1 = (int64_t*) cc_list_peekHead(a->list_nds);
-	int64_t* refa2 = (int64_t*) cc_list_peekTail(a->list_nds);
-	int64_t* refb1 = (int64_t*) cc_list_peekHead(b->list_nds);
-	int64_t* refb2 = (int64_t*) cc_list_peekTail(b->list_nds);
-	if((refa1 == NULL) || (refa2 == NULL) ||
-	   (refb1 == NULL) || (refb2 == NULL))
+	// only try to join ways with multiple nds
+	if((a->chain_count < 2) || (b->chain_count < 2))
 	{
 		return 0;
 	}
 
-	// only try to join ways with multiple nds
-	if((cc_list_size(a->list_nds) < 2) ||
-	   (cc_list_size(b->list_nds) < 2))
+	int64_t refa1;
+	int64_t refa2;
+	int64_t refb1;
+	int64_t refb2;
+	refa1 = osmdb_waySegment_endNd(a, OSMDB_WAYSEGMENT_HEAD, 0, NULL);
+	refa2 = osmdb_waySegment_endNd(a, OSMDB_WAYSEGMENT_TAIL, 0, NULL);
+	refb1 = osmdb_waySegment_endNd(b, OSMDB_WAYSEGMENT_HEAD, 0, NULL);
+	refb2 = osmdb_waySegment_endNd(b, OSMDB_WAYSEGMENT_TAIL, 0, NULL);
+
+	// don't try to join loops
+	if((refa1 == refa2) || (refb1 == refb2))
 	{
 		return 0;
 	}
 
-	// don't try to join loops
-	if((*refa1 == *refa2) || (*refb1 == *refb2))
+	// check if ref1 is included in both ways and
+	// how they should be joined
+	int end_a;
+	int end_b;
+	if((ref1 == refa1) && (ref1 == refb2))
+	{
+		// join head-to-tail
+		end_a = OSMDB_WAYSEGMENT_HEAD;
+		end_b = OSMDB_WAYSEGMENT_TAIL;
+		*ref2 = refb1;
+	}
+	else if((ref1 == refa2) && (ref1 == refb1))
+	{
+		// join tail-to-head
+		end_a = OSMDB_WAYSEGMENT_TAIL;
+		end_b = OSMDB_WAYSEGMENT_HEAD;
+		*ref2 = refb2;
+	}
+	else if((ref1 == refa1) && (ref1 == refb1))
+	{
+		// join head-to-head
+		end_a = OSMDB_WAYSEGMENT_HEAD;
+		end_b = OSMDB_WAYSEGMENT_HEAD;
+		*ref2 = refb2;
+	}
+	else if((ref1 == refa2) && (ref1 == refb2))
+	{
+		// join tail-to-tail
+		end_a = OSMDB_WAYSEGMENT_TAIL;
+		end_b = OSMDB_WAYSEGMENT_TAIL;
+		*ref2 = refb1;
+	}
+	else
 	{
 		return 0;
 	}
 
 	// check if ways may be joined
-	osmdb_wayInfo_t* ai = a->hwi->way_info;
-	osmdb_wayInfo_t* bi = b->hwi->way_info;
+	osmdb_wayInfo_t* ai = a->way_info;
+	osmdb_wayInfo_t* bi = b->way_info;
 	if(is_member == 0)
 	{
 		if((ai->class != bi->class)  ||
@@ -278,86 +579,43 @@ osmdb_tiler_joinWay(osmdb_tiler_t* self, int tid,
 			return 0;
 		}
 
-		// check if ref1 is included in both ways and
-		// how they should be joined
-		int64_t*       refp;
-		int64_t*       refn;
-		cc_listIter_t* next;
-		cc_listIter_t* prev;
-		if((ref1 == *refa1) && (ref1 == *refb2))
-		{
-			// join head-to-tail
-			prev = cc_list_next(cc_list_head(a->list_nds));
-			next = cc_list_prev(cc_list_tail(b->list_nds));
-		}
-		else if((ref1 == *refa2) && (ref1 == *refb1))
-		{
-			// join tail-to-head
-			prev = cc_list_next(cc_list_head(b->list_nds));
-			next = cc_list_prev(cc_list_tail(a->list_nds));
-		}
-		else if((ref1 == *refa1) && (ref1 == *refb1))
-		{
-			// join head-to-head
-			prev = cc_list_next(cc_list_head(a->list_nds));
-			next = cc_list_next(cc_list_head(b->list_nds));
-		}
-		else if((ref1 == *refa2) && (ref1 == *refb2))
-		{
-			// join tail-to-tail
-			prev = cc_list_prev(cc_list_tail(a->list_nds));
-			next = cc_list_prev(cc_list_tail(b->list_nds));
-		}
-		else
+		// check join angle to prevent joining ways
+		// at a sharp angle since this causes weird
+		// rendering artifacts
+		// the world coordinates of the nds were resolved
+		// when the segments were created and nds which are
+		// missing due to osmosis are not joined
+		osmdb_tilePoint_t wpt[3];
+		osmdb_waySegment_endNd(a, end_a, 1, &wpt[0]);
+		osmdb_waySegment_endNd(a, end_a, 0, &wpt[1]);
+		osmdb_waySegment_endNd(b, end_b, 1, &wpt[2]);
+		if((wpt[0].x == OSMDB_WAYSEGMENT_MISSING) ||
+		   (wpt[1].x == OSMDB_WAYSEGMENT_MISSING) ||
+		   (wpt[2].x == OSMDB_WAYSEGMENT_MISSING))
 		{
 			return 0;
 		}
-		refp = (int64_t*) cc_list_peekIter(prev);
-		refn = (int64_t*) cc_list_peekIter(next);
-
-		// identify the nodes to be joined
-		osmdb_handle_t* hnc0 = NULL;
-		osmdb_handle_t* hnc1 = NULL;
-		osmdb_handle_t* hnc2 = NULL;
-		if((osmdb_index_get(self->index, tid,
-		                    OSMDB_TYPE_NODECOORD,
-		                    *refp, &hnc0) == 0) ||
-		   (osmdb_index_get(self->index, tid,
-		                    OSMDB_TYPE_NODECOORD,
-		                    ref1, &hnc1) == 0) ||
-		   (osmdb_index_get(self->index, tid,
-		                    OSMDB_TYPE_NODECOORD,
-		                    *refn, &hnc2) == 0) ||
-		   (hnc0 == NULL) || (hnc1 == NULL) ||
-		   (hnc2 == NULL))
-		{
-			osmdb_index_put(self->index, &hnc0);
-			osmdb_index_put(self->index, &hnc1);
-			osmdb_index_put(self->index, &hnc2);
-			return 0;
-		}
 
-		// check join angle to prevent joining ways
-		// at a sharp angle since this causes weird
-		// rendering artifacts
+		int    wx[3] = { wpt[0].x, wpt[1].x, wpt[2].x };
+		int    wy[3] = { wpt[0].y, wpt[1].y, wpt[2].y };
+		double lat[3];
+		double lon[3];
+		osmdb_proj_world2coord(3, wx, wy, lat, lon);
+
+		double x[3];
+		double y[3];
+		double z[3];
+		osmdb_proj_geo2xyz(3, lat, lon, cc_mi2m(5280.0f),
+		                   x, y, z);
+
 		cc_vec3d_t p0;
 		cc_vec3d_t p1;
 		cc_vec3d_t p2;
 		cc_vec3d_t v01;
 		cc_vec3d_t v12;
-		osmdb_nodeCoord_t* nc0 = hnc0->node_coord;
-		osmdb_nodeCoord_t* nc1 = hnc1->node_coord;
-		osmdb_nodeCoord_t* nc2 = hnc2->node_coord;
-		float onemi = cc_mi2m(5280.0f);
-		terrain_geo2xyz(nc0->lat, nc0->lon, onemi,
-		                &p0.x,  &p0.y, &p0.z);
-		terrain_geo2xyz(nc1->lat, nc1->lon, onemi,
-		                &p1.x,  &p1.y, &p1.z);
-		terrain_geo2xyz(nc2->lat, nc2->lon, onemi,
-		                &p2.x,  &p2.y, &p2.z);
-		osmdb_index_put(self->index, &hnc0);
-		osmdb_index_put(self->index, &hnc1);
-		osmdb_index_put(self->index, &hnc2);
+		cc_vec3d_load(&p0, x[0], y[0], z[0]);
+		cc_vec3d_load(&p1, x[1], y[1], z[1]);
+		cc_vec3d_load(&p2, x[2], y[2], z[2]);
 		cc_vec3d_subv_copy(&p1, &p0, &v01);
 		cc_vec3d_subv_copy(&p2, &p1, &v12);
 		cc_vec3d_normalize(&v01);
@@ -369,69 +627,8 @@ osmdb_tiler_joinWay(osmdb_tiler_t* self, int tid,
 		}
 	}
 
-	// join ways
-	cc_listIter_t* iter;
-	cc_listIter_t* temp;
-	if((ref1 == *refa1) && (ref1 == *refb2))
-	{
-		// join head-to-tail
-		// skip the last node
-		iter = cc_list_tail(b->list_nds);
-		iter = cc_list_prev(iter);
-		while(iter)
-		{
-			temp = cc_list_prev(iter);
-			cc_list_swap(b->list_nds, a->list_nds, iter, NULL);
-			iter = temp;
-		}
-		*ref2 = *refb1;
-	}
-	else if((ref1 == *refa2) && (ref1 == *refb1))
-	{
-		// join tail-to-head
-		// skip the first node
-		iter = cc_list_head(b->list_nds);
-		iter = cc_list_next(iter);
-		while(iter)
-		{
-			temp = cc_list_next(iter);
-			cc_list_swapn(b->list_nds, a->list_nds, iter, NULL);
-			iter = temp;
-		}
-		*ref2 = *refb2;
-	}
-	else if((ref1 == *refa1) && (ref1 == *refb1))
-	{
-		// join head-to-head
-		// skip the first node
-		iter = cc_list_head(b->list_nds);
-		iter = cc_list_next(iter);
-		while(iter)
-		{
-			temp = cc_list_next(iter);
-			cc_list_swap(b->list_nds, a->list_nds, iter, NULL);
-			iter = temp;
-		}
-		*ref2 = *refb2;
-	}
-	else if((ref1 == *refa2) && (ref1 == *refb2))
-	{
-		// join tail-to-tail
-		// skip the last node
-		iter = cc_list_tail(b->list_nds);
-		iter = cc_list_prev(iter);
-		while(iter)
-		{
-			temp = cc_list_prev(iter);
-			cc_list_swapn(b->list_nds, a->list_nds, iter, NULL);
-			iter = temp;
-		}
-		*ref2 = *refb1;
-	}
-	else
-	{
-		return 0;
-	}
+	// join ways in constant time
+	osmdb_waySegment_join(a, end_a, b, end_b);
 
 	// combine range
 	if(b->way_range.latT > a->way_range.latT)
@@ -462,466 +659,531 @@ osmdb_tiler_joinWays(osmdb_tiler_t* self, int tid,
 
 	osmdb_tilerState_t* state = self->state[tid];
 
-	osmdb_waySegment_t* seg1;
-	osmdb_waySegment_t* seg2;
-	cc_multimapIter_t   mmiterator1;
-	cc_multimapIter_t*  mmiter1;
-	cc_multimapIter_t   mmiterator2;
-	cc_mapIter_t*       miter1;
-	cc_mapIter_t        miterator2;
-	cc_mapIter_t*       miter2;
-	cc_listIter_t*      iter1;
-	cc_listIter_t*      iter2;
-	cc_list_t*          list1;
-	const cc_list_t*    list2;
-	int64_t*            id1;
-	int64_t*            id2;
-	int64_t*            _ref1;
+	int                 i;
 	int64_t             ref1;
 	int64_t             ref2;
-	int                 len;
-	mmiter1 = cc_multimap_head(state->mm_nds_join,
-	                           &mmiterator1);
-	while(mmiter1)
+	osmdb_joinRef_t*    jr1;
+	osmdb_joinRef_t*    jr2;
+	osmdb_joinRef_t*    jrx;
+	osmdb_waySegment_t* seg1;
+	osmdb_waySegment_t* seg2;
+	for(i = 0; i < state->map_nds_join->count; ++i)
 	{
-		_ref1  = (int64_t*) cc_multimap_key(mmiter1, &len);
-		ref1   = *_ref1;
+		ref1 = state->map_nds_join->entries[i].id;
 
-		list1 = (cc_list_t*) cc_multimap_list(mmiter1);
-		iter1 = cc_list_head(list1);
-		while(iter1)
+		jr1 = (osmdb_joinRef_t*)
+		      state->map_nds_join->entries[i].val;
+		while(jr1)
 		{
-			id1  = (int64_t*) cc_list_peekIter(iter1);
-			if(*id1 == -1)
+			if(jr1->wid == -1)
 			{
-				iter1 = cc_list_next(iter1);
+				jr1 = jr1->next;
 				continue;
 			}
 
-			miter1 = cc_map_findp(state->map_segs,
-			                      sizeof(int64_t), id1);
-			if(miter1 == NULL)
+			seg1 = (osmdb_waySegment_t*)
+			       osmdb_idmap_find(state->map_segs, jr1->wid);
+			if(seg1 == NULL)
 			{
-				iter1 = cc_list_next(iter1);
+				jr1 = jr1->next;
 				continue;
 			}
-			seg1 = (osmdb_waySegment_t*) cc_map_val(miter1);
 
-			iter2 = cc_list_next(iter1);
-			while(iter2)
+			jr2 = jr1->next;
+			while(jr2)
 			{
-				miter2 = &miterator2;
-				id2 = (int64_t*) cc_list_peekIter(iter2);
-				if(*id2 == -1)
+				if(jr2->wid == -1)
 				{
-					iter2 = cc_list_next(iter2);
+					jr2 = jr2->next;
 					continue;
 				}
 
-				miter2 = cc_map_findp(state->map_segs,
-				                      sizeof(int64_t), id2);
-				if(miter2 == NULL)
+				seg2 = (osmdb_waySegment_t*)
+				       osmdb_idmap_find(state->map_segs, jr2->wid);
+				if(seg2 == NULL)
 				{
-					iter2 = cc_list_next(iter2);
+					jr2 = jr2->next;
 					continue;
 				}
-				seg2 = (osmdb_waySegment_t*) cc_map_val(miter2);
 
 				if(osmdb_tiler_joinWay(self, tid, is_member,
 				                       seg1, seg2,
 				                       ref1, &ref2) == 0)
 				{
-					iter2 = cc_list_next(iter2);
+					jr2 = jr2->next;
 					continue;
 				}
 
 				// replace ref2->id2 with ref2->id1 in
-				// mm_nds_join
-				list2 = cc_multimap_findp(state->mm_nds_join,
-				                          &mmiterator2,
-				                          sizeof(int64_t),
-				                          (const void*) &ref2);
-				iter2 = cc_list_head(list2);
-				while(iter2)
+				// map_nds_join
+				jrx = (osmdb_joinRef_t*)
+				      osmdb_idmap_find(state->map_nds_join, ref2);
+				while(jrx)
 				{
-					int64_t* idx = (int64_t*) cc_list_peekIter(iter2);
-					if(*idx == *id2)
+					if(jrx->wid == jr2->wid)
 					{
-						*idx = *id1;
+						jrx->wid = jr1->wid;
 						break;
 					}
 
-					iter2 = cc_list_next(iter2);
+					jrx = jrx->next;
 				}
 
-				// remove segs from mm_nds_join
-				*id1 = -1;
-				*id2 = -1;
-
 				// remove seg2 from map_segs
-				cc_map_remove(state->map_segs, &miter2);
+				// note that the seg2 nds remain in the arena
+				// until seg1 is flattened
+				osmdb_idmap_remove(state->map_segs, jr2->wid);
 				osmdb_waySegment_delete(self->index, &seg2);
-				iter2 = NULL;
+
+				// remove segs from map_nds_join
+				jr1->wid = -1;
+				jr2->wid = -1;
+				break;
 			}
 
-			iter1 = cc_list_next(iter1);
+			jr1 = jr1->next;
 		}
+	}
 
-		mmiter1 = cc_multimap_nextList(mmiter1);
+	// flatten the joined segments
+	for(i = 0; i < state->map_segs->count; ++i)
+	{
+		seg1 = (osmdb_waySegment_t*)
+		       state->map_segs->entries[i].val;
+		if(seg1 &&
+		   (osmdb_waySegment_flatten(seg1, state->arena) == 0))
+		{
+			return 0;
+		}
 	}
 
 	return 1;
 }
 
 static int
-osmdb_tiler_sampleWay(osmdb_tiler_t* self, int tid,
-                      osmdb_waySegment_t* seg)
+osmdb_tiler_projectWay(osmdb_tiler_t* self, int tid,
+                       osmdb_waySegment_t* seg)
 {
 	ASSERT(self);
 	ASSERT(seg);
 
 	osmdb_tilerState_t* state = self->state[tid];
 
-	int first = 1;
-
-	cc_vec3d_t p0 = { .x=0.0, .y=0.0, .z=0.0 };
+	if(seg->count == 0)
+	{
+		return 1;
+	}
 
-	cc_listIter_t* iter;
-	iter = cc_list_head(seg->list_nds);
-	while(iter)
+	seg->pts = (osmdb_tilePoint_t*)
+	           osmdb_arena_alloc(state->arena,
+	                             seg->count*sizeof(osmdb_tilePoint_t));
+	if(seg->pts == NULL)
 	{
-		int64_t* _ref = (int64_t*) cc_list_peekIter(iter);
+		return 0;
+	}
 
-		// handles may not exist due to osmosis
-		osmdb_handle_t* hnc = NULL;
-		if(osmdb_index_get(self->index, tid,
-		                   OSMDB_TYPE_NODECOORD,
-		                   *_ref, &hnc) == 0)
+	// project nds to the tile space of the first tile of
+	// the metatile and compact the nds in place to discard
+	// nds which are missing due to osmosis
+	int      i;
+	int      j   = 0;
+	int64_t* nds = osmdb_waySegment_nds(seg);
+	for(i = 0; i < seg->count; ++i)
+	{
+		if(seg->wpts[i].x == OSMDB_WAYSEGMENT_MISSING)
 		{
-			return 0;
-		}
-		else if(hnc == NULL)
-		{
-			iter = cc_list_next(iter);
 			continue;
 		}
 
-		// accept the last nd
-		cc_listIter_t* next = cc_list_next(iter);
-		if(next == NULL)
-		{
-			osmdb_index_put(self->index, &hnc);
-			return 1;
-		}
+		nds[j] = nds[i];
+		osmdb_ostream_world2tilePoint(state->meta_os[0],
+		                              seg->wpts[i].x,
+		                              seg->wpts[i].y,
+		                              &seg->pts[j]);
+		++j;
+	}
+	seg->count = j;
+	seg->npts  = j;
 
-		// compute distance between points
-		double     lat   = hnc->node_coord->lat;
-		double     lon   = hnc->node_coord->lon;
-		float      onemi = cc_mi2m(5280.0f);
-		cc_vec3d_t p1;
-		terrain_geo2xyz(lat, lon, onemi,
-		                &p1.x, &p1.y, &p1.z);
-		float dist = cc_vec3d_distance(&p1, &p0);
+	return 1;
+}
 
-		// check if the nd should be kept or discarded
-		if(first || (dist >= state->min_dist))
+static double
+osmdb_tiler_dist2(osmdb_tilePoint_t* p,
+                  osmdb_tilePoint_t* a,
+                  osmdb_tilePoint_t* b)
+{
+	ASSERT(p);
+	ASSERT(a);
+	ASSERT(b);
+
+	// squared distance from p to the line segment ab
+	double abx = (double) (b->x - a->x);
+	double aby = (double) (b->y - a->y);
+	double apx = (double) (p->x - a->x);
+	double apy = (double) (p->y - a->y);
+	double ab2 = abx*abx + aby*aby;
+	if(ab2 > 0.0)
+	{
+		double t = (apx*abx + apy*aby)/ab2;
+		if(t > 1.0)
 		{
-			cc_vec3d_copy(&p1, &p0);
-			iter = cc_list_next(iter);
+			apx = (double) (p->x - b->x);
+			apy = (double) (p->y - b->y);
 		}
-		else
+		else if(t > 0.0)
 		{
-			cc_list_remove(seg->list_nds, &iter);
-			FREE(_ref);
+			apx -= t*abx;
+			apy -= t*aby;
 		}
-
-		first = 0;
-		osmdb_index_put(self->index, &hnc);
 	}
 
-	return 1;
+	return apx*apx + apy*apy;
 }
 
 static int
-osmdb_tiler_sampleWays(osmdb_tiler_t* self, int tid)
+osmdb_tiler_simplifyWay(osmdb_tiler_t* self, int tid,
+                        osmdb_waySegment_t* seg)
 {
 	ASSERT(self);
+	ASSERT(seg);
 
 	osmdb_tilerState_t* state = self->state[tid];
 
-	cc_mapIter_t* miter;
-	miter = cc_map_head(state->map_segs);
-	while(miter)
+	if(osmdb_tiler_projectWay(self, tid, seg) == 0)
 	{
-		osmdb_waySegment_t* seg;
-		seg = (osmdb_waySegment_t*) cc_map_val(miter);
-		if(osmdb_tiler_sampleWay(self, tid, seg) == 0)
-		{
-			return 0;
-		}
+		return 0;
+	}
 
-		miter = cc_map_next(miter);
+	// don't simplify short segs
+	int count = seg->count;
+	if(count <= 2)
+	{
+		return 1;
 	}
 
-	return 1;
-}
+	char* keep;
+	int*  stack;
+	keep  = (char*) osmdb_arena_alloc(state->arena,
+	                                  count*sizeof(char));
+	stack = (int*) osmdb_arena_alloc(state->arena,
+	                                 2*count*sizeof(int));
+	if((keep == NULL) || (stack == NULL))
+	{
+		return 0;
+	}
 
-static double osmdb_dot(double* a, double* b)
-{
-	ASSERT(a);
-	ASSERT(b);
+	// the endpoints and nds shared with the endpoints of
+	// other ways are kept so that ways still join
+	int      i;
+	int64_t* nds = osmdb_waySegment_nds(seg);
+	for(i = 0; i < count; ++i)
+	{
+		keep[i] = 0;
+		if((i == 0) || (i == count - 1) ||
+		   osmdb_idmap_find(state->map_nds_join, nds[i]))
+		{
+			keep[i] = 1;
+		}
+	}
 
-	return a[0]*b[0] + a[1]*b[1];
-}
+	// Douglas-Peucker simplification
+	double tol2 = state->tolerance*state->tolerance;
+	int    top  = 0;
+	stack[top++] = 0;
+	stack[top++] = count - 1;
+	while(top)
+	{
+		int i1 = stack[--top];
+		int i0 = stack[--top];
 
-static int osmdb_quadrant(double* pc, double* tlc, double* trc)
-{
-	ASSERT(pc);
-	ASSERT(tlc);
-	ASSERT(trc);
+		// find the farthest point from the segment
+		int    k    = -1;
+		double max2 = 0.0;
+		for(i = i0 + 1; i < i1; ++i)
+		{
+			if(keep[i])
+			{
+				// split at kept nds
+				k    = i;
+				max2 = tol2 + 1.0;
+				break;
+			}
 
-	double tl = osmdb_dot(tlc, pc);
-	double tr = osmdb_dot(trc, pc);
+			double d2 = osmdb_tiler_dist2(&seg->pts[i],
+			                              &seg->pts[i0],
+			                              &seg->pts[i1]);
+			if(d2 > max2)
+			{
+				k    = i;
+				max2 = d2;
+			}
+		}
 
-	if((tl > 0.0f) && (tr > 0.0f))
-	{
-		return OSMDB_QUADRANT_TOP;
-	}
-	else if((tl > 0.0f) && (tr <= 0.0f))
-	{
-		return OSMDB_QUADRANT_LEFT;
+		if((k >= 0) && (max2 > tol2))
+		{
+			keep[k] = 1;
+			stack[top++] = i0;
+			stack[top++] = k;
+			stack[top++] = k;
+			stack[top++] = i1;
+		}
 	}
-	else if((tl <= 0.0f) && (tr <= 0.0f))
+
+	// compact the nds and pts in place
+	int j = 0;
+	for(i = 0; i < count; ++i)
 	{
-		return OSMDB_QUADRANT_BOTTOM;
+		if(keep[i])
+		{
+			nds[j]      = nds[i];
+			seg->pts[j] = seg->pts[i];
+			++j;
+		}
 	}
-	return OSMDB_QUADRANT_RIGHT;
+	seg->count = j;
+	seg->npts  = j;
+
+	return 1;
 }
 
-static void osmdb_normalize(double* p)
+static int
+osmdb_tiler_simplifyWays(osmdb_tiler_t* self, int tid)
 {
-	ASSERT(p);
+	ASSERT(self);
+
+	osmdb_tilerState_t* state = self->state[tid];
 
-	double mag = sqrt(p[0]*p[0] + p[1]*p[1]);
-	p[0] = p[0]/mag;
-	p[1] = p[1]/mag;
+	int i;
+	osmdb_waySegment_t* seg;
+	for(i = 0; i < state->map_segs->count; ++i)
+	{
+		seg = (osmdb_waySegment_t*)
+		      state->map_segs->entries[i].val;
+		if(seg &&
+		   (osmdb_tiler_simplifyWay(self, tid, seg) == 0))
+		{
+			return 0;
+		}
+	}
+
+	return 1;
 }
 
 static int
 osmdb_tiler_clipWay(osmdb_tiler_t* self, int tid,
-                    osmdb_waySegment_t* seg,
-                    int member,
-                    double latT, double lonL,
-                    double latB, double lonR)
+                    osmdb_waySegment_t* seg, int k,
+                    int* _npts, osmdb_tilePoint_t** _pts,
+                    int* _nparts, int** _parts)
 {
 	ASSERT(self);
+	ASSERT(seg);
+	ASSERT(_npts);
+	ASSERT(_pts);
+	ASSERT(_nparts);
+	ASSERT(_parts);
 
-	// don't clip short segs
-	if(cc_list_size(seg->list_nds) <= 2)
+	osmdb_tilerState_t* state = self->state[tid];
+
+	*_npts   = 0;
+	*_pts    = NULL;
+	*_nparts = 0;
+	*_parts  = NULL;
+	if(seg->npts == 0)
 	{
 		return 1;
 	}
 
-	int64_t* first;
-	int64_t* last;
-	first = (int64_t*) cc_list_peekHead(seg->list_nds);
-	last  = (int64_t*) cc_list_peekTail(seg->list_nds);
-
-	// check if way forms a loop
-	int loop  = 0;
-	if(*first == *last)
-	{
-		loop = 1;
-	}
-
-	/*
-	 * quadrant setup
-	 * remove (B), (E), (F), (L)
-	 * remove A as well if not loop
-	 *  \                          /
-	 *   \        (L)             /
-	 *    \      M        K      /
-	 *  A  +--------------------+
-	 *     |TLC        J     TRC|
-	 *     |     N              | I
-	 *     |                    |
-	 * (B) |                    |
-	 *     |         *          |
-	 *     |         CENTER     |
-	 *     |                    | H
-	 *     |                    |
-	 *   C +--------------------+
-	 *    /                G     \
-	 *   /  D          (F)        \
-	 *  /         (E)              \
-	 */
-	int q0 = OSMDB_QUADRANT_NONE;
-	int q1 = OSMDB_QUADRANT_NONE;
-	int q2 = OSMDB_QUADRANT_NONE;
-	double dlat = (latT - latB)/2.0;
-	double dlon = (lonR - lonL)/2.0;
-	double center[2] =
-	{
-		lonL + dlon,
-		latB + dlat
-	};
-	double tlc[2] =
-	{
-		(lonL - center[0])/dlon,
-		(latT - center[1])/dlat
-	};
-	double trc[2] =
+	// the pts are in the tile space of the first tile of
+	// the metatile so the rect is offset to tile k
+	int n  = state->meta_n;
+	int dx = 32767*(k%n);
+	int dy = 32767*(k/n);
+	osmdb_clipRect_t rect =
 	{
-		(lonR - center[0])/dlon,
-		(latT - center[1])/dlat
+		.t = 16383  + state->border - dy,
+		.l = -16384 - state->border + dx,
+		.b = -16384 - state->border - dy,
+		.r = 16383  + state->border + dx,
 	};
-	osmdb_normalize(tlc);
-	osmdb_normalize(trc);
-
-	// clip way
-	int64_t*        _ref;
-	osmdb_handle_t* hnc = NULL;
-	cc_listIter_t*  iter;
-	cc_listIter_t*  prev = NULL;
-	iter = cc_list_head(seg->list_nds);
-	while(iter)
-	{
-		_ref = (int64_t*) cc_list_peekIter(iter);
 
-		if(osmdb_index_get(self->index, tid,
-		                   OSMDB_TYPE_NODECOORD,
-		                   *_ref, &hnc) == 0)
+	// closed areas are clipped as polygons to preserve fill
+	// while other ways (including closed lines such as
+	// roundabouts and fences) may be split into multiple
+	// parts
+	// the clipped pts may alias the seg pts
+	int64_t* nds = osmdb_waySegment_nds(seg);
+	if((seg->flags & OSMDB_WAY_FLAG_AREA) &&
+	   (seg->count > 0) && (nds[0] == nds[seg->count - 1]))
+	{
+		if(osmdb_clip_ring(&rect, state->arena,
+		                   seg->npts, seg->pts,
+		                   _npts, _pts) == 0)
 		{
 			return 0;
 		}
-		else if(hnc == NULL)
-		{
-			// ignore
-			iter = cc_list_next(iter);
-			continue;
-		}
 
-		// check if node is clipped
-		if((hnc->node_coord->lat < latB) ||
-		   (hnc->node_coord->lat > latT) ||
-		   (hnc->node_coord->lon > lonR) ||
-		   (hnc->node_coord->lon < lonL))
+		if(*_npts)
 		{
-			// proceed to clipping
-		}
-		else
-		{
-			// not clipped by tile
-			q0   = OSMDB_QUADRANT_NONE;
-			q1   = OSMDB_QUADRANT_NONE;
-			prev = NULL;
-			iter = cc_list_next(iter);
-			osmdb_index_put(self->index, &hnc);
-			continue;
-		}
-
-		// compute the quadrant
-		double pc[2] =
-		{
-			(hnc->node_coord->lon - center[0])/dlon,
-			(hnc->node_coord->lat - center[1])/dlat
-		};
-		osmdb_normalize(pc);
-		q2 = osmdb_quadrant(pc, tlc, trc);
-
-		// mark the first and last node
-		int clip_last = 0;
-		if(iter == cc_list_head(seg->list_nds))
-		{
-			if(loop || member)
+			*_parts = (int*)
+			          osmdb_arena_alloc(state->arena,
+			                            sizeof(int));
+			if(*_parts == NULL)
 			{
-				q0 = OSMDB_QUADRANT_NONE;
-				q1 = OSMDB_QUADRANT_NONE;
-			}
-			else
-			{
-				q0 = q2;
-				q1 = q2;
-			}
-			prev = iter;
-			iter = cc_list_next(iter);
-			osmdb_index_put(self->index, &hnc);
-			continue;
-		}
-		else if(iter == cc_list_tail(seg->list_nds))
-		{
-			if((loop == 0) && (member == 0) && (q1 == q2))
-			{
-				clip_last = 1;
-			}
-			else
-			{
-				// don't clip the prev node when
-				// keeping the last node
-				prev = NULL;
+				return 0;
 			}
+			*_nparts    = 1;
+			(*_parts)[0] = *_npts;
 		}
+		return 1;
+	}
 
-		// clip prev node
-		if(prev && (q0 == q2) && (q1 == q2))
-		{
-			_ref = (int64_t*) cc_list_remove(seg->list_nds, &prev);
-			FREE(_ref);
-		}
+	return osmdb_clip_line(&rect, state->arena,
+	                       seg->npts, seg->pts,
+	                       _npts, _pts, _nparts, _parts);
+}
 
-		// clip last node
-		if(clip_last)
-		{
-			_ref = (int64_t*) cc_list_remove(seg->list_nds, &iter);
-			FREE(_ref);
-			osmdb_index_put(self->index, &hnc);
-			return 1;
-		}
+static int
+osmdb_tiler_markWay(osmdb_tiler_t* self, int tid,
+                    int64_t wid, int mask)
+{
+	ASSERT(self);
 
-		q0   = q1;
-		q1   = q2;
-		prev = iter;
-		iter = cc_list_next(iter);
-		osmdb_index_put(self->index, &hnc);
+	osmdb_tilerState_t* state = self->state[tid];
+
+	// the member ways drawn by the rel are not exported
+	// as ways to the tiles of the mask and are stored
+	// with the cached rel
+	uintptr_t bits;
+	bits = (uintptr_t) osmdb_idmap_find(state->map_export_ways,
+	                                    wid);
+	bits |= (uintptr_t) mask;
+	if((osmdb_idmap_add(state->map_export_ways, wid,
+	                    (void*) bits) == 0) ||
+	   (osmdb_idmap_add(state->map_export_rel, wid,
+	                    (void*) &OSMDB_ONE) == 0))
+	{
+		return 0;
 	}
 
 	return 1;
 }
 
 static int
-osmdb_tiler_clipWays(osmdb_tiler_t* self, int tid)
+osmdb_tiler_newSegment(osmdb_tiler_t* self, int tid,
+                       int64_t wid, int flags,
+                       osmdb_waySegment_t** _seg)
 {
 	ASSERT(self);
+	ASSERT(_seg);
 
 	osmdb_tilerState_t* state = self->state[tid];
+	osmdb_geomCache_t*  cache = self->geom_cache;
 
-	// elements are defined with zero width but in
-	// practice are drawn with non-zero width
-	// points/lines so an offset is needed to ensure they
-	// are not clipped between neighboring tiles
-	double dlat = (state->latT - state->latB)/16.0;
-	double dlon = (state->lonR - state->lonL)/16.0;
-	double latT = state->latT + dlat;
-	double lonL = state->lonL - dlon;
-	double latB = state->latB - dlat;
-	double lonR = state->lonR + dlon;
+	*_seg = NULL;
 
-	cc_mapIter_t* miter;
-	miter = cc_map_head(state->map_segs);
-	while(miter)
+	// check the segments fetched by the previous tiles of
+	// the metatile and the geometry cache which contain the
+	// resolved world coordinates of the nds
+	int    is_meta = (state->meta_n > 1);
+	size_t size;
+	void*  data = NULL;
+	if(is_meta)
 	{
-		osmdb_waySegment_t* seg;
-		seg = (osmdb_waySegment_t*) cc_map_val(miter);
+		data = osmdb_tilerState_getMetaSeg(state, wid, &size);
+	}
+
+	if((data == NULL) && cache)
+	{
+		data = osmdb_geomCache_get(cache,
+		                           OSMDB_GEOMCACHE_TYPE_WAY,
+		                           state->zoom, wid,
+		                           state->arena, &size);
+		if(data && is_meta &&
+		   (osmdb_tilerState_putMetaSeg(state, wid, size,
+		                                data) == 0))
+		{
+			return 0;
+		}
+	}
+
+	if(data)
+	{
+		*_seg = osmdb_waySegment_unpack(state->arena,
+		                                data, &size);
+		if(*_seg == NULL)
+		{
+			return 0;
+		}
+		(*_seg)->flags = flags;
+
+		return 1;
+	}
 
-		if(osmdb_tiler_clipWay(self, tid, seg, 0,
-		                       latT, lonL, latB, lonR) == 0)
+	// create segment
+	// low zoom tiles use the generalized geometry which is
+	// keyed by the way tile ref
+	// chains are referenced as -cid (see osmdb_wayChain_t)
+	// segment may not exist due to osmosis
+	osmdb_waySegment_t* seg = NULL;
+	if(state->type_waygen >= 0)
+	{
+		if(osmdb_waySegment_newChain(self->index, state->arena,
+		                             tid, state->type_waygen,
+		                             wid, flags, &seg) == 0)
 		{
 			return 0;
 		}
+	}
+	else if(wid < 0)
+	{
+		if(osmdb_waySegment_newChain(self->index, state->arena,
+		                             tid, OSMDB_TYPE_WAYCHAIN,
+		                             -wid, flags, &seg) == 0)
+		{
+			return 0;
+		}
+	}
+	else if(osmdb_waySegment_new(self->index, state->arena,
+	                             tid, wid, flags, &seg) == 0)
+	{
+		return 0;
+	}
 
-		miter = cc_map_next(miter);
+	if(seg == NULL)
+	{
+		return 1;
 	}
 
+	// the packed segment is a temporary in the arena
+	// since the cache and metatile store a copy
+	if(cache || is_meta)
+	{
+		size = osmdb_waySegment_packSize(seg);
+		data = osmdb_arena_alloc(state->arena, size);
+		if(data == NULL)
+		{
+			osmdb_waySegment_delete(self->index, &seg);
+			return 0;
+		}
+		osmdb_waySegment_pack(seg, seg->wpts, 0, 0, data);
+
+		if((cache &&
+		    (osmdb_geomCache_put(cache,
+		                         OSMDB_GEOMCACHE_TYPE_WAY,
+		                         state->zoom, wid,
+		                         size, data) == 0)) ||
+		   (is_meta &&
+		    (osmdb_tilerState_putMetaSeg(state, wid, size,
+		                                 data) == 0)))
+		{
+			osmdb_waySegment_delete(self->index, &seg);
+			return 0;
+		}
+	}
+
+	*_seg = seg;
+
 	return 1;
 }
 
@@ -929,36 +1191,28 @@ static int
 osmdb_tiler_gatherWay(osmdb_tiler_t* self,
                       int tid, int64_t wid,
                       int flags, int is_member,
-                      int class, const char* name)
+                      int class, const char* name,
+                      int mask)
 {
 	// name may be NULL
 	ASSERT(self);
 
 	osmdb_tilerState_t* state = self->state[tid];
 
-	osmdb_exportKey_t key =
+	// check if way is already included by a relation
+	// in the tiles of the mask
+	uintptr_t bits;
+	bits = (uintptr_t) osmdb_idmap_find(state->map_export_ways,
+	                                    wid);
+	if((is_member == 0) && (bits & (uintptr_t) mask))
 	{
-		.type = OSMDB_EXPORT_TYPE_WAY,
-		.id   = wid
-	};
-
-	// check if way is already included
-	if(is_member == 0)
-	{
-		cc_mapIter_t* miter;
-		miter = cc_map_findp(state->map_export,
-		                     sizeof(osmdb_exportKey_t), &key);
-		if(miter)
-		{
-			return 1;
-		}
+		return 1;
 	}
 
-	// create segment
 	// segment may not exist due to osmosis
 	osmdb_waySegment_t* seg = NULL;
-	if(osmdb_waySegment_new(self->index, tid, wid, flags,
-	                        &seg) == 0)
+	if(osmdb_tiler_newSegment(self, tid, wid, flags,
+	                          &seg) == 0)
 	{
 		return 0;
 	}
@@ -967,83 +1221,49 @@ osmdb_tiler_gatherWay(osmdb_tiler_t* self,
 		return 1;
 	}
 
-	if(cc_map_addp(state->map_segs, (const void*) seg,
-	               sizeof(int64_t), &wid) == NULL)
-	{
-		osmdb_waySegment_delete(self->index, &seg);
-		return 0;
-	}
-
-	// check if seg is complete
-	int64_t* ref1;
-	int64_t* ref2;
-	ref1 = (int64_t*) cc_list_peekHead(seg->list_nds);
-	ref2 = (int64_t*) cc_list_peekTail(seg->list_nds);
-	if((ref1 == NULL) || (ref2 == NULL))
+	// ways are areas when selected as polygons by the style
+	// but members are areas when the rel is an area
+	if((is_member == 0) &&
+	   (seg->way_info->flags & OSMDB_WAYINFO_FLAG_AREA))
 	{
-		return 1;
+		seg->flags |= OSMDB_WAY_FLAG_AREA;
 	}
 
-	// otherwise add join nds
-	int64_t* id1_copy = (int64_t*)
-	                    MALLOC(sizeof(int64_t));
-	if(id1_copy == NULL)
+	if(osmdb_idmap_add(state->map_segs, wid,
+	                   (void*) seg) == 0)
 	{
+		osmdb_waySegment_delete(self->index, &seg);
 		return 0;
 	}
-	*id1_copy = wid;
 
-	int64_t* id2_copy = (int64_t*)
-	                    MALLOC(sizeof(int64_t));
-	if(id2_copy == NULL)
+	// check if seg is complete
+	if(seg->count == 0)
 	{
-		FREE(id1_copy);
-		return 0;
+		return 1;
 	}
-	*id2_copy = wid;
 
-	if(cc_multimap_addp(state->mm_nds_join,
-	                    (const void*) id1_copy,
-	                    sizeof(int64_t),
-	                    (const void*) ref1) == 0)
-	{
-		FREE(id1_copy);
-		FREE(id2_copy);
-		return 0;
-	}
+	int64_t* nds  = osmdb_waySegment_nds(seg);
+	int64_t  ref1 = nds[0];
+	int64_t  ref2 = nds[seg->count - 1];
 
-	if(cc_multimap_addp(state->mm_nds_join,
-	                    (const void*) id2_copy,
-	                    sizeof(int64_t),
-	                    (const void*) ref2) == 0)
+	// otherwise add join nds
+	if((osmdb_tilerState_addJoin(state, ref1, wid) == 0) ||
+	   (osmdb_tilerState_addJoin(state, ref2, wid) == 0))
 	{
-		FREE(id2_copy);
 		return 0;
 	}
 
 	// mark way as found if class or name matches rel
 	if(is_member)
 	{
-		osmdb_handle_t* hwi       = seg->hwi;
-		int             way_class = hwi->way_info->class;
-		const char*     way_name  = osmdb_wayInfo_name(hwi->way_info);
+		osmdb_wayInfo_t* way_info  = seg->way_info;
+		int              way_class = way_info->class;
+		const char*      way_name  = osmdb_wayInfo_name(way_info);
 		if((class == way_class) ||
 		   (name && way_name && (strcmp(name, way_name) == 0)))
 		{
-			osmdb_exportKey_t key =
-			{
-				.type = OSMDB_EXPORT_TYPE_WAY,
-				.id   = wid
-			};
-
-			cc_mapIter_t* miter;
-			miter = cc_map_findp(state->map_export,
-			                     sizeof(osmdb_exportKey_t), &key);
-			if((miter == NULL) &&
-			   (cc_map_addp(state->map_export,
-			                (const void*) &OSMDB_ONE,
-			                sizeof(osmdb_exportKey_t),
-			                &key) == NULL))
+			if(osmdb_tiler_markWay(self, tid, wid,
+			                       mask) == 0)
 			{
 				return 0;
 			}
@@ -1055,138 +1275,388 @@ osmdb_tiler_gatherWay(osmdb_tiler_t* self,
 
 static int
 osmdb_tiler_exportWay(osmdb_tiler_t* self, int tid,
-                      osmdb_waySegment_t* seg)
+                      osmdb_waySegment_t* seg, int k)
 {
 	ASSERT(self);
 	ASSERT(seg);
 
 	osmdb_tilerState_t* state = self->state[tid];
+	osmdb_ostream_t*    os    = state->meta_os[k];
 
-	if(cc_list_size(seg->list_nds) == 0)
-	{
-		// skip
-		return 1;
-	}
-
-	if(osmdb_ostream_beginWay(state->os,
-	                          seg->hwi->way_info,
-	                          &seg->way_range,
-	                          seg->flags) == 0)
+	int                npts;
+	osmdb_tilePoint_t* pts;
+	int                nparts;
+	int*               parts;
+	if(osmdb_tiler_clipWay(self, tid, seg, k, &npts, &pts,
+	                       &nparts, &parts) == 0)
 	{
 		return 0;
 	}
 
-	osmdb_handle_t* hnc = NULL;
-	cc_listIter_t*  iter;
-	iter = cc_list_head(seg->list_nds);
-	while(iter)
-	{
-		int64_t* ref = (int64_t*) cc_list_peekIter(iter);
+	// translate the pts to the tile space of tile k
+	int n  = state->meta_n;
+	int dx = 32767*(k%n);
+	int dy = 32767*(k/n);
 
-		// handles may not exist due to osmosis
-		if(osmdb_index_get(self->index, tid,
-		                   OSMDB_TYPE_NODECOORD,
-		                   *ref, &hnc) == 0)
+	// each part is exported as a separate way
+	int i;
+	int j;
+	int first = 0;
+	for(i = 0; i < nparts; ++i)
+	{
+		if(osmdb_ostream_beginWay(os,
+		                          seg->way_info,
+		                          &seg->way_range,
+		                          seg->flags) == 0)
 		{
 			return 0;
 		}
-		else if(hnc == NULL)
+
+		for(j = first; j < first + parts[i]; ++j)
 		{
-			iter = cc_list_next(iter);
-			continue;
+			osmdb_tilePoint_t pt =
+			{
+				.x = pts[j].x - dx,
+				.y = pts[j].y + dy,
+			};
+
+			if(osmdb_ostream_addWayPoint(os, &pt) == 0)
+			{
+				return 0;
+			}
 		}
+		first += parts[i];
+
+		osmdb_ostream_endWay(os);
+	}
+
+	return 1;
+}
+
+static int
+osmdb_tiler_exportWays(osmdb_tiler_t* self, int tid,
+                       int mask)
+{
+	ASSERT(self);
+
+	osmdb_tilerState_t* state = self->state[tid];
 
-		if(osmdb_ostream_addWayCoord(state->os,
-		                             hnc->node_coord) == 0)
+	// clip and export the segs to each tile selected by
+	// the mask
+	int i;
+	int k;
+	int n = state->meta_n;
+	osmdb_waySegment_t* seg;
+	for(k = 0; k < n*n; ++k)
+	{
+		if((mask & (1 << k)) == 0)
 		{
-			goto fail_way_coord;
+			continue;
 		}
 
-		osmdb_index_put(self->index, &hnc);
-
-		iter = cc_list_next(iter);
+		for(i = 0; i < state->map_segs->count; ++i)
+		{
+			seg = (osmdb_waySegment_t*)
+			      state->map_segs->entries[i].val;
+			if(seg &&
+			   (osmdb_tiler_exportWay(self, tid, seg, k) == 0))
+			{
+				return 0;
+			}
+		}
 	}
 
-	osmdb_ostream_endWay(state->os);
+	osmdb_tilerState_reset(state, self->index, 0);
 
-	// success
 	return 1;
+}
 
-	// failure
-	fail_way_coord:
-		osmdb_index_put(self->index, &hnc);
-	return 0;
+typedef int (*osmdb_tiler_refFn)(osmdb_tiler_t* self,
+                                 int tid, int64_t ref,
+                                 int mask);
+
+static void
+osmdb_tiler_putRefs(osmdb_tiler_t* self, int tid,
+                    osmdb_handle_t** htr)
+{
+	ASSERT(self);
+	ASSERT(htr);
+
+	osmdb_tilerState_t* state = self->state[tid];
+
+	int k;
+	int n = state->meta_n;
+	for(k = 0; k < n*n; ++k)
+	{
+		osmdb_index_put(self->index, &htr[k]);
+	}
 }
 
 static int
-osmdb_tiler_exportWays(osmdb_tiler_t* self, int tid)
+osmdb_tiler_getRefs(osmdb_tiler_t* self, int tid,
+                    int type, int mask,
+                    osmdb_handle_t** htr)
 {
 	ASSERT(self);
+	ASSERT(htr);
 
 	osmdb_tilerState_t* state = self->state[tid];
 
-	osmdb_waySegment_t* seg;
-	cc_mapIter_t*       miter;
-	miter = cc_map_head(state->map_segs);
-	while(miter)
+	// tile refs are keyed by id = 2^zoom*y + x
+	// handles may not exist due to osmosis or are NULL
+	// for the tiles which are not selected by the mask
+	int k;
+	int n = state->meta_n;
+	for(k = 0; k < n*n; ++k)
 	{
-		seg = (osmdb_waySegment_t*) cc_map_val(miter);
-		if(osmdb_tiler_exportWay(self, tid, seg) == 0)
+		htr[k] = NULL;
+		if((mask & (1 << k)) == 0)
 		{
-			return 0;
+			continue;
 		}
 
-		miter = cc_map_next(miter);
+		int64_t x  = state->x + k%n;
+		int64_t y  = state->y + k/n;
+		int64_t id = (y << state->zoom) + x;
+		if(osmdb_index_get(self->index, tid,
+		                   type, id, &htr[k]) == 0)
+		{
+			osmdb_tiler_putRefs(self, tid, htr);
+			return 0;
+		}
 	}
 
-	osmdb_tilerState_reset(state, self->index, 0);
+	return 1;
+}
+
+static int
+osmdb_tiler_unionRefs(osmdb_tiler_t* self, int tid,
+                      osmdb_handle_t** htr,
+                      osmdb_tiler_refFn ref_fn)
+{
+	ASSERT(self);
+	ASSERT(htr);
+	ASSERT(ref_fn);
+
+	osmdb_tilerState_t* state = self->state[tid];
+
+	// visit the union of the tile refs of the metatile
+	// once per ref where the refs of each tile are sorted
+	// by class so the classes are merged in order and the
+	// mask selects the tiles which include the ref
+	int k;
+	int n = state->meta_n;
+	int cursor[OSMDB_TILERSTATE_META_MAX*
+	           OSMDB_TILERSTATE_META_MAX];
+	memset((void*) cursor, 0, sizeof(cursor));
+	while(state->expired == 0)
+	{
+		// find the next class
+		int      i;
+		int      class = -1;
+		int      c;
+		int      count;
+		int64_t* refs;
+		for(k = 0; k < n*n; ++k)
+		{
+			if((htr[k] == NULL) ||
+			   (cursor[k] >= htr[k]->tile_refs->count_classes))
+			{
+				continue;
+			}
+
+			osmdb_tileRefs_classRefs(htr[k]->tile_refs,
+			                         cursor[k], &c, &count);
+			if((class < 0) || (c < class))
+			{
+				class = c;
+			}
+		}
+
+		if(class < 0)
+		{
+			break;
+		}
+
+		// the mask is applied before the refs are looked up
+		int skip = state->mask && (state->mask[class] == 0);
+
+		int64_t* class_refs[OSMDB_TILERSTATE_META_MAX*
+		                    OSMDB_TILERSTATE_META_MAX];
+		int      class_count[OSMDB_TILERSTATE_META_MAX*
+		                     OSMDB_TILERSTATE_META_MAX];
+		int      pos[OSMDB_TILERSTATE_META_MAX*
+		             OSMDB_TILERSTATE_META_MAX];
+		osmdb_idmap_clear(state->map_meta);
+		for(k = 0; k < n*n; ++k)
+		{
+			class_refs[k]  = NULL;
+			class_count[k] = 0;
+			pos[k]         = 0;
+			if((htr[k] == NULL) ||
+			   (cursor[k] >= htr[k]->tile_refs->count_classes))
+			{
+				continue;
+			}
+
+			refs = osmdb_tileRefs_classRefs(htr[k]->tile_refs,
+			                                cursor[k], &c,
+			                                &count);
+			if(c != class)
+			{
+				continue;
+			}
+			++cursor[k];
+
+			if(skip)
+			{
+				continue;
+			}
+			class_refs[k]  = refs;
+			class_count[k] = count;
+
+			for(i = 0; i < count; ++i)
+			{
+				uintptr_t bits;
+				bits = (uintptr_t)
+				       osmdb_idmap_find(state->map_meta,
+				                        refs[i]);
+				bits |= (uintptr_t) (1 << k);
+				if(osmdb_idmap_add(state->map_meta, refs[i],
+				                   (void*) bits) == 0)
+				{
+					return 0;
+				}
+			}
+		}
+
+		// the refs of each tile are in insertion order so
+		// the refs are merged such that each tile visits
+		// its refs in the same order as a single tile
+		// where a ref is visited once it is the next ref
+		// of every tile which includes the ref
+		// visited refs are removed from map_meta
+		while(osmdb_tiler_expired(self, tid) == 0)
+		{
+			int64_t   ref   = 0;
+			uintptr_t bits  = 0;
+			int       first = -1;
+			for(k = 0; k < n*n; ++k)
+			{
+				// skip the visited refs
+				while((pos[k] < class_count[k]) &&
+				      (osmdb_idmap_find(state->map_meta,
+				                        class_refs[k][pos[k]]) == NULL))
+				{
+					++pos[k];
+				}
+			}
+
+			for(k = 0; k < n*n; ++k)
+			{
+				if(pos[k] >= class_count[k])
+				{
+					continue;
+				}
+
+				if(first < 0)
+				{
+					first = k;
+				}
+
+				int64_t   r = class_refs[k][pos[k]];
+				uintptr_t b;
+				b = (uintptr_t)
+				    osmdb_idmap_find(state->map_meta, r);
+
+				int j;
+				for(j = 0; j < n*n; ++j)
+				{
+					if((b & (1 << j)) &&
+					   (class_refs[j][pos[j]] != r))
+					{
+						break;
+					}
+				}
+
+				if(j == n*n)
+				{
+					ref  = r;
+					bits = b;
+					break;
+				}
+			}
+
+			if(first < 0)
+			{
+				break;
+			}
+
+			// the insertion order is shared by the tiles
+			// but fall back to the first tile otherwise
+			if(bits == 0)
+			{
+				ref  = class_refs[first][pos[first]];
+				bits = (uintptr_t)
+				       osmdb_idmap_find(state->map_meta, ref);
+			}
+			osmdb_idmap_remove(state->map_meta, ref);
+
+			if((*ref_fn)(self, tid, ref, (int) bits) == 0)
+			{
+				return 0;
+			}
+		}
+	}
 
 	return 1;
 }
 
 static int
-osmdb_tiler_gatherWays(osmdb_tiler_t* self, int tid)
+osmdb_tiler_gatherWayRef(osmdb_tiler_t* self, int tid,
+                         int64_t wid, int mask)
+{
+	ASSERT(self);
+
+	return osmdb_tiler_gatherWay(self, tid, wid,
+	                             0, 0, 0, NULL, mask);
+}
+
+static int
+osmdb_tiler_gatherWays(osmdb_tiler_t* self, int tid, int k)
 {
 	ASSERT(self);
 
 	osmdb_tilerState_t* state = self->state[tid];
 
-	int     type;
-	int64_t id;
+	int type;
 	if(state->zoom == 15)
 	{
 		type = OSMDB_TYPE_TILEREF_WAY15;
-		id   = 32768*state->y + state->x; // 2^15
 	}
 	else if(state->zoom == 13)
 	{
 		type = OSMDB_TYPE_TILEREF_WAY13;
-		id   = 8192*state->y + state->x; // 2^13
 	}
 	else if(state->zoom == 11)
 	{
 		type = OSMDB_TYPE_TILEREF_WAY11;
-		id   = 2048*state->y + state->x; // 2^11
 	}
 	else if(state->zoom == 9)
 	{
 		type = OSMDB_TYPE_TILEREF_WAY9;
-		id   = 512*state->y + state->x; // 2^9
 	}
 	else if(state->zoom == 7)
 	{
 		type = OSMDB_TYPE_TILEREF_WAY7;
-		id   = 128*state->y + state->x; // 2^7
 	}
 	else if(state->zoom == 5)
 	{
 		type = OSMDB_TYPE_TILEREF_WAY5;
-		id   = 32*state->y + state->x; // 2^5
 	}
 	else if(state->zoom == 3)
 	{
 		type = OSMDB_TYPE_TILEREF_WAY3;
-		id   = 8*state->y + state->x; // 2^3
 	}
 	else
 	{
@@ -1194,28 +1664,30 @@ osmdb_tiler_gatherWays(osmdb_tiler_t* self, int tid)
 		return 0;
 	}
 
-	// handles may not exist due to osmosis
-	osmdb_handle_t* htr;
-	if(osmdb_index_get(self->index, tid,
-	                   type, id, &htr) == 0)
+	// the ways are gathered, joined and simplified per tile
+	// of the metatile since the joins and simplification
+	// depend on the ways of the tile but the segments are
+	// fetched once per metatile (see map_meta_segs)
+	osmdb_handle_t* htr[OSMDB_TILERSTATE_META_MAX*
+	                    OSMDB_TILERSTATE_META_MAX];
+	if(osmdb_tiler_getRefs(self, tid, type, 1 << k,
+	                       htr) == 0)
 	{
 		return 0;
 	}
-	else if(htr == NULL)
+
+	if(osmdb_tiler_unionRefs(self, tid, htr,
+	                         osmdb_tiler_gatherWayRef) == 0)
 	{
-		return 1;
+		goto fail_gather_way;
 	}
 
-	int      i;
-	int      count = htr->tile_refs->count;
-	int64_t* refs  = osmdb_tileRefs_refs(htr->tile_refs);
-	for(i = 0; i < count; ++i)
+	// discard the gathered ways on expiry
+	if(state->expired)
 	{
-		if(osmdb_tiler_gatherWay(self, tid, refs[i],
-		                         0, 0, 0, NULL) == 0)
-		{
-			goto fail_gather_way;
-		}
+		osmdb_tilerState_reset(state, self->index, 0);
+		osmdb_tiler_putRefs(self, tid, htr);
+		return 1;
 	}
 
 	if(osmdb_tiler_joinWays(self, tid, 0) == 0)
@@ -1223,43 +1695,245 @@ osmdb_tiler_gatherWays(osmdb_tiler_t* self, int tid)
 		goto fail_join;
 	}
 
-	if(osmdb_tiler_sampleWays(self, tid) == 0)
+	if(osmdb_tiler_simplifyWays(self, tid) == 0)
 	{
-		goto fail_sample;
+		goto fail_simplify;
 	}
 
-	if(osmdb_tiler_clipWays(self, tid) == 0)
-	{
-		goto fail_clip;
-	}
-
-	if(osmdb_tiler_exportWays(self, tid) == 0)
+	if(osmdb_tiler_exportWays(self, tid, 1 << k) == 0)
 	{
 		goto fail_export;
 	}
 
-	osmdb_index_put(self->index, &htr);
+	osmdb_tiler_putRefs(self, tid, htr);
 
 	// success
 	return 1;
 
+	// failure
 	fail_export:
-	fail_clip:
-	fail_sample:
+	fail_simplify:
 	fail_join:
 	fail_gather_way:
-		osmdb_index_put(self->index, &htr);
+		osmdb_tiler_putRefs(self, tid, htr);
 	return 0;
 }
 
+static int
+osmdb_tiler_gatherRings(osmdb_tiler_t* self, int tid,
+                        osmdb_relRings_t* rel_rings,
+                        int flags_area, int mask)
+{
+	ASSERT(self);
+	ASSERT(rel_rings);
+
+	osmdb_tilerState_t* state = self->state[tid];
+
+	// mark the members which are drawn by the rel
+	int      i;
+	int64_t* wids = osmdb_relRings_wids(rel_rings);
+	for(i = 0; i < rel_rings->count_wids; ++i)
+	{
+		if(osmdb_tiler_markWay(self, tid, wids[i],
+		                       mask) == 0)
+		{
+			return 0;
+		}
+	}
+
+	// rings were assembled by the importer so they are
+	// keyed by index rather than joined by wid
+	osmdb_relRing_t*    ring = NULL;
+	osmdb_waySegment_t* seg;
+	for(i = 0; i < rel_rings->count; ++i)
+	{
+		if(osmdb_tiler_expired(self, tid))
+		{
+			break;
+		}
+
+		ring = osmdb_relRings_ring(rel_rings, ring);
+
+		int flags = flags_area;
+		if(ring->flags & OSMDB_RELRING_FLAG_INNER)
+		{
+			flags |= OSMDB_WAY_FLAG_INNER;
+		}
+
+		// segment may not exist due to osmosis
+		seg = NULL;
+		if(osmdb_waySegment_newRing(self->index, state->arena,
+		                            tid, ring, flags,
+		                            &seg) == 0)
+		{
+			return 0;
+		}
+		else if(seg == NULL)
+		{
+			continue;
+		}
+
+		if(osmdb_idmap_add(state->map_segs, i,
+		                   (void*) seg) == 0)
+		{
+			osmdb_waySegment_delete(self->index, &seg);
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+static int
+osmdb_tiler_cacheRel(osmdb_tiler_t* self, int tid,
+                     int64_t rid)
+{
+	ASSERT(self);
+
+	osmdb_tilerState_t* state = self->state[tid];
+	osmdb_geomCache_t*  cache = self->geom_cache;
+
+	if(cache == NULL)
+	{
+		return 1;
+	}
+
+	// the simplified pts are offset to the tile space of
+	// tile (0,0) which is an exact translation of the tile
+	// space of every other tile at the same zoom level
+	int dx = 32767*state->x;
+	int dy = -32767*state->y;
+
+	int                  i;
+	osmdb_waySegment_t*  seg;
+	osmdb_idmap_t*       map_wids = state->map_export_rel;
+	osmdb_tilerRelPack_t pack =
+	{
+		.count_wids = map_wids->count,
+	};
+	size_t size = sizeof(osmdb_tilerRelPack_t) +
+	              pack.count_wids*sizeof(int64_t);
+	for(i = 0; i < state->map_segs->count; ++i)
+	{
+		seg = (osmdb_waySegment_t*)
+		      state->map_segs->entries[i].val;
+		if(seg)
+		{
+			size += osmdb_waySegment_packSize(seg);
+			++pack.count_segs;
+		}
+	}
+
+	// the packed rel is a temporary in the arena since the
+	// cache stores a copy
+	char* data = (char*) osmdb_arena_alloc(state->arena, size);
+	if(data == NULL)
+	{
+		return 0;
+	}
+
+	size_t offset = sizeof(osmdb_tilerRelPack_t);
+	memcpy(data, &pack, offset);
+
+	int64_t* wids = (int64_t*) (data + offset);
+	for(i = 0; i < pack.count_wids; ++i)
+	{
+		wids[i] = map_wids->entries[i].id;
+	}
+	offset += pack.count_wids*sizeof(int64_t);
+
+	for(i = 0; i < state->map_segs->count; ++i)
+	{
+		seg = (osmdb_waySegment_t*)
+		      state->map_segs->entries[i].val;
+		if(seg)
+		{
+			osmdb_waySegment_pack(seg, seg->pts, dx, dy,
+			                      data + offset);
+			offset += osmdb_waySegment_packSize(seg);
+		}
+	}
+
+	return osmdb_geomCache_put(cache,
+	                           OSMDB_GEOMCACHE_TYPE_REL,
+	                           state->zoom, rid,
+	                           size, data);
+}
+
+static int
+osmdb_tiler_unpackRel(osmdb_tiler_t* self, int tid,
+                      void* data, int mask)
+{
+	ASSERT(self);
+	ASSERT(data);
+
+	osmdb_tilerState_t* state = self->state[tid];
+
+	osmdb_tilerRelPack_t* pack;
+	pack = (osmdb_tilerRelPack_t*) data;
+
+	int      i;
+	char*    p      = (char*) data;
+	size_t   offset = sizeof(osmdb_tilerRelPack_t);
+	int64_t* wids   = (int64_t*) (p + offset);
+	for(i = 0; i < pack->count_wids; ++i)
+	{
+		if(osmdb_tiler_markWay(self, tid, wids[i],
+		                       mask) == 0)
+		{
+			return 0;
+		}
+	}
+	offset += pack->count_wids*sizeof(int64_t);
+
+	// translate the pts in place from the tile space of
+	// tile (0,0) to the tile space of the metatile
+	int dx = 32767*state->x;
+	int dy = -32767*state->y;
+
+	int                 j;
+	size_t              size;
+	osmdb_waySegment_t* seg;
+	for(i = 0; i < pack->count_segs; ++i)
+	{
+		seg = osmdb_waySegment_unpack(state->arena,
+		                              p + offset, &size);
+		if(seg == NULL)
+		{
+			return 0;
+		}
+		offset += size;
+
+		seg->pts  = seg->wpts;
+		seg->npts = seg->count;
+		for(j = 0; j < seg->npts; ++j)
+		{
+			seg->pts[j].x -= dx;
+			seg->pts[j].y -= dy;
+		}
+
+		if(osmdb_idmap_add(state->map_segs, i,
+		                   (void*) seg) == 0)
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
 static int
 osmdb_tiler_gatherRel(osmdb_tiler_t* self,
-                      int tid, int64_t rid)
+                      int tid, int64_t rid, int mask)
 {
 	ASSERT(self);
 
 	osmdb_tilerState_t* state = self->state[tid];
 
+	// the rel is exported to each tile selected by the mask
+	int k;
+	int n = state->meta_n;
+
 	// handles may not exist due to osmosis
 	osmdb_handle_t* hri;
 	if(osmdb_index_get(self->index, tid,
@@ -1268,18 +1942,48 @@ osmdb_tiler_gatherRel(osmdb_tiler_t* self,
 	{
 		return 0;
 	}
-	else if(hri == NULL)
+	else if(hri == NULL)
+	{
+		return 1;
+	}
+
+	// the cached geometry replaces the members and rings
+	// which are joined and simplified once per zoom level
+	size_t size_geom;
+	void*  geom = NULL;
+	if(self->geom_cache)
+	{
+		geom = osmdb_geomCache_get(self->geom_cache,
+		                           OSMDB_GEOMCACHE_TYPE_REL,
+		                           state->zoom, rid,
+		                           state->arena, &size_geom);
+	}
+
+	// members are optional
+	osmdb_handle_t* hrm = NULL;
+	if((geom == NULL) &&
+	   (osmdb_index_get(self->index, tid,
+	                    OSMDB_TYPE_RELMEMBERS,
+	                    rid, &hrm) == 0))
+	{
+		goto fail_members;
+	}
+
+	// rings are optional and replace the members of
+	// multipolygon and boundary relations
+	// low zoom tiles use the generalized rings
+	int type_rings = OSMDB_TYPE_RELRINGS;
+	if(state->type_relgen >= 0)
 	{
-		return 1;
+		type_rings = state->type_relgen;
 	}
 
-	// members are optional
-	osmdb_handle_t* hrm;
-	if(osmdb_index_get(self->index, tid,
-	                   OSMDB_TYPE_RELMEMBERS,
-	                   rid, &hrm) == 0)
+	osmdb_handle_t* hrg = NULL;
+	if((geom == NULL) &&
+	   (osmdb_index_get(self->index, tid,
+	                    type_rings, rid, &hrg) == 0))
 	{
-		goto fail_members;
+		goto fail_rings;
 	}
 
 	osmdb_handle_t* hrr;
@@ -1291,6 +1995,7 @@ osmdb_tiler_gatherRel(osmdb_tiler_t* self,
 	}
 	else if(hrr == NULL)
 	{
+		osmdb_index_put(self->index, &hrg);
 		osmdb_index_put(self->index, &hrm);
 		osmdb_index_put(self->index, &hri);
 		return 1;
@@ -1323,16 +2028,44 @@ osmdb_tiler_gatherRel(osmdb_tiler_t* self,
 		name      = osmdb_nodeInfo_name(hni->node_info);
 	}
 
-	if(osmdb_ostream_beginRel(state->os,
-	                          hri->rel_info,
-	                          hrr->rel_range,
-	                          size_name, name,
-	                          hnc ? hnc->node_coord : NULL) == 0)
+	for(k = 0; k < n*n; ++k)
+	{
+		if((mask & (1 << k)) &&
+		   (osmdb_ostream_beginRel(state->meta_os[k],
+		                           hri->rel_info,
+		                           hrr->rel_range,
+		                           size_name, name,
+		                           hnc ? hnc->node_coord : NULL) == 0))
+		{
+			goto fail_begin_rel;
+		}
+	}
+
+	// the rings/members of areas are clipped as polygons
+	int flags_area = 0;
+	if(hri->rel_info->flags & OSMDB_RELINFO_FLAG_AREA)
 	{
-		goto fail_begin_rel;
+		flags_area = OSMDB_WAY_FLAG_AREA;
 	}
 
-	if(hrm)
+	if(geom)
+	{
+		if(osmdb_tiler_unpackRel(self, tid, geom,
+		                         mask) == 0)
+		{
+			goto fail_member;
+		}
+	}
+	else if(hrg)
+	{
+		if(osmdb_tiler_gatherRings(self, tid,
+		                           hrg->rel_rings,
+		                           flags_area, mask) == 0)
+		{
+			goto fail_member;
+		}
+	}
+	else if(hrm)
 	{
 		int i;
 		int count;
@@ -1341,61 +2074,93 @@ osmdb_tiler_gatherRel(osmdb_tiler_t* self,
 		count = hrm->rel_members->count;
 		for(i = 0; i < count; ++i)
 		{
+			if(osmdb_tiler_expired(self, tid))
+			{
+				break;
+			}
+
 			osmdb_relData_t* datai = &data[i];
 
-			int flags = 0;
+			int flags = flags_area;
 			if(datai->inner)
 			{
-				flags = OSMDB_WAY_FLAG_INNER;
+				flags |= OSMDB_WAY_FLAG_INNER;
 			}
 
 			int class = hri->rel_info->class;
 			if(osmdb_tiler_gatherWay(self, tid, datai->wid,
-			                         flags, 1, class, name) == 0)
+			                         flags, 1, class, name,
+			                         mask) == 0)
 			{
 				goto fail_member;
 			}
 		}
-	}
 
-	if(osmdb_tiler_joinWays(self, tid, 1) == 0)
-	{
-		goto fail_join;
+		if((state->expired == 0) &&
+		   (osmdb_tiler_joinWays(self, tid, 1) == 0))
+		{
+			goto fail_join;
+		}
 	}
 
-	if(osmdb_tiler_sampleWays(self, tid) == 0)
+	// discard the incomplete rel on expiry
+	if(state->expired)
 	{
-		goto fail_sample;
+		for(k = 0; k < n*n; ++k)
+		{
+			if(mask & (1 << k))
+			{
+				osmdb_ostream_discardRel(state->meta_os[k]);
+			}
+		}
+		osmdb_tilerState_reset(state, self->index, 0);
+		osmdb_index_put(self->index, &hnc);
+		osmdb_index_put(self->index, &hni);
+		osmdb_index_put(self->index, &hrr);
+		osmdb_index_put(self->index, &hrg);
+		osmdb_index_put(self->index, &hrm);
+		osmdb_index_put(self->index, &hri);
+		return 1;
 	}
 
-	if(osmdb_tiler_clipWays(self, tid) == 0)
+	// the cached geometry is already simplified
+	if(geom == NULL)
 	{
-		goto fail_clip;
+		if(osmdb_tiler_simplifyWays(self, tid) == 0)
+		{
+			goto fail_simplify;
+		}
+
+		if(osmdb_tiler_cacheRel(self, tid, rid) == 0)
+		{
+			goto fail_cache;
+		}
 	}
 
-	if(osmdb_tiler_exportWays(self, tid) == 0)
+	if(osmdb_tiler_exportWays(self, tid, mask) == 0)
 	{
 		goto fail_export;
 	}
 
-	osmdb_ostream_endRel(state->os);
-
-	// mark node as found
-	if(hni && hni->node_info)
+	for(k = 0; k < n*n; ++k)
 	{
-		osmdb_exportKey_t key =
+		if(mask & (1 << k))
 		{
-			.type = OSMDB_EXPORT_TYPE_NODE,
-			.id   = hni->node_info->nid
-		};
+			osmdb_ostream_endRel(state->meta_os[k]);
+		}
+	}
 
-		cc_mapIter_t* miter;
-		miter = cc_map_findp(state->map_export,
-		                     sizeof(osmdb_exportKey_t), &key);
-		if((miter == NULL) &&
-		   (cc_map_addp(state->map_export,
-		                (const void*) &OSMDB_ONE,
-		                sizeof(osmdb_exportKey_t), &key) == NULL))
+	// mark node as found in the tiles of the mask
+	if(hni && hni->node_info)
+	{
+		uintptr_t bits;
+		bits = (uintptr_t)
+		       osmdb_idmap_find(state->map_export_nodes,
+		                        hni->node_info->nid);
+		bits |= (uintptr_t) mask;
+		if(osmdb_idmap_add(state->map_export_nodes,
+		                   hni->node_info->nid,
+		                   (void*) bits) == 0)
 		{
 			goto fail_mark;
 		}
@@ -1404,6 +2169,7 @@ osmdb_tiler_gatherRel(osmdb_tiler_t* self,
 	osmdb_index_put(self->index, &hnc);
 	osmdb_index_put(self->index, &hni);
 	osmdb_index_put(self->index, &hrr);
+	osmdb_index_put(self->index, &hrg);
 	osmdb_index_put(self->index, &hrm);
 	osmdb_index_put(self->index, &hri);
 
@@ -1413,8 +2179,8 @@ osmdb_tiler_gatherRel(osmdb_tiler_t* self,
 	// failure
 	fail_mark:
 	fail_export:
-	fail_clip:
-	fail_sample:
+	fail_cache:
+	fail_simplify:
 	fail_join:
 	fail_member:
 	fail_begin_rel:
@@ -1424,6 +2190,8 @@ osmdb_tiler_gatherRel(osmdb_tiler_t* self,
 	fail_node_info:
 		osmdb_index_put(self->index, &hrr);
 	fail_range:
+		osmdb_index_put(self->index, &hrg);
+	fail_rings:
 		osmdb_index_put(self->index, &hrm);
 	fail_members:
 		osmdb_index_put(self->index, &hri);
@@ -1437,42 +2205,34 @@ osmdb_tiler_gatherRels(osmdb_tiler_t* self, int tid)
 
 	osmdb_tilerState_t* state = self->state[tid];
 
-	int     type;
-	int64_t id;
+	int type;
 	if(state->zoom == 15)
 	{
 		type = OSMDB_TYPE_TILEREF_REL15;
-		id   = 32768*state->y + state->x; // 2^15
 	}
 	else if(state->zoom == 13)
 	{
 		type = OSMDB_TYPE_TILEREF_REL13;
-		id   = 8192*state->y + state->x; // 2^13
 	}
 	else if(state->zoom == 11)
 	{
 		type = OSMDB_TYPE_TILEREF_REL11;
-		id   = 2048*state->y + state->x; // 2^11
 	}
 	else if(state->zoom == 9)
 	{
 		type = OSMDB_TYPE_TILEREF_REL9;
-		id   = 512*state->y + state->x; // 2^9
 	}
 	else if(state->zoom == 7)
 	{
 		type = OSMDB_TYPE_TILEREF_REL7;
-		id   = 128*state->y + state->x; // 2^7
 	}
 	else if(state->zoom == 5)
 	{
 		type = OSMDB_TYPE_TILEREF_REL5;
-		id   = 32*state->y + state->x; // 2^5
 	}
 	else if(state->zoom == 3)
 	{
 		type = OSMDB_TYPE_TILEREF_REL3;
-		id   = 8*state->y + state->x; // 2^3
 	}
 	else
 	{
@@ -1480,35 +2240,201 @@ osmdb_tiler_gatherRels(osmdb_tiler_t* self, int tid)
 		return 0;
 	}
 
-	// handles may not exist due to osmosis
-	osmdb_handle_t* htr;
-	if(osmdb_index_get(self->index, tid,
-	                   type, id, &htr) == 0)
+	int             n = state->meta_n;
+	osmdb_handle_t* htr[OSMDB_TILERSTATE_META_MAX*
+	                    OSMDB_TILERSTATE_META_MAX];
+	if(osmdb_tiler_getRefs(self, tid, type,
+	                       (1 << (n*n)) - 1, htr) == 0)
 	{
 		return 0;
 	}
-	else if(htr == NULL)
+
+	// each rel of the metatile is gathered, joined and
+	// simplified once and then clipped to the tiles which
+	// include the rel
+	if(osmdb_tiler_unionRefs(self, tid, htr,
+	                         osmdb_tiler_gatherRel) == 0)
 	{
-		return 1;
+		goto fail_gather_rel;
 	}
 
-	// gather rels in tile
-	int      i;
-	int      ret   = 1;
-	int      count = htr->tile_refs->count;
-	int64_t* refs  = osmdb_tileRefs_refs(htr->tile_refs);
-	for(i = 0; i < count; ++i)
+	osmdb_tiler_putRefs(self, tid, htr);
+
+	// success
+	return 1;
+
+	// failure
+	fail_gather_rel:
+		osmdb_tiler_putRefs(self, tid, htr);
+	return 0;
+}
+
+static osmdb_tile_t*
+osmdb_tiler_copy(osmdb_tile_t* shared, size_t size,
+                 size_t* _size)
+{
+	// _size may be NULL
+	ASSERT(shared);
+
+	osmdb_tile_t* tile;
+	tile = (osmdb_tile_t*) MALLOC(size);
+	if(tile == NULL)
+	{
+		LOGE("MALLOC failed");
+		return NULL;
+	}
+	memcpy((void*) tile, (const void*) shared, size);
+
+	if(_size)
+	{
+		*_size = size;
+	}
+
+	return tile;
+}
+
+static int
+osmdb_tiler_makeTiles(osmdb_tiler_t* self,
+                      int tid, int zoom, int x0, int y0,
+                      int n, const char* mask,
+                      osmdb_tilerToken_t* token,
+                      osmdb_tile_t** tiles, size_t* sizes)
+{
+	// mask and token may be NULL
+	ASSERT(self);
+	ASSERT(tiles);
+	ASSERT(sizes);
+
+	osmdb_tilerState_t* state = self->state[tid];
+
+	osmdb_index_lock(self->index);
+
+	if(osmdb_tilerState_init(state, zoom, x0, y0,
+	                         n, mask) == 0)
+	{
+		goto fail_init;
+	}
+	state->token = token;
+
+	int k;
+	osmdb_ostream_t* os;
+	for(k = 0; k < n*n; ++k)
+	{
+		os = state->meta_os[k];
+		if(osmdb_ostream_beginTile(os, zoom,
+		                           x0 + k%n, y0 + k/n,
+		                           self->changeset) == 0)
+		{
+			goto fail_begin;
+		}
+		os->grid_cells = self->grid_cells;
+
+		// the tile only includes the classes of the mask
+		if(mask)
+		{
+			os->flags |= OSMDB_TILE_FLAG_SUBSET;
+		}
+
+		// zoom 15 tiles serve zooms 15-20 so the pts are
+		// ordered by level of detail where the highest
+		// level matches the simplification tolerance
+		if(zoom == 15)
+		{
+			os->lod_tolerance = state->tolerance;
+		}
+	}
+
+	// the token is checked between the rels/ways/nodes and
+	// for each ref such that an expired build omits the
+	// remaining rels/ways/nodes
+	if(osmdb_tiler_gatherRels(self, tid) == 0)
+	{
+		goto fail_gather_rels;
+	}
+
+	// the ways and nodes are gathered per tile of the
+	// metatile such that each tile matches a single tile
+	// while the way segments are fetched once per metatile
+	for(k = 0; k < n*n; ++k)
 	{
-		if(osmdb_tiler_gatherRel(self, tid, refs[i]) == 0)
+		if(osmdb_tiler_expired(self, tid))
 		{
-			ret = 0;
 			break;
 		}
+
+		if(osmdb_tiler_gatherWays(self, tid, k) == 0)
+		{
+			goto fail_gather_ways;
+		}
 	}
 
-	osmdb_index_put(self->index, &htr);
+	for(k = 0; k < n*n; ++k)
+	{
+		if(osmdb_tiler_expired(self, tid))
+		{
+			break;
+		}
+
+		state->x      = x0 + k%n;
+		state->y      = y0 + k/n;
+		state->os     = state->meta_os[k];
+		state->meta_k = k;
+		if(osmdb_tiler_gatherNodes(self, tid) == 0)
+		{
+			state->x      = x0;
+			state->y      = y0;
+			state->os     = state->meta_os[0];
+			state->meta_k = 0;
+			goto fail_gather_nodes;
+		}
+	}
+	state->x      = x0;
+	state->y      = y0;
+	state->os     = state->meta_os[0];
+	state->meta_k = 0;
+
+	if(state->expired)
+	{
+		if(token->partial == 0)
+		{
+			goto fail_expired;
+		}
+
+		for(k = 0; k < n*n; ++k)
+		{
+			state->meta_os[k]->flags |= OSMDB_TILE_FLAG_PARTIAL;
+		}
+	}
+
+	// the tiles are owned by the streams of the state and
+	// remain valid until the next build for tid
+	for(k = 0; k < n*n; ++k)
+	{
+		tiles[k] = osmdb_ostream_endTileShared(state->meta_os[k],
+		                                       &sizes[k]);
+		if(tiles[k] == NULL)
+		{
+			goto fail_end;
+		}
+	}
+
+	osmdb_tilerState_reset(state, self->index, 1);
+	osmdb_index_unlock(self->index);
+
+	// success
+	return 1;
 
-	return ret;
+	// failure
+	fail_end:
+	fail_expired:
+	fail_gather_nodes:
+	fail_gather_ways:
+	fail_gather_rels:
+	fail_begin:
+		osmdb_tilerState_reset(state, self->index, 1);
+	fail_init:
+		osmdb_index_unlock(self->index);
+	return 0;
 }
 
 /***********************************************************
@@ -1538,6 +2464,8 @@ osmdb_tiler_new(const char* fname_db,
 		goto fail_index;
 	}
 
+	// thinning is disabled by default since the class
+	// importance requires a style (see osmdb_tiler_thinNodes)
 	self->nth = nth;
 
 	self->changeset = osmdb_index_changeset(self->index);
@@ -1598,12 +2526,90 @@ void osmdb_tiler_delete(osmdb_tiler_t** _self)
 			osmdb_tilerState_delete(&self->state[i]);
 		}
 		FREE(self->state);
+		FREE(self->thin_min_zoom);
+		osmdb_geomCache_delete(&self->geom_cache);
 		osmdb_index_delete(&self->index);
 		FREE(self);
 		*_self = NULL;
 	}
 }
 
+int osmdb_tiler_thinNodes(osmdb_tiler_t* self, int cells,
+                          const int* min_zoom)
+{
+	// min_zoom may be NULL
+	ASSERT(self);
+
+	// cells is the size of the thinning grid where 0
+	// disables thinning and min_zoom is the optional class
+	// importance indexed by class code
+	if((cells < 0) || (cells > OSMDB_TILERSTATE_THIN_MAX))
+	{
+		LOGE("invalid cells=%i", cells);
+		return 0;
+	}
+
+	int* thin_min_zoom = NULL;
+	if(min_zoom)
+	{
+		int count = osmdb_classCount();
+		thin_min_zoom = (int*) MALLOC(count*sizeof(int));
+		if(thin_min_zoom == NULL)
+		{
+			LOGE("MALLOC failed");
+			return 0;
+		}
+		memcpy(thin_min_zoom, min_zoom, count*sizeof(int));
+	}
+
+	FREE(self->thin_min_zoom);
+	self->thin_cells    = cells;
+	self->thin_min_zoom = thin_min_zoom;
+
+	return 1;
+}
+
+int osmdb_tiler_indexGrid(osmdb_tiler_t* self, int cells)
+{
+	ASSERT(self);
+
+	// cells is the size of the grid index where 0 disables
+	// the grid (see osmdb_tileIter_query)
+	if((cells < 0) || (cells > OSMDB_TILE_GRID_MAX))
+	{
+		LOGE("invalid cells=%i", cells);
+		return 0;
+	}
+
+	self->grid_cells = cells;
+
+	return 1;
+}
+
+int osmdb_tiler_cacheGeometry(osmdb_tiler_t* self,
+                              size_t size)
+{
+	ASSERT(self);
+
+	// size is the size of the geometry cache in bytes
+	// where 0 disables the cache
+	// the cache must be configured before making tiles
+	osmdb_geomCache_t* cache = NULL;
+	if(size)
+	{
+		cache = osmdb_geomCache_new(size);
+		if(cache == NULL)
+		{
+			return 0;
+		}
+	}
+
+	osmdb_geomCache_delete(&self->geom_cache);
+	self->geom_cache = cache;
+
+	return 1;
+}
+
 osmdb_tile_t*
 osmdb_tiler_make(osmdb_tiler_t* self,
                  int tid, int zoom, int x, int y,
@@ -1612,58 +2618,112 @@ osmdb_tiler_make(osmdb_tiler_t* self,
 	// _size may be NULL
 	ASSERT(self);
 
-	osmdb_tilerState_t* state = self->state[tid];
+	return osmdb_tiler_makeMask(self, tid, zoom, x, y,
+	                            NULL, _size);
+}
 
-	osmdb_index_lock(self->index);
+osmdb_tile_t*
+osmdb_tiler_makeMask(osmdb_tiler_t* self,
+                     int tid, int zoom, int x, int y,
+                     const char* mask, size_t* _size)
+{
+	// mask and _size may be NULL
+	ASSERT(self);
 
-	if(osmdb_tilerState_init(state, zoom, x, y) == 0)
-	{
-		goto fail_init;
-	}
+	return osmdb_tiler_makeToken(self, tid, zoom, x, y,
+	                             mask, NULL, _size);
+}
+
+osmdb_tile_t*
+osmdb_tiler_makeToken(osmdb_tiler_t* self,
+                      int tid, int zoom, int x, int y,
+                      const char* mask,
+                      osmdb_tilerToken_t* token,
+                      size_t* _size)
+{
+	// mask, token and _size may be NULL
+	ASSERT(self);
 
-	if(osmdb_ostream_beginTile(state->os,
-	                           zoom, x, y,
-	                           self->changeset) == 0)
+	osmdb_tile_t* shared = NULL;
+	size_t        size   = 0;
+	if(osmdb_tiler_makeTiles(self, tid, zoom, x, y, 1,
+	                         mask, token, &shared,
+	                         &size) == 0)
 	{
-		goto fail_begin;
+		return NULL;
 	}
 
-	if(osmdb_tiler_gatherRels(self, tid) == 0)
+	return osmdb_tiler_copy(shared, size, _size);
+}
+
+osmdb_tile_t*
+osmdb_tiler_makeShared(osmdb_tiler_t* self,
+                       int tid, int zoom, int x, int y,
+                       size_t* _size)
+{
+	// _size may be NULL
+	ASSERT(self);
+
+	// the tile is owned by the tiler and remains valid
+	// until the next make for tid such that the caller
+	// must not delete the tile
+	osmdb_tile_t* tile = NULL;
+	size_t        size = 0;
+	if(osmdb_tiler_makeTiles(self, tid, zoom, x, y, 1,
+	                         NULL, NULL, &tile, &size) == 0)
 	{
-		goto fail_gather_rels;
+		return NULL;
 	}
 
-	if(osmdb_tiler_gatherWays(self, tid) == 0)
+	if(_size)
 	{
-		goto fail_gather_ways;
+		*_size = size;
 	}
 
-	if(osmdb_tiler_gatherNodes(self, tid) == 0)
+	return tile;
+}
+
+int osmdb_tiler_makeMeta(osmdb_tiler_t* self,
+                         int tid, int zoom, int x0, int y0,
+                         int n, osmdb_tile_t** tiles,
+                         size_t* sizes)
+{
+	ASSERT(self);
+	ASSERT(tiles);
+	ASSERT(sizes);
+
+	// tiles and sizes are arrays of n*n elements in row
+	// major order starting from the tile (x0,y0)
+	osmdb_tile_t* shared[OSMDB_TILERSTATE_META_MAX*
+	                     OSMDB_TILERSTATE_META_MAX];
+	if(osmdb_tiler_makeTiles(self, tid, zoom, x0, y0, n,
+	                         NULL, NULL, shared,
+	                         sizes) == 0)
 	{
-		goto fail_gather_nodes;
+		return 0;
 	}
 
-	osmdb_tile_t* tile;
-	tile = osmdb_ostream_endTile(state->os, _size);
-	if(tile == NULL)
+	int k;
+	for(k = 0; k < n*n; ++k)
 	{
-		goto fail_end;
+		tiles[k] = osmdb_tiler_copy(shared[k], sizes[k], NULL);
+		if(tiles[k] == NULL)
+		{
+			goto fail_copy;
+		}
 	}
 
-	osmdb_tilerState_reset(state, self->index, 1);
-	osmdb_index_unlock(self->index);
-
 	// success
-	return tile;
+	return 1;
 
 	// failure
-	fail_end:
-	fail_gather_nodes:
-	fail_gather_ways:
-	fail_gather_rels:
-		osmdb_tilerState_reset(state, self->index, 1);
-	fail_begin:
-	fail_init:
-		osmdb_index_unlock(self->index);
-	return NULL;
+	fail_copy:
+	{
+		int j;
+		for(j = 0; j < k; ++j)
+		{
+			osmdb_tile_delete(&tiles[j]);
+		}
+	}
+	return 0;
 }
@@ -25,16 +25,31 @@
 #define osmdb_tiler_H
 
 #include "../index/osmdb_index.h"
+#include "osmdb_geomCache.h"
 #include "osmdb_tile.h"
 #include "osmdb_tilerState.h"
 #include "osmdb_ostream.h"
 
+// recommended size of the node thinning grid which keeps
+// at most one node per 16x16 pixel cell of a 256 pixel tile
+#define OSMDB_TILER_THIN_CELLS 16
+
 typedef struct
 {
 	osmdb_index_t* index;
 
 	int64_t changeset;
 
+	// node thinning
+	int  thin_cells;
+	int* thin_min_zoom;
+
+	// grid index
+	int grid_cells;
+
+	// optional geometry cache
+	osmdb_geomCache_t* geom_cache;
+
 	// thread state
 	int nth;
 	osmdb_tilerState_t** state;
@@ -43,9 +58,37 @@ typedef struct
 osmdb_tiler_t* osmdb_tiler_new(const char* fname_db,
                                int nth, float smem);
 void           osmdb_tiler_delete(osmdb_tiler_t** _self);
+int            osmdb_tiler_thinNodes(osmdb_tiler_t* self,
+                                     int cells,
+                                     const int* min_zoom);
+int            osmdb_tiler_indexGrid(osmdb_tiler_t* self,
+                                     int cells);
+int            osmdb_tiler_cacheGeometry(osmdb_tiler_t* self,
+                                         size_t size);
 osmdb_tile_t*  osmdb_tiler_make(osmdb_tiler_t* self,
                                 int tid,
                                 int zoom, int x, int y,
                                 size_t* _size);
+osmdb_tile_t*  osmdb_tiler_makeMask(osmdb_tiler_t* self,
+                                    int tid,
+                                    int zoom, int x, int y,
+                                    const char* mask,
+                                    size_t* _size);
+osmdb_tile_t*  osmdb_tiler_makeToken(osmdb_tiler_t* self,
+                                     int tid,
+                                     int zoom, int x, int y,
+                                     const char* mask,
+                                     osmdb_tilerToken_t* token,
+                                     size_t* _size);
+osmdb_tile_t*  osmdb_tiler_makeShared(osmdb_tiler_t* self,
+                                      int tid,
+                                      int zoom, int x, int y,
+                                      size_t* _size);
+int            osmdb_tiler_makeMeta(osmdb_tiler_t* self,
+                                    int tid,
+                                    int zoom, int x0, int y0,
+                                    int n,
+                                    osmdb_tile_t** tiles,
+                                    size_t* sizes);
 
 #endif
@@ -22,19 +22,29 @@
  */
 
 #include <inttypes.h>
-#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 
 #define LOG_TAG "osmdb"
-#include "libcc/math/cc_float.h"
-#include "libcc/math/cc_vec3d.h"
 #include "libcc/cc_log.h"
 #include "libcc/cc_memory.h"
 #include "terrain/terrain_util.h"
 #include "osmdb_waySegment.h"
 #include "osmdb_tilerState.h"
 
+#define OSMDB_TILERSTATE_ARENA_SIZE (256*1024)
+
+// the arena memory retained between builds such that a
+// long running server does not retain the memory of the
+// largest tile
+#define OSMDB_TILERSTATE_ARENA_MAX (4*OSMDB_TILERSTATE_ARENA_SIZE)
+
+// elements are defined with zero width but in practice
+// are drawn with non-zero width points/lines so a border
+// is needed to ensure they are not clipped between
+// neighboring tiles which matches the importer border
+#define OSMDB_TILERSTATE_BORDER (1.0/16.0)
+
 /***********************************************************
 * public                                                   *
 ***********************************************************/
@@ -50,40 +60,96 @@ osmdb_tilerState_t* osmdb_tilerState_new(void)
 		return NULL;
 	}
 
-	self->os = osmdb_ostream_new();
-	if(self->os == NULL)
+	// the streams of the other metatile tiles are created
+	// on demand by osmdb_tilerState_init
+	self->meta_n     = 1;
+	self->meta_os[0] = osmdb_ostream_new();
+	if(self->meta_os[0] == NULL)
 	{
 		goto fail_os;
 	}
+	self->os = self->meta_os[0];
+
+	self->map_meta = osmdb_idmap_new();
+	if(self->map_meta == NULL)
+	{
+		goto fail_map_meta;
+	}
+
+	self->meta_arena = osmdb_arena_new(OSMDB_TILERSTATE_ARENA_SIZE,
+	                                   OSMDB_TILERSTATE_ARENA_MAX);
+	if(self->meta_arena == NULL)
+	{
+		goto fail_meta_arena;
+	}
+
+	self->map_meta_segs = osmdb_idmap_new();
+	if(self->map_meta_segs == NULL)
+	{
+		goto fail_map_meta_segs;
+	}
+
+	// segments, nds and join refs are allocated from
+	// the arena which is rewound in one shot by reset
+	self->arena = osmdb_arena_new(OSMDB_TILERSTATE_ARENA_SIZE,
+	                              OSMDB_TILERSTATE_ARENA_MAX);
+	if(self->arena == NULL)
+	{
+		goto fail_arena;
+	}
+
+	self->map_export_nodes = osmdb_idmap_new();
+	if(self->map_export_nodes == NULL)
+	{
+		goto fail_map_export_nodes;
+	}
+
+	self->map_export_ways = osmdb_idmap_new();
+	if(self->map_export_ways == NULL)
+	{
+		goto fail_map_export_ways;
+	}
 
-	self->map_export = cc_map_new();
-	if(self->map_export == NULL)
+	self->map_export_rel = osmdb_idmap_new();
+	if(self->map_export_rel == NULL)
 	{
-		goto fail_map_export;
+		goto fail_map_export_rel;
 	}
 
-	self->map_segs = cc_map_new();
+	self->map_segs = osmdb_idmap_new();
 	if(self->map_segs == NULL)
 	{
 		goto fail_map_segs;
 	}
 
-	self->mm_nds_join = cc_multimap_new(NULL);
-	if(self->mm_nds_join == NULL)
+	self->map_nds_join = osmdb_idmap_new();
+	if(self->map_nds_join == NULL)
 	{
-		goto fail_mm_nds_join;
+		goto fail_map_nds_join;
 	}
 
 	// success
 	return self;
 
 	// failure
-	fail_mm_nds_join:
-		cc_map_delete(&self->map_segs);
+	fail_map_nds_join:
+		osmdb_idmap_delete(&self->map_segs);
 	fail_map_segs:
-		cc_map_delete(&self->map_export);
-	fail_map_export:
-		osmdb_ostream_delete(&self->os);
+		osmdb_idmap_delete(&self->map_export_rel);
+	fail_map_export_rel:
+		osmdb_idmap_delete(&self->map_export_ways);
+	fail_map_export_ways:
+		osmdb_idmap_delete(&self->map_export_nodes);
+	fail_map_export_nodes:
+		osmdb_arena_delete(&self->arena);
+	fail_arena:
+		osmdb_idmap_delete(&self->map_meta_segs);
+	fail_map_meta_segs:
+		osmdb_arena_delete(&self->meta_arena);
+	fail_meta_arena:
+		osmdb_idmap_delete(&self->map_meta);
+	fail_map_meta:
+		osmdb_ostream_delete(&self->meta_os[0]);
 	fail_os:
 		FREE(self);
 	return NULL;
@@ -98,38 +164,76 @@ void osmdb_tilerState_delete(osmdb_tilerState_t** _self)
 	{
 		// tiler must reset the tilerState when making
 		// tiles to ensure that these objects are empty
-		cc_multimap_delete(&self->mm_nds_join);
-		cc_map_delete(&self->map_segs);
-		cc_map_delete(&self->map_export);
-		osmdb_ostream_delete(&self->os);
+		osmdb_idmap_delete(&self->map_nds_join);
+		osmdb_idmap_delete(&self->map_segs);
+		osmdb_idmap_delete(&self->map_export_rel);
+		osmdb_idmap_delete(&self->map_export_ways);
+		osmdb_idmap_delete(&self->map_export_nodes);
+		osmdb_arena_delete(&self->arena);
+		osmdb_idmap_delete(&self->map_meta_segs);
+		osmdb_arena_delete(&self->meta_arena);
+		osmdb_idmap_delete(&self->map_meta);
+
+		int i;
+		int count = OSMDB_TILERSTATE_META_MAX*
+		            OSMDB_TILERSTATE_META_MAX;
+		for(i = 0; i < count; ++i)
+		{
+			osmdb_ostream_delete(&self->meta_os[i]);
+		}
 		FREE(self);
 	}
 }
 
 int osmdb_tilerState_init(osmdb_tilerState_t* self,
-                          int zoom, int x, int y)
+                          int zoom, int x, int y,
+                          int n, const char* mask)
 {
+	// mask may be NULL
 	ASSERT(self);
 
-	self->zoom = zoom;
-	self->x    = x;
-	self->y    = y;
+	if((n < 1) || (n > OSMDB_TILERSTATE_META_MAX) ||
+	   (x < 0) || (x + n > (1 << zoom)) ||
+	   (y < 0) || (y + n > (1 << zoom)))
+	{
+		LOGE("invalid zoom=%i, x=%i, y=%i, n=%i",
+		     zoom, x, y, n);
+		return 0;
+	}
+
+	int i;
+	for(i = 0; i < n*n; ++i)
+	{
+		if(self->meta_os[i])
+		{
+			continue;
+		}
+
+		self->meta_os[i] = osmdb_ostream_new();
+		if(self->meta_os[i] == NULL)
+		{
+			return 0;
+		}
+	}
+	self->meta_n = n;
+	self->meta_k = 0;
+	self->os     = self->meta_os[0];
+
+	self->zoom    = zoom;
+	self->x       = x;
+	self->y       = y;
+	self->mask    = mask;
+	self->token   = NULL;
+	self->expired = 0;
 
 	terrain_bounds(x, y, zoom, &self->latT, &self->lonL,
 	               &self->latB, &self->lonR);
 
-	// compute x,y for tile
-	cc_vec3d_t pa;
-	cc_vec3d_t pb;
-	float onemi = cc_mi2m(5280.0f);
-	terrain_geo2xyz(self->latT, self->lonL, onemi,
-	                &pa.x, &pa.y, &pa.z);
-	terrain_geo2xyz(self->latB, self->lonR, onemi,
-	                &pb.x, &pb.y, &pb.z);
-
-	// compute min_dist and scale min_dist since
-	// each tile serves multiple zoom levels
-	float s = 8.0f;
+	// compute the tolerance and scale the tolerance since
+	// each tile serves multiple zoom levels such that the
+	// simplification error is at most one pixel at the
+	// highest zoom level served by the tile
+	float s = 1.0f;
 	if(zoom == 15)
 	{
 		// 2:16, 4:17, 8:18, 16:19, 32:20
@@ -140,8 +244,36 @@ int osmdb_tilerState_init(osmdb_tilerState_t* self,
 		s *= 1.0f/2.0f;
 	}
 
-	float pix = sqrtf(2*256.0f*256.0f);
-	self->min_dist = s*cc_vec3d_distance(&pb, &pa)/pix;
+	// tile space is 32767 units for 256 pixels
+	self->tolerance = s*32767.0/256.0;
+	self->border    = (int) (OSMDB_TILERSTATE_BORDER*32767.0);
+
+	// select the generalized geometry types
+	if(zoom == 9)
+	{
+		self->type_waygen = OSMDB_TYPE_WAYGEN9;
+		self->type_relgen = OSMDB_TYPE_RELGEN9;
+	}
+	else if(zoom == 7)
+	{
+		self->type_waygen = OSMDB_TYPE_WAYGEN7;
+		self->type_relgen = OSMDB_TYPE_RELGEN7;
+	}
+	else if(zoom == 5)
+	{
+		self->type_waygen = OSMDB_TYPE_WAYGEN5;
+		self->type_relgen = OSMDB_TYPE_RELGEN5;
+	}
+	else if(zoom == 3)
+	{
+		self->type_waygen = OSMDB_TYPE_WAYGEN3;
+		self->type_relgen = OSMDB_TYPE_RELGEN3;
+	}
+	else
+	{
+		self->type_waygen = -1;
+		self->type_relgen = -1;
+	}
 
 	return 1;
 }
@@ -153,33 +285,116 @@ void osmdb_tilerState_reset(osmdb_tilerState_t* self,
 	ASSERT(self);
 	ASSERT(index);
 
-	// map_export is a mapping from nid/wid to ONE
-	// so we can simply discard the map references
+	// map_export is a mapping from nid/wid to a mask
+	// so we can simply clear the maps
+	// the metatile segments are shared by the tiles of
+	// the metatile so they are discarded with map_export
 	if(discard_export)
 	{
-		cc_map_discard(self->map_export);
+		osmdb_idmap_clear(self->map_export_nodes);
+		osmdb_idmap_clear(self->map_export_ways);
+		osmdb_idmap_clear(self->map_meta_segs);
+		osmdb_arena_reset(self->meta_arena);
 	}
+	osmdb_idmap_clear(self->map_export_rel);
 
 	// delete way segments
-	cc_mapIter_t* miter;
-	miter = cc_map_head(self->map_segs);
-	while(miter)
+	int i;
+	for(i = 0; i < self->map_segs->count; ++i)
 	{
 		osmdb_waySegment_t* seg;
 		seg = (osmdb_waySegment_t*)
-		      cc_map_remove(self->map_segs, &miter);
+		      self->map_segs->entries[i].val;
 		osmdb_waySegment_delete(index, &seg);
 	}
+	osmdb_idmap_clear(self->map_segs);
+
+	// join refs are allocated from the arena
+	osmdb_idmap_clear(self->map_nds_join);
+
+	// rewind the arena for segments, nds and join refs
+	osmdb_arena_reset(self->arena);
+}
 
-	// delete refs
-	cc_multimapIter_t  mmiterator;
-	cc_multimapIter_t* mmiter;
-	mmiter = cc_multimap_head(self->mm_nds_join, &mmiterator);
-	while(mmiter)
+int osmdb_tilerState_putMetaSeg(osmdb_tilerState_t* self,
+                                int64_t wid, size_t size,
+                                const void* data)
+{
+	ASSERT(self);
+	ASSERT(data);
+
+	// the packed segment is prefixed by its size
+	size_t* ptr;
+	ptr = (size_t*)
+	      osmdb_arena_alloc(self->meta_arena,
+	                        sizeof(size_t) + size);
+	if(ptr == NULL)
 	{
-		int64_t* ref;
-		ref = (int64_t*)
-		      cc_multimap_remove(self->mm_nds_join, &mmiter);
-		FREE(ref);
+		return 0;
 	}
+	ptr[0] = size;
+	memcpy((void*) &ptr[1], data, size);
+
+	return osmdb_idmap_add(self->map_meta_segs, wid,
+	                       (void*) ptr);
+}
+
+void* osmdb_tilerState_getMetaSeg(osmdb_tilerState_t* self,
+                                  int64_t wid, size_t* _size)
+{
+	ASSERT(self);
+	ASSERT(_size);
+
+	size_t* ptr;
+	ptr = (size_t*) osmdb_idmap_find(self->map_meta_segs, wid);
+	if(ptr == NULL)
+	{
+		return NULL;
+	}
+
+	// the segment is copied to the arena since the nds
+	// are compacted in place by the tiler
+	void* data = osmdb_arena_alloc(self->arena, ptr[0]);
+	if(data == NULL)
+	{
+		return NULL;
+	}
+	memcpy(data, (const void*) &ptr[1], ptr[0]);
+
+	*_size = ptr[0];
+
+	return data;
+}
+
+int osmdb_tilerState_addJoin(osmdb_tilerState_t* self,
+                             int64_t nid, int64_t wid)
+{
+	ASSERT(self);
+
+	osmdb_joinRef_t* ref;
+	ref = (osmdb_joinRef_t*)
+	      osmdb_arena_alloc(self->arena,
+	                        sizeof(osmdb_joinRef_t));
+	if(ref == NULL)
+	{
+		return 0;
+	}
+	ref->wid  = wid;
+	ref->next = NULL;
+	ref->tail = ref;
+
+	// append ref to preserve the join order
+	osmdb_joinRef_t* head;
+	head = (osmdb_joinRef_t*)
+	       osmdb_idmap_find(self->map_nds_join, nid);
+	if(head == NULL)
+	{
+		return osmdb_idmap_add(self->map_nds_join, nid,
+		                       (void*) ref);
+	}
+
+	head->tail->next = ref;
+	head->tail       = ref;
+
+	return 1;
 }
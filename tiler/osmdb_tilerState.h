@@ -24,12 +24,48 @@
 #ifndef osmdb_tilerState_H
 #define osmdb_tilerState_H
 
-#include "libcc/cc_list.h"
-#include "libcc/cc_map.h"
-#include "libcc/cc_multimap.h"
 #include "../index/osmdb_index.h"
+#include "osmdb_arena.h"
+#include "osmdb_idmap.h"
 #include "osmdb_ostream.h"
 
+#define OSMDB_TILERSTATE_THIN_MAX 32
+
+// metatiles are at most 4x4 tiles (see osmdb_tiler_makeMeta)
+#define OSMDB_TILERSTATE_META_MAX 4
+
+// best node candidate for a cell of the thinning grid
+typedef struct
+{
+	osmdb_handle_t* hni;
+	osmdb_handle_t* hnc;
+} osmdb_tilerThin_t;
+
+// optional deadline and cancellation token for a tile
+// build (see osmdb_tiler_makeToken)
+// the deadline is a cc_timestamp or 0.0 for none and
+// cancel may be set by another thread to abort the build
+// partial selects a degraded tile which omits the
+// remaining rels/ways/nodes once the build expires
+// (see OSMDB_TILE_FLAG_PARTIAL) rather than a failure
+typedef struct
+{
+	double       deadline;
+	volatile int cancel;
+	int          partial;
+} osmdb_tilerToken_t;
+
+// list of wids which share a join nd
+// wid is set to -1 once the way has been joined
+// tail is only valid for the head of the list
+typedef struct osmdb_joinRef_s
+{
+	int64_t wid;
+
+	struct osmdb_joinRef_s* next;
+	struct osmdb_joinRef_s* tail;
+} osmdb_joinRef_t;
+
 typedef struct
 {
 	int zoom;
@@ -41,20 +77,83 @@ typedef struct
 	double latB;
 	double lonR;
 
-	float min_dist;
+	// simplification tolerance and clip border
+	// in tile space
+	double tolerance;
+	int    border;
+
+	// low zoom tiles use the generalized geometry types
+	// (see OSMDB_TYPE_WAYGEN9) rather than the full
+	// resolution nds where the types are -1 otherwise
+	int type_waygen;
+	int type_relgen;
+
+	// optional class mask indexed by the class code which
+	// selects a subset of the tile refs
+	const char* mask;
+
+	// optional token where expired is set once the
+	// deadline passes or the build is canceled
+	osmdb_tilerToken_t* token;
+	int                 expired;
 
+	// a metatile of meta_n*meta_n tiles shares the gathered
+	// geometry which is projected to the tile space of the
+	// first tile and exported to the stream of each tile
+	// in row-major order where os and meta_k are the
+	// stream and index of the current tile for the nodes
+	int              meta_n;
+	int              meta_k;
+	osmdb_ostream_t* meta_os[OSMDB_TILERSTATE_META_MAX*
+	                         OSMDB_TILERSTATE_META_MAX];
 	osmdb_ostream_t* os;
-	cc_map_t*        map_export;
-	cc_map_t*        map_segs;
-	cc_multimap_t*   mm_nds_join;
+
+	// map_meta is the union of the tile refs of the
+	// metatile which maps the refs to the mask of tiles
+	// (see osmdb_tiler_gatherRels)
+	osmdb_idmap_t* map_meta;
+
+	// map_meta_segs maps the wids fetched by the tiles of
+	// the metatile to the packed segments in meta_arena
+	// such that the ways shared by the tiles are fetched
+	// once per metatile (see osmdb_tiler_newSegment)
+	osmdb_arena_t* meta_arena;
+	osmdb_idmap_t* map_meta_segs;
+
+	// the arena and maps are cleared rather than freed
+	// between tiles to avoid allocations in steady state
+	// where map_export_nodes/ways map the nodes and member
+	// ways drawn by the rels to the mask of tiles which
+	// include the rel and map_export_rel contains the
+	// member ways drawn by the current rel
+	// (see osmdb_tiler_cacheRel)
+	osmdb_arena_t*   arena;
+	osmdb_idmap_t*   map_export_nodes;
+	osmdb_idmap_t*   map_export_ways;
+	osmdb_idmap_t*   map_export_rel;
+	osmdb_idmap_t*   map_segs;
+	osmdb_idmap_t*   map_nds_join;
+
+	// node thinning grid (see osmdb_tiler_thinNodes)
+	osmdb_tilerThin_t thin[OSMDB_TILERSTATE_THIN_MAX*
+	                       OSMDB_TILERSTATE_THIN_MAX];
 } osmdb_tilerState_t;
 
 osmdb_tilerState_t* osmdb_tilerState_new(void);
 void                osmdb_tilerState_delete(osmdb_tilerState_t** _self);
 int                 osmdb_tilerState_init(osmdb_tilerState_t* self,
-                                          int zoom, int x, int y);
+                                          int zoom, int x, int y,
+                                          int n, const char* mask);
 void                osmdb_tilerState_reset(osmdb_tilerState_t* self,
                                            osmdb_index_t* index,
                                            int discard_export);
+int                 osmdb_tilerState_putMetaSeg(osmdb_tilerState_t* self,
+                                                int64_t wid, size_t size,
+                                                const void* data);
+void*               osmdb_tilerState_getMetaSeg(osmdb_tilerState_t* self,
+                                                int64_t wid,
+                                                size_t* _size);
+int                 osmdb_tilerState_addJoin(osmdb_tilerState_t* self,
+                                             int64_t nid, int64_t wid);
 
 #endif
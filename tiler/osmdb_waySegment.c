@@ -30,27 +30,143 @@
 #include "libcc/cc_memory.h"
 #include "osmdb_waySegment.h"
 
+// packed segments are stored in the geometry cache as the
+// header followed by the way_info, nds and pts where each
+// part is padded to 8 bytes
+typedef struct
+{
+	osmdb_wayRange_t way_range;
+	int              flags;
+	int              count;
+	int              size_info;
+	int              pad;
+} osmdb_waySegmentPack_t;
+
+#define OSMDB_WAYSEGMENT_PAD(size) (((size) + 7) & ~((size_t) 7))
+
 /***********************************************************
 * private                                                  *
 ***********************************************************/
 
+static void
+osmdb_waySegment_initChain(osmdb_waySegment_t* self)
+{
+	ASSERT(self);
+
+	// the segment is a chain of one
+	self->chain_count                     = self->count;
+	self->term[OSMDB_WAYSEGMENT_HEAD]     = self;
+	self->term[OSMDB_WAYSEGMENT_TAIL]     = self;
+	self->term_end[OSMDB_WAYSEGMENT_HEAD] = OSMDB_WAYSEGMENT_HEAD;
+	self->term_end[OSMDB_WAYSEGMENT_TAIL] = OSMDB_WAYSEGMENT_TAIL;
+}
+
+static int
+osmdb_waySegment_newResolved(osmdb_index_t* index,
+                             osmdb_arena_t* arena, int tid,
+                             osmdb_wayRange_t* range,
+                             int count, int64_t* nds,
+                             osmdb_worldPoint_t* pts,
+                             int flags,
+                             osmdb_waySegment_t** _seg)
+{
+	ASSERT(index);
+	ASSERT(arena);
+	ASSERT(range);
+	ASSERT(nds);
+	ASSERT(pts);
+	ASSERT(_seg);
+
+	*_seg = NULL;
+
+	osmdb_waySegment_t* seg;
+	seg = (osmdb_waySegment_t*)
+	      osmdb_arena_alloc(arena, sizeof(osmdb_waySegment_t));
+	if(seg == NULL)
+	{
+		return 0;
+	}
+	memset(seg, 0, sizeof(osmdb_waySegment_t));
+
+	seg->flags = flags;
+
+	int64_t wid = range->wid;
+	if(osmdb_index_get(index, tid,
+	                   OSMDB_TYPE_WAYINFO,
+	                   wid, &seg->hwi) == 0)
+	{
+		LOGE("invalid wid=%" PRId64, wid);
+		return 0;
+	}
+	else if(seg->hwi == NULL)
+	{
+		return 1;
+	}
+	seg->way_info = seg->hwi->way_info;
+
+	// copy range
+	memcpy(&seg->way_range, range,
+	       sizeof(osmdb_wayRange_t));
+
+	// copy nds and pts which were resolved by the importer
+	seg->nds  = (int64_t*)
+	            osmdb_arena_alloc(arena,
+	                              count*sizeof(int64_t));
+	seg->wpts = (osmdb_tilePoint_t*)
+	            osmdb_arena_alloc(arena,
+	                              count*sizeof(osmdb_tilePoint_t));
+	if((seg->nds == NULL) || (seg->wpts == NULL))
+	{
+		goto fail_nds;
+	}
+
+	memcpy(seg->nds, nds,
+	       count*sizeof(int64_t));
+	seg->count = count;
+
+	int i;
+	for(i = 0; i < count; ++i)
+	{
+		seg->wpts[i].x = pts[i].x;
+		seg->wpts[i].y = pts[i].y;
+	}
+
+	osmdb_waySegment_initChain(seg);
+
+	*_seg = seg;
+
+	// success
+	return 1;
+
+	// failure
+	fail_nds:
+		osmdb_index_put(index, &seg->hwi);
+	return 0;
+}
+
+/***********************************************************
+* public                                                   *
+***********************************************************/
+
 int osmdb_waySegment_new(osmdb_index_t* index,
+                         osmdb_arena_t* arena,
                          int tid, int64_t wid, int flags,
                          osmdb_waySegment_t** _seg)
 {
 	ASSERT(index);
+	ASSERT(arena);
 	ASSERT(_seg);
 
 	*_seg = NULL;
 
 	osmdb_waySegment_t* seg;
 	seg = (osmdb_waySegment_t*)
-	      CALLOC(1, sizeof(osmdb_waySegment_t));
+	      osmdb_arena_alloc(arena, sizeof(osmdb_waySegment_t));
 	if(seg == NULL)
 	{
-		LOGE("CALLOC failed");
 		return 0;
 	}
+	memset(seg, 0, sizeof(osmdb_waySegment_t));
 
 	seg->flags = flags;
 
@@ -59,13 +175,13 @@ int osmdb_waySegment_new(osmdb_index_t* index,
 	                   wid, &seg->hwi) == 0)
 	{
 		LOGE("invalid wid=%" PRId64, wid);
-		goto fail_hwi;
+		return 0;
 	}
 	else if(seg->hwi == NULL)
 	{
-		FREE(seg);
 		return 1;
 	}
+	seg->way_info = seg->hwi->way_info;
 
 	// copy range
 	osmdb_handle_t* hwr = NULL;
@@ -79,19 +195,12 @@ int osmdb_waySegment_new(osmdb_index_t* index,
 	else if(hwr == NULL)
 	{
 		osmdb_index_put(index, &seg->hwi);
-		FREE(seg);
 		return 1;
 	}
 	memcpy(&seg->way_range, hwr->way_range,
 	       sizeof(osmdb_wayRange_t));
 
 	// copy nds
-	seg->list_nds = cc_list_new();
-	if(seg->list_nds == NULL)
-	{
-		goto fail_list_nds;
-	}
-
 	osmdb_handle_t* hwn = NULL;
 	if(osmdb_index_get(index, tid,
 	                   OSMDB_TYPE_WAYNDS,
@@ -102,33 +211,57 @@ int osmdb_waySegment_new(osmdb_index_t* index,
 	}
 	else if(hwn == NULL)
 	{
-		cc_list_delete(&seg->list_nds);
 		osmdb_index_put(index, &hwr);
 		osmdb_index_put(index, &seg->hwi);
-		FREE(seg);
 		return 1;
 	}
 
-	int      i;
-	int64_t* ref;
 	osmdb_wayNds_t* way_nds = hwn->way_nds;
-	int64_t* refs = osmdb_wayNds_nds(way_nds);
-	for(i = 0; i < way_nds->count; ++i)
+	if(way_nds->count)
 	{
-		ref = (int64_t*) CALLOC(1, sizeof(int64_t));
-		if(ref == NULL)
+		int count = way_nds->count;
+		seg->nds  = (int64_t*)
+		            osmdb_arena_alloc(arena,
+		                              count*sizeof(int64_t));
+		seg->wpts = (osmdb_tilePoint_t*)
+		            osmdb_arena_alloc(arena,
+		                              count*sizeof(osmdb_tilePoint_t));
+		if((seg->nds == NULL) || (seg->wpts == NULL))
 		{
-			goto fail_ref;
+			goto fail_nds;
 		}
-		*ref = refs[i];
 
-		if(cc_list_append(seg->list_nds, NULL,
-		                  (const void*) ref) == NULL)
+		memcpy(seg->nds, osmdb_wayNds_nds(way_nds),
+		       count*sizeof(int64_t));
+		seg->count = count;
+
+		// resolve the world coordinates once so they may be
+		// reused when joining and projecting the segment
+		int i;
+		for(i = 0; i < count; ++i)
 		{
-			goto fail_append;
+			osmdb_handle_t* hnc = NULL;
+			if(osmdb_index_get(index, tid,
+			                   OSMDB_TYPE_NODECOORD,
+			                   seg->nds[i], &hnc) == 0)
+			{
+				goto fail_nds;
+			}
+			else if(hnc == NULL)
+			{
+				seg->wpts[i].x = OSMDB_WAYSEGMENT_MISSING;
+				seg->wpts[i].y = OSMDB_WAYSEGMENT_MISSING;
+				continue;
+			}
+
+			seg->wpts[i].x = hnc->node_coord->x;
+			seg->wpts[i].y = hnc->node_coord->y;
+			osmdb_index_put(index, &hnc);
 		}
 	}
 
+	osmdb_waySegment_initChain(seg);
+
 	osmdb_index_put(index, &hwn);
 	osmdb_index_put(index, &hwr);
 
@@ -138,52 +271,309 @@ int osmdb_waySegment_new(osmdb_index_t* index,
 	return 1;
 
 	// failure
-	fail_append:
-		FREE(ref);
-	fail_ref:
+	fail_nds:
 		osmdb_index_put(index, &hwn);
 	fail_hwn:
-	{
-		cc_listIter_t* iter;
-		iter = cc_list_head(seg->list_nds);
-		while(iter)
-		{
-			ref = (int64_t*)
-			      cc_list_remove(seg->list_nds, &iter);
-			FREE(ref);
-		}
-		cc_list_delete(&seg->list_nds);
-	}
-	fail_list_nds:
 		osmdb_index_put(index, &hwr);
 	fail_hwr:
 		osmdb_index_put(index, &seg->hwi);
-	fail_hwi:
-		FREE(seg);
 	return 0;
 }
 
+int osmdb_waySegment_newRing(osmdb_index_t* index,
+                             osmdb_arena_t* arena,
+                             int tid, osmdb_relRing_t* ring,
+                             int flags,
+                             osmdb_waySegment_t** _seg)
+{
+	ASSERT(index);
+	ASSERT(arena);
+	ASSERT(ring);
+	ASSERT(_seg);
+
+	return osmdb_waySegment_newResolved(index, arena, tid,
+	                                    &ring->range,
+	                                    ring->count,
+	                                    osmdb_relRing_nds(ring),
+	                                    osmdb_relRing_pts(ring),
+	                                    flags, _seg);
+}
+
+int osmdb_waySegment_newChain(osmdb_index_t* index,
+                              osmdb_arena_t* arena,
+                              int tid, int type,
+                              int64_t cid, int flags,
+                              osmdb_waySegment_t** _seg)
+{
+	ASSERT(index);
+	ASSERT(arena);
+	ASSERT(_seg);
+
+	*_seg = NULL;
+
+	// type is OSMDB_TYPE_WAYCHAIN or OSMDB_TYPE_WAYGENX
+	// which share the osmdb_wayChain_t layout
+	osmdb_handle_t* hwc = NULL;
+	if(osmdb_index_get(index, tid,
+	                   type, cid, &hwc) == 0)
+	{
+		LOGE("invalid cid=%" PRId64, cid);
+		return 0;
+	}
+	else if(hwc == NULL)
+	{
+		return 1;
+	}
+
+	osmdb_wayChain_t* way_chain = hwc->way_chain;
+	if(osmdb_waySegment_newResolved(index, arena, tid,
+	                                &way_chain->range,
+	                                way_chain->count,
+	                                osmdb_wayChain_nds(way_chain),
+	                                osmdb_wayChain_pts(way_chain),
+	                                flags, _seg) == 0)
+	{
+		osmdb_index_put(index, &hwc);
+		return 0;
+	}
+
+	osmdb_index_put(index, &hwc);
+
+	return 1;
+}
+
 void osmdb_waySegment_delete(osmdb_index_t* index,
                              osmdb_waySegment_t** _seg)
 {
 	ASSERT(index);
 	ASSERT(_seg);
 
+	// segments are allocated from the tilerState arena
+	// so only the way_info handle must be released
 	osmdb_waySegment_t* seg = *_seg;
 	if(seg)
 	{
-		cc_listIter_t* iter = cc_list_head(seg->list_nds);
-		while(iter)
+		osmdb_index_put(index, &seg->hwi);
+		*_seg = NULL;
+	}
+}
+
+osmdb_waySegment_t*
+osmdb_waySegment_unpack(osmdb_arena_t* arena,
+                        void* data, size_t* _size)
+{
+	ASSERT(arena);
+	ASSERT(data);
+	ASSERT(_size);
+
+	osmdb_waySegment_t* seg;
+	seg = (osmdb_waySegment_t*)
+	      osmdb_arena_alloc(arena, sizeof(osmdb_waySegment_t));
+	if(seg == NULL)
+	{
+		return NULL;
+	}
+	memset(seg, 0, sizeof(osmdb_waySegment_t));
+
+	// the segment references the packed data which must
+	// remain valid until the arena is reset
+	osmdb_waySegmentPack_t* pack;
+	pack = (osmdb_waySegmentPack_t*) data;
+
+	int    count = pack->count;
+	char*  p     = (char*) data;
+	size_t size  = sizeof(osmdb_waySegmentPack_t);
+	seg->way_info = (osmdb_wayInfo_t*) (p + size);
+	size += OSMDB_WAYSEGMENT_PAD(pack->size_info);
+	seg->nds = (int64_t*) (p + size);
+	size += count*sizeof(int64_t);
+	seg->wpts = (osmdb_tilePoint_t*) (p + size);
+	size += OSMDB_WAYSEGMENT_PAD(count*sizeof(osmdb_tilePoint_t));
+
+	memcpy(&seg->way_range, &pack->way_range,
+	       sizeof(osmdb_wayRange_t));
+	seg->flags = pack->flags;
+	seg->count = count;
+
+	osmdb_waySegment_initChain(seg);
+
+	*_size = size;
+
+	return seg;
+}
+
+size_t osmdb_waySegment_packSize(osmdb_waySegment_t* self)
+{
+	ASSERT(self);
+
+	size_t size_info = osmdb_wayInfo_sizeof(self->way_info);
+	return sizeof(osmdb_waySegmentPack_t) +
+	       OSMDB_WAYSEGMENT_PAD(size_info) +
+	       self->count*sizeof(int64_t) +
+	       OSMDB_WAYSEGMENT_PAD(self->count*
+	                            sizeof(osmdb_tilePoint_t));
+}
+
+void osmdb_waySegment_pack(osmdb_waySegment_t* self,
+                           const osmdb_tilePoint_t* pts,
+                           int dx, int dy, void* data)
+{
+	// pts may be NULL if count is 0
+	ASSERT(self);
+	ASSERT(data);
+
+	// pts are the count world/tile space points of the nds
+	// which are offset by dx/dy
+	size_t size_info = osmdb_wayInfo_sizeof(self->way_info);
+
+	osmdb_waySegmentPack_t* pack;
+	pack = (osmdb_waySegmentPack_t*) data;
+	memset(pack, 0, sizeof(osmdb_waySegmentPack_t));
+	memcpy(&pack->way_range, &self->way_range,
+	       sizeof(osmdb_wayRange_t));
+	pack->flags     = self->flags;
+	pack->count     = self->count;
+	pack->size_info = (int) size_info;
+
+	char*  p    = (char*) data;
+	size_t size = sizeof(osmdb_waySegmentPack_t);
+	memcpy(p + size, self->way_info, size_info);
+	size += OSMDB_WAYSEGMENT_PAD(size_info);
+	memcpy(p + size, self->nds, self->count*sizeof(int64_t));
+	size += self->count*sizeof(int64_t);
+
+	int i;
+	osmdb_tilePoint_t* ppts = (osmdb_tilePoint_t*) (p + size);
+	for(i = 0; i < self->count; ++i)
+	{
+		ppts[i].x = pts[i].x + dx;
+		ppts[i].y = pts[i].y + dy;
+	}
+}
+
+int64_t* osmdb_waySegment_nds(osmdb_waySegment_t* self)
+{
+	ASSERT(self);
+
+	return self->nds;
+}
+
+int64_t osmdb_waySegment_endNd(osmdb_waySegment_t* self,
+                               int end, int offset,
+                               osmdb_tilePoint_t* wpt)
+{
+	// wpt may be NULL
+	ASSERT(self);
+
+	// offset is the number of nds from the end of the chain
+	// which must be within the terminal segment
+	osmdb_waySegment_t* seg = self->term[end];
+
+	int i = offset;
+	if(self->term_end[end] == OSMDB_WAYSEGMENT_TAIL)
+	{
+		i = seg->count - 1 - offset;
+	}
+	ASSERT((i >= 0) && (i < seg->count));
+
+	if(wpt)
+	{
+		*wpt = seg->wpts[i];
+	}
+
+	return seg->nds[i];
+}
+
+void osmdb_waySegment_join(osmdb_waySegment_t* self,
+                           int end,
+                           osmdb_waySegment_t* seg,
+                           int seg_end)
+{
+	ASSERT(self);
+	ASSERT(seg);
+
+	// link the terminal segments
+	osmdb_waySegment_t* a     = self->term[end];
+	osmdb_waySegment_t* b     = seg->term[seg_end];
+	int                 a_end = self->term_end[end];
+	int                 b_end = seg->term_end[seg_end];
+	a->link[a_end]     = b;
+	a->link_end[a_end] = b_end;
+	b->link[b_end]     = a;
+	b->link_end[b_end] = a_end;
+
+	// the far end of seg replaces the joined end
+	self->term[end]     = seg->term[1 - seg_end];
+	self->term_end[end] = seg->term_end[1 - seg_end];
+
+	// the joined nd is shared
+	self->chain_count += seg->chain_count - 1;
+}
+
+int osmdb_waySegment_flatten(osmdb_waySegment_t* self,
+                             osmdb_arena_t* arena)
+{
+	ASSERT(self);
+	ASSERT(arena);
+
+	// check if the segment was joined
+	if(self->chain_count == self->count)
+	{
+		return 1;
+	}
+
+	int count = self->chain_count;
+
+	int64_t*           nds;
+	osmdb_tilePoint_t* wpts;
+	nds  = (int64_t*)
+	       osmdb_arena_alloc(arena, count*sizeof(int64_t));
+	wpts = (osmdb_tilePoint_t*)
+	       osmdb_arena_alloc(arena,
+	                         count*sizeof(osmdb_tilePoint_t));
+	if((nds == NULL) || (wpts == NULL))
+	{
+		return 0;
+	}
+
+	// walk the chain from the head where the first nd of
+	// each linked segment is shared with the previous
+	int                 i;
+	int                 k;
+	int                 j    = 0;
+	int                 skip = 0;
+	osmdb_waySegment_t* seg  = self->term[OSMDB_WAYSEGMENT_HEAD];
+	int                 end  = self->term_end[OSMDB_WAYSEGMENT_HEAD];
+	while(seg)
+	{
+		for(k = skip; k < seg->count; ++k)
 		{
-			int64_t* ref;
-			ref = (int64_t*) cc_list_remove(seg->list_nds, &iter);
-			FREE(ref);
-		}
-		cc_list_delete(&seg->list_nds);
+			i = k;
+			if(end == OSMDB_WAYSEGMENT_TAIL)
+			{
+				i = seg->count - 1 - k;
+			}
 
-		osmdb_index_put(index, &seg->hwi);
+			nds[j]  = seg->nds[i];
+			wpts[j] = seg->wpts[i];
+			++j;
+		}
 
-		FREE(seg);
-		*_seg = NULL;
+		int next_end = seg->link_end[1 - end];
+		seg  = seg->link[1 - end];
+		end  = next_end;
+		skip = 1;
 	}
+	ASSERT(j == count);
+
+	self->count = count;
+	self->nds   = nds;
+	self->wpts  = wpts;
+
+	// the segment is now a chain of one
+	self->link[OSMDB_WAYSEGMENT_HEAD] = NULL;
+	self->link[OSMDB_WAYSEGMENT_TAIL] = NULL;
+	osmdb_waySegment_initChain(self);
+
+	return 1;
 }
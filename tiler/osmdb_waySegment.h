@@ -24,24 +24,93 @@
 #ifndef osmdb_waySegment_H
 #define osmdb_waySegment_H
 
-#include "libcc/cc_list.h"
 #include "../index/osmdb_index.h"
+#include "osmdb_arena.h"
+#include "osmdb_ostream.h"
 
-typedef struct
+#define OSMDB_WAYSEGMENT_HEAD 0
+#define OSMDB_WAYSEGMENT_TAIL 1
+
+// world coordinates of nds which are missing due to osmosis
+#define OSMDB_WAYSEGMENT_MISSING -1
+
+typedef struct osmdb_waySegment_s
 {
-	osmdb_handle_t* hwi;
+	// way_info references the hwi handle or the packed
+	// way_info when the segment was unpacked from the
+	// geometry cache in which case hwi is NULL
+	osmdb_handle_t*  hwi;
+	osmdb_wayInfo_t* way_info;
 
 	osmdb_wayRange_t way_range;
 
 	int flags;
 
-	cc_list_t* list_nds;
+	// nds and their world coordinates (see
+	// osmdb_proj_coord2world) which are resolved once when
+	// the segment is created
+	int                count;
+	int64_t*           nds;
+	osmdb_tilePoint_t* wpts;
+
+	// segments are joined in constant time by linking the
+	// ends of segments where link[end] is the neighbor
+	// joined at end of this segment and link_end[end] is
+	// the end of the neighbor
+	struct osmdb_waySegment_s* link[2];
+	int                        link_end[2];
+
+	// the segment which represents a chain tracks the
+	// terminal segments/ends of the chain until the chain
+	// is flattened
+	struct osmdb_waySegment_s* term[2];
+	int                        term_end[2];
+	int                        chain_count;
+
+	// pts are the tile space points for nds which are
+	// projected once the segments have been joined
+	// clipping replaces the pts and may split the way into
+	// parts such that the pts no longer match the nds
+	int                npts;
+	osmdb_tilePoint_t* pts;
+	int                nparts;
+	int*               parts;
 } osmdb_waySegment_t;
 
-int  osmdb_waySegment_new(osmdb_index_t* index,
-                          int tid, int64_t wid, int flags,
-                          osmdb_waySegment_t** _seg);
-void osmdb_waySegment_delete(osmdb_index_t* index,
-                             osmdb_waySegment_t** _seg);
+int      osmdb_waySegment_new(osmdb_index_t* index,
+                              osmdb_arena_t* arena,
+                              int tid, int64_t wid, int flags,
+                              osmdb_waySegment_t** _seg);
+int      osmdb_waySegment_newRing(osmdb_index_t* index,
+                                  osmdb_arena_t* arena,
+                                  int tid,
+                                  osmdb_relRing_t* ring,
+                                  int flags,
+                                  osmdb_waySegment_t** _seg);
+int      osmdb_waySegment_newChain(osmdb_index_t* index,
+                                   osmdb_arena_t* arena,
+                                   int tid, int type,
+                                   int64_t cid, int flags,
+                                   osmdb_waySegment_t** _seg);
+void     osmdb_waySegment_delete(osmdb_index_t* index,
+                                 osmdb_waySegment_t** _seg);
+osmdb_waySegment_t*
+         osmdb_waySegment_unpack(osmdb_arena_t* arena,
+                                 void* data,
+                                 size_t* _size);
+size_t   osmdb_waySegment_packSize(osmdb_waySegment_t* self);
+void     osmdb_waySegment_pack(osmdb_waySegment_t* self,
+                               const osmdb_tilePoint_t* pts,
+                               int dx, int dy, void* data);
+int64_t* osmdb_waySegment_nds(osmdb_waySegment_t* self);
+int64_t  osmdb_waySegment_endNd(osmdb_waySegment_t* self,
+                                int end, int offset,
+                                osmdb_tilePoint_t* wpt);
+void     osmdb_waySegment_join(osmdb_waySegment_t* self,
+                               int end,
+                               osmdb_waySegment_t* seg,
+                               int seg_end);
+int      osmdb_waySegment_flatten(osmdb_waySegment_t* self,
+                                  osmdb_arena_t* arena);
 
 #endif